@@ -0,0 +1,65 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+static void *default_alloc(void *user_data, size_t size)
+{
+        return malloc(size);
+}
+
+static void *default_realloc(void *user_data, void *ptr, size_t size)
+{
+        return realloc(ptr, size);
+}
+
+static void default_free(void *user_data, void *ptr)
+{
+        free(ptr);
+}
+
+const JSONAllocator json_default_allocator = {
+        default_alloc,
+        default_realloc,
+        default_free,
+        NULL,
+};
+
+void *json_allocator_alloc(const JSONAllocator *allocator, size_t size)
+{
+        return allocator->alloc(allocator->user_data, size);
+}
+
+void *json_allocator_realloc(const JSONAllocator *allocator,
+                             void *ptr, size_t size)
+{
+        return allocator->realloc(allocator->user_data, ptr, size);
+}
+
+void json_allocator_free(const JSONAllocator *allocator, void *ptr)
+{
+        if (ptr != NULL) {
+                allocator->free(allocator->user_data, ptr);
+        }
+}
+
@@ -0,0 +1,75 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_ALLOCATOR_H
+#define JIGSAWN_INTERNAL_ALLOCATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "jigsawn/allocator.h"
+
+/**
+ * The default allocator, which uses malloc, realloc and free.
+ */
+
+extern const JSONAllocator json_default_allocator;
+
+/**
+ * Allocate memory using a @ref JSONAllocator.
+ *
+ * @param allocator         The allocator.
+ * @param size              Size of the memory block, in bytes.
+ * @return                  Pointer to the memory, or NULL if out of memory.
+ */
+
+void *json_allocator_alloc(const JSONAllocator *allocator, size_t size);
+
+/**
+ * Resize memory allocated using a @ref JSONAllocator.
+ *
+ * @param allocator         The allocator.
+ * @param ptr               Pointer to the memory block, or NULL.
+ * @param size              New size of the memory block, in bytes.
+ * @return                  Pointer to the resized memory, or NULL if out
+ *                          of memory (in which case the original block
+ *                          is unchanged).
+ */
+
+void *json_allocator_realloc(const JSONAllocator *allocator,
+                             void *ptr, size_t size);
+
+/**
+ * Free memory allocated using a @ref JSONAllocator.
+ *
+ * @param allocator         The allocator.
+ * @param ptr               Pointer to the memory block, or NULL.
+ */
+
+void json_allocator_free(const JSONAllocator *allocator, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_ALLOCATOR_H */
+
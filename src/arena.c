@@ -0,0 +1,249 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "arena.h"
+
+/* Size of the blocks that allocations are made from. */
+
+#define ARENA_BLOCK_SIZE     (64 * 1024)
+
+/* Allocations larger than this get a block of their own, so that they
+ * do not waste the remainder of the current block. */
+
+#define ARENA_MAX_SHARED     (ARENA_BLOCK_SIZE / 4)
+
+struct _JSONArenaBlock {
+
+        /** Next (older) block in the list. */
+
+        JSONArenaBlock *next;
+
+        /** Size of the data area, in bytes. */
+
+        size_t size;
+
+        /** Number of bytes of the data area that are in use. */
+
+        size_t used;
+};
+
+/* Size of the block header, rounded up so that the data area is 
+ * aligned. */
+
+#define BLOCK_HEADER_SIZE \
+        ((sizeof(JSONArenaBlock) + JSON_ARENA_ALIGN - 1) \
+         & ~(JSON_ARENA_ALIGN - 1))
+
+#define BLOCK_DATA(block)   ((unsigned char *) (block) + BLOCK_HEADER_SIZE)
+
+struct _JSONArenaFree {
+        JSONArenaFree *next;
+};
+
+/* Round a size up to a multiple of the alignment. */
+
+static size_t round_size(size_t size)
+{
+        return (size + JSON_ARENA_ALIGN - 1) & ~(size_t) (JSON_ARENA_ALIGN - 1);
+}
+
+void json_arena_init(JSONArena *arena, const JSONAllocator *allocator)
+{
+        arena->allocator = allocator;
+        arena->blocks = NULL;
+        memset(arena->freelists, 0, sizeof(arena->freelists));
+}
+
+/* Free a list of blocks. */
+
+static void free_blocks(JSONArena *arena, JSONArenaBlock *block)
+{
+        JSONArenaBlock *next;
+
+        while (block != NULL) {
+                next = block->next;
+                json_allocator_free(arena->allocator, block);
+                block = next;
+        }
+}
+
+void json_arena_free_all(JSONArena *arena)
+{
+        free_blocks(arena, arena->blocks);
+        json_arena_init(arena, arena->allocator);
+}
+
+void json_arena_reset(JSONArena *arena)
+{
+        JSONArenaBlock *block, *next;
+        JSONArenaBlock *keep;
+
+        /* Free all blocks, except that the first block allocated (the
+         * last in the list) is kept for reuse, if it is a standard
+         * size block. */
+
+        keep = NULL;
+
+        for (block = arena->blocks; block != NULL; block = next) {
+                next = block->next;
+
+                if (next == NULL && block->size == ARENA_BLOCK_SIZE) {
+                        keep = block;
+                        keep->used = 0;
+                } else {
+                        json_allocator_free(arena->allocator, block);
+                }
+        }
+
+        arena->blocks = keep;
+        memset(arena->freelists, 0, sizeof(arena->freelists));
+}
+
+/* Allocate a new block with a data area of at least the given size,
+ * and add it to the arena.  dedicated is non-zero if the block is for
+ * a single allocation.  Returns NULL if out of memory. */
+
+static JSONArenaBlock *new_block(JSONArena *arena, size_t size,
+                                 int dedicated)
+{
+        JSONArenaBlock *block;
+
+        block = json_allocator_alloc(arena->allocator,
+                                     BLOCK_HEADER_SIZE + size);
+
+        if (block == NULL) {
+                return NULL;
+        }
+
+        block->size = size;
+        block->used = 0;
+
+        /* Dedicated blocks go behind the current block, so that the
+         * space left in it can continue to be used. */
+
+        if (dedicated && arena->blocks != NULL) {
+                block->next = arena->blocks->next;
+                arena->blocks->next = block;
+        } else {
+                block->next = arena->blocks;
+                arena->blocks = block;
+        }
+
+        return block;
+}
+
+void *json_arena_alloc(JSONArena *arena, size_t size)
+{
+        JSONArenaBlock *block;
+        JSONArenaFree *recycled;
+        void *result;
+
+        size = round_size(size);
+
+        /* Reuse a previously released allocation if possible. */
+
+        if (size > 0 && size <= JSON_ARENA_MAX_SMALL) {
+                recycled = arena->freelists[size / JSON_ARENA_ALIGN - 1];
+
+                if (recycled != NULL) {
+                        arena->freelists[size / JSON_ARENA_ALIGN - 1]
+                                = recycled->next;
+                        return recycled;
+                }
+        }
+
+        if (size > ARENA_MAX_SHARED) {
+                block = new_block(arena, size, 1);
+
+                if (block == NULL) {
+                        return NULL;
+                }
+
+                block->used = size;
+
+                return BLOCK_DATA(block);
+        }
+
+        /* Bump allocate from the current block, starting a new one if
+         * there is not enough space left. */
+
+        block = arena->blocks;
+
+        if (block == NULL || block->size - block->used < size) {
+                block = new_block(arena, ARENA_BLOCK_SIZE, 0);
+
+                if (block == NULL) {
+                        return NULL;
+                }
+        }
+
+        result = BLOCK_DATA(block) + block->used;
+        block->used += size;
+
+        return result;
+}
+
+void json_arena_release(JSONArena *arena, void *ptr, size_t size)
+{
+        JSONArenaFree *recycled;
+
+        size = round_size(size);
+
+        if (ptr == NULL || size == 0 || size > JSON_ARENA_MAX_SMALL) {
+                return;
+        }
+
+        recycled = ptr;
+        recycled->next = arena->freelists[size / JSON_ARENA_ALIGN - 1];
+        arena->freelists[size / JSON_ARENA_ALIGN - 1] = recycled;
+}
+
+char *json_arena_strdup(JSONArena *arena, const char *str)
+{
+        char *result;
+        size_t len;
+
+        len = strlen(str) + 1;
+        result = json_arena_alloc(arena, len);
+
+        if (result != NULL) {
+                memcpy(result, str, len);
+        }
+
+        return result;
+}
+
+char *json_arena_strndup(JSONArena *arena, const char *str, size_t len)
+{
+        char *result;
+
+        result = json_arena_alloc(arena, len + 1);
+
+        if (result != NULL) {
+                memcpy(result, str, len);
+                result[len] = '\0';
+        }
+
+        return result;
+}
+
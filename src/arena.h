@@ -0,0 +1,153 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_ARENA_H
+#define JIGSAWN_INTERNAL_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+/*
+ * Arena allocator.  Memory is allocated from large blocks by bumping
+ * a pointer, and is all released at once when the arena is reset or
+ * freed.  Small allocations that are freed individually are kept on
+ * per-size freelists and recycled.
+ */
+
+/** Alignment of all allocations from an arena. */
+
+#define JSON_ARENA_ALIGN          16
+
+/** Allocations up to this size are recycled through freelists. */
+
+#define JSON_ARENA_MAX_SMALL      256
+
+/** Number of freelists (size classes). */
+
+#define JSON_ARENA_NUM_CLASSES    (JSON_ARENA_MAX_SMALL / JSON_ARENA_ALIGN)
+
+typedef struct _JSONArena JSONArena;
+typedef struct _JSONArenaBlock JSONArenaBlock;
+typedef struct _JSONArenaFree JSONArenaFree;
+
+struct _JSONArena {
+
+        /** Allocator used to allocate blocks. */
+
+        const JSONAllocator *allocator;
+
+        /** Block currently being allocated from; earlier blocks follow. */
+
+        JSONArenaBlock *blocks;
+
+        /** Freelists of recycled allocations, one per size class. */
+
+        JSONArenaFree *freelists[JSON_ARENA_NUM_CLASSES];
+};
+
+/**
+ * Initialise a @ref JSONArena.  No memory is allocated until the
+ * first allocation is made.
+ *
+ * @param arena             Pointer to the arena to initialise.
+ * @param allocator         Allocator to allocate blocks of memory from.
+ *                          The pointer must remain valid until the 
+ *                          arena is freed.
+ */
+
+void json_arena_init(JSONArena *arena, const JSONAllocator *allocator);
+
+/**
+ * Free all memory used by a @ref JSONArena.
+ *
+ * @param arena             The arena.
+ */
+
+void json_arena_free_all(JSONArena *arena);
+
+/**
+ * Release all allocations made from a @ref JSONArena, so that the 
+ * memory can be reused.  The first block is kept for reuse; other
+ * blocks are freed.
+ *
+ * @param arena             The arena.
+ */
+
+void json_arena_reset(JSONArena *arena);
+
+/**
+ * Allocate memory from a @ref JSONArena.
+ *
+ * @param arena             The arena.
+ * @param size              Size of the allocation, in bytes.
+ * @return                  Pointer to the new memory, or NULL if out of
+ *                          memory.
+ */
+
+void *json_arena_alloc(JSONArena *arena, size_t size);
+
+/**
+ * Return memory allocated with @ref json_arena_alloc so that it can be
+ * reused by later allocations of the same size class.  Large 
+ * allocations are not recycled, and are only released when the arena
+ * is reset.
+ *
+ * @param arena             The arena.
+ * @param ptr               Pointer to the memory.
+ * @param size              Size passed to @ref json_arena_alloc.
+ */
+
+void json_arena_release(JSONArena *arena, void *ptr, size_t size);
+
+/**
+ * Copy a string into a @ref JSONArena.
+ *
+ * @param arena             The arena.
+ * @param str               The string to copy.
+ * @return                  Pointer to the copy, or NULL if out of memory.
+ */
+
+char *json_arena_strdup(JSONArena *arena, const char *str);
+
+/**
+ * Copy a string of known length into a @ref JSONArena, adding a 
+ * terminating NUL.  The string need not be NUL-terminated itself.
+ *
+ * @param arena             The arena.
+ * @param str               The string to copy.
+ * @param len               Length of the string, in bytes.
+ * @return                  Pointer to the copy, which is len + 1 bytes
+ *                          long, or NULL if out of memory.
+ */
+
+char *json_arena_strndup(JSONArena *arena, const char *str, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_ARENA_H */
+
@@ -0,0 +1,334 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#ifdef HAVE_LIBZSTD
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#endif
+
+#include "jigsawn/error.h"
+
+#include "decompress.h"
+
+struct _JSONDecompressor {
+        JSONCompression compression;
+        const JSONAllocator *allocator;
+
+        /** Non-zero when the end of a stream has been reached. */
+
+        int at_end;
+
+        z_stream zstream;
+
+#ifdef HAVE_LIBZSTD
+        ZSTD_DStream *zstd_stream;
+#endif
+};
+
+JSONCompression json_decompress_detect(const unsigned char *data,
+                                       size_t data_len)
+{
+        /* gzip: ID1, ID2, and CM (always 8, deflate) */
+
+        if (data_len >= 3
+         && data[0] == 0x1f && data[1] == 0x8b && data[2] == 0x08) {
+                return JSON_COMPRESSION_GZIP;
+        }
+
+#ifdef HAVE_LIBZSTD
+        /* zstd: frame magic number 0xFD2FB528, little endian */
+
+        if (data_len >= 4
+         && data[0] == 0x28 && data[1] == 0xb5
+         && data[2] == 0x2f && data[3] == 0xfd) {
+                return JSON_COMPRESSION_ZSTD;
+        }
+#endif
+
+        return JSON_COMPRESSION_NONE;
+}
+
+/* Memory allocation functions, so that zlib and zstd allocate through
+ * the decompressor's allocator. */
+
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size)
+{
+        return json_allocator_alloc(opaque, (size_t) items * size);
+}
+
+static void zlib_free(voidpf opaque, voidpf ptr)
+{
+        json_allocator_free(opaque, ptr);
+}
+
+#ifdef HAVE_ZSTD_CREATEDSTREAM_ADVANCED
+
+static void *zstd_alloc(void *opaque, size_t size)
+{
+        return json_allocator_alloc(opaque, size);
+}
+
+static void zstd_free(void *opaque, void *ptr)
+{
+        json_allocator_free(opaque, ptr);
+}
+
+#endif
+
+JSONDecompressor *json_decompressor_new(JSONCompression compression,
+                                        const JSONAllocator *allocator)
+{
+        JSONDecompressor *decompressor;
+#ifdef HAVE_ZSTD_CREATEDSTREAM_ADVANCED
+        ZSTD_customMem zstd_mem;
+#endif
+
+        decompressor = json_allocator_alloc(allocator, sizeof(JSONDecompressor));
+
+        if (decompressor == NULL) {
+                return NULL;
+        }
+
+        decompressor->compression = compression;
+        decompressor->allocator = allocator;
+        decompressor->at_end = 1;
+
+        switch (compression) {
+                case JSON_COMPRESSION_GZIP:
+                        memset(&decompressor->zstream, 0, 
+                               sizeof(decompressor->zstream));
+                        decompressor->zstream.zalloc = zlib_alloc;
+                        decompressor->zstream.zfree = zlib_free;
+                        decompressor->zstream.opaque = (voidpf) allocator;
+
+                        /* Window bits + 16 selects the gzip format. */
+
+                        if (inflateInit2(&decompressor->zstream,
+                                         MAX_WBITS + 16) != Z_OK) {
+                                json_allocator_free(allocator, decompressor);
+                                return NULL;
+                        }
+                        break;
+
+#ifdef HAVE_LIBZSTD
+                case JSON_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD_CREATEDSTREAM_ADVANCED
+                        zstd_mem.customAlloc = zstd_alloc;
+                        zstd_mem.customFree = zstd_free;
+                        zstd_mem.opaque = (void *) allocator;
+
+                        decompressor->zstd_stream
+                                = ZSTD_createDStream_advanced(zstd_mem);
+#else
+                        decompressor->zstd_stream = ZSTD_createDStream();
+#endif
+
+                        if (decompressor->zstd_stream == NULL) {
+                                json_allocator_free(allocator, decompressor);
+                                return NULL;
+                        }
+
+                        ZSTD_initDStream(decompressor->zstd_stream);
+                        break;
+#endif
+
+                default:
+                        break;
+        }
+
+        return decompressor;
+}
+
+void json_decompressor_free(JSONDecompressor *decompressor)
+{
+        switch (decompressor->compression) {
+                case JSON_COMPRESSION_GZIP:
+                        inflateEnd(&decompressor->zstream);
+                        break;
+
+#ifdef HAVE_LIBZSTD
+                case JSON_COMPRESSION_ZSTD:
+                        ZSTD_freeDStream(decompressor->zstd_stream);
+                        break;
+#endif
+
+                default:
+                        break;
+        }
+
+        json_allocator_free(decompressor->allocator, decompressor);
+}
+
+/* Decompress gzip data.  Returns zero for success, or negative error 
+ * code. */
+
+static int run_gzip(JSONDecompressor *decompressor,
+                    const unsigned char *input, size_t input_len,
+                    size_t *input_used,
+                    unsigned char *output, size_t output_len,
+                    size_t *output_used)
+{
+        z_stream *zstream;
+        int result;
+
+        zstream = &decompressor->zstream;
+
+        /* zlib counts the input and output in unsigned ints, so 
+         * larger buffers (such as a memory mapped file of 4 GiB or 
+         * more) are given to it a part at a time; the caller passes 
+         * the rest in the next call. */
+
+        if (input_len > UINT_MAX) {
+                input_len = UINT_MAX;
+        }
+
+        if (output_len > UINT_MAX) {
+                output_len = UINT_MAX;
+        }
+
+        zstream->next_in = (Bytef *) input;
+        zstream->avail_in = input_len;
+        zstream->next_out = output;
+        zstream->avail_out = output_len;
+
+        /* Output may still be waiting to be flushed even when all
+         * input has been used, so continue until no more progress 
+         * can be made. */
+
+        while (zstream->avail_out > 0) {
+
+                /* Start of the next member of a multi-member file? */
+
+                if (decompressor->at_end) {
+                        if (zstream->avail_in == 0) {
+                                break;
+                        }
+
+                        inflateReset(zstream);
+                        decompressor->at_end = 0;
+                }
+
+                result = inflate(zstream, Z_NO_FLUSH);
+
+                if (result == Z_STREAM_END) {
+                        decompressor->at_end = 1;
+                } else if (result == Z_BUF_ERROR) {
+                        break;
+                } else if (result != Z_OK) {
+                        return JSON_ERROR_INPUT_STREAM;
+                }
+        }
+
+        *input_used = input_len - zstream->avail_in;
+        *output_used = output_len - zstream->avail_out;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+#ifdef HAVE_LIBZSTD
+
+/* Decompress zstd data.  Returns zero for success, or negative error 
+ * code. */
+
+static int run_zstd(JSONDecompressor *decompressor,
+                    const unsigned char *input, size_t input_len,
+                    size_t *input_used,
+                    unsigned char *output, size_t output_len,
+                    size_t *output_used)
+{
+        ZSTD_inBuffer in;
+        ZSTD_outBuffer out;
+        size_t in_pos, out_pos;
+        size_t result;
+
+        in.src = input;
+        in.size = input_len;
+        in.pos = 0;
+        out.dst = output;
+        out.size = output_len;
+        out.pos = 0;
+
+        /* As with gzip, continue until no more progress can be
+         * made, as output may be waiting to be flushed. */
+
+        while (out.pos < out.size) {
+                in_pos = in.pos;
+                out_pos = out.pos;
+
+                result = ZSTD_decompressStream(decompressor->zstd_stream,
+                                               &out, &in);
+
+                if (ZSTD_isError(result)) {
+                        return JSON_ERROR_INPUT_STREAM;
+                }
+
+                if (in.pos == in_pos && out.pos == out_pos) {
+                        break;
+                }
+
+                /* Zero means that a frame has been completely decoded
+                 * and flushed; zstd starts the next frame itself. */
+
+                decompressor->at_end = result == 0;
+        }
+
+        *input_used = in.pos;
+        *output_used = out.pos;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+#endif
+
+int json_decompressor_run(JSONDecompressor *decompressor,
+                          const unsigned char *input, size_t input_len,
+                          size_t *input_used,
+                          unsigned char *output, size_t output_len,
+                          size_t *output_used)
+{
+        switch (decompressor->compression) {
+                case JSON_COMPRESSION_GZIP:
+                        return run_gzip(decompressor, input, input_len,
+                                        input_used, output, output_len,
+                                        output_used);
+
+#ifdef HAVE_LIBZSTD
+                case JSON_COMPRESSION_ZSTD:
+                        return run_zstd(decompressor, input, input_len,
+                                        input_used, output, output_len,
+                                        output_used);
+#endif
+
+                default:
+                        return JSON_ERROR_INPUT_STREAM;
+        }
+}
+
+int json_decompressor_at_end(JSONDecompressor *decompressor)
+{
+        return decompressor->at_end;
+}
+
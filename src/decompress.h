@@ -0,0 +1,131 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_DECOMPRESS_H
+#define JIGSAWN_INTERNAL_DECOMPRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+/*
+ * Decompression of compressed input streams.
+ */
+
+typedef struct _JSONDecompressor JSONDecompressor;
+
+/**
+ * Compression format of an input stream.
+ */
+
+typedef enum {
+        JSON_COMPRESSION_NONE,            /* Not compressed */
+        JSON_COMPRESSION_GZIP,            /* gzip (RFC 1952) */
+        JSON_COMPRESSION_ZSTD,            /* Zstandard (RFC 8878) */
+} JSONCompression;
+
+/** Number of bytes needed by @ref json_decompress_detect. */
+
+#define JSON_DECOMPRESS_MAGIC_LEN    4
+
+/**
+ * Detect the compression format of an input stream from the magic
+ * bytes at its start.  Formats that are not supported by this build
+ * are not detected.
+ *
+ * @param data              Pointer to the start of the stream.
+ * @param data_len          Length of the data available.  At least
+ *                          @ref JSON_DECOMPRESS_MAGIC_LEN bytes are
+ *                          needed to detect all formats.
+ * @return                  The compression format.
+ */
+
+JSONCompression json_decompress_detect(const unsigned char *data,
+                                       size_t data_len);
+
+/**
+ * Create a new @ref JSONDecompressor.
+ *
+ * @param compression       The compression format.
+ * @param allocator         Allocator to allocate memory from.  The 
+ *                          pointer must remain valid until the 
+ *                          decompressor is freed.
+ * @return                  A new decompressor, or NULL if out of memory.
+ */
+
+JSONDecompressor *json_decompressor_new(JSONCompression compression,
+                                        const JSONAllocator *allocator);
+
+/**
+ * Free a @ref JSONDecompressor.
+ *
+ * @param decompressor      The decompressor.
+ */
+
+void json_decompressor_free(JSONDecompressor *decompressor);
+
+/**
+ * Decompress data.  Decompression continues until the output buffer
+ * is full, all of the input has been used, or the end of the 
+ * compressed stream is reached.  Multiple concatenated streams (gzip 
+ * members or zstd frames) are decompressed as one.
+ *
+ * @param decompressor      The decompressor.
+ * @param input             Pointer to compressed input data.
+ * @param input_len         Length of the input data, in bytes.
+ * @param input_used        Pointer to a variable to store the number
+ *                          of bytes of input that were used.
+ * @param output            Buffer in which to store decompressed data.
+ * @param output_len        Size of the output buffer, in bytes.
+ * @param output_used       Pointer to a variable to store the number
+ *                          of bytes of output that were produced.
+ * @return                  Zero for success, or negative error code
+ *                          if the input is corrupt.
+ */
+
+int json_decompressor_run(JSONDecompressor *decompressor,
+                          const unsigned char *input, size_t input_len,
+                          size_t *input_used,
+                          unsigned char *output, size_t output_len,
+                          size_t *output_used);
+
+/**
+ * Query whether a @ref JSONDecompressor is at the boundary between 
+ * compressed streams, ie. all data passed to it so far forms complete
+ * streams.  If the input ends when this is not true, the input was
+ * truncated.
+ *
+ * @param decompressor      The decompressor.
+ * @return                  Non-zero if at the end of a stream.
+ */
+
+int json_decompressor_at_end(JSONDecompressor *decompressor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_DECOMPRESS_H */
+
@@ -0,0 +1,523 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "jigsawn/error.h"
+
+#include "file-reader.h"
+
+/* Number of reads kept in flight, and the size of each.  Reads are
+ * made at offsets in the file that are multiples of the block size,
+ * into buffers that are aligned to a page boundary. */
+
+#define FILE_READER_DEPTH         4
+#define FILE_READER_BLOCK_SIZE    (1024 * 1024)
+#define FILE_READER_ALIGN         4096
+
+typedef struct {
+        unsigned char *data;
+
+        /** Offset in the file of the start of the block. */
+
+        off_t offset;
+
+        /** Number of bytes of data read into the block so far. */
+
+        size_t len;
+
+        /** If true, an asynchronous read into the block is in flight. */
+
+        int in_flight;
+
+        /** Result of the asynchronous read: byte count or -errno. */
+
+        int result;
+
+        struct iovec iov;
+} JSONFileBlock;
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+/* io_uring submission and completion queues, mapped from the kernel. */
+
+typedef struct {
+        int fd;
+
+        void *sq_ring;
+        size_t sq_ring_len;
+        void *cq_ring;
+        size_t cq_ring_len;
+        struct io_uring_sqe *sqes;
+        size_t sqes_len;
+
+        unsigned int *sq_tail;
+        unsigned int *sq_mask;
+        unsigned int *sq_array;
+        unsigned int *cq_head;
+        unsigned int *cq_tail;
+        unsigned int *cq_mask;
+        struct io_uring_cqe *cqes;
+
+        /** Number of reads queued that have not yet been submitted. */
+
+        unsigned int to_submit;
+} JSONFileRing;
+
+#endif
+
+struct _JSONFileReader {
+        int fd;
+        const JSONAllocator *allocator;
+        JSONInputStats *stats;
+
+        /** Memory allocated for the blocks, before alignment. */
+
+        void *buffer_memory;
+
+        JSONFileBlock blocks[FILE_READER_DEPTH];
+
+        /** Index of the block to return next. */
+
+        unsigned int head;
+
+        /** If true, the caller holds the block at head. */
+
+        int holding;
+
+        /** If true, the end of the file has been reached. */
+
+        int finished;
+
+        /** Offset in the file of the next block to read. */
+
+        off_t next_offset;
+
+#ifdef HAVE_LINUX_IO_URING_H
+        /** If true, reads are made with io_uring. */
+
+        int use_ring;
+
+        JSONFileRing ring;
+#endif
+};
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+/* Set up an io_uring.  Returns zero if io_uring is not available. */
+
+static int json_file_ring_init(JSONFileRing *ring)
+{
+        struct io_uring_params params;
+
+        memset(&params, 0, sizeof(params));
+        ring->fd = syscall(__NR_io_uring_setup, FILE_READER_DEPTH, &params);
+
+        if (ring->fd < 0) {
+                return 0;
+        }
+
+        ring->sq_ring_len = params.sq_off.array
+                          + params.sq_entries * sizeof(unsigned int);
+        ring->cq_ring_len = params.cq_off.cqes
+                          + params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        /* Newer kernels map both rings with a single mapping. */
+
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0
+         && ring->cq_ring_len > ring->sq_ring_len) {
+                ring->sq_ring_len = ring->cq_ring_len;
+        }
+
+        ring->sq_ring = mmap(NULL, ring->sq_ring_len,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE,
+                             ring->fd, IORING_OFF_SQ_RING);
+
+        if (ring->sq_ring == MAP_FAILED) {
+                close(ring->fd);
+                return 0;
+        }
+
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+                ring->cq_ring = ring->sq_ring;
+        } else {
+                ring->cq_ring = mmap(NULL, ring->cq_ring_len,
+                                     PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE,
+                                     ring->fd, IORING_OFF_CQ_RING);
+
+                if (ring->cq_ring == MAP_FAILED) {
+                        munmap(ring->sq_ring, ring->sq_ring_len);
+                        close(ring->fd);
+                        return 0;
+                }
+        }
+
+        ring->sqes = mmap(NULL, ring->sqes_len,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQES);
+
+        if (ring->sqes == MAP_FAILED) {
+                if (ring->cq_ring != ring->sq_ring) {
+                        munmap(ring->cq_ring, ring->cq_ring_len);
+                }
+                munmap(ring->sq_ring, ring->sq_ring_len);
+                close(ring->fd);
+                return 0;
+        }
+
+        ring->sq_tail = (unsigned int *) ((char *) ring->sq_ring
+                                          + params.sq_off.tail);
+        ring->sq_mask = (unsigned int *) ((char *) ring->sq_ring
+                                          + params.sq_off.ring_mask);
+        ring->sq_array = (unsigned int *) ((char *) ring->sq_ring
+                                           + params.sq_off.array);
+        ring->cq_head = (unsigned int *) ((char *) ring->cq_ring
+                                          + params.cq_off.head);
+        ring->cq_tail = (unsigned int *) ((char *) ring->cq_ring
+                                          + params.cq_off.tail);
+        ring->cq_mask = (unsigned int *) ((char *) ring->cq_ring
+                                          + params.cq_off.ring_mask);
+        ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring
+                                              + params.cq_off.cqes);
+        ring->to_submit = 0;
+
+        return 1;
+}
+
+static void json_file_ring_free(JSONFileRing *ring)
+{
+        munmap(ring->sqes, ring->sqes_len);
+
+        if (ring->cq_ring != ring->sq_ring) {
+                munmap(ring->cq_ring, ring->cq_ring_len);
+        }
+
+        munmap(ring->sq_ring, ring->sq_ring_len);
+        close(ring->fd);
+}
+
+/* Queue a read into a block.  It is submitted by the next call to
+ * json_file_ring_enter. */
+
+static void json_file_ring_queue(JSONFileReader *reader,
+                                 unsigned int block_index)
+{
+        JSONFileRing *ring = &reader->ring;
+        JSONFileBlock *block = &reader->blocks[block_index];
+        struct io_uring_sqe *sqe;
+        unsigned int tail;
+        unsigned int index;
+
+        tail = *ring->sq_tail;
+        index = tail & *ring->sq_mask;
+
+        block->iov.iov_base = block->data;
+        block->iov.iov_len = FILE_READER_BLOCK_SIZE;
+
+        sqe = &ring->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = reader->fd;
+        sqe->addr = (uintptr_t) &block->iov;
+        sqe->len = 1;
+        sqe->off = block->offset;
+        sqe->user_data = block_index;
+
+        ring->sq_array[index] = index;
+
+        __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        ++ring->to_submit;
+        block->in_flight = 1;
+}
+
+/* Submit queued reads, and if min_complete is non-zero, wait for at
+ * least that many to complete.  Completed reads are marked as no
+ * longer in flight.  Returns zero for success, or error code. */
+
+static int json_file_ring_enter(JSONFileReader *reader,
+                                unsigned int min_complete)
+{
+        JSONFileRing *ring = &reader->ring;
+        struct io_uring_cqe *cqe;
+        JSONFileBlock *block;
+        unsigned int head, tail;
+        int result;
+
+        result = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit,
+                         min_complete,
+                         min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                         NULL, 0);
+        ++reader->stats->syscalls;
+
+        if (result < 0) {
+                return errno == EINTR ? JSON_ERROR_SUCCESS
+                                      : JSON_ERROR_INPUT_STREAM;
+        }
+
+        ring->to_submit -= result;
+
+        /* Collect the completed reads. */
+
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+                cqe = &ring->cqes[head & *ring->cq_mask];
+                block = &reader->blocks[cqe->user_data];
+                block->result = cqe->res;
+                block->in_flight = 0;
+                ++head;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        return JSON_ERROR_SUCCESS;
+}
+
+#endif /* #ifdef HAVE_LINUX_IO_URING_H */
+
+/* Read the rest of a block synchronously, until it is full or the
+ * end of the file is reached.  Returns zero for success, or error
+ * code. */
+
+static int json_file_reader_pread(JSONFileReader *reader,
+                                  JSONFileBlock *block)
+{
+        ssize_t result;
+
+        while (block->len < FILE_READER_BLOCK_SIZE) {
+                result = pread(reader->fd, block->data + block->len,
+                               FILE_READER_BLOCK_SIZE - block->len,
+                               block->offset + block->len);
+                ++reader->stats->syscalls;
+
+                if (result < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+
+                        return JSON_ERROR_INPUT_STREAM;
+                } else if (result == 0) {
+                        break;
+                }
+
+                block->len += result;
+                reader->stats->bytes_read += result;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Start reading the next block of the file into a block. */
+
+static void json_file_reader_start(JSONFileReader *reader,
+                                   unsigned int block_index)
+{
+        JSONFileBlock *block = &reader->blocks[block_index];
+
+        block->offset = reader->next_offset;
+        block->len = 0;
+        reader->next_offset += FILE_READER_BLOCK_SIZE;
+
+#ifdef HAVE_LINUX_IO_URING_H
+        if (reader->use_ring) {
+                json_file_ring_queue(reader, block_index);
+        }
+#endif
+}
+
+/* Wait for a block to be read.  Returns zero for success, or error
+ * code. */
+
+static int json_file_reader_wait(JSONFileReader *reader,
+                                 JSONFileBlock *block)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+        int err;
+
+        if (reader->use_ring) {
+
+                /* Submit the reads that were queued, even if the block
+                 * is already read, so that they stay in flight. */
+
+                do {
+                        err = json_file_ring_enter(reader,
+                                                   block->in_flight ? 1 : 0);
+
+                        if (err < 0) {
+                                return err;
+                        }
+                } while (block->in_flight);
+
+                /* If the read failed, or was short, the rest of the
+                 * block is read synchronously below; this also finds
+                 * the end of file after a short read. */
+
+                if (block->result > 0) {
+                        block->len = block->result;
+                        reader->stats->bytes_read += block->result;
+                }
+        }
+#endif
+
+        return json_file_reader_pread(reader, block);
+}
+
+JSONFileReader *json_file_reader_new(int fd,
+                                     const JSONAllocator *allocator,
+                                     JSONInputStats *stats)
+{
+        JSONFileReader *reader;
+        unsigned char *data;
+        unsigned int i;
+
+        reader = json_allocator_alloc(allocator, sizeof(JSONFileReader));
+
+        if (reader == NULL) {
+                return NULL;
+        }
+
+        reader->buffer_memory 
+                = json_allocator_alloc(allocator,
+                                       FILE_READER_DEPTH
+                                         * FILE_READER_BLOCK_SIZE
+                                       + FILE_READER_ALIGN);
+
+        if (reader->buffer_memory == NULL) {
+                json_allocator_free(allocator, reader);
+                return NULL;
+        }
+
+        reader->fd = fd;
+        reader->allocator = allocator;
+        reader->stats = stats;
+        reader->head = 0;
+        reader->holding = 0;
+        reader->finished = 0;
+        reader->next_offset = 0;
+
+        data = (unsigned char *)
+               (((uintptr_t) reader->buffer_memory + FILE_READER_ALIGN - 1)
+                & ~((uintptr_t) FILE_READER_ALIGN - 1));
+
+        for (i=0; i<FILE_READER_DEPTH; ++i) {
+                reader->blocks[i].data = data + i * FILE_READER_BLOCK_SIZE;
+                reader->blocks[i].in_flight = 0;
+                reader->blocks[i].result = 0;
+        }
+
+#ifdef HAVE_LINUX_IO_URING_H
+        reader->use_ring = json_file_ring_init(&reader->ring);
+#endif
+
+        /* Start reading the first blocks.  With io_uring, they are 
+         * submitted when the first block is waited for. */
+
+        for (i=0; i<FILE_READER_DEPTH; ++i) {
+                json_file_reader_start(reader, i);
+        }
+
+        return reader;
+}
+
+void json_file_reader_free(JSONFileReader *reader)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+        unsigned int i;
+
+        /* The kernel may still be writing into the blocks, so wait
+         * for the reads that are in flight before freeing them. */
+
+        if (reader->use_ring) {
+                for (i=0; i<FILE_READER_DEPTH; ++i) {
+                        while (reader->blocks[i].in_flight) {
+                                if (json_file_ring_enter(reader, 1) < 0) {
+                                        break;
+                                }
+                        }
+                }
+
+                json_file_ring_free(&reader->ring);
+        }
+#endif
+
+        json_allocator_free(reader->allocator, reader->buffer_memory);
+        json_allocator_free(reader->allocator, reader);
+}
+
+int json_file_reader_next(JSONFileReader *reader,
+                          const unsigned char **data,
+                          size_t *data_len)
+{
+        JSONFileBlock *block;
+        int err;
+
+        if (reader->finished) {
+                *data = NULL;
+                *data_len = 0;
+                return JSON_ERROR_SUCCESS;
+        }
+
+        /* Reuse the block we were holding to read further ahead. */
+
+        if (reader->holding) {
+                json_file_reader_start(reader, reader->head);
+                reader->head = (reader->head + 1) % FILE_READER_DEPTH;
+        }
+
+        reader->holding = 1;
+        block = &reader->blocks[reader->head];
+
+        err = json_file_reader_wait(reader, block);
+
+        if (err < 0) {
+                reader->finished = 1;
+                return err;
+        }
+
+        /* A block that is not full is the last one. */
+
+        if (block->len < FILE_READER_BLOCK_SIZE) {
+                reader->finished = 1;
+        }
+
+        *data = block->data;
+        *data_len = block->len;
+
+        return JSON_ERROR_SUCCESS;
+}
@@ -0,0 +1,91 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_FILE_READER_H
+#define JIGSAWN_INTERNAL_FILE_READER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "input-reader.h"
+
+/*
+ * Reading of files with asynchronous I/O: several large reads are 
+ * kept in flight at once using io_uring, where it is available, or
+ * made one at a time with pread() otherwise.
+ */
+
+typedef struct _JSONFileReader JSONFileReader;
+
+/**
+ * Create a new @ref JSONFileReader, and start reading from the 
+ * beginning of a file.
+ *
+ * @param fd                File descriptor of the file to read.  The
+ *                          file descriptor is not closed when the 
+ *                          reader is freed.
+ * @param allocator         Allocator to allocate memory from.  The 
+ *                          pointer must remain valid until the reader
+ *                          is freed.
+ * @param stats             Statistics to update as data is read.
+ * @return                  A new file reader, or NULL if out of memory.
+ */
+
+JSONFileReader *json_file_reader_new(int fd,
+                                     const JSONAllocator *allocator,
+                                     JSONInputStats *stats);
+
+/**
+ * Free a @ref JSONFileReader, waiting for any reads that are in 
+ * flight to complete.
+ *
+ * @param reader            The file reader.
+ */
+
+void json_file_reader_free(JSONFileReader *reader);
+
+/**
+ * Get the next block of data from a @ref JSONFileReader, waiting for
+ * it to be read if necessary.  The block returned by the previous call
+ * is reused for a new read, so it must no longer be used.
+ *
+ * @param reader            The file reader.
+ * @param data              Pointer to a variable to store a pointer to
+ *                          the data.
+ * @param data_len          Pointer to a variable to store the length
+ *                          of the data, which is zero at end of file.
+ * @return                  Zero for success, or negative error code if
+ *                          the file could not be read.
+ */
+
+int json_file_reader_next(JSONFileReader *reader,
+                          const unsigned char **data,
+                          size_t *data_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_FILE_READER_H */
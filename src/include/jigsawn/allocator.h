@@ -0,0 +1,65 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_ALLOCATOR_H
+#define JIGSAWN_ALLOCATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+/**
+ * A memory allocator.  All memory used by a @ref JSONParser is 
+ * allocated through the allocator that the parser was created with.
+ * All three functions must be provided; they have the same semantics
+ * as the standard C library functions of the same names, except that
+ * they also receive the user_data pointer.
+ */
+
+typedef struct _JSONAllocator JSONAllocator;
+
+struct _JSONAllocator {
+
+        /** Allocate a block of memory. */
+
+        void *(*alloc)(void *user_data, size_t size);
+
+        /** Resize a block of memory allocated with alloc. */
+
+        void *(*realloc)(void *user_data, void *ptr, size_t size);
+
+        /** Free a block of memory allocated with alloc or realloc. */
+
+        void (*free)(void *user_data, void *ptr);
+
+        /** Pointer passed to each of the functions. */
+
+        void *user_data;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_ALLOCATOR_H */
+
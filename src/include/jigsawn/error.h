@@ -33,6 +33,9 @@ extern "C" {
 #define JSON_ERROR_INPUT_STREAM     (-4)    /* Error while reading input */
 #define JSON_ERROR_END_OF_FILE      (-5)    /* End of file reached */
 #define JSON_ERROR_UNKNOWN_ENCODING (-6)    /* Unknown Unicode encoding */
+#define JSON_ERROR_TOO_LONG         (-7)    /* Size limit exceeded */
+#define JSON_ERROR_NEED_MORE        (-8)    /* More input must be fed */
+#define JSON_ERROR_INVALID_ARGUMENT (-9)    /* Invalid function argument */
 
 #ifdef __cplusplus
 }
@@ -27,6 +27,8 @@ extern "C" {
 #endif
 
 #include <stdlib.h>
+#include <sys/uio.h>
+#include "allocator.h"
 #include "value.h"
 
 /**
@@ -65,6 +67,48 @@ typedef int (*JSONInputReadFunc)(JSONInputSource source,
                                  unsigned char *data,
                                  size_t data_len);
 
+/**
+ * Statistics about the input read by a JSON parser, and the object
+ * keys read from it.
+ */
+
+typedef struct {
+
+        /** Number of bytes read from the input source. */
+
+        size_t bytes_read;
+
+        /** 
+         * Number of system calls made to read the input.  Each call to
+         * a read callback function is counted as one.
+         */
+
+        unsigned long read_syscalls;
+
+        /** System calls made per MiB read. */
+
+        double syscalls_per_mb;
+
+        /** 
+         * Number of object keys looked up in the parser's key intern
+         * table (see @ref json_mapping_get_key).
+         */
+
+        unsigned long key_lookups;
+
+        /** Number of keys looked up that had already been interned. */
+
+        unsigned long key_hits;
+
+        /** Proportion of keys looked up that had already been interned. */
+
+        double key_hit_rate;
+
+        /** Number of distinct keys interned. */
+
+        unsigned long distinct_keys;
+} JSONParserStats;
+
 /**
  * A JSON parser.
  */
@@ -76,7 +120,9 @@ typedef struct _JSONParser JSONParser;
  *
  * @param source        The source to read data from.
  * @param read_func     Callback function to invoke to read data from the
- *                      input source.
+ *                      input source.  If this is NULL, the parser is
+ *                      created in push mode, and data is supplied 
+ *                      with @ref json_parser_feed instead.
  * @return              A new @param JSONParser, or NULL if it was not
  *                      possible to create a new parser.
  */
@@ -84,6 +130,185 @@ typedef struct _JSONParser JSONParser;
 JSONParser *json_parser_new(JSONInputSource source,
                             JSONInputReadFunc read_func);
 
+/**
+ * Create a new @param JSONParser that allocates all of its memory 
+ * using the specified allocator, instead of the standard C library 
+ * functions.
+ *
+ * @param source        The source to read data from.
+ * @param read_func     Callback function to invoke to read data from the
+ *                      input source, or NULL for push mode (see
+ *                      @ref json_parser_feed).
+ * @param allocator     The allocator.  The structure is copied, so it
+ *                      need not remain valid after this call, but the
+ *                      user_data pointer it contains must remain valid
+ *                      until the parser is freed.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_with_allocator(JSONInputSource source,
+                                           JSONInputReadFunc read_func,
+                                           const JSONAllocator *allocator);
+
+/**
+ * Create a new @param JSONParser to read from a block of data already
+ * held in memory.  The data is read in place without being copied, 
+ * so it must remain valid until the parser is freed.
+ *
+ * @param data          Pointer to the JSON data.
+ * @param data_len      Length of the data, in bytes.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_from_memory(const void *data, size_t data_len);
+
+/**
+ * Create a new @param JSONParser to read from a block of data held in
+ * memory, as @ref json_parser_new_from_memory, that allocates all of 
+ * its memory using the specified allocator (see 
+ * @ref json_parser_new_with_allocator).
+ *
+ * @param data          Pointer to the JSON data.
+ * @param data_len      Length of the data, in bytes.
+ * @param allocator     The allocator.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_from_memory_with_allocator(
+                        const void *data, size_t data_len,
+                        const JSONAllocator *allocator);
+
+/**
+ * Create a new @param JSONParser to read from a writable block of 
+ * data held in memory, which is modified as it is read.  Strings are
+ * unescaped in place in the data and NUL-terminated there, so no 
+ * string values are copied, even those that contain escape sequences 
+ * (see @ref json_string_get_value).  The contents of the data are 
+ * undefined after parsing, and it must remain valid until the parser 
+ * is freed.  Compressed data and UTF-16 and UTF-32 data cannot be 
+ * modified in this way, and are read as by 
+ * @ref json_parser_new_from_memory.
+ *
+ * @param data          Pointer to the JSON data.
+ * @param data_len      Length of the data, in bytes.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_in_situ(void *data, size_t data_len);
+
+/**
+ * Create a new @param JSONParser to read from a writable block of 
+ * data held in memory, as @ref json_parser_new_in_situ, that 
+ * allocates all of its memory using the specified allocator (see 
+ * @ref json_parser_new_with_allocator).
+ *
+ * @param data          Pointer to the JSON data.
+ * @param data_len      Length of the data, in bytes.
+ * @param allocator     The allocator.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_in_situ_with_allocator(
+                        void *data, size_t data_len,
+                        const JSONAllocator *allocator);
+
+/**
+ * Create a new @param JSONParser to read from data held in memory in
+ * several segments (eg. a chain of network buffers), described by an
+ * array of iovec structures.  The segments are read in place, without
+ * being joined together, so the data and the array must remain valid
+ * until the parser is freed.
+ *
+ * @param iov           Pointer to the array of segments.
+ * @param iov_count     Number of segments in the array.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_from_iovec(const struct iovec *iov,
+                                       int iov_count);
+
+/**
+ * Create a new @param JSONParser to read from data held in memory in
+ * several segments, as @ref json_parser_new_from_iovec, that 
+ * allocates all of its memory using the specified allocator (see 
+ * @ref json_parser_new_with_allocator).
+ *
+ * @param iov           Pointer to the array of segments.
+ * @param iov_count     Number of segments in the array.
+ * @param allocator     The allocator.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to create a new parser.
+ */
+
+JSONParser *json_parser_new_from_iovec_with_allocator(
+                        const struct iovec *iov, int iov_count,
+                        const JSONAllocator *allocator);
+
+/**
+ * Create a new @param JSONParser to read from a file.  Regular files
+ * are mapped into memory and read in place; other files (eg. pipes)
+ * are read in blocks.
+ *
+ * @param filename      Path to the file to read.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to open the file or create a new parser.
+ */
+
+JSONParser *json_parser_new_from_file(const char *filename);
+
+/**
+ * Create a new @param JSONParser to read from a file, as 
+ * @ref json_parser_new_from_file, that allocates all of its memory 
+ * using the specified allocator (see 
+ * @ref json_parser_new_with_allocator).
+ *
+ * @param filename      Path to the file to read.
+ * @param allocator     The allocator.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to open the file or create a new parser.
+ */
+
+JSONParser *json_parser_new_from_file_with_allocator(
+                        const char *filename,
+                        const JSONAllocator *allocator);
+
+/**
+ * Create a new @param JSONParser to read from a file with 
+ * asynchronous I/O.  Several large reads are kept in flight at once
+ * with io_uring on Linux; where that is not available, the file is 
+ * read in large blocks with pread().  This suits large files on fast
+ * storage, which are read with far fewer system calls than through a
+ * callback function.
+ *
+ * @param filename      Path to the file to read.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to open the file or create a new parser.
+ */
+
+JSONParser *json_parser_new_from_file_async(const char *filename);
+
+/**
+ * Create a new @param JSONParser to read from a file with 
+ * asynchronous I/O, as @ref json_parser_new_from_file_async, that
+ * allocates all of its memory using the specified allocator (see 
+ * @ref json_parser_new_with_allocator).
+ *
+ * @param filename      Path to the file to read.
+ * @param allocator     The allocator.
+ * @return              A new @param JSONParser, or NULL if it was not
+ *                      possible to open the file or create a new parser.
+ */
+
+JSONParser *json_parser_new_from_file_async_with_allocator(
+                        const char *filename,
+                        const JSONAllocator *allocator);
+
 /**
  * Free a @param JSONParser.
  *
@@ -92,6 +317,159 @@ JSONParser *json_parser_new(JSONInputSource source,
 
 void json_parser_free(JSONParser *parser);
 
+/**
+ * Supply the next block of input data to a @param JSONParser that was
+ * created in push mode.  This allows data to be parsed as it arrives
+ * (eg. from a non-blocking socket), without blocking to wait for it.
+ * After feeding data, values should be read until a read fails and
+ * @ref json_parser_get_error returns @ref JSON_ERROR_NEED_MORE; only
+ * then can the next block be fed.  The data is read in place, so it
+ * must remain valid until that point, but not afterwards: a token
+ * that is split between blocks is resumed where it left off.
+ *
+ * @param parser        The parser.
+ * @param data          Pointer to the data.
+ * @param data_len      Length of the data, in bytes.  Passing zero
+ *                      indicates the end of the input.
+ * @return              Zero for success, or @ref JSON_ERROR_INPUT_STREAM
+ *                      if the parser is not in push mode, or data from
+ *                      the previous block is still waiting to be read.
+ */
+
+int json_parser_feed(JSONParser *parser, const void *data, size_t data_len);
+
+/**
+ * Read the next value from the input stream.  Arrays and objects are
+ * returned as a value from which their contents can then be read (see
+ * @ref json_value_read_next).  Any arrays and objects that were not 
+ * read to the end are skipped first.
+ *
+ * @param parser        The parser.
+ * @return              The new value, or NULL if no value could be 
+ *                      read; the reason is given by 
+ *                      @ref json_parser_get_error.
+ */
+
+JSONValue *json_parser_read_value(JSONParser *parser);
+
+/**
+ * Get the error code describing the result of the last read from a 
+ * @param JSONParser.
+ *
+ * @param parser        The parser.
+ * @return              @ref JSON_ERROR_SUCCESS if the last read 
+ *                      succeeded, @ref JSON_ERROR_NEED_MORE if more data
+ *                      must be fed to a push mode parser before the 
+ *                      read can succeed, or another error code.
+ */
+
+int json_parser_get_error(JSONParser *parser);
+
+/**
+ * Set the maximum length of string that a @param JSONParser will read.
+ * Input containing longer strings is treated as an error, and
+ * @ref json_parser_get_error returns @ref JSON_ERROR_TOO_LONG.  By 
+ * default there is no limit.
+ *
+ * @param parser        The parser.
+ * @param max_length    Maximum length of a string in bytes (when 
+ *                      encoded as UTF-8), or zero for no limit.
+ */
+
+void json_parser_set_max_string_length(JSONParser *parser,
+                                       size_t max_length);
+
+/**
+ * Read input for a @param JSONParser in a background thread, so that
+ * waiting for the input (eg. from a disk or pipe) overlaps with 
+ * parsing it.  The thread fills a ring of buffers ahead of the 
+ * parser; for example, 4 buffers of 1 MiB.  This must be called 
+ * before anything is read, and only affects parsers that read from a
+ * callback function or a file that cannot be mapped into memory.  The
+ * callback function is invoked from the background thread.
+ *
+ * @param parser        The parser.
+ * @param num_buffers   Number of buffers (at least 2).
+ * @param buffer_size   Size of each buffer, in bytes.
+ * @return              Zero for success, or @ref JSON_ERROR_INPUT_STREAM
+ *                      if reading has already started or the thread 
+ *                      could not be started.
+ */
+
+int json_parser_set_readahead(JSONParser *parser,
+                              unsigned int num_buffers,
+                              size_t buffer_size);
+
+/**
+ * Parse input held in memory in two stages: first, the positions of 
+ * all of the tokens in the document are found, with a fast scan that
+ * uses SIMD instructions where the CPU supports them, and then the
+ * values are read using this index, which allows the whitespace 
+ * between tokens to be skipped over in one step, and gives where each
+ * string, number and keyword ends, so that it can be read in one go.
+ * It only affects parsers that read from 
+ * memory or from a file that can be mapped into memory, and that are
+ * not compressed or in UTF-16 or UTF-32; other input is read as 
+ * normal.  Values are read in the same way whether or not the index 
+ * is used.  This must be called before anything is read.
+ *
+ * @param parser        The parser.
+ * @param num_threads   Number of threads to build the index with, or 
+ *                      zero to read without an index.  For very large
+ *                      documents, several threads each index part of
+ *                      the document; small documents are always 
+ *                      indexed by a single thread.
+ * @return              Zero for success, or @ref JSON_ERROR_INPUT_STREAM
+ *                      if reading has already started.
+ */
+
+int json_parser_set_structural_index(JSONParser *parser,
+                                     unsigned int num_threads);
+
+/**
+ * Register the set of object keys that the caller is interested in.
+ * Each key read is then looked up in the set with a perfect hash as
+ * it is read, and the index of the key in the array is given by 
+ * @ref json_mapping_get_key_id, so that mappings can be dispatched 
+ * with a switch statement.  Keys that are not in the set are not 
+ * copied or stored.  This must be called before anything is read.
+ *
+ * @param parser        The parser.
+ * @param keys          Array of keys, as NUL-terminated strings, which
+ *                      are copied.  If a key appears more than once, 
+ *                      the index of its first appearance is used.
+ * @param num_keys      Number of keys in the array.
+ * @return              Zero for success, 
+ *                      @ref JSON_ERROR_INVALID_ARGUMENT if num_keys is
+ *                      negative, keys or one of the keys is NULL, or
+ *                      no perfect hash could be found for the keys,
+ *                      @ref JSON_ERROR_INPUT_STREAM if reading has 
+ *                      already started, or @ref JSON_ERROR_OUT_OF_MEMORY.
+ */
+
+int json_parser_register_keys(JSONParser *parser,
+                              const char *const *keys, int num_keys);
+
+/**
+ * Get statistics about the input and keys read by a @param JSONParser
+ * so far.
+ *
+ * @param parser        The parser.
+ * @param stats         Pointer to a structure to store the statistics.
+ */
+
+void json_parser_get_stats(JSONParser *parser, JSONParserStats *stats);
+
+/**
+ * Free all @ref JSONValue structures that have been read from a
+ * @param JSONParser, in a single operation.  The memory is reused for
+ * values that are read afterwards.
+ *
+ * @param parser        The parser.
+ */
+
+void json_parser_reset_arena(JSONParser *parser);
+
 /**
  * Get the root value of the JSON input stream.  This is always
  * either an array or object.
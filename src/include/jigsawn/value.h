@@ -26,6 +26,9 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 extern "C" {
 #endif
 
+#include <stdlib.h>
+#include <stdint.h>
+
 /**
  * The type of a @ref JSONValue. 
  */
@@ -38,7 +41,8 @@ typedef enum {
         JSON_VALUE_MAPPING,
         JSON_VALUE_INT,
         JSON_VALUE_FLOAT,
-        JSON_VALUE_BOOLEAN
+        JSON_VALUE_BOOLEAN,
+        JSON_VALUE_UINT64
 } JSONValueType;
 
 /**
@@ -56,6 +60,20 @@ typedef struct _JSONValue JSONValue;
 
 JSONValueType json_value_get_type(JSONValue *value);
 
+/**
+ * Free a @ref JSONValue that is no longer needed.  Values are 
+ * allocated from a memory arena owned by the parser, so this is 
+ * optional: all values are freed when the parser is freed or 
+ * @ref json_parser_reset_arena is called.  Freeing values while 
+ * streaming through a large document allows their memory to be 
+ * reused for the values that follow.  Freeing an object mapping 
+ * (@ref JSON_VALUE_MAPPING) also frees its value.
+ *
+ * @param value              The value to free.
+ */
+
+void json_value_free(JSONValue *value);
+
 /**
  * Query whether more values can be read from an array or object.
  *
@@ -68,12 +86,17 @@ JSONValueType json_value_get_type(JSONValue *value);
 int json_value_has_more(JSONValue *value);
 
 /**
- * Read the next value from an array or object.
+ * Read the next value from an array or object.  If the last value 
+ * read was itself an array or object, and it was not read to the end,
+ * the rest of it is skipped first (see @ref json_value_skip).  Once 
+ * the end has been reached, or the array or object has been skipped,
+ * no more values can be read from it.
  *
  * @param value              The array or object to read from.
  * @return                   Pointer to the next value read, or NULL if
  *                           the end of the array or object has been
- *                           reached, or an error occurred.
+ *                           reached, or an error occurred; the reason 
+ *                           is given by @ref json_parser_get_error.
  *                           If this is an object, the values
  *                           returned are of type @ref JSON_VALUE_MAPPING.
  */
@@ -81,23 +104,101 @@ int json_value_has_more(JSONValue *value);
 JSONValue *json_value_read_next(JSONValue *value);
 
 /**
- * Get the value of a string @ref JSONValue.
+ * Skip the rest of an array or object without reading it.  The input
+ * is scanned for the matching closing bracket, only keeping track of
+ * the nesting depth and of where strings begin and end: no values are
+ * allocated, strings are not copied and numbers are not converted, so
+ * this is much faster than reading the values.  The skipped input is
+ * not checked for errors.  If the value is an object mapping, its 
+ * value is skipped.  Other values are already complete, and are left
+ * alone.
+ *
+ * @param value              The value to skip.
+ * @return                   Zero if successful, or negative error code:
+ *                           @ref JSON_ERROR_NEED_MORE if more data must 
+ *                           be fed to a push mode parser, in which case
+ *                           the skip continues when this is called 
+ *                           again.
+ */
+
+int json_value_skip(JSONValue *value);
+
+/**
+ * Get the value of a string @ref JSONValue, as a NUL-terminated 
+ * string.  When the parser reads from memory or a mapped file, strings
+ * that contain no escape sequences are not copied, and are instead 
+ * left in the input data, where they are not NUL-terminated; such a
+ * string is copied the first time that this is called.  Parsers 
+ * created with @ref json_parser_new_in_situ NUL-terminate strings in
+ * the input data, so they are never copied.  Use
+ * @ref json_string_get_data and @ref json_string_get_length to read
+ * strings without copying them.
  *
  * @param value              The value.
- * @return                   The string data, encoded in UTF-8 format.
+ * @return                   The string data, encoded in UTF-8 format,
+ *                           or NULL if out of memory.
  */
 
 const char *json_string_get_value(JSONValue *value);
 
+/**
+ * Get the contents of a string @ref JSONValue without copying them.
+ * The contents may be in the parser's input data, in which case they
+ * are not NUL-terminated, and are only valid until the parser is freed
+ * or its input is changed.
+ *
+ * @param value              The value.
+ * @return                   Pointer to the string data, encoded in
+ *                           UTF-8 format, which is
+ *                           @ref json_string_get_length bytes long.
+ */
+
+const char *json_string_get_data(JSONValue *value);
+
+/**
+ * Get the length of a string @ref JSONValue.
+ *
+ * @param value              The value.
+ * @return                   Length of the string in bytes, when encoded
+ *                           in UTF-8 format.
+ */
+
+size_t json_string_get_length(JSONValue *value);
+
 /**
  * Get the value of an integer @ref JSONValue (@ref JSON_VALUE_INT).
+ * Integers are read as 64-bit values; if the value does not fit in an
+ * int, the result is truncated.
  *
  * @param value              The value.
  * @return                   The integer value.
+ * @sa json_int64_get_value
  */
 
 int json_int_get_value(JSONValue *value);
 
+/**
+ * Get the value of an integer @ref JSONValue (@ref JSON_VALUE_INT)
+ * as a signed 64-bit value.
+ *
+ * @param value              The value.
+ * @return                   The integer value.
+ */
+
+int64_t json_int64_get_value(JSONValue *value);
+
+/**
+ * Get the value of a non-negative integer @ref JSONValue as an 
+ * unsigned 64-bit value.  Integers that are too large to be stored as
+ * signed 64-bit values are read as @ref JSON_VALUE_UINT64; this can
+ * also be used to read non-negative @ref JSON_VALUE_INT values.
+ *
+ * @param value              The value.
+ * @return                   The integer value.
+ */
+
+uint64_t json_uint64_get_value(JSONValue *value);
+
 /**
  * Get the value of a floating-point @ref JSONValue
  * (@ref JSON_VALUE_FLOAT).
@@ -120,16 +221,62 @@ int json_boolean_get_value(JSONValue *value);
 
 /**
  * Get the key for an object mapping (@ref JSONValue of type
- * @ref JSON_VALUE_MAPPING).
+ * @ref JSON_VALUE_MAPPING), as a NUL-terminated string.  Like string 
+ * values, keys are not NUL-terminated in the parser's input data.  
+ * Instead, each parser interns the keys that it reads: each distinct
+ * key is copied once, and every mapping with that key returns the same
+ * pointer, which remains valid until the parser is freed, so keys can
+ * be compared by pointer.  Very long keys, and keys beyond the first 
+ * 65536 distinct keys, are not interned, and are copied like string
+ * values.  If keys have been registered with 
+ * @ref json_parser_register_keys, registered keys are never copied,
+ * and other keys are not stored.
  *
  * @param value              The mapping.
- * @return                   Key for the mapping.
+ * @return                   Key for the mapping, or NULL if out of 
+ *                           memory, or if keys have been registered
+ *                           and this key is not one of them.
  *
+ * @sa json_mapping_get_key_data
  * @sa json_mapping_get_value
  */
 
 const char *json_mapping_get_key(JSONValue *value);
 
+/**
+ * Get the ID of the key for an object mapping, if keys have been 
+ * registered with the parser using @ref json_parser_register_keys.
+ *
+ * @param value              The mapping.
+ * @return                   Index of the key in the array of keys
+ *                           registered, or -1 if this key was not 
+ *                           registered.
+ */
+
+int json_mapping_get_key_id(JSONValue *value);
+
+/**
+ * Get the key for an object mapping without copying it (see 
+ * @ref json_string_get_data).
+ *
+ * @param value              The mapping.
+ * @return                   Pointer to the key, which is
+ *                           @ref json_mapping_get_key_length bytes long,
+ *                           and may not be NUL-terminated.
+ */
+
+const char *json_mapping_get_key_data(JSONValue *value);
+
+/**
+ * Get the length of the key for an object mapping.
+ *
+ * @param value              The mapping.
+ * @return                   Length of the key in bytes, when encoded in
+ *                           UTF-8 format.
+ */
+
+size_t json_mapping_get_key_length(JSONValue *value);
+
 /**
  * Get the value for an object mapping (@ref JSONValue of type
  * @ref JSON_VALUE_MAPPING).
@@ -142,6 +289,50 @@ const char *json_mapping_get_key(JSONValue *value);
 
 JSONValue *json_mapping_get_value(JSONValue *value);
 
+/**
+ * Find the value for a key in an object (@ref JSON_VALUE_OBJECT), 
+ * reading forward from the current position.  Each key is compared 
+ * against the key requested as it is read, without a mapping being
+ * allocated or the key being copied, and the values for other keys 
+ * are skipped as with @ref json_value_skip.  Keys before the current
+ * position are not searched; reading can continue after the value 
+ * found, for example to find a key that follows it.
+ *
+ * @param object             The object to search.
+ * @param key                The key to find.
+ * @return                   The value for the key, or NULL if the key
+ *                           was not found before the end of the object
+ *                           or an error occurred; the reason is given
+ *                           by @ref json_parser_get_error.  If more 
+ *                           data must be fed to a push mode parser 
+ *                           (@ref JSON_ERROR_NEED_MORE), the search 
+ *                           continues when this is called again with 
+ *                           the same key; the object must not be read
+ *                           in any other way until then.
+ * @sa json_object_find_any
+ */
+
+JSONValue *json_object_find(JSONValue *object, const char *key);
+
+/**
+ * Find the value for the next of a set of keys in an object, in the
+ * same way as @ref json_object_find.  To read the values for several
+ * keys in a single pass, call this repeatedly until it returns NULL.
+ *
+ * @param object             The object to search.
+ * @param keys               Array of keys to find.
+ * @param num_keys           Number of keys in the array.
+ * @param index              Pointer to a variable in which to store 
+ *                           the index in the array of the key found,
+ *                           or NULL.
+ * @return                   The value for the key, or NULL (see
+ *                           @ref json_object_find).
+ */
+
+JSONValue *json_object_find_any(JSONValue *object,
+                                const char *const *keys, int num_keys,
+                                int *index);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,11 +20,21 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "jigsawn/error.h"
 
 #include "input-reader.h"
+#include "file-reader.h"
+#include "readahead.h"
+#include "transcode.h"
 #include "utf8.h"
+#include "utf8-validate.h"
 
 typedef struct {
         unsigned char sequence[4];
@@ -51,42 +61,268 @@ static const int encoding_templates[NUM_JSON_ENCODINGS][4] = {
         { 0, 0, 0, 1 }        /* JSON_ENCODING_32BE */
 };
 
-/* Character lengths for each of the encoding types */
+/* UTF-8 input is validated in chunks of this size as it is read, 
+ * so that the chunk is still in the cache when it is lexed. */
 
-static const int encoding_lengths[] = {
-        1,                    /* JSON_ENCODING_UTF8, unused */
-        2,                    /* JSON_ENCODING_16LE */
-        2,                    /* JSON_ENCODING_16BE */
-        4,                    /* JSON_ENCODING_32LE */
-        4                     /* JSON_ENCODING_32BE */
-};
+#define VALIDATE_CHUNK_SIZE     (64 * 1024)
+
+/* Size of the blocks that compressed input is decompressed into, and
+ * of the blocks that compressed data is read in from callback 
+ * sources. */
+
+#define DECOMPRESS_BLOCK_SIZE   (128 * 1024)
+#define COMPRESSED_BLOCK_SIZE   (64 * 1024)
+
+/* Size of the blocks that UTF-16 and UTF-32 input is converted into. */
+
+#define TRANSCODE_BLOCK_SIZE    (64 * 1024)
 
 /* Returns non-zero if end of file has been reached. */
 
 int json_input_is_eof(JSONInputReader *reader)
 {
         return reader->eof
+            && reader->pending_char < 0
             && reader->input_buffer_pos >= reader->input_buffer_len;
 }
 
-/* Fill the input buffer.  Returns zero for success, or error code. */
+/* Read the next block of compressed data from the source.  Returns 
+ * zero for success, or error code. */
 
-static int json_input_buffer_fill(JSONInputReader *reader)
+static int json_input_read_compressed(JSONInputReader *reader)
+{
+        int bytes;
+        int err;
+
+        if (reader->block_source != NULL) {
+                err = reader->block_next(reader->block_source,
+                                         &reader->compressed_data,
+                                         &reader->compressed_len);
+
+                if (reader->compressed_len == 0) {
+                        reader->compressed_eof = 1;
+                }
+
+                return err;
+        }
+
+        /* Memory sources passed all of their data at the start. */
+
+        if (reader->read_func == NULL) {
+                reader->compressed_eof = 1;
+                return JSON_ERROR_SUCCESS;
+        }
+
+        if (reader->compressed_buffer == NULL) {
+                reader->compressed_buffer 
+                        = json_allocator_alloc(reader->allocator,
+                                               COMPRESSED_BLOCK_SIZE);
+
+                if (reader->compressed_buffer == NULL) {
+                        return JSON_ERROR_OUT_OF_MEMORY;
+                }
+        }
+
+        bytes = reader->read_func(reader->source,
+                                  reader->compressed_buffer,
+                                  COMPRESSED_BLOCK_SIZE);
+
+        ++reader->stats.syscalls;
+
+        if (bytes < 0) {
+                return JSON_ERROR_INPUT_STREAM;
+        } else if (bytes == 0) {
+                reader->compressed_eof = 1;
+        }
+
+        reader->compressed_data = reader->compressed_buffer;
+        reader->compressed_len = bytes;
+        reader->stats.bytes_read += bytes;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Fill the input buffer with decompressed data.  Returns zero for 
+ * success, or error code. */
+
+static int json_input_decompress_fill(JSONInputReader *reader)
+{
+        size_t in_used, out_used;
+        size_t len;
+        int err;
+
+        reader->input_data = reader->decompress_buffer;
+        len = 0;
+
+        /* Decompress until the block is full or the input ends. */
+
+        while (len < DECOMPRESS_BLOCK_SIZE) {
+                if (reader->compressed_len == 0) {
+                        if (reader->compressed_eof) {
+                                break;
+                        }
+
+                        err = json_input_read_compressed(reader);
+
+                        if (err < 0) {
+                                return err;
+                        }
+                }
+
+                err = json_decompressor_run(reader->decompressor,
+                                            reader->compressed_data,
+                                            reader->compressed_len,
+                                            &in_used,
+                                            reader->decompress_buffer + len,
+                                            DECOMPRESS_BLOCK_SIZE - len,
+                                            &out_used);
+
+                if (err < 0) {
+                        return err;
+                }
+
+                /* If there is input but no progress, the data after 
+                 * the end of the compressed stream is not valid. */
+
+                if (in_used == 0 && out_used == 0
+                 && reader->compressed_len > 0) {
+                        return JSON_ERROR_INPUT_STREAM;
+                }
+
+                reader->compressed_data += in_used;
+                reader->compressed_len -= in_used;
+                len += out_used;
+        }
+
+        reader->input_buffer_len = len;
+
+        /* At the end of the input, the compressed stream must be 
+         * complete, or it has been truncated. */
+
+        if (len == 0) {
+                reader->eof = 1;
+
+                if (!json_decompressor_at_end(reader->decompressor)) {
+                        return JSON_ERROR_INPUT_STREAM;
+                }
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Block source functions for a file read with asynchronous I/O. */
+
+static int json_input_file_reader_next(void *handle,
+                                       const unsigned char **data,
+                                       size_t *data_len)
+{
+        return json_file_reader_next(handle, data, data_len);
+}
+
+static void json_input_file_reader_free(void *handle)
+{
+        json_file_reader_free(handle);
+}
+
+/* Start reading a file with asynchronous I/O.  Returns zero for 
+ * success, or error code. */
+
+static int json_input_start_file_reader(JSONInputReader *reader)
+{
+        reader->block_source = json_file_reader_new(reader->fd,
+                                                    reader->allocator,
+                                                    &reader->stats);
+
+        if (reader->block_source == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        reader->block_next = json_input_file_reader_next;
+        reader->block_free = json_input_file_reader_free;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Read the next block of data from the source into input_data.  
+ * Returns zero for success, or error code. */
+
+static int json_input_read_block(JSONInputReader *reader)
 {
-        char *buffer;
+        unsigned char *buffer;
         int bytes;
         int remaining = sizeof(reader->input_buffer);
-         
+        int err;
+
+        if (reader->decompressor != NULL) {
+                return json_input_decompress_fill(reader);
+        }
+
+        /* Push sources continue with the rest of the last block fed;
+         * when that has been read, more data must be fed, unless we
+         * have been told that this is the end of the input. */
+
+        if (reader->push) {
+                if (reader->next_data_len > 0) {
+                        reader->input_data = reader->next_data;
+                        reader->input_buffer_len = reader->next_data_len;
+                        reader->next_data_len = 0;
+                        return JSON_ERROR_SUCCESS;
+                } else if (reader->eof) {
+                        return JSON_ERROR_SUCCESS;
+                } else {
+                        return JSON_ERROR_NEED_MORE;
+                }
+        }
+
+        /* Files read with asynchronous I/O start reading when the
+         * first block is needed, so that the allocator set after the
+         * reader was initialised is used. */
+
+        if (reader->async && reader->block_source == NULL) {
+                err = json_input_start_file_reader(reader);
+
+                if (err < 0) {
+                        return err;
+                }
+        }
+
+        /* With a block source, the next block has already been read
+         * (or is being read) in the background. */
+
+        if (reader->block_source != NULL) {
+                err = reader->block_next(reader->block_source,
+                                         &reader->input_data,
+                                         &reader->input_buffer_len);
+
+                if (err < 0) {
+                        return err;
+                } else if (reader->input_buffer_len == 0) {
+                        reader->eof = 1;
+                }
+
+                return JSON_ERROR_SUCCESS;
+        }
+
+        /* Memory sources have no more data to read: everything is
+         * already in input_data. */
+
+        if (reader->read_func == NULL) {
+                reader->eof = 1;
+                return JSON_ERROR_SUCCESS;
+        }
+
         /* Read as many bytes as possible until the buffer becomes 
          * full or we reach the end of file */
 
         buffer = reader->input_buffer;
+        reader->input_data = reader->input_buffer;
         reader->input_buffer_len = 0;
 
         while (remaining > 0) {
                 bytes = reader->read_func(reader->source, 
                                           buffer,
                                           remaining);
+                ++reader->stats.syscalls;
 
                 if (bytes == 0) {
                         reader->eof = 1;
@@ -98,15 +334,203 @@ static int json_input_buffer_fill(JSONInputReader *reader)
                 buffer += bytes;
                 remaining -= bytes;
                 reader->input_buffer_len += bytes;
+                reader->stats.bytes_read += bytes;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Read the next block of data to be converted to UTF-8.  Returns zero
+ * for success, or error code. */
+
+static int json_input_read_transcode(JSONInputReader *reader)
+{
+        int err;
+
+        err = json_input_read_block(reader);
+
+        if (err == 0) {
+                reader->transcode_data = reader->input_data;
+                reader->transcode_len = reader->input_buffer_len;
+                reader->transcode_eof = reader->eof;
+        }
+
+        /* The data read is not to be read directly. */
+
+        reader->input_data = reader->transcode_buffer;
+        reader->input_buffer_len = 0;
+
+        return err;
+}
+
+/* Convert a character that was split between blocks, from the start of
+ * it kept in transcode_partial and the rest at the start of 
+ * transcode_data.  Returns zero for success, or error code. */
+
+static int json_input_transcode_partial(JSONInputReader *reader,
+                                        unsigned char *out,
+                                        size_t out_len,
+                                        size_t *out_used)
+{
+        size_t partial_len, len, in_used;
+        int err;
+
+        partial_len = reader->transcode_partial_len;
+        len = sizeof(reader->transcode_partial) - partial_len;
+
+        if (len > reader->transcode_len) {
+                len = reader->transcode_len;
+        }
+
+        memcpy(reader->transcode_partial + partial_len,
+               reader->transcode_data, len);
+
+        err = json_transcode_to_utf8(reader->encoding,
+                                     reader->transcode_partial,
+                                     partial_len + len, &in_used,
+                                     out, out_len, out_used);
+
+        if (err < 0) {
+                return err;
+        }
+
+        /* If the character is still incomplete, keep all of the data
+         * and wait for the next block.  Otherwise, any data converted
+         * after the end of the character is skipped in transcode_data.
+         */
+
+        if (in_used < partial_len) {
+                reader->transcode_partial_len += len;
+                reader->transcode_data += len;
+                reader->transcode_len -= len;
+        } else {
+                reader->transcode_partial_len = 0;
+                reader->transcode_data += in_used - partial_len;
+                reader->transcode_len -= in_used - partial_len;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Fill the input buffer with data converted to UTF-8.  Returns zero 
+ * for success, or error code. */
+
+static int json_input_transcode_fill(JSONInputReader *reader)
+{
+        size_t in_used, out_used;
+        size_t len;
+        int err;
+
+        len = 0;
+
+        /* Convert until the block is full or the input ends.  The
+         * converter always leaves space for one more character. */
+
+        while (TRANSCODE_BLOCK_SIZE - len >= 4) {
+                if (reader->transcode_len == 0) {
+
+                        /* Input that ends part way through a character
+                         * has been truncated. */
+
+                        if (reader->transcode_eof) {
+                                if (reader->transcode_partial_len > 0
+                                 && len == 0) {
+                                        return JSON_ERROR_ENCODING;
+                                }
+
+                                break;
+                        }
+
+                        /* In push mode, return what we have rather 
+                         * than wait for more data to be fed. */
+
+                        if (reader->push && len > 0) {
+                                break;
+                        }
+
+                        err = json_input_read_transcode(reader);
+
+                        if (err < 0) {
+                                return err;
+                        }
+
+                        continue;
+                }
+
+                in_used = 0;
+
+                if (reader->transcode_partial_len > 0) {
+                        err = json_input_transcode_partial(
+                                reader,
+                                reader->transcode_buffer + len,
+                                TRANSCODE_BLOCK_SIZE - len,
+                                &out_used);
+                } else {
+                        err = json_transcode_to_utf8(
+                                reader->encoding,
+                                reader->transcode_data,
+                                reader->transcode_len, &in_used,
+                                reader->transcode_buffer + len,
+                                TRANSCODE_BLOCK_SIZE - len,
+                                &out_used);
+                }
+
+                reader->transcode_data += in_used;
+                reader->transcode_len -= in_used;
+                len += out_used;
+
+                /* An invalid character is reported once the data 
+                 * before it has been read. */
+
+                if (err < 0) {
+                        if (len > 0) {
+                                break;
+                        }
+
+                        return err;
+                }
+
+                /* A character at the end of the block that is not
+                 * complete must wait for the next block. */
+
+                if (reader->transcode_partial_len == 0
+                 && reader->transcode_len > 0
+                 && reader->transcode_len < 4
+                 && TRANSCODE_BLOCK_SIZE - len >= 4
+                 && in_used + out_used == 0) {
+                        memcpy(reader->transcode_partial,
+                               reader->transcode_data,
+                               reader->transcode_len);
+                        reader->transcode_partial_len = reader->transcode_len;
+                        reader->transcode_len = 0;
+                }
         }
 
+        reader->input_data = reader->transcode_buffer;
+        reader->input_buffer_len = len;
+        reader->eof = reader->transcode_eof
+                   && reader->transcode_len == 0
+                   && reader->transcode_partial_len == 0;
+
         return JSON_ERROR_SUCCESS;
 }
 
+/* Fill the input buffer.  Returns zero for success, or error code. */
+
+static int json_input_buffer_fill(JSONInputReader *reader)
+{
+        if (reader->transcode_buffer != NULL) {
+                return json_input_transcode_fill(reader);
+        } else {
+                return json_input_read_block(reader);
+        }
+}
+
 /* Check if the initial bytes from the input stream match a BOM template 
  * that can be used to deduce the endianness/encoding. */
 
-static int check_bom_template(unsigned char *p, const BOMTemplate *template)
+static int check_bom_template(const unsigned char *p,
+                              const BOMTemplate *template)
 {
         int i;
 
@@ -123,7 +547,7 @@ static int check_bom_template(unsigned char *p, const BOMTemplate *template)
 
 /* Check if a four byte sequence matches an encoding template */
 
-static int check_template(char *p, const int *template)
+static int check_template(const unsigned char *p, const int *template)
 {
         int i;
 
@@ -136,18 +560,85 @@ static int check_template(char *p, const int *template)
         return 1;
 }
 
-/* Determine the encoding of the input data.  Returns zero for success,
+/* Check if the input data is compressed, and if it is, start to 
+ * decompress it.  This is done at the start of the input, in the same
+ * way as the encoding is detected.  Returns zero for success, or
+ * negative error code. */
+
+static int json_input_find_compression(JSONInputReader *reader)
+{
+        JSONCompression compression;
+
+        compression = json_decompress_detect(reader->input_data
+                                               + reader->input_buffer_pos,
+                                             reader->input_buffer_len
+                                               - reader->input_buffer_pos);
+
+        if (compression == JSON_COMPRESSION_NONE) {
+                return JSON_ERROR_SUCCESS;
+        }
+
+        reader->decompressor = json_decompressor_new(compression,
+                                                     reader->allocator);
+        reader->decompress_buffer 
+                = json_allocator_alloc(reader->allocator,
+                                       DECOMPRESS_BLOCK_SIZE);
+
+        if (reader->decompressor == NULL
+         || reader->decompress_buffer == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        /* The data read so far is the start of the compressed stream.
+         * For callback sources, this is in input_buffer, which is not
+         * needed for anything else from now on. */
+
+        reader->compressed_data = reader->input_data
+                                + reader->input_buffer_pos;
+        reader->compressed_len = reader->input_buffer_len
+                               - reader->input_buffer_pos;
+        reader->compressed_eof = reader->eof;
+
+        reader->eof = 0;
+        reader->input_buffer_pos = 0;
+        reader->trusted_len = 0;
+
+        return json_input_decompress_fill(reader);
+}
+
+/* Detect the encoding of the input data.  Returns zero for success,
  * or negative error code. */
 
-static int json_input_find_encoding(JSONInputReader *reader)
+static int json_input_detect_encoding(JSONInputReader *reader)
 {
-        int i, j;
+        int i;
         int err;
 
-        err = json_input_buffer_fill(reader);
+        if (reader->input_buffer_pos >= reader->input_buffer_len) {
+                err = json_input_buffer_fill(reader);
 
-        if (err < 0) {
-                return err;
+                if (err < 0) {
+                        return err;
+                }
+
+                reader->input_buffer_pos = 0;
+                reader->trusted_len = 0;
+        }
+
+        /* In push mode, wait until there are four bytes to look at. 
+         * Otherwise, check for compressed input first. */
+
+        if (reader->push) {
+                if (!reader->eof
+                 && reader->input_buffer_len - reader->input_buffer_pos < 4) {
+                        return JSON_ERROR_NEED_MORE;
+                }
+        } else if (reader->decompressor == NULL) {
+                err = json_input_find_compression(reader);
+
+                if (err < 0) {
+                        return err;
+                }
         }
 
         /* If less than four bytes, fall back to UTF8 as a default. */
@@ -165,7 +656,7 @@ static int json_input_find_encoding(JSONInputReader *reader)
                 /* If we match a template, set the encoding and skip
                  * past the BOM marker. */
 
-                if (check_bom_template(reader->input_buffer,
+                if (check_bom_template(reader->input_data,
                                        &bom_templates[i])) {
                         reader->encoding = bom_templates[i].encoding;
                         reader->input_buffer_pos = bom_templates[i].length;
@@ -177,7 +668,7 @@ static int json_input_find_encoding(JSONInputReader *reader)
          * values to work out the encoding, as described in the JSON RFC. */
 
         for (i=0; i<NUM_JSON_ENCODINGS; ++i) {
-                if (check_template(reader->input_buffer, 
+                if (check_template(reader->input_data, 
                                    encoding_templates[i])) {
                         reader->encoding = i;
                         return JSON_ERROR_SUCCESS;
@@ -189,12 +680,61 @@ static int json_input_find_encoding(JSONInputReader *reader)
         return JSON_ERROR_UNKNOWN_ENCODING;
 }
 
-/* Read a byte from the input stream.  Returns the byte value or 
+/* Start to convert UTF-16 or UTF-32 input to UTF-8.  The rest of the 
+ * data in the current block is the start of the data to convert.
+ * Returns zero for success, or negative error code. */
+
+static int json_input_start_transcode(JSONInputReader *reader)
+{
+        reader->transcode_buffer = json_allocator_alloc(reader->allocator,
+                                                        TRANSCODE_BLOCK_SIZE);
+
+        if (reader->transcode_buffer == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        reader->transcode_data = reader->input_data
+                               + reader->input_buffer_pos;
+        reader->transcode_len = reader->input_buffer_len
+                              - reader->input_buffer_pos;
+        reader->transcode_eof = reader->eof;
+
+        reader->eof = 0;
+        reader->input_data = reader->transcode_buffer;
+        reader->input_buffer_len = 0;
+        reader->input_buffer_pos = 0;
+        reader->trusted_len = 0;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Determine the encoding of the input data, and start to convert it
+ * to UTF-8 if necessary.  Returns zero for success, or negative error
+ * code. */
+
+static int json_input_find_encoding(JSONInputReader *reader)
+{
+        int err;
+
+        err = json_input_detect_encoding(reader);
+
+        if (err < 0) {
+                return err;
+        }
+
+        if (reader->encoding != JSON_ENCODING_UTF8) {
+                return json_input_start_transcode(reader);
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Ensure there is data in the input buffer waiting to be read, 
+ * reading the next block if necessary.  Returns zero for success, or
  * negative error code. */
 
-static int json_input_read_byte(JSONInputReader *reader)
+static int json_input_check_buffer(JSONInputReader *reader)
 {
-        int result;
         int err;
 
         /* Reached the end of the current block? Read the next one. */
@@ -214,6 +754,7 @@ static int json_input_read_byte(JSONInputReader *reader)
                 }
 
                 reader->input_buffer_pos = 0;
+                reader->trusted_len = 0;
         }
 
         /* End of file? */ 
@@ -222,25 +763,139 @@ static int json_input_read_byte(JSONInputReader *reader)
                 return JSON_ERROR_END_OF_FILE;
         }
 
-        /* Return the next character */
-
-        result = reader->input_buffer[reader->input_buffer_pos];
-        ++reader->input_buffer_pos;
-
-        return result;
+        return JSON_ERROR_SUCCESS;
 }
 
-/* Read a UTF-8 encoded character.  Returns negative error code if
+/* Read a byte from the input stream.  Returns the byte value or 
+ * negative error code. */
+
+static int json_input_read_byte(JSONInputReader *reader)
+{
+        int result;
+        int err;
+
+        err = json_input_check_buffer(reader);
+
+        if (err < 0) {
+                return err;
+        }
+
+        /* Return the next character */
+
+        result = reader->input_data[reader->input_buffer_pos];
+        ++reader->input_buffer_pos;
+
+        return result;
+}
+
+/* Validate the next chunk of UTF-8 data from the current position,
+ * extending the trusted region over it. */
+
+static void json_input_validate(JSONInputReader *reader)
+{
+        size_t len;
+
+        /* Data converted to UTF-8 is always valid. */
+
+        if (reader->transcode_buffer != NULL) {
+                reader->trusted_len = reader->input_buffer_len;
+                return;
+        }
+
+        len = reader->input_buffer_len - reader->input_buffer_pos;
+
+        if (len > VALIDATE_CHUNK_SIZE) {
+                len = VALIDATE_CHUNK_SIZE;
+        }
+
+        reader->trusted_len = reader->input_buffer_pos
+                            + json_utf8_validate(reader->input_data
+                                                   + reader->input_buffer_pos,
+                                                 len);
+}
+
+/* Query if the data is UTF-8. */
+
+int json_input_is_utf8(JSONInputReader *reader)
+{
+        return reader->encoding == JSON_ENCODING_UTF8
+            || reader->transcode_buffer != NULL;
+}
+
+/* Query if the data is read in place. */
+
+int json_input_is_in_place(JSONInputReader *reader)
+{
+        if (reader->push || reader->read_func != NULL || reader->async
+         || reader->decompressor != NULL
+         || reader->encoding != JSON_ENCODING_UTF8) {
+                return 0;
+        }
+
+        /* The only block source that reads in place is an iovec 
+         * array, where each block is one of the caller's segments. */
+
+        return reader->block_source == NULL || reader->iov != NULL;
+}
+
+/* Query if the data may be modified. */
+
+int json_input_is_in_situ(JSONInputReader *reader)
+{
+        return reader->in_situ && json_input_is_in_place(reader);
+}
+
+/* Get the number of bytes from the current position that are trusted
+ * to be valid UTF-8. */
+
+size_t json_input_get_trusted_len(JSONInputReader *reader)
+{
+        if (!json_input_is_utf8(reader)) {
+                return 0;
+        }
+
+        if (reader->input_buffer_pos >= reader->trusted_len) {
+                json_input_validate(reader);
+        }
+
+        return reader->trusted_len - reader->input_buffer_pos;
+}
+
+/* Read a UTF-8 encoded character.  Returns negative error code if
  * an error occurs.*/
 
 static int json_input_read_utf8(JSONInputReader *reader)
 {
+        const unsigned char *p;
         unsigned char buf[4];
         int seq_length;
         int c;
         int i;
 
-        /* Read the first byte */
+        /* Characters in the trusted region have already been validated,
+         * and can be decoded directly. */
+
+        if (reader->input_buffer_pos >= reader->trusted_len
+         && reader->input_buffer_pos < reader->input_buffer_len) {
+                json_input_validate(reader);
+        }
+
+        if (reader->input_buffer_pos < reader->trusted_len) {
+                p = reader->input_data + reader->input_buffer_pos;
+
+                if (p[0] < 0x80) {
+                        ++reader->input_buffer_pos;
+                        return p[0];
+                }
+
+                seq_length = json_utf8_seq_length(p[0]);
+                reader->input_buffer_pos += seq_length;
+
+                return json_utf8_decode(p, seq_length);
+        }
+
+        /* Otherwise, the character is split between blocks, or is 
+         * invalid.  Read the first byte */
 
         c = json_input_read_byte(reader);
 
@@ -252,6 +907,10 @@ static int json_input_read_utf8(JSONInputReader *reader)
 
         seq_length = json_utf8_seq_length(c);
 
+        if (seq_length < 0) {
+                return seq_length;
+        }
+
         /* Read extra bytes in the sequence. */
 
         buf[0] = c;
@@ -266,11 +925,50 @@ static int json_input_read_utf8(JSONInputReader *reader)
                 buf[i] = c;
         }
 
-        /* Decode the character */
+        /* Check the sequence is valid, and decode the character */
+
+        if (json_utf8_check_seq(buf, seq_length) != seq_length) {
+                return JSON_ERROR_ENCODING;
+        }
 
         return json_utf8_decode(buf, seq_length);
 }
 
+/* Get the block of data waiting to be read. */
+
+int json_input_get_span(JSONInputReader *reader,
+                        const unsigned char **span,
+                        size_t *span_len)
+{
+        int err;
+
+        /* The pushed back character must be read first. */
+
+        if (reader->pending_char >= 0) {
+                *span = NULL;
+                *span_len = 0;
+                return JSON_ERROR_SUCCESS;
+        }
+
+        err = json_input_check_buffer(reader);
+
+        if (err < 0) {
+                return err;
+        }
+
+        *span = reader->input_data + reader->input_buffer_pos;
+        *span_len = reader->input_buffer_len - reader->input_buffer_pos;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Consume data returned by json_input_get_span. */
+
+void json_input_skip(JSONInputReader *reader, size_t bytes)
+{
+        reader->input_buffer_pos += bytes;
+}
+
 /* Get the character encoding */
 
 int json_input_get_encoding(JSONInputReader *reader, 
@@ -291,15 +989,45 @@ int json_input_get_encoding(JSONInputReader *reader,
         return JSON_ERROR_SUCCESS;
 }
 
-/* Read a character. */
+/* Get the rest of the input, if it is held in memory in one block. */
 
-int json_input_read_char(JSONInputReader *reader)
+int json_input_get_document(JSONInputReader *reader,
+                            const unsigned char **data,
+                            size_t *data_len)
+{
+        JSONInputEncoding encoding;
+        int err;
+
+        if (reader->push || reader->read_func != NULL
+         || reader->block_source != NULL || reader->async) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        err = json_input_get_encoding(reader, &encoding);
+
+        if (err < 0) {
+                return err;
+        }
+
+        /* Compressed input and input converted to UTF-8 are read in
+         * blocks, through a buffer. */
+
+        if (encoding != JSON_ENCODING_UTF8 || reader->decompressor != NULL
+         || !reader->eof || reader->pending_char >= 0) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        *data = reader->input_data + reader->input_buffer_pos;
+        *data_len = reader->input_buffer_len - reader->input_buffer_pos;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Decode the next character from the input data. */
+
+static int json_input_decode_char(JSONInputReader *reader)
 {
-        unsigned char charbuf[4];
-        int len;
         int err;
-        int c;
-        int i;
 
         /* If we have not yet determined the Unicode encoding type,
          * determine it now. */
@@ -312,48 +1040,104 @@ int json_input_read_char(JSONInputReader *reader)
                 }
         }
 
-        /* UTF-8 is a special case */
+        /* Other encodings are converted to UTF-8 as they are read. */
+
+        return json_input_read_utf8(reader);
+}
+
+/* Keep the start of a character that is split between blocks in
+ * input_buffer, so that the block fed by the caller no longer needs
+ * to be valid.  The character started at the specified position in
+ * the specified block, of the specified length.  If the reader has
+ * since moved on to another block (the rest of the block that
+ * completed the previous split character), all of that block is part
+ * of the character too. */
+
+static void json_input_save_partial(JSONInputReader *reader,
+                                    const unsigned char *data,
+                                    size_t start, size_t data_len)
+{
+        size_t len, next_len;
+
+        len = data_len - start;
+        next_len = 0;
 
-        if (reader->encoding == JSON_ENCODING_UTF8) {
-                return json_input_read_utf8(reader);
+        if (reader->input_data != data) {
+                next_len = reader->input_buffer_len;
         }
 
-        /* Read bytes needed for the character */
+        memmove(reader->input_buffer, data + start, len);
 
-        len = encoding_lengths[reader->encoding];
+        if (next_len > 0) {
+                memcpy(reader->input_buffer + len, reader->input_data,
+                       next_len);
+        }
 
-        for (i=0; i<len; ++i) {
-                c = json_input_read_byte(reader);
+        reader->input_data = reader->input_buffer;
+        reader->input_buffer_len = len + next_len;
+        reader->input_buffer_pos = 0;
+        reader->trusted_len = 0;
+}
 
-                if (c < 0) {
-                        return c;
-                }
+/* Read a character from a push mode reader. */
+
+static int json_input_read_push(JSONInputReader *reader)
+{
+        const unsigned char *data;
+        size_t start, data_len;
+        int err;
+        int c;
+
+        err = json_input_check_buffer(reader);
+
+        if (err < 0) {
+                return err;
+        }
+
+        /* If the character is incomplete, the data read so far must
+         * be kept, and the character read again when more data has 
+         * been fed. */
+
+        data = reader->input_data;
+        data_len = reader->input_buffer_len;
+        start = reader->input_buffer_pos;
+        c = json_input_decode_char(reader);
 
-                charbuf[i] = c;
+        if (c == JSON_ERROR_NEED_MORE) {
+                json_input_save_partial(reader, data, start, data_len);
         }
 
-        /* Decode the character */
+        return c;
+}
+
+/* Read a character. */
+
+int json_input_read_char(JSONInputReader *reader)
+{
+        int c;
+
+        /* Return the pushed back character, if there is one. */
+
+        if (reader->pending_char >= 0) {
+                c = reader->pending_char;
+                reader->pending_char = -1;
+                return c;
+        }
 
-        switch (reader->encoding) {
-                case JSON_ENCODING_16LE:
-                        return (charbuf[1] << 8) | charbuf[0];
-                case JSON_ENCODING_16BE:
-                        return (charbuf[0] << 8) | charbuf[1];
-                case JSON_ENCODING_32LE:
-                        return (charbuf[3] << 24)
-                             | (charbuf[2] << 16)
-                             | (charbuf[1] << 8)
-                             | charbuf[0];
-                case JSON_ENCODING_32BE:
-                        return (charbuf[0] << 24)
-                             | (charbuf[1] << 16)
-                             | (charbuf[2] << 8)
-                             | charbuf[3];
-                default:
-                        return JSON_ERROR_ENCODING;
+        if (reader->push) {
+                return json_input_read_push(reader);
+        } else {
+                return json_input_decode_char(reader);
         }
 }
 
+/* Push back a character. */
+
+void json_input_unread_char(JSONInputReader *reader, int c)
+{
+        reader->pending_char = c;
+}
+
 /* Initialise JSONInputReader structure. */
 
 void json_input_reader_init(JSONInputReader *reader,
@@ -361,10 +1145,449 @@ void json_input_reader_init(JSONInputReader *reader,
                             JSONInputReadFunc read_func)
 {
         reader->encoding = JSON_ENCODING_UNKNOWN;
+        reader->input_data = reader->input_buffer;
         reader->input_buffer_len = 0;
         reader->input_buffer_pos = 0;
+        reader->trusted_len = 0;
+        reader->pending_char = -1;
         reader->eof = 0;
+        reader->push = 0;
+        reader->next_data = NULL;
+        reader->next_data_len = 0;
         reader->source = source;
         reader->read_func = read_func;
+        reader->mapping = NULL;
+        reader->mapping_len = 0;
+        reader->fd = -1;
+        reader->allocator = &json_default_allocator;
+        reader->decompressor = NULL;
+        reader->decompress_buffer = NULL;
+        reader->compressed_data = NULL;
+        reader->compressed_len = 0;
+        reader->compressed_buffer = NULL;
+        reader->compressed_eof = 0;
+        reader->transcode_buffer = NULL;
+        reader->transcode_data = NULL;
+        reader->transcode_len = 0;
+        reader->transcode_partial_len = 0;
+        reader->transcode_eof = 0;
+        reader->block_source = NULL;
+        reader->block_next = NULL;
+        reader->block_free = NULL;
+        reader->async = 0;
+        reader->in_situ = 0;
+        reader->iov = NULL;
+        reader->iov_count = 0;
+        reader->iov_index = 0;
+        reader->iov_offset = 0;
+        reader->stats.bytes_read = 0;
+        reader->stats.syscalls = 0;
+}
+
+/* Set the allocator used by a JSONInputReader. */
+
+void json_input_reader_set_allocator(JSONInputReader *reader,
+                                     const JSONAllocator *allocator)
+{
+        reader->allocator = allocator;
+}
+
+/* Block source functions for a readahead thread. */
+
+static int json_input_readahead_next(void *handle,
+                                     const unsigned char **data,
+                                     size_t *data_len)
+{
+        return json_readahead_next(handle, data, data_len);
+}
+
+static void json_input_readahead_free(void *handle)
+{
+        json_readahead_free(handle);
+}
+
+/* Start reading ahead in a background thread. */
+
+int json_input_reader_set_readahead(JSONInputReader *reader,
+                                    unsigned int num_buffers,
+                                    size_t buffer_size)
+{
+        if (reader->read_func == NULL) {
+                return JSON_ERROR_SUCCESS;
+        }
+
+        if (reader->block_source != NULL
+         || reader->encoding != JSON_ENCODING_UNKNOWN
+         || reader->input_buffer_len > 0 || reader->eof) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        reader->block_source = json_readahead_new(reader->source,
+                                                  reader->read_func,
+                                                  num_buffers, buffer_size,
+                                                  reader->allocator,
+                                                  &reader->stats);
+
+        if (reader->block_source == NULL) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        reader->block_next = json_input_readahead_next;
+        reader->block_free = json_input_readahead_free;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Get statistics about the input read. */
+
+void json_input_reader_get_stats(JSONInputReader *reader,
+                                 JSONInputStats *stats)
+{
+        stats->bytes_read = __atomic_load_n(&reader->stats.bytes_read,
+                                            __ATOMIC_RELAXED);
+        stats->syscalls = __atomic_load_n(&reader->stats.syscalls,
+                                          __ATOMIC_RELAXED);
+}
+
+/* Initialise JSONInputReader structure to read from memory. */
+
+void json_input_reader_init_memory(JSONInputReader *reader,
+                                   const void *data,
+                                   size_t data_len)
+{
+        json_input_reader_init(reader, NULL, NULL);
+
+        /* The entire input is one block, read in place. */
+
+        reader->input_data = data;
+        reader->input_buffer_len = data_len;
+        reader->eof = 1;
+        reader->stats.bytes_read = data_len;
+}
+
+/* Initialise JSONInputReader structure to read from a writable block
+ * of memory. */
+
+void json_input_reader_init_in_situ(JSONInputReader *reader,
+                                    void *data, size_t data_len)
+{
+        json_input_reader_init_memory(reader, data, data_len);
+        reader->in_situ = 1;
+}
+
+/* Block source function for an iovec source: each segment is one
+ * block, from iov_offset onwards.  Empty segments are skipped, as an
+ * empty block marks the end of the input. */
+
+static int json_input_iovec_next(void *handle,
+                                 const unsigned char **data,
+                                 size_t *data_len)
+{
+        JSONInputReader *reader = handle;
+        const struct iovec *iov;
+
+        while (reader->iov_index < reader->iov_count
+            && reader->iov[reader->iov_index].iov_len
+                 <= reader->iov_offset) {
+                ++reader->iov_index;
+                reader->iov_offset = 0;
+        }
+
+        if (reader->iov_index >= reader->iov_count) {
+                *data = NULL;
+                *data_len = 0;
+                return JSON_ERROR_SUCCESS;
+        }
+
+        iov = &reader->iov[reader->iov_index];
+        *data = (const unsigned char *) iov->iov_base + reader->iov_offset;
+        *data_len = iov->iov_len - reader->iov_offset;
+
+        ++reader->iov_index;
+        reader->iov_offset = 0;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Initialise JSONInputReader structure to read from an iovec array. */
+
+void json_input_reader_init_iovec(JSONInputReader *reader,
+                                  const struct iovec *iov,
+                                  int iov_count)
+{
+        const unsigned char *data;
+        size_t len;
+        int i;
+
+        json_input_reader_init(reader, NULL, NULL);
+
+        reader->iov = iov;
+        reader->iov_count = iov_count;
+        reader->block_source = reader;
+        reader->block_next = json_input_iovec_next;
+
+        for (i=0; i<iov_count; ++i) {
+                reader->stats.bytes_read += iov[i].iov_len;
+        }
+
+        /* The encoding and compression are detected from the first 
+         * four bytes of the first block.  If the first segment is 
+         * shorter than that, gather the first bytes into input_buffer;
+         * this is the only time that data is copied. */
+
+        json_input_iovec_next(reader, &reader->input_data,
+                              &reader->input_buffer_len);
+
+        if (reader->input_buffer_len >= 4) {
+                return;
+        }
+
+        if (reader->input_buffer_len > 0) {
+                memcpy(reader->input_buffer, reader->input_data,
+                       reader->input_buffer_len);
+        }
+
+        reader->input_data = reader->input_buffer;
+
+        while (reader->input_buffer_len < 4
+            && json_input_iovec_next(reader, &data, &len) == 0
+            && len > 0) {
+                if (len > 4 - reader->input_buffer_len) {
+                        len = 4 - reader->input_buffer_len;
+                }
+
+                memcpy(reader->input_buffer + reader->input_buffer_len,
+                       data, len);
+                reader->input_buffer_len += len;
+
+                /* Continue from after the bytes that were copied. */
+
+                if (len < reader->iov[reader->iov_index - 1].iov_len) {
+                        --reader->iov_index;
+                        reader->iov_offset = len;
+                }
+        }
+}
+
+/* Initialise JSONInputReader structure for push mode. */
+
+void json_input_reader_init_push(JSONInputReader *reader)
+{
+        json_input_reader_init(reader, NULL, NULL);
+
+        reader->push = 1;
+}
+
+/* Supply the next block of data to a push mode reader. */
+
+int json_input_feed(JSONInputReader *reader,
+                    const void *data, size_t data_len)
+{
+        size_t partial_len;
+
+        if (!reader->push || reader->eof) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        /* If the input is being converted to UTF-8, the data fed is
+         * the next block to convert.  Converted data is kept in 
+         * transcode_buffer, so only the data still to be converted
+         * must have been used up. */
+
+        if (reader->transcode_buffer != NULL) {
+                if (reader->next_data_len > 0 || reader->transcode_len > 0
+                 || reader->transcode_eof) {
+                        return JSON_ERROR_INPUT_STREAM;
+                }
+
+                if (data_len == 0) {
+                        reader->transcode_eof = 1;
+                } else {
+                        reader->next_data = data;
+                        reader->next_data_len = data_len;
+                }
+
+                return JSON_ERROR_SUCCESS;
+        }
+
+        /* All data from the previous block must have been read, 
+         * except for a split character saved in input_buffer. */
+
+        if (reader->next_data_len > 0
+         || (reader->input_buffer_pos < reader->input_buffer_len
+          && reader->input_data != reader->input_buffer)) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        if (data_len == 0) {
+                reader->eof = 1;
+                return JSON_ERROR_SUCCESS;
+        }
+
+        if (reader->input_buffer_pos < reader->input_buffer_len) {
+
+                /* Complete the split character by appending to it in
+                 * input_buffer.  No character is longer than four 
+                 * bytes, so this is always enough; the rest of the 
+                 * block is read in place afterwards. */
+
+                partial_len = data_len;
+
+                if (partial_len > 4) {
+                        partial_len = 4;
+                }
+
+                memcpy(reader->input_buffer + reader->input_buffer_len,
+                       data, partial_len);
+                reader->input_buffer_len += partial_len;
+                reader->next_data = (const unsigned char *) data
+                                  + partial_len;
+                reader->next_data_len = data_len - partial_len;
+        } else {
+                reader->input_data = data;
+                reader->input_buffer_len = data_len;
+                reader->input_buffer_pos = 0;
+                reader->trusted_len = 0;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Callback function used to read from a file that cannot be mapped
+ * into memory (eg. a pipe). */
+
+static int json_input_fd_read(JSONInputSource source,
+                              unsigned char *data,
+                              size_t data_len)
+{
+        int *fd = source;
+        ssize_t result;
+
+        do {
+                result = read(*fd, data, data_len);
+        } while (result < 0 && errno == EINTR);
+
+        return result;
+}
+
+/* Initialise JSONInputReader structure to read from a file. */
+
+int json_input_reader_init_file(JSONInputReader *reader,
+                                const char *filename)
+{
+        struct stat st;
+        void *mapping;
+        int fd;
+
+        fd = open(filename, O_RDONLY);
+
+        if (fd < 0) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        if (fstat(fd, &st) < 0) {
+                close(fd);
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        /* Empty files cannot be mapped. */
+
+        if (S_ISREG(st.st_mode) && st.st_size == 0) {
+                close(fd);
+                json_input_reader_init_memory(reader, NULL, 0);
+                return JSON_ERROR_SUCCESS;
+        }
+
+        /* Map regular files into memory, so that they can be read
+         * in place.  The file descriptor is not needed after this. */
+
+        if (S_ISREG(st.st_mode)) {
+                mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                               fd, 0);
+
+                if (mapping != MAP_FAILED) {
+                        close(fd);
+
+                        /* We read the file from start to end: tell the
+                         * kernel so that it can read ahead aggressively. */
+
+                        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+                        json_input_reader_init_memory(reader, mapping,
+                                                      st.st_size);
+                        reader->mapping = mapping;
+                        reader->mapping_len = st.st_size;
+
+                        return JSON_ERROR_SUCCESS;
+                }
+        }
+
+        /* Not possible to map the file; fall back to reading from the
+         * file descriptor into the input buffer. */
+
+        json_input_reader_init(reader, &reader->fd, json_input_fd_read);
+        reader->fd = fd;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Initialise JSONInputReader structure to read from a file with 
+ * asynchronous I/O. */
+
+int json_input_reader_init_file_async(JSONInputReader *reader,
+                                      const char *filename)
+{
+        int fd;
+
+        fd = open(filename, O_RDONLY);
+
+        if (fd < 0) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        /* The file is read from start to end. */
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        json_input_reader_init(reader, NULL, NULL);
+        reader->fd = fd;
+        reader->async = 1;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Free resources used by a JSONInputReader. */
+
+void json_input_reader_free(JSONInputReader *reader)
+{
+        /* The block source must be freed first, as it may be reading
+         * from the file descriptor. */
+
+        if (reader->block_free != NULL) {
+                reader->block_free(reader->block_source);
+                reader->block_source = NULL;
+        }
+
+        if (reader->mapping != NULL) {
+                munmap(reader->mapping, reader->mapping_len);
+                reader->mapping = NULL;
+        }
+
+        if (reader->fd >= 0) {
+                close(reader->fd);
+                reader->fd = -1;
+        }
+
+        if (reader->decompressor != NULL) {
+                json_decompressor_free(reader->decompressor);
+                reader->decompressor = NULL;
+        }
+
+        json_allocator_free(reader->allocator, reader->decompress_buffer);
+        json_allocator_free(reader->allocator, reader->compressed_buffer);
+        json_allocator_free(reader->allocator, reader->transcode_buffer);
+        reader->decompress_buffer = NULL;
+        reader->compressed_buffer = NULL;
+        reader->transcode_buffer = NULL;
 }
 
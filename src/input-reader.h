@@ -27,10 +27,59 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 extern "C" {
 #endif
 
+#include <sys/uio.h>
+
 #include "jigsawn/parser.h"
+#include "allocator.h"
+#include "decompress.h"
 
 typedef struct _JSONInputReader JSONInputReader;
 
+/**
+ * Function to get the next block of data from a block source (a 
+ * readahead thread, or a file read with asynchronous I/O).  The block
+ * returned by the previous call is no longer valid.
+ *
+ * @param handle           Handle for the block source.
+ * @param data             Pointer to a variable to store a pointer to
+ *                         the data.
+ * @param data_len         Pointer to a variable to store the length of
+ *                         the data, which is zero at end of file.
+ * @return                 Zero for success, or negative error code.
+ */
+
+typedef int (*JSONInputBlockFunc)(void *handle,
+                                  const unsigned char **data,
+                                  size_t *data_len);
+
+/**
+ * Function to free a block source.
+ *
+ * @param handle           Handle for the block source.
+ */
+
+typedef void (*JSONInputBlockFreeFunc)(void *handle);
+
+/**
+ * Statistics about the input read by a @ref JSONInputReader.  When
+ * input is read by a readahead thread, the counters are updated by
+ * that thread, and must be read with atomic loads.
+ */
+
+typedef struct {
+
+        /** Number of bytes read from the source. */
+
+        size_t bytes_read;
+
+        /** 
+         * Number of system calls made to read the data.  Each call
+         * to a read callback function is counted as one.
+         */
+
+        unsigned long syscalls;
+} JSONInputStats;
+
 struct _JSONInputReader {
 
         /**
@@ -47,29 +96,199 @@ struct _JSONInputReader {
         
         unsigned char input_buffer[256];
 
-        /** Number of bytes in input_buffer.  */
+        /**
+         * Pointer to the block of data currently being read.  For 
+         * callback sources this points to input_buffer; for memory
+         * and file sources it points directly at the input data, so
+         * that no copy is needed.
+         */
+
+        const unsigned char *input_data;
+
+        /** Number of bytes in input_data.  */
 
         size_t input_buffer_len;
 
-        /** Position we have reached reading data out of input_buffer.  */
+        /** Position we have reached reading data out of input_data.  */
 
         size_t input_buffer_pos;
 
+        /** 
+         * For UTF-8 input, the end of the trusted region of input_data:
+         * the data from input_buffer_pos up to this offset has been 
+         * validated, and consists of complete, valid sequences.
+         */
+
+        size_t trusted_len;
+
+        /** 
+         * Character pushed back with @ref json_input_unread_char, to be
+         * returned by the next read, or -1 if there is none.
+         */
+
+        int pending_char;
+
         /** If true, the end of file has been reached. */
 
         int eof;
 
+        /**
+         * If true, data is supplied with @ref json_input_feed rather
+         * than read from a source.
+         */
+
+        int push;
+
+        /**
+         * For push readers, data from the last block fed that is still
+         * to be read after the data in input_data.  This is used when
+         * a character was split between blocks: the start of the 
+         * character is kept in input_buffer, and the rest of the 
+         * character is appended to it.
+         */
+
+        const unsigned char *next_data;
+
+        /** Length of next_data, in bytes. */
+
+        size_t next_data_len;
+
         /** Input source. */
 
         JSONInputSource *source;
 
-        /** Callback function to read more data from the source. */
+        /** 
+         * Callback function to read more data from the source, or NULL
+         * if all data is already held in memory.
+         */
 
         JSONInputReadFunc read_func;
+
+        /** If non-NULL, start of a memory mapping to unmap when freed. */
+
+        void *mapping;
+
+        /** Length of the memory mapping. */
+
+        size_t mapping_len;
+
+        /** File descriptor to close when freed, or -1. */
+
+        int fd;
+
+        /** Allocator used for decompression. */
+
+        const JSONAllocator *allocator;
+
+        /** 
+         * If the input is compressed, the decompressor, or NULL.  
+         * Decompressed data is written to decompress_buffer, and
+         * input_data points to it.
+         */
+
+        JSONDecompressor *decompressor;
+
+        unsigned char *decompress_buffer;
+
+        /** Compressed data waiting to be decompressed. */
+
+        const unsigned char *compressed_data;
+
+        /** Length of compressed_data, in bytes. */
+
+        size_t compressed_len;
+
+        /** Buffer for compressed data read from a callback source. */
+
+        unsigned char *compressed_buffer;
+
+        /** If true, all compressed data has been read from the source. */
+
+        int compressed_eof;
+
+        /** 
+         * If the input is UTF-16 or UTF-32, it is converted to UTF-8 in
+         * blocks: data read from the source is converted into 
+         * transcode_buffer, and input_data points to it.  Otherwise, 
+         * NULL.
+         */
+
+        unsigned char *transcode_buffer;
+
+        /** Data read from the source that is waiting to be converted. */
+
+        const unsigned char *transcode_data;
+
+        /** Length of transcode_data, in bytes. */
+
+        size_t transcode_len;
+
+        /** 
+         * Start of a character that is split between blocks read from
+         * the source, kept until the rest of it has been read.
+         */
+
+        unsigned char transcode_partial[4];
+
+        /** Length of the data in transcode_partial, in bytes. */
+
+        size_t transcode_partial_len;
+
+        /** If true, all data to be converted has been read. */
+
+        int transcode_eof;
+
+        /** 
+         * If non-NULL, data is read in blocks from a block source (eg.
+         * a readahead thread), instead of from read_func, and 
+         * input_data (or compressed_data) points into its buffers.
+         */
+
+        void *block_source;
+
+        JSONInputBlockFunc block_next;
+
+        JSONInputBlockFreeFunc block_free;
+
+        /** 
+         * If true, the file in fd is read with asynchronous I/O, by a
+         * block source that is created when reading starts.
+         */
+
+        int async;
+
+        /**
+         * If true, the input data is a single writable block belonging
+         * to the caller, which the lexer may modify as it reads.
+         */
+
+        int in_situ;
+
+        /** 
+         * For iovec sources, the array of segments to read, and the
+         * position of the next segment to read as a block.
+         */
+
+        const struct iovec *iov;
+
+        int iov_count;
+
+        int iov_index;
+
+        size_t iov_offset;
+
+        /** Statistics about the input read. */
+
+        JSONInputStats stats;
 };
 
 /**
- * Initialise a @ref JSONInputReader structure.
+ * Initialise a @ref JSONInputReader structure.  If the data read from
+ * the source is compressed (gzip, or zstd if supported), this is 
+ * detected when reading starts, and it is decompressed as it is read.
+ * This also applies to memory and file sources, but not to push mode.
+ * UTF-16 and UTF-32 input is converted to UTF-8 in blocks as it is 
+ * read, for all sources.
  *
  * @param reader           Pointer to the structure to initialise.
  * @param source           Handle for source to read data from.
@@ -80,6 +299,165 @@ void json_input_reader_init(JSONInputReader *reader,
                             JSONInputSource source,
                             JSONInputReadFunc read_func);
 
+/**
+ * Set the allocator that a @ref JSONInputReader uses to allocate 
+ * memory.  This must be called after the reader is initialised; by
+ * default, the default allocator is used.
+ *
+ * @param reader           The reader.
+ * @param allocator        The allocator.  The pointer must remain valid
+ *                         until the reader is freed.
+ */
+
+void json_input_reader_set_allocator(JSONInputReader *reader,
+                                     const JSONAllocator *allocator);
+
+/**
+ * Start a background thread to read data for a @ref JSONInputReader
+ * ahead of when it is needed, so that waiting for input overlaps with
+ * processing of the data already read.  This must be called after the
+ * reader is initialised and before anything is read from it.  It has
+ * no effect on readers that do not read from a callback function 
+ * (memory sources, mapped files and push mode).
+ *
+ * @param reader           The reader.
+ * @param num_buffers      Number of buffers for the thread to read
+ *                         into (at least 2).
+ * @param buffer_size      Size of each buffer, in bytes.
+ * @return                 Zero if successful, or negative error code:
+ *                         @ref JSON_ERROR_INPUT_STREAM if reading has
+ *                         already started, or the thread could not be
+ *                         started.
+ */
+
+int json_input_reader_set_readahead(JSONInputReader *reader,
+                                    unsigned int num_buffers,
+                                    size_t buffer_size);
+
+/**
+ * Get statistics about the input read by a @ref JSONInputReader.
+ *
+ * @param reader           The reader.
+ * @param stats            Pointer to a structure to store the 
+ *                         statistics.
+ */
+
+void json_input_reader_get_stats(JSONInputReader *reader,
+                                 JSONInputStats *stats);
+
+/**
+ * Initialise a @ref JSONInputReader structure to read from a block of
+ * data already held in memory.  The data is read in place and is not
+ * copied, so it must remain valid until the reader is freed.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ * @param data             Pointer to the input data.
+ * @param data_len         Length of the input data, in bytes.
+ */
+
+void json_input_reader_init_memory(JSONInputReader *reader,
+                                   const void *data,
+                                   size_t data_len);
+
+/**
+ * Initialise a @ref JSONInputReader structure to read from a writable
+ * block of data held in memory, which may be modified as it is read:
+ * the lexer unescapes strings in place in the data (see 
+ * @ref json_input_is_in_situ).  The data must remain valid until the 
+ * reader is freed.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ * @param data             Pointer to the input data.
+ * @param data_len         Length of the input data, in bytes.
+ */
+
+void json_input_reader_init_in_situ(JSONInputReader *reader,
+                                    void *data, size_t data_len);
+
+/**
+ * Initialise a @ref JSONInputReader structure to read from data held
+ * in memory in several segments, described by an array of iovec 
+ * structures.  Each segment is read in place as a block, so that the
+ * data is not copied, and must remain valid (as must the array) until
+ * the reader is freed.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ * @param iov              Pointer to the array of segments.
+ * @param iov_count        Number of segments in the array.
+ */
+
+void json_input_reader_init_iovec(JSONInputReader *reader,
+                                  const struct iovec *iov,
+                                  int iov_count);
+
+/**
+ * Initialise a @ref JSONInputReader structure to read from a file.
+ * Where possible, the file is mapped into memory and read in place.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ * @param filename         Path to the file to read.
+ * @return                 Zero if successful, or negative error code.
+ */
+
+int json_input_reader_init_file(JSONInputReader *reader,
+                                const char *filename);
+
+/**
+ * Initialise a @ref JSONInputReader structure to read from a file 
+ * using asynchronous I/O, with several large reads in flight at once.
+ * On Linux, io_uring is used where it is available; otherwise the 
+ * file is read with pread(), in large blocks.  This is intended for
+ * large regular files, where it makes far fewer system calls than 
+ * reading through a callback function.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ * @param filename         Path to the file to read.
+ * @return                 Zero if successful, or negative error code.
+ */
+
+int json_input_reader_init_file_async(JSONInputReader *reader,
+                                      const char *filename);
+
+/**
+ * Initialise a @ref JSONInputReader structure for push mode, where
+ * data is supplied in blocks with @ref json_input_feed as it becomes
+ * available, instead of being read from a source.  When all data in
+ * the current block has been read, reads fail with 
+ * @ref JSON_ERROR_NEED_MORE.
+ *
+ * @param reader           Pointer to the structure to initialise.
+ */
+
+void json_input_reader_init_push(JSONInputReader *reader);
+
+/**
+ * Supply the next block of data to a push mode @ref JSONInputReader.
+ * The data is read in place, so it must remain valid until a read
+ * fails with @ref JSON_ERROR_NEED_MORE.  If a character is split 
+ * between blocks, the start of it is kept by the reader.
+ *
+ * @param reader           The reader.
+ * @param data             Pointer to the data.
+ * @param data_len         Length of the data, in bytes.  If zero, this
+ *                         indicates the end of the input.
+ * @return                 Zero if successful, or negative error code:
+ *                         @ref JSON_ERROR_INPUT_STREAM if the reader
+ *                         is not a push mode reader, or data from the
+ *                         previous block is still waiting to be read.
+ */
+
+int json_input_feed(JSONInputReader *reader,
+                    const void *data, size_t data_len);
+
+/**
+ * Free resources (memory mappings, file descriptors) used by a
+ * @ref JSONInputReader.
+ *
+ * @param reader           The reader.
+ */
+
+void json_input_reader_free(JSONInputReader *reader);
+
 /**
  * Read a character from a @ref JSONInputReader.
  *
@@ -89,6 +467,119 @@ void json_input_reader_init(JSONInputReader *reader,
 
 int json_input_read_char(JSONInputReader *reader);
 
+/**
+ * Read a character from a @ref JSONInputReader, in the same way as 
+ * @ref json_input_read_char.  This is a macro: ASCII characters in the
+ * trusted region of the input (see @ref json_input_get_trusted_len) 
+ * are read directly, and only other characters need a function call.
+ * Because the trusted region only exists once the encoding has been
+ * determined, and the input is always decoded as UTF-8 after that, 
+ * no checks of the encoding are needed.  The reader argument is 
+ * evaluated more than once.
+ *
+ * @param reader           The reader to read from.
+ * @return                 Character value, or negative error value.
+ */
+
+#define JSON_INPUT_READ_CHAR(reader)                                      \
+        ((reader)->input_buffer_pos < (reader)->trusted_len               \
+          && (reader)->pending_char < 0                                   \
+          && (reader)->input_data[(reader)->input_buffer_pos] < 0x80      \
+            ? (reader)->input_data[(reader)->input_buffer_pos++]          \
+            : json_input_read_char(reader))
+
+/**
+ * Push back a character read with @ref json_input_read_char, so that
+ * it is returned again by the next read.  Only one character can be 
+ * pushed back at a time.
+ *
+ * @param reader           The reader.
+ * @param c                The character to push back.
+ */
+
+void json_input_unread_char(JSONInputReader *reader, int c);
+
+/**
+ * Get a pointer to the block of input data that is waiting to be
+ * read, refilling the input buffer first if it is empty.  This allows
+ * runs of UTF-8 data to be processed in bulk, rather than a character
+ * at a time.  The data must be consumed with @ref json_input_skip.
+ * If a character has been pushed back with @ref json_input_unread_char,
+ * the span is empty.
+ *
+ * @param reader           The reader.
+ * @param span             Pointer to a variable to store a pointer to
+ *                         the data.
+ * @param span_len         Pointer to a variable to store the number of
+ *                         bytes available.
+ * @return                 Zero if successful, or negative error code.
+ */
+
+int json_input_get_span(JSONInputReader *reader,
+                        const unsigned char **span,
+                        size_t *span_len);
+
+/**
+ * Consume bytes returned by @ref json_input_get_span.
+ *
+ * @param reader           The reader.
+ * @param bytes            Number of bytes to consume.
+ */
+
+void json_input_skip(JSONInputReader *reader, size_t bytes);
+
+/**
+ * Query if the data returned by @ref json_input_get_span is UTF-8.
+ * This is true for UTF-8 input, and also for UTF-16 and UTF-32 input,
+ * which is converted to UTF-8 as it is read.
+ *
+ * @param reader           The reader.
+ * @return                 Non-zero if the data is UTF-8.
+ */
+
+int json_input_is_utf8(JSONInputReader *reader);
+
+/**
+ * Query if the data returned by @ref json_input_get_span is the input
+ * itself, read in place, rather than a copy in a buffer.  This is true
+ * for UTF-8 memory sources, mapped files and iovec arrays that are not
+ * compressed.  Data read in place remains valid, at the same address,
+ * until the reader is freed or initialised again.
+ *
+ * @param reader           The reader.
+ * @return                 Non-zero if the data is read in place.
+ */
+
+int json_input_is_in_place(JSONInputReader *reader);
+
+/**
+ * Query if the data returned by @ref json_input_get_span may be 
+ * modified.  This is true if the reader was initialised with
+ * @ref json_input_reader_init_in_situ and the data is read in place
+ * (it is not compressed, and is UTF-8).  Only data that has already
+ * been consumed may be modified.
+ *
+ * @param reader           The reader.
+ * @return                 Non-zero if the data may be modified.
+ */
+
+int json_input_is_in_situ(JSONInputReader *reader);
+
+/**
+ * Get the number of bytes of the data returned by 
+ * @ref json_input_get_span that are trusted to be valid UTF-8: they 
+ * have been validated, and consist of complete, valid sequences, 
+ * which can be used without further checks.  The data is validated 
+ * in chunks, as it is needed, so this may be less than the length of
+ * the span even if all of it is valid.
+ *
+ * @param reader           The reader.
+ * @return                 Number of trusted bytes, which is always 
+ *                         zero if the data is not UTF-8.
+ */
+
+size_t json_input_get_trusted_len(JSONInputReader *reader);
+
 /**
  * Query if an input stream has reached the end of file. 
  *
@@ -109,6 +600,28 @@ int json_input_is_eof(JSONInputReader *reader);
 int json_input_get_encoding(JSONInputReader *reader,
                             JSONInputEncoding *encoding);
 
+/**
+ * Get all of the input data that is still to be read, if the input 
+ * is UTF-8 and is held in memory as a single block, read in place: 
+ * this is the case for memory sources and mapped files that are not
+ * compressed.  The encoding is detected first, if it has not been 
+ * already.
+ *
+ * @param reader           The reader.
+ * @param data             Pointer to a variable to store a pointer to
+ *                         the data, which starts at the current 
+ *                         position.
+ * @param data_len         Pointer to a variable to store the length of
+ *                         the data, in bytes.
+ * @return                 Zero if successful, or negative error code:
+ *                         @ref JSON_ERROR_INPUT_STREAM if the input is
+ *                         not held in memory in this way.
+ */
+
+int json_input_get_document(JSONInputReader *reader,
+                            const unsigned char **data,
+                            size_t *data_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,189 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "key-intern.h"
+#include "key-set.h"
+
+/* Initial number of slots, allocated when the first key is added. */
+
+#define KEY_INTERN_MIN_SIZE       64
+
+/* Keys longer than this are not interned. */
+
+#define KEY_INTERN_MAX_LENGTH     256
+
+/* Maximum number of keys in a table. */
+
+#define KEY_INTERN_MAX_KEYS       65536
+
+void json_key_intern_init(JSONKeyIntern *table,
+                          const JSONAllocator *allocator)
+{
+        table->entries = NULL;
+        table->mask = 0;
+        table->num_keys = 0;
+        table->lookups = 0;
+        table->hits = 0;
+        table->allocator = allocator;
+}
+
+void json_key_intern_free(JSONKeyIntern *table)
+{
+        size_t i;
+
+        if (table->entries != NULL) {
+                for (i=0; i<=table->mask; ++i) {
+                        json_allocator_free(table->allocator,
+                                            table->entries[i].key);
+                }
+        }
+
+        json_allocator_free(table->allocator, table->entries);
+
+        json_key_intern_init(table, table->allocator);
+}
+
+/* Double the size of the table (or allocate it, if empty), moving the
+ * keys into their new slots.  Returns non-zero for success. */
+
+static int json_key_intern_enlarge(JSONKeyIntern *table)
+{
+        JSONKeyInternEntry *entries;
+        size_t new_size;
+        size_t i, slot;
+
+        if (table->entries == NULL) {
+                new_size = KEY_INTERN_MIN_SIZE;
+        } else {
+                new_size = (table->mask + 1) * 2;
+        }
+
+        entries = json_allocator_alloc(table->allocator,
+                                       sizeof(JSONKeyInternEntry) * new_size);
+
+        if (entries == NULL) {
+                return 0;
+        }
+
+        for (i=0; i<new_size; ++i) {
+                entries[i].key = NULL;
+        }
+
+        if (table->entries != NULL) {
+                for (i=0; i<=table->mask; ++i) {
+                        if (table->entries[i].key == NULL) {
+                                continue;
+                        }
+
+                        slot = table->entries[i].hash & (new_size - 1);
+
+                        while (entries[slot].key != NULL) {
+                                slot = (slot + 1) & (new_size - 1);
+                        }
+
+                        entries[slot] = table->entries[i];
+                }
+
+                json_allocator_free(table->allocator, table->entries);
+        }
+
+        table->entries = entries;
+        table->mask = new_size - 1;
+
+        return 1;
+}
+
+const char *json_key_intern(JSONKeyIntern *table, const char *data,
+                            size_t length)
+{
+        JSONKeyInternEntry *entry;
+        uint32_t hash;
+        size_t slot;
+        char *key;
+
+        ++table->lookups;
+
+        if (length > KEY_INTERN_MAX_LENGTH) {
+                return NULL;
+        }
+
+        hash = (uint32_t) json_key_hash(0, data, length);
+
+        /* Search for the key, stopping at the first empty slot. */
+
+        if (table->entries != NULL) {
+                slot = hash & table->mask;
+
+                for (;;) {
+                        entry = &table->entries[slot];
+
+                        if (entry->key == NULL) {
+                                break;
+                        }
+
+                        if (entry->hash == hash && entry->length == length
+                         && memcmp(entry->key, data, length) == 0) {
+                                ++table->hits;
+                                return entry->key;
+                        }
+
+                        slot = (slot + 1) & table->mask;
+                }
+        }
+
+        /* Add the key, keeping the table at most half full. */
+
+        if (table->num_keys >= KEY_INTERN_MAX_KEYS) {
+                return NULL;
+        }
+
+        if (table->entries == NULL
+         || (table->num_keys + 1) * 2 > table->mask + 1) {
+                if (!json_key_intern_enlarge(table)) {
+                        return NULL;
+                }
+        }
+
+        key = json_allocator_alloc(table->allocator, length + 1);
+
+        if (key == NULL) {
+                return NULL;
+        }
+
+        memcpy(key, data, length);
+        key[length] = '\0';
+
+        slot = hash & table->mask;
+
+        while (table->entries[slot].key != NULL) {
+                slot = (slot + 1) & table->mask;
+        }
+
+        entry = &table->entries[slot];
+        entry->key = key;
+        entry->length = length;
+        entry->hash = hash;
+        ++table->num_keys;
+
+        return key;
+}
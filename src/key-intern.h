@@ -0,0 +1,131 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_KEY_INTERN_H
+#define JIGSAWN_INTERNAL_KEY_INTERN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+/*
+ * Table of interned object keys.  Each distinct key is copied once,
+ * and the same copy is used for every occurrence of the key, so that
+ * keys can be compared by pointer.  The table is an open addressing 
+ * hash table with linear probing, keyed by the bytes of the key.
+ */
+
+/**
+ * An entry in a @ref JSONKeyIntern table.
+ */
+
+typedef struct {
+
+        /** The key, NUL-terminated, or NULL for an empty slot. */
+
+        char *key;
+
+        /** Length of the key, in bytes. */
+
+        size_t length;
+
+        /** Hash of the key. */
+
+        uint32_t hash;
+} JSONKeyInternEntry;
+
+/**
+ * Key intern table.
+ */
+
+typedef struct {
+
+        /** Slots of the table. */
+
+        JSONKeyInternEntry *entries;
+
+        /** Number of slots, which is a power of two, minus one. */
+
+        size_t mask;
+
+        /** Number of keys in the table. */
+
+        size_t num_keys;
+
+        /** Number of keys looked up. */
+
+        unsigned long lookups;
+
+        /** Number of keys looked up that were already in the table. */
+
+        unsigned long hits;
+
+        /** Allocator used to allocate the table and keys. */
+
+        const JSONAllocator *allocator;
+} JSONKeyIntern;
+
+/**
+ * Initialise an empty @ref JSONKeyIntern table.
+ *
+ * @param table             Pointer to the structure to initialise.
+ * @param allocator         Allocator to allocate memory from.
+ */
+
+void json_key_intern_init(JSONKeyIntern *table,
+                          const JSONAllocator *allocator);
+
+/**
+ * Look up a key in a @ref JSONKeyIntern table, adding it if it is not
+ * already there.  To bound the memory used for documents that do not
+ * repeat their keys, such as objects used as maps, long keys are not
+ * interned, and no more keys are added once the table is full.
+ *
+ * @param table             The table.
+ * @param data              Pointer to the key data.
+ * @param length            Length of the key, in bytes.
+ * @return                  The interned copy of the key, which is
+ *                          NUL-terminated and remains valid until the
+ *                          table is freed, or NULL if the key could
+ *                          not be interned.
+ */
+
+const char *json_key_intern(JSONKeyIntern *table, const char *data,
+                            size_t length);
+
+/**
+ * Free a @ref JSONKeyIntern table and the keys in it.
+ *
+ * @param table             The table.
+ */
+
+void json_key_intern_free(JSONKeyIntern *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_KEY_INTERN_H */
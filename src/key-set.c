@@ -0,0 +1,411 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "jigsawn/error.h"
+
+#include "key-set.h"
+
+/* Smallest table size.  The table has at least twice as many slots as
+ * there are keys, so that each bucket quickly finds free slots. */
+
+#define KEY_SET_MIN_TABLE_SIZE    8
+
+/* Number of seeds tried before giving up on building the set. */
+
+#define KEY_SET_MAX_SEEDS         (1 << 16)
+
+uint64_t json_key_hash(uint32_t seed, const char *data, size_t length)
+{
+        uint64_t h;
+        size_t i;
+
+        h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+
+        for (i=0; i<length; ++i) {
+                h ^= (unsigned char) data[i];
+                h *= 0x100000001b3ULL;
+        }
+
+        h ^= h >> 29;
+
+        return h;
+}
+
+/* The low 32 bits of the hash give the first slot for a key, and the 
+ * high bits its bucket and the step between the slots tried for each
+ * displacement. */
+
+static unsigned int key_bucket(const JSONKeySet *set, uint64_t h)
+{
+        return (uint32_t) (h >> 32) % set->num_buckets;
+}
+
+static uint32_t key_slot(const JSONKeySet *set, uint64_t h,
+                         uint32_t displacement)
+{
+        uint32_t step;
+
+        /* The step is odd, so that the displacements of a key cover 
+         * every slot in the table. */
+
+        step = (uint32_t) (h >> 24) | 1;
+
+        return ((uint32_t) h + displacement * step) & set->table_mask;
+}
+
+void json_key_set_init(JSONKeySet *set, const JSONAllocator *allocator)
+{
+        set->keys = NULL;
+        set->lengths = NULL;
+        set->num_keys = 0;
+        set->displacements = NULL;
+        set->num_buckets = 0;
+        set->slots = NULL;
+        set->table_mask = 0;
+        set->seed = 0;
+        set->allocator = allocator;
+}
+
+void json_key_set_free(JSONKeySet *set)
+{
+        unsigned int i;
+
+        if (set->keys != NULL) {
+                for (i=0; i<set->num_keys; ++i) {
+                        json_allocator_free(set->allocator, set->keys[i]);
+                }
+        }
+
+        json_allocator_free(set->allocator, set->keys);
+        json_allocator_free(set->allocator, set->lengths);
+        json_allocator_free(set->allocator, set->displacements);
+        json_allocator_free(set->allocator, set->slots);
+
+        json_key_set_init(set, set->allocator);
+}
+
+/* Copy the keys into the set.  Returns zero for success, or negative
+ * error code. */
+
+static int copy_keys(JSONKeySet *set, const char *const *keys,
+                     unsigned int num_keys)
+{
+        unsigned int i;
+
+        set->keys = json_allocator_alloc(set->allocator,
+                                         sizeof(char *) * num_keys);
+        set->lengths = json_allocator_alloc(set->allocator,
+                                            sizeof(size_t) * num_keys);
+
+        if (set->keys == NULL || set->lengths == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        for (i=0; i<num_keys; ++i) {
+                set->keys[i] = NULL;
+        }
+
+        set->num_keys = num_keys;
+
+        for (i=0; i<num_keys; ++i) {
+                set->lengths[i] = strlen(keys[i]);
+                set->keys[i] = json_allocator_alloc(set->allocator,
+                                                    set->lengths[i] + 1);
+
+                if (set->keys[i] == NULL) {
+                        return JSON_ERROR_OUT_OF_MEMORY;
+                }
+
+                memcpy(set->keys[i], keys[i], set->lengths[i] + 1);
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Find the first appearance of a key in the set, returning its ID. */
+
+static unsigned int first_appearance(JSONKeySet *set, unsigned int key_id)
+{
+        unsigned int i;
+
+        for (i=0; i<key_id; ++i) {
+                if (set->lengths[i] == set->lengths[key_id]
+                 && memcmp(set->keys[i], set->keys[key_id],
+                           set->lengths[i]) == 0) {
+                        break;
+                }
+        }
+
+        return i;
+}
+
+/* Try to place the keys into the table with the current seed.
+ * members lists the IDs of the keys to place, which is reordered so
+ * that the keys in each bucket are together; bucket_start gives the
+ * index in members of the first key in each bucket, and order is used
+ * to sort the buckets by size.  Returns non-zero for success. */
+
+static int place_keys(JSONKeySet *set, unsigned int *members,
+                      unsigned int num_members, unsigned int *bucket_start,
+                      unsigned int *order)
+{
+        unsigned int num_buckets;
+        unsigned int b, i, j, k;
+        unsigned int start, size;
+        unsigned int bucket;
+        uint32_t displacement;
+        uint32_t slot;
+        uint64_t h;
+        int id;
+
+        num_buckets = set->num_buckets;
+
+        /* Group the keys by bucket with a counting sort, storing the
+         * sorted IDs in the table temporarily. */
+
+        memset(bucket_start, 0, sizeof(unsigned int) * (num_buckets + 1));
+        memset(set->displacements, 0, sizeof(uint32_t) * num_buckets);
+
+        for (i=0; i<num_members; ++i) {
+                h = json_key_hash(set->seed, set->keys[members[i]],
+                                  set->lengths[members[i]]);
+                ++bucket_start[key_bucket(set, h) + 1];
+        }
+
+        for (b=0; b<num_buckets; ++b) {
+                bucket_start[b + 1] += bucket_start[b];
+                order[b] = bucket_start[b];
+        }
+
+        for (i=0; i<num_members; ++i) {
+                h = json_key_hash(set->seed, set->keys[members[i]],
+                                  set->lengths[members[i]]);
+                bucket = key_bucket(set, h);
+                set->slots[order[bucket]] = (int) members[i];
+                ++order[bucket];
+        }
+
+        for (i=0; i<num_members; ++i) {
+                members[i] = (unsigned int) set->slots[i];
+        }
+
+        /* Sort the buckets so that the largest are placed first, 
+         * while the table is still mostly empty. */
+
+        for (b=0; b<num_buckets; ++b) {
+                size = bucket_start[b + 1] - bucket_start[b];
+
+                for (j=b; j > 0; --j) {
+                        k = order[j - 1];
+
+                        if (bucket_start[k + 1] - bucket_start[k] >= size) {
+                                break;
+                        }
+
+                        order[j] = k;
+                }
+
+                order[j] = b;
+        }
+
+        for (i=0; i<=set->table_mask; ++i) {
+                set->slots[i] = -1;
+        }
+
+        /* Find a displacement for each bucket that moves all of its 
+         * keys into free slots. */
+
+        for (b=0; b<num_buckets; ++b) {
+                bucket = order[b];
+                start = bucket_start[bucket];
+                size = bucket_start[bucket + 1] - start;
+
+                if (size == 0) {
+                        break;
+                }
+
+                for (displacement=0; displacement<=set->table_mask;
+                     ++displacement) {
+
+                        for (i=0; i<size; ++i) {
+                                id = (int) members[start + i];
+                                h = json_key_hash(set->seed,
+                                                  set->keys[id],
+                                                  set->lengths[id]);
+                                slot = key_slot(set, h, displacement);
+
+                                if (set->slots[slot] >= 0) {
+                                        break;
+                                }
+
+                                set->slots[slot] = id;
+                        }
+
+                        if (i == size) {
+                                break;
+                        }
+
+                        /* Undo the keys placed before the collision. */
+
+                        for (j=0; j<i; ++j) {
+                                id = (int) members[start + j];
+                                h = json_key_hash(set->seed,
+                                                  set->keys[id],
+                                                  set->lengths[id]);
+                                set->slots[key_slot(set, h, displacement)]
+                                        = -1;
+                        }
+                }
+
+                if (displacement > set->table_mask) {
+                        return 0;
+                }
+
+                set->displacements[bucket] = displacement;
+        }
+
+        return 1;
+}
+
+int json_key_set_build(JSONKeySet *set, const char *const *keys,
+                       unsigned int num_keys)
+{
+        unsigned int *members;
+        unsigned int *bucket_start;
+        unsigned int *order;
+        unsigned int num_members;
+        unsigned int table_size;
+        unsigned int i;
+        int err;
+
+        json_key_set_free(set);
+
+        if (num_keys == 0) {
+                return JSON_ERROR_SUCCESS;
+        }
+
+        err = copy_keys(set, keys, num_keys);
+
+        if (err < 0) {
+                json_key_set_free(set);
+                return err;
+        }
+
+        /* Only the first appearance of each key is placed in the 
+         * table. */
+
+        members = json_allocator_alloc(set->allocator,
+                                       sizeof(unsigned int) * num_keys);
+
+        if (members == NULL) {
+                json_key_set_free(set);
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        num_members = 0;
+
+        for (i=0; i<num_keys; ++i) {
+                if (first_appearance(set, i) == i) {
+                        members[num_members] = i;
+                        ++num_members;
+                }
+        }
+
+        table_size = KEY_SET_MIN_TABLE_SIZE;
+
+        while (table_size < num_members * 2) {
+                table_size *= 2;
+        }
+
+        set->table_mask = table_size - 1;
+        set->num_buckets = (num_members + 1) / 2;
+
+        set->slots = json_allocator_alloc(set->allocator,
+                                          sizeof(int) * table_size);
+        set->displacements = json_allocator_alloc(set->allocator,
+                                sizeof(uint32_t) * set->num_buckets);
+        bucket_start = json_allocator_alloc(set->allocator,
+                                sizeof(unsigned int) * (set->num_buckets + 1));
+        order = json_allocator_alloc(set->allocator,
+                                     sizeof(unsigned int) * set->num_buckets);
+
+        if (set->slots == NULL || set->displacements == NULL
+         || bucket_start == NULL || order == NULL) {
+                err = JSON_ERROR_OUT_OF_MEMORY;
+        } else {
+                /* With random keys, a seed usually only fails if two
+                 * keys in the same bucket have the same first slot and
+                 * step, so one of the first few seeds normally works.
+                 * Keys whose hashes collide for every seed, whether by
+                 * chance or by design, are rejected rather than 
+                 * searched for forever. */
+
+                err = JSON_ERROR_INVALID_ARGUMENT;
+
+                for (set->seed = 0; set->seed < KEY_SET_MAX_SEEDS;
+                     ++set->seed) {
+                        if (place_keys(set, members, num_members,
+                                       bucket_start, order)) {
+                                err = JSON_ERROR_SUCCESS;
+                                break;
+                        }
+                }
+        }
+
+        json_allocator_free(set->allocator, members);
+        json_allocator_free(set->allocator, bucket_start);
+        json_allocator_free(set->allocator, order);
+
+        if (err < 0) {
+                json_key_set_free(set);
+        }
+
+        return err;
+}
+
+int json_key_set_lookup(const JSONKeySet *set, const char *data,
+                        size_t length)
+{
+        uint64_t h;
+        int id;
+
+        if (set->num_keys == 0) {
+                return -1;
+        }
+
+        h = json_key_hash(set->seed, data, length);
+        id = set->slots[key_slot(set, h,
+                                 set->displacements[key_bucket(set, h)])];
+
+        if (id >= 0 && set->lengths[id] == length
+         && memcmp(set->keys[id], data, length) == 0) {
+                return id;
+        }
+
+        return -1;
+}
+
+const char *json_key_set_get_key(const JSONKeySet *set, int key_id)
+{
+        return set->keys[key_id];
+}
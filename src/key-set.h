@@ -0,0 +1,154 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_KEY_SET_H
+#define JIGSAWN_INTERNAL_KEY_SET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+/*
+ * A fixed set of object keys, each of which has an integer ID, looked
+ * up with a perfect hash: every key in the set hashes to its own slot
+ * in the table, so a lookup hashes the key, reads one slot and makes
+ * one comparison.  The hash function is built with the "hash and
+ * displace" method: the keys are divided into buckets by their hash,
+ * and each bucket is given a displacement that moves all of its keys
+ * into free slots, starting with the largest buckets.
+ */
+
+typedef struct {
+
+        /** Copies of the keys, NUL-terminated, indexed by key ID. */
+
+        char **keys;
+
+        /** Lengths of the keys, indexed by key ID. */
+
+        size_t *lengths;
+
+        /** Number of keys. */
+
+        unsigned int num_keys;
+
+        /** Displacement for each bucket. */
+
+        uint32_t *displacements;
+
+        /** Number of buckets. */
+
+        unsigned int num_buckets;
+
+        /** Key ID stored in each slot of the table, or -1 if empty. */
+
+        int *slots;
+
+        /** Size of the table, which is a power of two, minus one. */
+
+        uint32_t table_mask;
+
+        /** Seed for the hash function. */
+
+        uint32_t seed;
+
+        /** Allocator used to allocate the set. */
+
+        const JSONAllocator *allocator;
+} JSONKeySet;
+
+/**
+ * Hash a key with 64-bit FNV-1a, varied by a seed.
+ *
+ * @param seed              The seed.
+ * @param data              Pointer to the key data.
+ * @param length            Length of the key, in bytes.
+ * @return                  The hash.
+ */
+
+uint64_t json_key_hash(uint32_t seed, const char *data, size_t length);
+
+/**
+ * Initialise an empty @ref JSONKeySet.
+ *
+ * @param set               Pointer to the structure to initialise.
+ * @param allocator         Allocator to allocate memory from.
+ */
+
+void json_key_set_init(JSONKeySet *set, const JSONAllocator *allocator);
+
+/**
+ * Build a @ref JSONKeySet from an array of keys, replacing any keys
+ * already in the set.  The ID of each key is its index in the array;
+ * if a key appears more than once, the ID of its first appearance is
+ * used.
+ *
+ * @param set               The set.
+ * @param keys              Array of keys, as NUL-terminated strings.
+ * @param num_keys          Number of keys in the array.
+ * @return                  Zero if successful, or negative error code:
+ *                          @ref JSON_ERROR_INVALID_ARGUMENT if no 
+ *                          perfect hash could be found for the keys.
+ */
+
+int json_key_set_build(JSONKeySet *set, const char *const *keys,
+                       unsigned int num_keys);
+
+/**
+ * Look up a key in a @ref JSONKeySet.
+ *
+ * @param set               The set.
+ * @param data              Pointer to the key data.
+ * @param length            Length of the key, in bytes.
+ * @return                  ID of the key, or -1 if it is not in the set.
+ */
+
+int json_key_set_lookup(const JSONKeySet *set, const char *data,
+                        size_t length);
+
+/**
+ * Get a key in a @ref JSONKeySet.
+ *
+ * @param set               The set.
+ * @param key_id            ID of the key.
+ * @return                  The key, as a NUL-terminated string.
+ */
+
+const char *json_key_set_get_key(const JSONKeySet *set, int key_id);
+
+/**
+ * Free the memory used by a @ref JSONKeySet.
+ *
+ * @param set               The set.
+ */
+
+void json_key_set_free(JSONKeySet *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_KEY_SET_H */
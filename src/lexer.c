@@ -20,27 +20,107 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "jigsawn/error.h"
 
 #include "input-reader.h"
 #include "lexer.h"
+#include "number.h"
 #include "string-buffer.h"
+#include "string-scan.h"
+#include "structural-index.h"
+#include "utf8.h"
+
+/* State of a token being read.  In push mode, the input may run out
+ * part-way through a token; the state is saved so that reading can
+ * continue when more input has been fed. */
+
+typedef enum {
+        LEXER_STATE_START,                /* Not inside a token */
+        LEXER_STATE_STRING,               /* Inside a string */
+        LEXER_STATE_ESCAPE,               /* After \ inside a string */
+        LEXER_STATE_UNICODE_ESCAPE,       /* Inside \uXXXX */
+        LEXER_STATE_KEYWORD,              /* Inside true/false/null */
+        LEXER_STATE_NUMBER_SIGN,          /* After leading - */
+        LEXER_STATE_NUMBER_INT,           /* Integer part */
+        LEXER_STATE_NUMBER_POINT,         /* After integer part */
+        LEXER_STATE_NUMBER_FRAC_FIRST,    /* After decimal point */
+        LEXER_STATE_NUMBER_FRAC,          /* Fractional part */
+        LEXER_STATE_NUMBER_EXP_MARK,      /* After fractional part */
+        LEXER_STATE_NUMBER_EXP_SIGN,      /* After e/E */
+        LEXER_STATE_NUMBER_EXP_FIRST,     /* After exponent sign */
+        LEXER_STATE_NUMBER_EXP,           /* Exponent digits */
+} JSONLexerState;
+
+typedef struct {
+
+        /** String buffer in which we store the token contents. */
+
+        JSONStringBuffer buffer;
+
+        /**
+         * If non-NULL, the contents of a string token are in the input
+         * data, which is read in place, rather than in the buffer.
+         */
+
+        const unsigned char *view;
+        size_t view_len;
+
+        /** Binary value of number tokens. */
+
+        union {
+                int64_t intval;
+                uint64_t uintval;
+                double floatval;
+        } number;
+
+        /** State of the token being read. */
+
+        JSONLexerState state;
+
+        /** Number being read, and whether it is a floating point value. */
+
+        JSONNumber partial_number;
+        int is_float;
+
+        /** Exponent of a number being read, and its sign. */
+
+        int exponent;
+        int exponent_negative;
+
+        /** Value of a \u escape sequence being read, and its length. */
+
+        int escape_value;
+        int escape_digits;
+
+        /** Remainder of a keyword being matched, and its token. */
+
+        const char *keyword;
+        JSONToken keyword_token;
+
+        /** Error code, if reading the token failed. */
+
+        int error;
+} JSONTokenData;
 
 struct _JSONLexer {
+
+        /** Allocator used for the lexer and its buffers */
+
+        JSONAllocator allocator;
         
         /** Input source reader */
 
         JSONInputReader reader;
 
         /** 
-         * String buffers in which we store token contents.  We read
-         * one token ahead so that we can "peek" at the next token; 
-         * to do this, we need two separate string buffer.  We switch
-         * between which buffer we're using.
+         * Token contents.  We read one token ahead so that we can 
+         * "peek" at the next token; to do this, we need two separate 
+         * sets of token data.  We switch between which one we're using.
          */
 
-        JSONStringBuffer string_buffers[2];
+        JSONTokenData token_data[2];
 
         /**
          * Buffer used for the last token returned by
@@ -56,58 +136,226 @@ struct _JSONLexer {
 
         JSONToken next_token;
 
+        /**
+         * Error code for the error token, once one has been read.
+         */
+
+        int error;
+
         /** 
          * Non-zero when we have read the first token.
          */
 
         int read_first;
+
+        /** 
+         * If non-zero, a structural index is built when reading starts,
+         * if the input is held in memory, using this number of threads.
+         */
+
+        unsigned int index_threads;
+
+        /** Structural index of the input. */
+
+        JSONStructuralIndex index;
+
+        /** 
+         * Start of the indexed input data, which positions in the index
+         * are relative to, or NULL if the index is not being used.
+         */
+
+        const unsigned char *index_data;
+
+        /** Length of the indexed input data, in bytes. */
+
+        size_t index_len;
+
+        /** Next position in the index that has not been read past. */
+
+        size_t index_pos;
+
+        /**
+         * State of a skip (see @ref json_lexer_skip): the number of 
+         * arrays and objects still to be closed, which is zero if no 
+         * skip is in progress, and whether the skip is inside a string
+         * and after a backslash.  A skip is only left in progress if 
+         * more input is needed to finish it.  skip_requested is the 
+         * number of levels that the skip in progress was asked for.
+         */
+
+        unsigned int skip_levels;
+        unsigned int skip_requested;
+        int skip_in_string;
+        int skip_escaped;
+};
+
+/* Character classes.  These are used instead of the <ctype.h> 
+ * functions, which are slower, and which depend on the locale: the
+ * characters that are whitespace or hex digits in JSON are always the
+ * same. */
+
+#define CHAR_WHITESPACE         0x01      /* Space, tab, CR or LF */
+#define CHAR_HEX_DIGIT          0x02      /* 0-9, a-f, A-F */
+#define CHAR_PUNCTUATION        0x04      /* Single character token */
+#define CHAR_STRING             0x08      /* Start of a string */
+#define CHAR_NUMBER             0x10      /* Start of a number */
+#define CHAR_KEYWORD            0x20      /* Start of a keyword */
+
+typedef struct {
+
+        /** Character class flags. */
+
+        unsigned char flags;
+
+        /** 
+         * For punctuation, the token; for the start of a keyword, the
+         * index of the keyword in the keywords table.
+         */
+
+        unsigned char value;
+} JSONCharClass;
+
+/* Keywords, with the tokens that they are read as. */
+
+typedef struct {
+        const char *text;
+        size_t length;
+        JSONToken token;
+} JSONKeyword;
+
+static const JSONKeyword keywords[] = {
+        { "true",  4, JSON_TOKEN_TRUE },
+        { "false", 5, JSON_TOKEN_FALSE },
+        { "null",  4, JSON_TOKEN_NULL },
+};
+
+/* Class of each byte value.  Characters beyond the end of the table
+ * have no class. */
+
+static const JSONCharClass char_classes[256] = {
+        [' ']  = { CHAR_WHITESPACE },
+        ['\t'] = { CHAR_WHITESPACE },
+        ['\n'] = { CHAR_WHITESPACE },
+        ['\r'] = { CHAR_WHITESPACE },
+
+        ['[']  = { CHAR_PUNCTUATION, JSON_TOKEN_BEGIN_ARRAY },
+        [']']  = { CHAR_PUNCTUATION, JSON_TOKEN_END_ARRAY },
+        ['{']  = { CHAR_PUNCTUATION, JSON_TOKEN_BEGIN_OBJECT },
+        ['}']  = { CHAR_PUNCTUATION, JSON_TOKEN_END_OBJECT },
+        [':']  = { CHAR_PUNCTUATION, JSON_TOKEN_COLON },
+        [',']  = { CHAR_PUNCTUATION, JSON_TOKEN_COMMA },
+
+        ['\"'] = { CHAR_STRING },
+
+        ['-']  = { CHAR_NUMBER },
+        ['0']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['1']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['2']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['3']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['4']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['5']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['6']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['7']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['8']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+        ['9']  = { CHAR_NUMBER | CHAR_HEX_DIGIT },
+
+        ['a']  = { CHAR_HEX_DIGIT },
+        ['b']  = { CHAR_HEX_DIGIT },
+        ['c']  = { CHAR_HEX_DIGIT },
+        ['d']  = { CHAR_HEX_DIGIT },
+        ['e']  = { CHAR_HEX_DIGIT },
+        ['f']  = { CHAR_HEX_DIGIT | CHAR_KEYWORD, 1 },
+        ['A']  = { CHAR_HEX_DIGIT },
+        ['B']  = { CHAR_HEX_DIGIT },
+        ['C']  = { CHAR_HEX_DIGIT },
+        ['D']  = { CHAR_HEX_DIGIT },
+        ['E']  = { CHAR_HEX_DIGIT },
+        ['F']  = { CHAR_HEX_DIGIT },
+
+        ['t']  = { CHAR_KEYWORD, 0 },
+        ['n']  = { CHAR_KEYWORD, 2 },
 };
 
-/* Returns EOF token if EOF was reached, otherwise generic error token. */
+/* Get the class of a character. */
+
+#define CHAR_CLASS(c) \
+        (&char_classes[(unsigned int) (c) < 256 ? (c) : 0])
 
-static JSONToken error_result(JSONInputReader *reader)
+/* Returns the token for an error that occurred between tokens: EOF
+ * token if EOF was reached, otherwise error token. */
+
+static JSONToken error_result(JSONInputReader *reader, int err)
 {
-        if (json_input_is_eof(reader)) {
+        if (err == JSON_ERROR_NEED_MORE) {
+                return JSON_TOKEN_NEED_MORE;
+        } else if (json_input_is_eof(reader)) {
                 return JSON_TOKEN_EOF;
         } else {
                 return JSON_TOKEN_ERROR;
         }
 }
 
+/* Returns the token for an error that occurred inside a token.  The
+ * end of file is always an error here. */
+
+static JSONToken error_token(int err)
+{
+        if (err == JSON_ERROR_NEED_MORE) {
+                return JSON_TOKEN_NEED_MORE;
+        } else {
+                return JSON_TOKEN_ERROR;
+        }
+}
+
+/* Returns the token for an error that occurred while adding to a
+ * string.  Errors from the string buffer (the length limit being 
+ * exceeded, or running out of memory) are saved in the token data, so
+ * that they can be reported instead of a parse error. */
+
+static JSONToken string_error(JSONTokenData *token_data, int err)
+{
+        if (err == JSON_ERROR_TOO_LONG || err == JSON_ERROR_OUT_OF_MEMORY) {
+                token_data->error = err;
+        }
+
+        return error_token(err);
+}
+
 /* Parse a hexadecimal character to a 0-15 value.  Returns negative
  * error code if this is not a hexadecimal character */
 
 static int hex_to_i(int c)
 {
-        c = tolower(c);
+        if (!(CHAR_CLASS(c)->flags & CHAR_HEX_DIGIT)) {
+                return JSON_ERROR_PARSE;
+        }
 
-        if (c >= '0' && c <= '9') {
+        /* For letters of either case, the low four bits are the value
+         * minus nine. */
+
+        if (c <= '9') {
                 return c - '0';
-        } else if (c >= 'a' && c <= 'f') {
-                return 10 + c - 'a';
         } else {
-                return JSON_ERROR_PARSE;
+                return (c & 0x0f) + 9;
         }
 }
 
 /* Read a unicode escape sequence from a string, saving the escaped
- * character into the provided buffer.  This assumes that the preceding
- * '\u' has already been read.  Returns zero for success,
+ * character into the buffer.  This assumes that the preceding '\u' 
+ * has already been read; the digits read so far are stored in the
+ * token data, in case more input is needed.  Returns zero for success,
  * or negative error code. */
 
 static int read_unicode_escape(JSONInputReader *reader,
-                               JSONStringBuffer *buffer)
+                               JSONTokenData *token_data)
 {
-        int i, j;
-        int value;
+        int j;
         int c;
 
         /* Read four character hex sequence */
 
-        value = 0;
-
-        for (i=0; i<4; ++i) {
-                c = json_input_read_char(reader);
+        while (token_data->escape_digits < 4) {
+                c = JSON_INPUT_READ_CHAR(reader);
 
                 if (c < 0) {
                         return c;
@@ -123,298 +371,1769 @@ static int read_unicode_escape(JSONInputReader *reader,
 
                 /* Add to sequence */
 
-                value = (value << 4) | j;
+                token_data->escape_value = (token_data->escape_value << 4) | j;
+                ++token_data->escape_digits;
         }
 
         /* Add to string buffer */
 
-        return json_string_buffer_put_char(buffer, value);
+        token_data->state = LEXER_STATE_STRING;
+
+        return json_string_buffer_put_char(&token_data->buffer,
+                                           token_data->escape_value);
 }
 
-/* Read an escape character/sequence, saving the escaped character
- * into the provided buffer.  This assumes that the preceding
- * '\' has already been read.  Returns zero for success, or negative
- * error code. */
+/* Get the character represented by a single character escape 
+ * sequence (\n, \t, etc).  c is the character following the '\'.  
+ * Returns negative error code if this is not a valid escape sequence;
+ * \u sequences must be handled separately. */
 
-static int read_escape_char(JSONInputReader *reader, JSONStringBuffer *buffer)
+static int escape_char_value(int c)
 {
-        int c;
-
-        /* Find what type of escape sequence */
-
-        c = json_input_read_char(reader);
-
-        if (c < 0) {
-                return c;
-        }
-
         switch (c) {
                 case '\"':                 /* Quotes */
-                        return json_string_buffer_put_char(buffer, '\"');
+                        return '\"';
                 case '\\':                 /* Backslash */
-                        return json_string_buffer_put_char(buffer, '\\');
+                        return '\\';
                 case '/':                  /* Slash */
-                        return json_string_buffer_put_char(buffer, '/');
+                        return '/';
                 case 'b':                  /* Backspace */
-                        return json_string_buffer_put_char(buffer, '\b');
+                        return '\b';
                 case 'f':                  /* Form feed */
-                        return json_string_buffer_put_char(buffer, '\f');
+                        return '\f';
                 case 'n':                  /* New line */
-                        return json_string_buffer_put_char(buffer, '\n');
+                        return '\n';
                 case 'r':                  /* Carriage return */
-                        return json_string_buffer_put_char(buffer, '\r');
+                        return '\r';
                 case 't':                  /* Tab */
-                        return json_string_buffer_put_char(buffer, '\t');
-                case 'u':
-                        return read_unicode_escape(reader, buffer);
+                        return '\t';
                 default:
                         /* Invalid escape sequence */
 
                         return JSON_ERROR_PARSE;
         }
-
-        return JSON_ERROR_SUCCESS;
 }
 
-/* Read a string, saving the string contents into the provided
- * buffer.  Returns JSON_TOKEN_STRING if successful, or an
- * error token.  Assumes the opening " has already been read. */
+/* Read an escape character/sequence, saving the escaped character
+ * into the buffer.  This assumes that the preceding '\' has already 
+ * been read.  Returns zero for success, or negative error code. */
 
-static JSONToken read_string(JSONInputReader *reader,
-                             JSONStringBuffer *buffer)
+static int read_escape_char(JSONInputReader *reader,
+                            JSONTokenData *token_data)
 {
+        JSONStringBuffer *buffer;
         int c;
-        int err;
-
-        for (;;) {
 
-                /* Read the next character.  If we reach the end of file,
-                 * this is always an error. */
+        /* Continue reading a \u sequence? */
 
-                c = json_input_read_char(reader);
+        if (token_data->state == LEXER_STATE_UNICODE_ESCAPE) {
+                return read_unicode_escape(reader, token_data);
+        }
 
-                if (c < 0) {
-                        return JSON_TOKEN_ERROR;
-                }
+        /* Find what type of escape sequence */
 
-                /* If we get a \, this is an escape character.  A "
-                 * marks the end of string.  Otherwise, this is just a
-                 * normal character. */
+        c = JSON_INPUT_READ_CHAR(reader);
 
-                if (c == '\\') {
-                        err = read_escape_char(reader, buffer);
+        if (c < 0) {
+                return c;
+        }
 
-                        if (err < 0) {
-                                return JSON_TOKEN_ERROR;
-                        }
-                } else if (c == '\"') {
-                        break;
-                } else {
-                        err = json_string_buffer_put_char(buffer, c);
+        buffer = &token_data->buffer;
+        token_data->state = LEXER_STATE_STRING;
 
-                        if (err < 0) {
-                                return JSON_TOKEN_ERROR;
-                        }
-                }
+        if (c == 'u') {
+                token_data->state = LEXER_STATE_UNICODE_ESCAPE;
+                token_data->escape_value = 0;
+                token_data->escape_digits = 0;
+                return read_unicode_escape(reader, token_data);
         }
 
-        /* Terminate the string */
+        c = escape_char_value(c);
 
-        json_string_buffer_put_char(buffer, '\0');
+        if (c < 0) {
+                return c;
+        }
 
-        return JSON_TOKEN_STRING;
+        return json_string_buffer_put_char(buffer, c);
 }
 
-/* Read a keyword, returning a token type if successfully matched,
- * or JSON_TOKEN_ERROR for failure.  Assumes the first character 
- * has already been read. */
+/* Find the length of a run of ordinary characters at the start of a
+ * span of UTF-8 input.  The run ends at the first character that needs
+ * special handling (a quote, escape or control character), or at the
+ * end of the span.  Multi-byte sequences in the first trusted_len
+ * bytes have already been validated; others are included only if they
+ * are well-formed.  Sequences that are invalid or that continue into
+ * the next block are left to json_input_read_char. */
 
-static JSONToken read_keyword(JSONInputReader *reader,
-                              const char *keyword,
-                              JSONToken result)
+static size_t utf8_run_length(const unsigned char *span, size_t span_len,
+                              size_t trusted_len)
 {
-        const char *p;
-        int c;
-      
-        /* The first character of the keyword was already 
-         * succesfully read. */
+        size_t i;
+        int seq_length;
 
-        p = keyword + 1;
+        /* In the trusted region, only the special ASCII characters 
+         * stop the run. */
 
-        /* Check each character in turn */
+        if (trusted_len > span_len) {
+                trusted_len = span_len;
+        }
 
-        while (*p != '\0') {
-                
-                c = json_input_read_char(reader);
+        i = json_string_scan_trusted(span, trusted_len);
 
-                if (c < 0 || c != *p) {
-                        return JSON_TOKEN_ERROR;
-                }
-                
-                ++p;
+        if (i < trusted_len) {
+                return i;
         }
 
-        /* Read successfully. */
+        for (;;) {
 
-        return result;
-}
+                /* Skip over plain ASCII characters. */
 
-/**
- * Internal function to read the next token.  The specified
- * buffer is used to store the token contents.
- *
- * @param lexer            The lexer to read from.
- * @param buffer           @ref JSONStringBuffer to store the token contents.
- * @return                 Token, or @ref JSON_TOKEN_ERROR.
- */
+                i += json_string_scan(span + i, span_len - i);
 
-static JSONToken internal_read_token(JSONInputReader *reader,
-                                     JSONStringBuffer *buffer)
-{
-        int c;
+                if (i >= span_len || span[i] < 0x80) {
+                        break;
+                }
 
-        /* Read from the input stream until we reach a non-whitespace
-         * character. */
+                seq_length = json_utf8_check_seq(span + i, span_len - i);
 
-        do {
-                /* Read the character beginning the token */
+                if (seq_length <= 0) {
+                        break;
+                }
 
-                c = json_input_read_char(reader);
+                i += seq_length;
+        }
 
-                if (c < 0) {
-                        return error_result(reader);
-                }
-        } while (isspace(c));
+        return i;
+}
 
-        /* Start with an empty buffer. */
+/* Copy a run of ordinary characters from a UTF-8 input stream into
+ * the provided buffer in a single block, without decoding and 
+ * re-encoding each character.  The run ends at the first character 
+ * that needs special handling, or at the end of the current input
+ * block.  Returns zero for success, or negative error code. */
 
-        json_string_buffer_reset(buffer);
+static int read_utf8_run(JSONInputReader *reader, JSONStringBuffer *buffer)
+{
+        const unsigned char *span;
+        size_t span_len;
+        size_t i;
+        int err;
 
-        /* Try to determine the token type. */
+        err = json_input_get_span(reader, &span, &span_len);
 
-        switch (c) {
-                case '[':
-                        return JSON_TOKEN_BEGIN_ARRAY;
-                case ']':
-                        return JSON_TOKEN_END_ARRAY;
-                case '{':
-                        return JSON_TOKEN_BEGIN_OBJECT;
-                case '}':
-                        return JSON_TOKEN_BEGIN_OBJECT;
-                case '"':
-                        return read_string(reader, buffer);
-                case 't':
-                        return read_keyword(reader, "true", JSON_TOKEN_TRUE);
-                case 'f':
-                        return read_keyword(reader, "false", JSON_TOKEN_FALSE);
-                case 'n':
-                        return read_keyword(reader, "null", JSON_TOKEN_NULL);
-                case ':':
-                        return JSON_TOKEN_COLON;
-                case ',':
-                        return JSON_TOKEN_COMMA;
+        if (err < 0) {
+                return err;
         }
 
-        return JSON_TOKEN_ERROR;
+        i = utf8_run_length(span, span_len,
+                            json_input_get_trusted_len(reader));
+
+        json_input_skip(reader, i);
+
+        return json_string_buffer_put_bytes(buffer, span, i);
 }
 
-JSONLexer *json_lexer_new(JSONInputSource source,
-                          JSONInputReadFunc read_func)
+/* Read a string from input that is read in place, without copying it:
+ * if the whole string is in the current input block and contains no
+ * escape sequences, the token is left pointing at it in the input 
+ * data.  Returns non-zero if the string was read, or zero if it must
+ * be read into the buffer instead, in which case no input is consumed.
+ * Assumes the opening " has already been read. */
+
+static int read_string_view(JSONInputReader *reader,
+                            JSONTokenData *token_data)
 {
-        JSONLexer *lexer;
+        const unsigned char *span;
+        size_t span_len;
+        size_t max_size;
+        size_t i;
 
-        lexer = malloc(sizeof(JSONLexer));
+        if (json_input_get_span(reader, &span, &span_len) < 0) {
+                return 0;
+        }
 
-        if (lexer == NULL) {
-                return NULL;
+        i = utf8_run_length(span, span_len,
+                            json_input_get_trusted_len(reader));
+
+        if (i >= span_len || span[i] != '\"') {
+                return 0;
         }
 
-        json_input_reader_init(&lexer->reader, source, read_func);
-        json_string_buffer_init(&lexer->string_buffers[0]);
-        json_string_buffer_init(&lexer->string_buffers[1]);
+        /* Strings over the length limit are read into the buffer, so
+         * that the error is reported in the usual way. */
 
-        lexer->current_buffer = 0;
-        lexer->read_first = 0;
+        max_size = token_data->buffer.max_size;
 
-        return lexer;
-}
+        if (max_size != 0 && i >= max_size) {
+                return 0;
+        }
 
-void json_lexer_free(JSONLexer *lexer)
-{
-        json_string_buffer_free(&lexer->string_buffers[0]);
-        json_string_buffer_free(&lexer->string_buffers[1]);
-        free(lexer);
+        token_data->view = span;
+        token_data->view_len = i;
+        json_input_skip(reader, i + 1);
+
+        return 1;
 }
 
-/* Check that we have read the first token, and read it if necessary. */
+/* Read an escape sequence from a string that is unescaped in situ.
+ * The whole input is available at once, so the digits of a \u 
+ * sequence need not be saved in the token data.  This assumes that the
+ * preceding '\' has already been read.  Returns the escaped character,
+ * or negative error code. */
 
-static void json_lexer_check_first(JSONLexer *lexer)
+static int read_escape_in_situ(JSONInputReader *reader)
 {
-        /* Have we read the first token yet?  If not, we need to. */
+        int value;
+        int i;
+        int j;
+        int c;
 
-        if (!lexer->read_first) {
-                lexer->next_token
-                        = internal_read_token(&lexer->reader,
-                                              &lexer->string_buffers[0]);
-                lexer->read_first = 1;
+        c = JSON_INPUT_READ_CHAR(reader);
+
+        if (c < 0) {
+                return c;
+        } else if (c != 'u') {
+                return escape_char_value(c);
         }
-}
 
-/* Peek at the next token, but leaving it waiting in the queue to be
- * returned by @ref json_lexer_read_token. */
+        /* Read four character hex sequence */
 
-JSONToken json_lexer_peek_token(JSONLexer *lexer)
-{
-        /* Check we have read the first token */
+        value = 0;
 
-        json_lexer_check_first(lexer);
+        for (i=0; i<4; ++i) {
+                c = JSON_INPUT_READ_CHAR(reader);
 
-        return lexer->next_token;
-}
+                if (c < 0) {
+                        return c;
+                }
 
-/* Read a token. */
+                j = hex_to_i(c);
 
-JSONToken json_lexer_read_token(JSONLexer *lexer)
+                if (j < 0) {
+                        return j;
+                }
+
+                value = (value << 4) | j;
+        }
+
+        return value;
+}
+
+/* Read a string from input that may be modified (see 
+ * json_input_is_in_situ), without using the buffer.  The string is 
+ * unescaped over the input data as it is read: an escape sequence is
+ * never shorter than the character it represents, so the unescaped 
+ * string never overtakes the data still to be read.  The result is
+ * NUL-terminated, and the token is left pointing at it.  Returns
+ * JSON_TOKEN_STRING if successful, or an error token.  Assumes the
+ * opening " has already been read. */
+
+static JSONToken read_string_in_situ(JSONInputReader *reader,
+                                     JSONTokenData *token_data)
 {
-        JSONToken result;
-        JSONStringBuffer *next_buffer;
-        int new_current_buffer;
+        const unsigned char *span;
+        unsigned char *start;
+        size_t span_len;
+        size_t length;
+        size_t seq_length;
+        size_t max_size;
+        size_t run;
+        int err;
+        int c;
 
-        /* Check we have read the first token */
+        start = NULL;
+        length = 0;
 
-        json_lexer_check_first(lexer);
+        for (;;) {
+                err = json_input_get_span(reader, &span, &span_len);
 
-        /* Once we reach an error, stop. */
+                if (err < 0) {
+                        return error_token(err);
+                }
 
-        if (lexer->next_token == JSON_TOKEN_ERROR) {
-                return JSON_TOKEN_ERROR;
-        }
+                if (start == NULL) {
+                        start = (unsigned char *) span;
+                }
 
-        /* The next token is waiting in the next_token field, and is
-         * using the opposite buffer to the current one. */
+                /* Move the next run of ordinary characters down over
+                 * the escape sequences that came before it. */
 
-        result = lexer->next_token;
-        new_current_buffer = 1 - lexer->current_buffer;
+                run = utf8_run_length(span, span_len,
+                                      json_input_get_trusted_len(reader));
 
-        /* Retrieve the next token, overwriting the last token and its
-         * buffer. */
+                if (start + length != span) {
+                        memmove(start + length, span, run);
+                }
 
-        next_buffer = &lexer->string_buffers[lexer->current_buffer];
-        lexer->next_token = internal_read_token(&lexer->reader, next_buffer);
+                length += run;
+                json_input_skip(reader, run);
 
-        /* Update current_buffer and return the token */
+                /* Deal with the character following the run in the 
+                 * same way as read_string. */
 
-        lexer->current_buffer = new_current_buffer;
+                c = JSON_INPUT_READ_CHAR(reader);
 
-        return result;
-}
+                if (c == '\\') {
+                        c = read_escape_in_situ(reader);
+                } else if (c == '\"') {
+                        break;
+                }
 
-const char *json_lexer_get_buffer(JSONLexer *lexer)
-{
-        JSONStringBuffer *current_buffer;
+                if (c < 0) {
+                        return error_token(c);
+                }
+
+                json_utf8_encode(c, start + length, &seq_length);
+                length += seq_length;
+        }
+
+        max_size = token_data->buffer.max_size;
 
-        current_buffer = &lexer->string_buffers[lexer->current_buffer];
+        if (max_size != 0 && length >= max_size) {
+                token_data->error = JSON_ERROR_TOO_LONG;
+                return JSON_TOKEN_ERROR;
+        }
 
-        return json_string_buffer_get(current_buffer);
+        start[length] = '\0';
+        token_data->view = start;
+        token_data->view_len = length;
+
+        return JSON_TOKEN_STRING;
+}
+
+/* Reserve space in the buffer for a string from a UTF-8 input stream.
+ * If the closing quote is already in the current input block, the 
+ * string cannot be any longer than the data before it (escape
+ * sequences only ever shrink), so the whole string can be read 
+ * without the buffer being reallocated.  Quotes preceded by an odd
+ * number of backslashes are escaped, and are passed over. */
+
+static void reserve_utf8_string(JSONInputReader *reader,
+                                JSONStringBuffer *buffer)
+{
+        const unsigned char *span;
+        const unsigned char *start;
+        const unsigned char *end;
+        size_t span_len;
+        size_t backslashes;
+
+        if (json_input_get_span(reader, &span, &span_len) < 0) {
+                return;
+        }
+
+        start = span;
+
+        for (;;) {
+                end = memchr(start, '\"', span_len - (start - span));
+
+                if (end == NULL) {
+                        return;
+                }
+
+                backslashes = 0;
+
+                while (end - backslashes > span
+                    && *(end - backslashes - 1) == '\\') {
+                        ++backslashes;
+                }
+
+                if (backslashes % 2 == 0) {
+                        break;
+                }
+
+                start = end + 1;
+        }
+
+        /* This is only a hint, so errors are ignored here; they are
+         * reported when the data is actually added. */
+
+        json_string_buffer_reserve(buffer, end - span + 1);
+}
+
+/* Read a string, saving the string contents into the token data 
+ * buffer.  Returns JSON_TOKEN_STRING if successful, or an error token.
+ * Assumes the opening " has already been read. */
+
+static JSONToken read_string(JSONInputReader *reader,
+                             JSONTokenData *token_data)
+{
+        JSONStringBuffer *buffer;
+        int c;
+        int err;
+
+        buffer = &token_data->buffer;
+
+        for (;;) {
+
+                /* Inside an escape sequence? */
+
+                if (token_data->state != LEXER_STATE_STRING) {
+                        err = read_escape_char(reader, token_data);
+
+                        if (err < 0) {
+                                return string_error(token_data, err);
+                        }
+                }
+
+                /* For UTF-8 input, copy as much as possible in bulk.
+                 * The character following the run is dealt with 
+                 * below. */
+
+                if (json_input_is_utf8(reader)) {
+                        err = read_utf8_run(reader, buffer);
+
+                        if (err < 0) {
+                                return string_error(token_data, err);
+                        }
+                }
+
+                /* Read the next character.  If we reach the end of file,
+                 * this is always an error. */
+
+                c = JSON_INPUT_READ_CHAR(reader);
+
+                if (c < 0) {
+                        return error_token(c);
+                }
+
+                /* If we get a \, this is an escape character.  A "
+                 * marks the end of string.  Otherwise, this is just a
+                 * normal character. */
+
+                if (c == '\\') {
+                        token_data->state = LEXER_STATE_ESCAPE;
+                } else if (c == '\"') {
+                        break;
+                } else {
+                        err = json_string_buffer_put_char(buffer, c);
+
+                        if (err < 0) {
+                                return string_error(token_data, err);
+                        }
+                }
+        }
+
+        /* Terminate the string */
+
+        err = json_string_buffer_put_char(buffer, '\0');
+
+        if (err < 0) {
+                return string_error(token_data, err);
+        }
+
+        return JSON_TOKEN_STRING;
+}
+
+/* Read a keyword, returning a token type if successfully matched,
+ * or JSON_TOKEN_ERROR for failure.  The part of the keyword still to
+ * be matched is stored in the token data. */
+
+static JSONToken read_keyword(JSONInputReader *reader,
+                              JSONTokenData *token_data)
+{
+        int c;
+      
+        /* Check each character in turn */
+
+        while (*token_data->keyword != '\0') {
+                
+                c = JSON_INPUT_READ_CHAR(reader);
+
+                if (c < 0) {
+                        return error_token(c);
+                } else if (c != *token_data->keyword) {
+                        return JSON_TOKEN_ERROR;
+                }
+                
+                ++token_data->keyword;
+        }
+
+        /* Read successfully. */
+
+        return token_data->keyword_token;
+}
+
+/* Start reading a keyword.  The first character of the keyword has
+ * already been successfully read. */
+
+static JSONToken start_keyword(JSONInputReader *reader,
+                               JSONTokenData *token_data,
+                               const JSONKeyword *keyword)
+{
+        const unsigned char *span;
+        size_t span_len;
+
+        /* Usually the rest of the keyword is in the current block, and
+         * can be matched with a single comparison. */
+
+        if (json_input_get_span(reader, &span, &span_len) == 0
+         && span_len >= keyword->length - 1
+         && !memcmp(span, keyword->text + 1, keyword->length - 1)) {
+                json_input_skip(reader, keyword->length - 1);
+                return keyword->token;
+        }
+
+        token_data->state = LEXER_STATE_KEYWORD;
+        token_data->keyword = keyword->text + 1;
+        token_data->keyword_token = keyword->token;
+
+        return read_keyword(reader, token_data);
+}
+
+/* Read the next character of a number.  The end of file is not an
+ * error here, as it just marks the end of the number.  Returns the 
+ * character, -1 for end of file, or negative error code. */
+
+static int read_number_char(JSONInputReader *reader)
+{
+        int c;
+
+        c = JSON_INPUT_READ_CHAR(reader);
+
+        if (c == JSON_ERROR_END_OF_FILE) {
+                return -1;
+        }
+
+        return c;
+}
+
+/* Read a sequence of digits, adding them to the provided number.
+ * Returns zero for success, or negative error code. */
+
+static int read_digits(JSONInputReader *reader, JSONNumber *number,
+                       int fraction, JSONStringBuffer *buffer)
+{
+        const unsigned char *span;
+        size_t span_len;
+        int err;
+        int c;
+
+        for (;;) {
+
+                /* For UTF-8 input, convert eight digits at a time
+                 * where possible. */
+
+                if (json_input_is_utf8(reader)
+                 && json_input_get_span(reader, &span, &span_len) == 0) {
+                        while (span_len >= 8
+                            && json_number_add_eight_digits(number, span,
+                                                            fraction)) {
+                                json_input_skip(reader, 8);
+                                span += 8;
+                                span_len -= 8;
+                        }
+                }
+
+                c = read_number_char(reader);
+
+                if (c < -1) {
+                        return c;
+                }
+
+                /* Any other character marks the end of the digits. */
+
+                if (c < '0' || c > '9') {
+                        if (c >= 0) {
+                                json_input_unread_char(reader, c);
+                        }
+
+                        return JSON_ERROR_SUCCESS;
+                }
+
+                err = json_number_add_digit(number, c - '0', fraction,
+                                            buffer);
+
+                if (err < 0) {
+                        return err;
+                }
+        }
+}
+
+/* Handle the first digit of the integer part of a number, which 
+ * cannot be a leading zero unless it is the only digit.  Returns zero
+ * for success, or negative error code. */
+
+static int read_first_digit(JSONTokenData *token_data, int c)
+{
+        if (c == '0') {
+                /* Nothing to add */
+
+                token_data->state = LEXER_STATE_NUMBER_POINT;
+
+                return JSON_ERROR_SUCCESS;
+        } else if (c >= '1' && c <= '9') {
+                token_data->state = LEXER_STATE_NUMBER_INT;
+
+                return json_number_add_digit(&token_data->partial_number,
+                                             c - '0', 0,
+                                             &token_data->buffer);
+        } else {
+                return JSON_ERROR_PARSE;
+        }
+}
+
+/* Convert a number that has been completely read to a binary value in
+ * the token data.  Returns the token type. */
+
+static JSONToken finish_number(JSONTokenData *token_data)
+{
+        JSONNumber *number;
+
+        number = &token_data->partial_number;
+
+        /* Integers are returned as signed 64-bit values if they fit, 
+         * or unsigned 64-bit values if they are positive and too large.
+         * Everything else is converted to floating point. */
+
+        if (!token_data->is_float && !number->overflow) {
+                if (!number->negative && number->mantissa <= INT64_MAX) {
+                        token_data->number.intval = (int64_t) number->mantissa;
+                        return JSON_TOKEN_INTEGER;
+                } else if (!number->negative) {
+                        token_data->number.uintval = number->mantissa;
+                        return JSON_TOKEN_UNSIGNED_INTEGER;
+                } else if (number->mantissa <= (uint64_t) INT64_MAX + 1) {
+                        token_data->number.intval
+                                = (int64_t) (0 - number->mantissa);
+                        return JSON_TOKEN_INTEGER;
+                }
+        }
+
+        token_data->number.floatval
+                = json_number_to_double(number, &token_data->buffer);
+
+        return JSON_TOKEN_FLOAT;
+}
+
+/* Read a number, converting it to a binary value in the provided token
+ * data.  Returns JSON_TOKEN_INTEGER, JSON_TOKEN_UNSIGNED_INTEGER or
+ * JSON_TOKEN_FLOAT if successful, or an error token.  The number is
+ * read as a sequence of states, starting from the state set when the 
+ * first character was read, so that reading can be resumed if more
+ * input is needed. */
+
+static JSONToken read_number(JSONInputReader *reader,
+                             JSONTokenData *token_data)
+{
+        JSONNumber *number;
+        int err;
+        int c;
+
+        number = &token_data->partial_number;
+
+        for (;;) {
+                switch (token_data->state) {
+
+                /* After a leading '-': there must be a digit. */
+
+                case LEXER_STATE_NUMBER_SIGN:
+                        c = JSON_INPUT_READ_CHAR(reader);
+
+                        if (c < 0) {
+                                return error_token(c);
+                        }
+
+                        err = read_first_digit(token_data, c);
+
+                        if (err < 0) {
+                                return JSON_TOKEN_ERROR;
+                        }
+                        break;
+
+                /* Integer part. */
+
+                case LEXER_STATE_NUMBER_INT:
+                        err = read_digits(reader, number, 0,
+                                          &token_data->buffer);
+
+                        if (err < 0) {
+                                return error_token(err);
+                        }
+
+                        token_data->state = LEXER_STATE_NUMBER_POINT;
+                        break;
+
+                /* After the integer part, there may be a fractional
+                 * part or an exponent. */
+
+                case LEXER_STATE_NUMBER_POINT:
+                        c = read_number_char(reader);
+
+                        if (c == '.') {
+                                token_data->is_float = 1;
+                                token_data->state
+                                        = LEXER_STATE_NUMBER_FRAC_FIRST;
+                                break;
+                        }
+
+                        /* Fall through */
+
+                /* After the fractional part, there may be an 
+                 * exponent.  c is the character following the number
+                 * so far. */
+
+                case LEXER_STATE_NUMBER_EXP_MARK:
+                        if (token_data->state == LEXER_STATE_NUMBER_EXP_MARK) {
+                                c = read_number_char(reader);
+                        }
+
+                        if (c == 'e' || c == 'E') {
+                                token_data->is_float = 1;
+                                token_data->exponent = 0;
+                                token_data->exponent_negative = 0;
+                                token_data->state 
+                                        = LEXER_STATE_NUMBER_EXP_SIGN;
+                                break;
+                        } else if (c < -1) {
+                                return error_token(c);
+                        } else if (c >= 0) {
+                                json_input_unread_char(reader, c);
+                        }
+
+                        return finish_number(token_data);
+
+                /* Fractional part.  There must be at least one 
+                 * digit. */
+
+                case LEXER_STATE_NUMBER_FRAC_FIRST:
+                        c = JSON_INPUT_READ_CHAR(reader);
+
+                        if (c < 0) {
+                                return error_token(c);
+                        } else if (c < '0' || c > '9') {
+                                return JSON_TOKEN_ERROR;
+                        }
+
+                        err = json_number_add_digit(number, c - '0', 1,
+                                                    &token_data->buffer);
+
+                        if (err < 0) {
+                                return JSON_TOKEN_ERROR;
+                        }
+
+                        token_data->state = LEXER_STATE_NUMBER_FRAC;
+                        break;
+
+                case LEXER_STATE_NUMBER_FRAC:
+                        err = read_digits(reader, number, 1,
+                                          &token_data->buffer);
+
+                        if (err < 0) {
+                                return error_token(err);
+                        }
+
+                        token_data->state = LEXER_STATE_NUMBER_EXP_MARK;
+                        break;
+
+                /* After the 'e' of an exponent: optional sign. */
+
+                case LEXER_STATE_NUMBER_EXP_SIGN:
+                        c = JSON_INPUT_READ_CHAR(reader);
+
+                        if (c < 0) {
+                                return error_token(c);
+                        } else if (c == '-' || c == '+') {
+                                token_data->exponent_negative = c == '-';
+                        } else {
+                                json_input_unread_char(reader, c);
+                        }
+
+                        token_data->state = LEXER_STATE_NUMBER_EXP_FIRST;
+                        break;
+
+                /* There must be at least one digit in the exponent. */
+
+                case LEXER_STATE_NUMBER_EXP_FIRST:
+                        c = JSON_INPUT_READ_CHAR(reader);
+
+                        if (c < 0) {
+                                return error_token(c);
+                        } else if (c < '0' || c > '9') {
+                                return JSON_TOKEN_ERROR;
+                        }
+
+                        token_data->exponent = c - '0';
+                        token_data->state = LEXER_STATE_NUMBER_EXP;
+                        break;
+
+                case LEXER_STATE_NUMBER_EXP:
+                        c = read_number_char(reader);
+
+                        while (c >= '0' && c <= '9') {
+
+                                /* Values beyond this always overflow or
+                                 * underflow, so stop accumulating. */
+
+                                if (token_data->exponent < 100000) {
+                                        token_data->exponent
+                                            = token_data->exponent * 10
+                                            + c - '0';
+                                }
+
+                                c = read_number_char(reader);
+                        }
+
+                        if (c < -1) {
+                                return error_token(c);
+                        } else if (c >= 0) {
+                                json_input_unread_char(reader, c);
+                        }
+
+                        if (token_data->exponent_negative) {
+                                number->exponent -= token_data->exponent;
+                        } else {
+                                number->exponent += token_data->exponent;
+                        }
+
+                        return finish_number(token_data);
+
+                default:
+                        return JSON_TOKEN_ERROR;
+                }
+        }
+}
+
+/* Start reading a number.  c is the first character of the number,
+ * which has already been read. */
+
+static JSONToken start_number(JSONInputReader *reader,
+                              JSONTokenData *token_data, int c)
+{
+        json_number_init(&token_data->partial_number);
+        token_data->is_float = 0;
+
+        if (c == '-') {
+                token_data->partial_number.negative = 1;
+                token_data->state = LEXER_STATE_NUMBER_SIGN;
+        } else if (read_first_digit(token_data, c) < 0) {
+                return JSON_TOKEN_ERROR;
+        }
+
+        return read_number(reader, token_data);
+}
+
+/* Continue reading a token that was interrupted because more input
+ * was needed. */
+
+static JSONToken continue_token(JSONInputReader *reader,
+                                JSONTokenData *token_data)
+{
+        switch (token_data->state) {
+                case LEXER_STATE_STRING:
+                case LEXER_STATE_ESCAPE:
+                case LEXER_STATE_UNICODE_ESCAPE:
+                        return read_string(reader, token_data);
+
+                case LEXER_STATE_KEYWORD:
+                        return read_keyword(reader, token_data);
+
+                default:
+                        return read_number(reader, token_data);
+        }
+}
+
+/* Read a new token, starting from the first character. */
+
+static JSONToken read_new_token(JSONInputReader *reader,
+                                JSONTokenData *token_data)
+{
+        const JSONCharClass *char_class;
+        int c;
+
+        /* Read from the input stream until we reach a non-whitespace
+         * character. */
+
+        do {
+                /* Read the character beginning the token */
+
+                c = JSON_INPUT_READ_CHAR(reader);
+
+                if (c < 0) {
+                        return error_result(reader, c);
+                }
+
+                char_class = CHAR_CLASS(c);
+        } while (char_class->flags & CHAR_WHITESPACE);
+
+        /* Start with an empty buffer. */
+
+        json_string_buffer_reset(&token_data->buffer);
+        token_data->view = NULL;
+
+        /* Determine the token type from the class of the character. */
+
+        if (char_class->flags & CHAR_PUNCTUATION) {
+                return char_class->value;
+        } else if (char_class->flags & CHAR_STRING) {
+                if (json_input_is_utf8(reader)) {
+                        if (json_input_is_in_situ(reader)) {
+                                return read_string_in_situ(reader,
+                                                           token_data);
+                        } else if (json_input_is_in_place(reader)
+                                && read_string_view(reader, token_data)) {
+                                return JSON_TOKEN_STRING;
+                        }
+
+                        reserve_utf8_string(reader, &token_data->buffer);
+                }
+
+                token_data->state = LEXER_STATE_STRING;
+                return read_string(reader, token_data);
+        } else if (char_class->flags & CHAR_NUMBER) {
+                return start_number(reader, token_data, c);
+        } else if (char_class->flags & CHAR_KEYWORD) {
+                return start_keyword(reader, token_data,
+                                     &keywords[char_class->value]);
+        }
+
+        return JSON_TOKEN_ERROR;
+}
+
+/* Get the number of bytes from the current position that the 
+ * structural index can be used to read.  The index is only built when
+ * the whole document is held in memory in one block, so the data can
+ * be read directly, as with JSON_INPUT_READ_CHAR, provided that it has
+ * been validated as UTF-8 and no character has been pushed back.  
+ * The reader is only called to validate the next chunk of data. */
+
+static size_t indexed_data_len(JSONInputReader *reader)
+{
+        if (reader->pending_char >= 0) {
+                return 0;
+        } else if (reader->input_buffer_pos < reader->trusted_len) {
+                return reader->trusted_len - reader->input_buffer_pos;
+        } else {
+                return json_input_get_trusted_len(reader);
+        }
+}
+
+/* Use the structural index to skip the whitespace before the next 
+ * token.  The next position in the index is the start of the next 
+ * token, unless the last token was a number or keyword that was 
+ * followed directly by other characters (eg. "truex"), which do not
+ * start a token of their own and so are not in the index.  This is the
+ * case if the character after the last token is not whitespace; the 
+ * characters are then read as normal, so that the error is reported
+ * in the same way as without an index.  Any other character that is
+ * not whitespace would follow whitespace, and so be in the index. */
+
+static void skip_to_next_structural(JSONLexer *lexer)
+{
+        JSONInputReader *reader;
+        const unsigned char *span;
+        const size_t *positions;
+        size_t offset;
+        size_t next;
+
+        reader = &lexer->reader;
+
+        /* The character after a number is pushed back. */
+
+        if (reader->pending_char >= 0) {
+                if (!(CHAR_CLASS(reader->pending_char)->flags
+                      & CHAR_WHITESPACE)) {
+                        return;
+                }
+
+                json_input_read_char(reader);
+        }
+
+        span = reader->input_data + reader->input_buffer_pos;
+
+        if (indexed_data_len(reader) == 0
+         || !(CHAR_CLASS(span[0])->flags & CHAR_WHITESPACE)) {
+                return;
+        }
+
+        /* Find the next position at or after the current one. */
+
+        offset = span - lexer->index_data;
+        positions = lexer->index.positions;
+
+        while (lexer->index_pos < lexer->index.num_positions
+            && positions[lexer->index_pos] < offset) {
+                ++lexer->index_pos;
+        }
+
+        if (lexer->index_pos < lexer->index.num_positions) {
+                next = positions[lexer->index_pos];
+        } else {
+                next = lexer->index_len;
+        }
+
+        reader->input_buffer_pos += next - offset;
+}
+
+/* Add the digits at the start of some text to a number, stopping at
+ * the first character that is not a digit.  The number of digits 
+ * added is stored in count.  Returns zero for success, or negative 
+ * error code. */
+
+static int add_digits(JSONNumber *number, const unsigned char *text,
+                      size_t len, int fraction, JSONStringBuffer *buffer,
+                      size_t *count)
+{
+        size_t i;
+        int err;
+
+        i = 0;
+
+        while (i + 8 <= len
+            && json_number_add_eight_digits(number, text + i, fraction)) {
+                i += 8;
+        }
+
+        while (i < len && text[i] >= '0' && text[i] <= '9') {
+                err = json_number_add_digit(number, text[i] - '0',
+                                            fraction, buffer);
+
+                if (err < 0) {
+                        return err;
+                }
+
+                ++i;
+        }
+
+        *count = i;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Read a number whose extent is known from the structural index.
+ * Returns non-zero if the text is exactly one valid number, which is
+ * left in the token data to be converted.  Anything else, including
+ * an error, is left to read_number, which reports it in the usual
+ * way. */
+
+static int read_bounded_number(JSONTokenData *token_data,
+                               const unsigned char *text, size_t len)
+{
+        JSONNumber *number;
+        JSONStringBuffer *buffer;
+        size_t i, n;
+
+        number = &token_data->partial_number;
+        buffer = &token_data->buffer;
+        json_number_init(number);
+        token_data->is_float = 0;
+        i = 0;
+
+        if (text[i] == '-') {
+                number->negative = 1;
+                ++i;
+        }
+
+        /* Integer part: a single zero, or digits not starting with 
+         * zero. */
+
+        if (i < len && text[i] == '0') {
+                ++i;
+        } else {
+                if (add_digits(number, text + i, len - i, 0, buffer,
+                               &n) < 0 || n == 0) {
+                        return 0;
+                }
+
+                i += n;
+        }
+
+        if (i < len && text[i] == '.') {
+                token_data->is_float = 1;
+                if (add_digits(number, text + i + 1, len - i - 1, 1,
+                               buffer, &n) < 0 || n == 0) {
+                        return 0;
+                }
+
+                i += n + 1;
+        }
+
+        if (i < len && (text[i] == 'e' || text[i] == 'E')) {
+                token_data->is_float = 1;
+                token_data->exponent = 0;
+                token_data->exponent_negative = 0;
+                ++i;
+
+                if (i < len && (text[i] == '-' || text[i] == '+')) {
+                        token_data->exponent_negative = text[i] == '-';
+                        ++i;
+                }
+
+                if (i >= len || text[i] < '0' || text[i] > '9') {
+                        return 0;
+                }
+
+                while (i < len && text[i] >= '0' && text[i] <= '9') {
+                        if (token_data->exponent < 100000) {
+                                token_data->exponent
+                                    = token_data->exponent * 10
+                                    + text[i] - '0';
+                        }
+
+                        ++i;
+                }
+
+                if (token_data->exponent_negative) {
+                        number->exponent -= token_data->exponent;
+                } else {
+                        number->exponent += token_data->exponent;
+                }
+        }
+
+        return i == len;
+}
+
+/* Read a string whose closing quote is known from the structural 
+ * index, from data_len bytes of validated data that include the 
+ * quote.  If it contains no escape sequences or control characters,
+ * it is read in one go and non-zero is returned; otherwise it is left
+ * to be read in the usual way. */
+
+static int read_bounded_string(JSONInputReader *reader,
+                               JSONTokenData *token_data,
+                               const unsigned char *span, size_t len,
+                               size_t data_len)
+{
+        unsigned char *start;
+        size_t max_size;
+
+        /* The scan covers all of the validated data rather than 
+         * stopping at the closing quote: most strings are short, and a
+         * scan of their exact length would fall back from the SIMD 
+         * loop to the code that handles the tail. */
+
+        max_size = token_data->buffer.max_size;
+
+        if ((max_size != 0 && len >= max_size)
+         || json_string_scan_trusted(span + 1, data_len - 1) != len) {
+                return 0;
+        }
+
+        /* The document is read in place, since it is in memory. */
+
+        start = (unsigned char *) span + 1;
+
+        if (json_input_is_in_situ(reader)) {
+                start[len] = '\0';
+        }
+
+        token_data->view = start;
+        token_data->view_len = len;
+        reader->input_buffer_pos += len + 2;
+
+        return 1;
+}
+
+/* Read the next token using the structural index, which gives where
+ * the token ends as well as where it starts: the next position in the
+ * index is the closing quote of a string, or the token after a number
+ * or keyword.  Returns non-zero if the token was read, or zero if it 
+ * must be read in the usual way, in which case no input is consumed. */
+
+static int read_indexed_token(JSONLexer *lexer, JSONTokenData *token_data,
+                              JSONToken *result)
+{
+        JSONInputReader *reader;
+        const JSONCharClass *char_class;
+        const JSONKeyword *keyword;
+        const unsigned char *span;
+        const size_t *positions;
+        size_t data_len;
+        size_t offset, end, len;
+        size_t i;
+
+        reader = &lexer->reader;
+        data_len = indexed_data_len(reader);
+
+        if (data_len == 0) {
+                return 0;
+        }
+
+        span = reader->input_data + reader->input_buffer_pos;
+
+        /* The token must start at the next position in the index. */
+
+        offset = span - lexer->index_data;
+        positions = lexer->index.positions;
+        i = lexer->index_pos;
+
+        while (i < lexer->index.num_positions && positions[i] < offset) {
+                ++i;
+        }
+
+        lexer->index_pos = i;
+
+        if (i >= lexer->index.num_positions || positions[i] != offset) {
+                return 0;
+        }
+
+        if (i + 1 < lexer->index.num_positions) {
+                end = positions[i + 1];
+        } else {
+                end = lexer->index_len;
+        }
+
+        len = end - offset;
+
+        if (len > data_len) {
+                return 0;
+        }
+
+        json_string_buffer_reset(&token_data->buffer);
+        token_data->view = NULL;
+        char_class = CHAR_CLASS(span[0]);
+
+        if (char_class->flags & CHAR_PUNCTUATION) {
+                ++reader->input_buffer_pos;
+                lexer->index_pos = i + 1;
+                *result = char_class->value;
+                return 1;
+        } else if (char_class->flags & CHAR_STRING) {
+
+                /* Unterminated strings have no closing quote. */
+
+                if (len >= data_len || span[len] != '\"'
+                 || !read_bounded_string(reader, token_data, span,
+                                         len - 1, data_len)) {
+                        return 0;
+                }
+
+                lexer->index_pos = i + 2;
+                *result = JSON_TOKEN_STRING;
+                return 1;
+        } else if (char_class->flags & CHAR_KEYWORD) {
+                keyword = &keywords[char_class->value];
+
+                if (len < keyword->length
+                 || memcmp(span, keyword->text, keyword->length) != 0) {
+                        return 0;
+                }
+
+                reader->input_buffer_pos += keyword->length;
+                lexer->index_pos = i + 1;
+                *result = keyword->token;
+                return 1;
+        } else if (char_class->flags & CHAR_NUMBER) {
+
+                /* The number is followed by whitespace, if anything,
+                 * before the next token. */
+
+                while (len > 0
+                    && (CHAR_CLASS(span[len - 1])->flags & CHAR_WHITESPACE)) {
+                        --len;
+                }
+
+                if (!read_bounded_number(token_data, span, len)) {
+                        return 0;
+                }
+
+                reader->input_buffer_pos += len;
+                lexer->index_pos = i + 1;
+                *result = finish_number(token_data);
+                return 1;
+        }
+
+        return 0;
+}
+
+/**
+ * Internal function to read the next token.  The specified
+ * token data structure is used to store the token contents.  If
+ * the last token read into it was interrupted because more input 
+ * was needed, reading continues from where it stopped.
+ *
+ * @param lexer            The lexer to read from.
+ * @param token_data       @ref JSONTokenData to store the token contents.
+ * @return                 Token, @ref JSON_TOKEN_NEED_MORE, or 
+ *                         @ref JSON_TOKEN_ERROR.
+ */
+
+static JSONToken internal_read_token(JSONLexer *lexer,
+                                     JSONTokenData *token_data)
+{
+        JSONToken result;
+
+        if (token_data->state == LEXER_STATE_START) {
+                token_data->error = JSON_ERROR_PARSE;
+
+                if (lexer->index_data != NULL) {
+                        skip_to_next_structural(lexer);
+                }
+
+                if (lexer->index_data == NULL
+                 || !read_indexed_token(lexer, token_data, &result)) {
+                        result = read_new_token(&lexer->reader, token_data);
+                }
+        } else {
+                result = continue_token(&lexer->reader, token_data);
+        }
+
+        if (result != JSON_TOKEN_NEED_MORE) {
+                token_data->state = LEXER_STATE_START;
+        }
+
+        if (result == JSON_TOKEN_ERROR) {
+                lexer->error = token_data->error;
+        }
+
+        return result;
+}
+
+JSONLexer *json_lexer_new(const JSONAllocator *allocator)
+{
+        JSONLexer *lexer;
+
+        if (allocator == NULL) {
+                allocator = &json_default_allocator;
+        }
+
+        lexer = json_allocator_alloc(allocator, sizeof(JSONLexer));
+
+        if (lexer == NULL) {
+                return NULL;
+        }
+
+        lexer->allocator = *allocator;
+
+        json_input_reader_init(&lexer->reader, NULL, NULL);
+        json_string_buffer_init(&lexer->token_data[0].buffer,
+                                &lexer->allocator);
+        json_string_buffer_init(&lexer->token_data[1].buffer,
+                                &lexer->allocator);
+        lexer->token_data[0].state = LEXER_STATE_START;
+        lexer->token_data[1].state = LEXER_STATE_START;
+        lexer->token_data[0].view = NULL;
+        lexer->token_data[1].view = NULL;
+
+        lexer->current_buffer = 0;
+        lexer->read_first = 0;
+        lexer->error = JSON_ERROR_PARSE;
+
+        lexer->index_threads = 0;
+        json_structural_index_init(&lexer->index, &lexer->allocator);
+        lexer->index_data = NULL;
+
+        lexer->skip_levels = 0;
+        lexer->skip_requested = 0;
+
+        return lexer;
+}
+
+void json_lexer_set_max_string_length(JSONLexer *lexer, size_t max_length)
+{
+        size_t max_size;
+        int i;
+
+        /* Allow space for the terminating NUL. */
+
+        if (max_length == 0) {
+                max_size = 0;
+        } else {
+                max_size = max_length + 1;
+        }
+
+        for (i=0; i<2; ++i) {
+                json_string_buffer_set_max_size(&lexer->token_data[i].buffer,
+                                                max_size);
+        }
+}
+
+int json_lexer_set_structural_index(JSONLexer *lexer,
+                                    unsigned int num_threads)
+{
+        if (lexer->read_first) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        lexer->index_threads = num_threads;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+int json_lexer_has_started(JSONLexer *lexer)
+{
+        return lexer->read_first;
+}
+
+int json_lexer_get_error(JSONLexer *lexer)
+{
+        return lexer->error;
+}
+
+JSONInputReader *json_lexer_get_reader(JSONLexer *lexer)
+{
+        return &lexer->reader;
+}
+
+void json_lexer_free(JSONLexer *lexer)
+{
+        JSONAllocator allocator;
+
+        json_input_reader_free(&lexer->reader);
+        json_string_buffer_free(&lexer->token_data[0].buffer);
+        json_string_buffer_free(&lexer->token_data[1].buffer);
+        json_structural_index_free(&lexer->index);
+
+        /* The allocator is stored inside the lexer, so take a copy
+         * before freeing it. */
+
+        allocator = lexer->allocator;
+        json_allocator_free(&allocator, lexer);
+}
+
+/* Build the structural index of the input, if it is enabled and the
+ * input is held in memory.  If the index cannot be built, the input is
+ * read without it. */
+
+static void json_lexer_build_index(JSONLexer *lexer)
+{
+        const unsigned char *data;
+        size_t data_len;
+
+        if (json_input_get_document(&lexer->reader, &data, &data_len) < 0) {
+                return;
+        }
+
+        if (json_structural_index_build_parallel(&lexer->index, data, data_len,
+                                                 lexer->index_threads) < 0) {
+                return;
+        }
+
+        lexer->index_data = data;
+        lexer->index_len = data_len;
+        lexer->index_pos = 0;
+}
+
+/* Check that we have read the next token, and read it if necessary:
+ * either this is the first token, or reading the next token was
+ * interrupted because more input was needed. */
+
+static void json_lexer_check_next(JSONLexer *lexer)
+{
+        JSONTokenData *next_data;
+
+        if (!lexer->read_first && lexer->index_threads > 0) {
+                json_lexer_build_index(lexer);
+        }
+
+        if (!lexer->read_first || lexer->next_token == JSON_TOKEN_NEED_MORE) {
+                next_data = &lexer->token_data[1 - lexer->current_buffer];
+                lexer->next_token = internal_read_token(lexer, next_data);
+                lexer->read_first = 1;
+        }
+}
+
+/* Peek at the next token, but leaving it waiting in the queue to be
+ * returned by @ref json_lexer_read_token. */
+
+JSONToken json_lexer_peek_token(JSONLexer *lexer)
+{
+        /* Check we have read the next token */
+
+        json_lexer_check_next(lexer);
+
+        return lexer->next_token;
+}
+
+/* Read a token. */
+
+JSONToken json_lexer_read_token(JSONLexer *lexer)
+{
+        JSONToken result;
+        JSONTokenData *next_data;
+        int new_current_buffer;
+
+        /* Check we have read the next token */
+
+        json_lexer_check_next(lexer);
+
+        /* Once we reach an error, stop.  If more input is needed, the
+         * next token will be read again after it has been fed. */
+
+        if (lexer->next_token == JSON_TOKEN_ERROR
+         || lexer->next_token == JSON_TOKEN_NEED_MORE) {
+                return lexer->next_token;
+        }
+
+        /* The next token is waiting in the next_token field, and is
+         * using the opposite buffer to the current one. */
+
+        result = lexer->next_token;
+        new_current_buffer = 1 - lexer->current_buffer;
+
+        /* Retrieve the next token, overwriting the last token and its
+         * buffer. */
+
+        next_data = &lexer->token_data[lexer->current_buffer];
+        lexer->next_token = internal_read_token(lexer, next_data);
+
+        /* Update current_buffer and return the token */
+
+        lexer->current_buffer = new_current_buffer;
+
+        return result;
+}
+
+/* Deal with a character outside of a string while skipping.  Returns
+ * non-zero if it closes the last array or object being skipped. */
+
+static int skip_char(JSONLexer *lexer, int c)
+{
+        switch (c) {
+                case '\"':
+                        lexer->skip_in_string = 1;
+                        break;
+                case '[':
+                case '{':
+                        ++lexer->skip_levels;
+                        break;
+                case ']':
+                case '}':
+                        --lexer->skip_levels;
+                        return lexer->skip_levels == 0;
+                default:
+                        break;
+        }
+
+        return 0;
+}
+
+/* Skip over a span of input data.  Inside strings, the string scanner
+ * is used to jump to the next quote or backslash.  Returns the number
+ * of bytes consumed: either the whole span, or up to and including the
+ * character that closes the last array or object being skipped, which
+ * is stored in *closed. */
+
+static size_t skip_span(JSONLexer *lexer, const unsigned char *span,
+                        size_t span_len, int *closed)
+{
+        size_t i;
+        int c;
+
+        i = 0;
+
+        while (i < span_len) {
+                if (!lexer->skip_in_string) {
+                        c = span[i];
+                        ++i;
+
+                        if (skip_char(lexer, c)) {
+                                *closed = c;
+                                break;
+                        }
+                } else if (lexer->skip_escaped) {
+                        lexer->skip_escaped = 0;
+                        ++i;
+                } else {
+                        i += json_string_scan(span + i, span_len - i);
+
+                        if (i >= span_len) {
+                                break;
+                        }
+
+                        if (span[i] == '\\') {
+                                lexer->skip_escaped = 1;
+                        } else if (span[i] == '\"') {
+                                lexer->skip_in_string = 0;
+                        }
+
+                        ++i;
+                }
+        }
+
+        return i;
+}
+
+JSONToken json_lexer_skip(JSONLexer *lexer, unsigned int levels)
+{
+        JSONInputReader *reader;
+        JSONTokenData *next_data;
+        const unsigned char *span;
+        size_t span_len;
+        int closed;
+        int err;
+        int c;
+
+        reader = &lexer->reader;
+        next_data = &lexer->token_data[1 - lexer->current_buffer];
+
+        /* When an interrupted skip is continued, it may be asked to 
+         * skip further out than before. */
+
+        if (lexer->skip_levels > 0 && levels > lexer->skip_requested) {
+                lexer->skip_levels += levels - lexer->skip_requested;
+                lexer->skip_requested = levels;
+        }
+
+        /* Unless an interrupted skip is being continued, start with
+         * the token that was read ahead.  It is discarded, unless it
+         * is the end being skipped to. */
+
+        if (lexer->skip_levels == 0) {
+                lexer->skip_requested = levels;
+                json_lexer_check_next(lexer);
+                lexer->skip_in_string = 0;
+                lexer->skip_escaped = 0;
+
+                switch (lexer->next_token) {
+                        case JSON_TOKEN_BEGIN_ARRAY:
+                        case JSON_TOKEN_BEGIN_OBJECT:
+                                ++levels;
+                                break;
+
+                        case JSON_TOKEN_END_ARRAY:
+                        case JSON_TOKEN_END_OBJECT:
+                                if (levels == 1) {
+                                        return json_lexer_read_token(lexer);
+                                }
+
+                                --levels;
+                                break;
+
+                        case JSON_TOKEN_EOF:
+                        case JSON_TOKEN_ERROR:
+                                lexer->next_token = JSON_TOKEN_ERROR;
+                                return JSON_TOKEN_ERROR;
+
+                        case JSON_TOKEN_NEED_MORE:
+                                /* Continue from inside the incomplete
+                                 * token. */
+
+                                lexer->skip_in_string
+                                        = next_data->state == LEXER_STATE_STRING
+                                       || next_data->state == LEXER_STATE_ESCAPE
+                                       || next_data->state
+                                            == LEXER_STATE_UNICODE_ESCAPE;
+                                lexer->skip_escaped
+                                        = next_data->state == LEXER_STATE_ESCAPE;
+                                break;
+
+                        default:
+                                break;
+                }
+
+                next_data->state = LEXER_STATE_START;
+                lexer->skip_levels = levels;
+        }
+
+        closed = 0;
+
+        for (;;) {
+                /* The character after a number is pushed back, and is 
+                 * always outside of a string. */
+
+                if (reader->pending_char >= 0) {
+                        c = json_input_read_char(reader);
+
+                        if (skip_char(lexer, c)) {
+                                closed = c;
+                                break;
+                        }
+                }
+
+                err = json_input_get_span(reader, &span, &span_len);
+
+                if (err < 0) {
+                        break;
+                }
+
+                json_input_skip(reader, skip_span(lexer, span, span_len,
+                                                  &closed));
+
+                if (closed) {
+                        break;
+                }
+        }
+
+        if (!closed) {
+                if (err == JSON_ERROR_NEED_MORE) {
+                        lexer->next_token = JSON_TOKEN_NEED_MORE;
+                        return JSON_TOKEN_NEED_MORE;
+                }
+
+                /* The end of the input was reached before the end of
+                 * the array or object. */
+
+                lexer->skip_levels = 0;
+                lexer->next_token = JSON_TOKEN_ERROR;
+
+                return JSON_TOKEN_ERROR;
+        }
+
+        /* Read ahead the token after the end. */
+
+        lexer->next_token = internal_read_token(lexer, next_data);
+
+        if (closed == ']') {
+                return JSON_TOKEN_END_ARRAY;
+        } else {
+                return JSON_TOKEN_END_OBJECT;
+        }
+}
+
+const char *json_lexer_get_buffer(JSONLexer *lexer)
+{
+        JSONTokenData *token_data;
+        JSONStringBuffer *current_buffer;
+
+        token_data = &lexer->token_data[lexer->current_buffer];
+        current_buffer = &token_data->buffer;
+
+        /* A string read in place is not NUL-terminated, unless it was
+         * unescaped in situ; otherwise it must be copied into the 
+         * buffer. */
+
+        if (token_data->view != NULL
+         && token_data->view[token_data->view_len] == '\0') {
+                return (const char *) token_data->view;
+        } else if (token_data->view != NULL) {
+                if (json_string_buffer_put_bytes(current_buffer,
+                                                 token_data->view,
+                                                 token_data->view_len) < 0
+                 || json_string_buffer_put_char(current_buffer, '\0') < 0) {
+                        return NULL;
+                }
+
+                token_data->view = NULL;
+        }
+
+        return (const char *) json_string_buffer_get(current_buffer);
+}
+
+int json_lexer_get_string(JSONLexer *lexer, const char **data,
+                          size_t *length)
+{
+        JSONTokenData *token_data;
+        JSONStringBuffer *current_buffer;
+
+        token_data = &lexer->token_data[lexer->current_buffer];
+
+        if (token_data->view != NULL) {
+                *data = (const char *) token_data->view;
+                *length = token_data->view_len;
+                return 1;
+        }
+
+        /* The buffer length includes the terminating NUL. */
+
+        current_buffer = &token_data->buffer;
+        *data = (const char *) json_string_buffer_get(current_buffer);
+        *length = current_buffer->buffer_len - 1;
+
+        return 0;
+}
+
+int64_t json_lexer_get_int(JSONLexer *lexer)
+{
+        return lexer->token_data[lexer->current_buffer].number.intval;
+}
+
+uint64_t json_lexer_get_uint64(JSONLexer *lexer)
+{
+        return lexer->token_data[lexer->current_buffer].number.uintval;
+}
+
+double json_lexer_get_float(JSONLexer *lexer)
+{
+        return lexer->token_data[lexer->current_buffer].number.floatval;
 }
 
@@ -26,7 +26,11 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "jigsawn/parser.h"
+#include "allocator.h"
+#include "input-reader.h"
 
 /*
  * JSON lexer, used to parse a stream of JSON data into tokens.
@@ -43,7 +47,8 @@ typedef enum {
         JSON_TOKEN_END_ARRAY,             /* ] */
         JSON_TOKEN_BEGIN_OBJECT,          /* { */
         JSON_TOKEN_END_OBJECT,            /* } */
-        JSON_TOKEN_INTEGER,               /* [0-9]+ */
+        JSON_TOKEN_INTEGER,               /* [0-9]+ (64-bit signed) */
+        JSON_TOKEN_UNSIGNED_INTEGER,      /* [0-9]+ (beyond INT64_MAX) */
         JSON_TOKEN_FLOAT,                 /* [0-9]+.[0-9]+ */
         JSON_TOKEN_STRING,                /* "text" */
         JSON_TOKEN_TRUE,                  /* true */
@@ -53,20 +58,90 @@ typedef enum {
         JSON_TOKEN_COLON,                 /* : */
         JSON_TOKEN_EOF,                   /* End of file reached */
         JSON_TOKEN_ERROR,                 /* An error occurred */
+        JSON_TOKEN_NEED_MORE,             /* More input must be fed */
         JSON_TOKEN_START                  /* Start of file */
 } JSONToken;
 
 /**
- * Create a new @ref JSONLexer.
+ * Create a new @ref JSONLexer.  The lexer's input reader must be 
+ * initialised before any tokens are read.
  *
- * @param source            Source to read the JSON data from.
- * @param read_func         Callback function to invoke to read data.
+ * @param allocator         Allocator to allocate memory from, or NULL to
+ *                          use the default allocator.
  * @return                  A new @ref JSONLexer, or NULL if it was not 
  *                          possible to initialise the new lexer.
+ * @sa json_lexer_get_reader
+ */
+
+JSONLexer *json_lexer_new(const JSONAllocator *allocator);
+
+/**
+ * Get the @ref JSONInputReader that a @ref JSONLexer reads from, so 
+ * that it can be initialised with one of the json_input_reader_init
+ * functions.
+ *
+ * @param lexer             The lexer.
+ * @return                  Pointer to the lexer's input reader.
+ */
+
+JSONInputReader *json_lexer_get_reader(JSONLexer *lexer);
+
+/**
+ * Set the maximum length of string that a @ref JSONLexer will read.
+ * Longer strings cause an error token to be returned.
+ *
+ * @param lexer             The lexer.
+ * @param max_length        Maximum length in bytes (encoded as UTF-8),
+ *                          or zero for no limit.
+ */
+
+void json_lexer_set_max_string_length(JSONLexer *lexer, size_t max_length);
+
+/**
+ * Enable or disable reading with a structural index.  When enabled, if
+ * the input is held in memory in one block (see 
+ * @ref json_input_get_document), the positions at which tokens can 
+ * start are found for the whole document in a first pass, before the
+ * first token is read.  The lexer then moves between tokens using the
+ * index, rather than reading the whitespace between them a character
+ * at a time, and reads strings, numbers and keywords whose end is 
+ * given by the next position in the index without examining their 
+ * characters one at a time.  Otherwise, the input is read as normal.
+ * The tokens read are the same either way.
+ *
+ * @param lexer             The lexer.
+ * @param num_threads       Number of threads to build the index with 
+ *                          (see @ref json_structural_index_build_parallel),
+ *                          or zero to disable the index.
+ * @return                  Zero if successful, or 
+ *                          @ref JSON_ERROR_INPUT_STREAM if reading has
+ *                          already started.
+ */
+
+int json_lexer_set_structural_index(JSONLexer *lexer,
+                                    unsigned int num_threads);
+
+/**
+ * Query whether a @ref JSONLexer has started reading its input.
+ *
+ * @param lexer             The lexer.
+ * @return                  Non-zero if a token has been read.
+ */
+
+int json_lexer_has_started(JSONLexer *lexer);
+
+/**
+ * Get the reason for the error token returned by a @ref JSONLexer.
+ *
+ * @param lexer             The lexer.
+ * @return                  @ref JSON_ERROR_TOO_LONG if a string was 
+ *                          longer than the maximum length,
+ *                          @ref JSON_ERROR_OUT_OF_MEMORY if memory could
+ *                          not be allocated for a string, or 
+ *                          @ref JSON_ERROR_PARSE for other errors.
  */
 
-JSONLexer *json_lexer_new(JSONInputSource source,
-                          JSONInputReadFunc read_func);
+int json_lexer_get_error(JSONLexer *lexer);
 
 /**
  * Free a @ref JSONLexer.
@@ -82,7 +157,10 @@ void json_lexer_free(JSONLexer *lexer);
  *
  * @param lexer             The lexer.
  * @return                  Type of the token read, or @ref JSON_TOKEN_ERROR
- *                          if an error occurred while reading.
+ *                          if an error occurred while reading.  If the
+ *                          input reader is in push mode, 
+ *                          @ref JSON_TOKEN_NEED_MORE is returned if the
+ *                          token is incomplete.
  */
 
 JSONToken json_lexer_peek_token(JSONLexer *lexer);
@@ -92,22 +170,111 @@ JSONToken json_lexer_peek_token(JSONLexer *lexer);
  *
  * @param lexer             The lexer.
  * @return                  Type of the token read, or @ref JSON_TOKEN_ERROR
- *                          if an error occurred while reading.
+ *                          if an error occurred while reading.  If the
+ *                          input reader is in push mode, 
+ *                          @ref JSON_TOKEN_NEED_MORE is returned if the
+ *                          token is incomplete; the token is read again
+ *                          by the next call, after more input has been 
+ *                          fed with @ref json_input_feed.
  */
 
 JSONToken json_lexer_read_token(JSONLexer *lexer);
 
+/**
+ * Skip to the end of one or more arrays or objects that are open, 
+ * without reading the values that they contain: after the opening 
+ * bracket of an array has been read, skipping one level moves past
+ * its closing bracket.  The input is scanned only for brackets, 
+ * quotes and backslashes, so that no strings are copied and no 
+ * numbers are converted; the contents are not checked for errors.
+ *
+ * @param lexer             The lexer.
+ * @param levels            Number of arrays and objects to skip to the
+ *                          end of (at least one).
+ * @return                  The token that closes the outermost of them,
+ *                          @ref JSON_TOKEN_END_ARRAY or 
+ *                          @ref JSON_TOKEN_END_OBJECT, or 
+ *                          @ref JSON_TOKEN_ERROR if the end of the input
+ *                          is reached first.  If the input reader is in
+ *                          push mode, @ref JSON_TOKEN_NEED_MORE is 
+ *                          returned if the end has not yet been fed; 
+ *                          the skip is then continued by the next call.
+ *                          If levels is larger in that call, the skip 
+ *                          continues further out; if it is smaller, 
+ *                          the skip continues to the original end.
+ */
+
+JSONToken json_lexer_skip(JSONLexer *lexer, unsigned int levels);
+
 /**
  * Get the contents of the token buffer used to store the contents of
- * the last token that was read.  This is only valid for some token types -
- * the string and number types.
+ * the last token that was read.  This is only valid for string tokens.
+ * If the string was read in place (see @ref json_lexer_get_string), 
+ * it is first copied into the buffer.
  *
  * @param lexer             The lexer.
- * @return                  Pointer to the token buffer.
+ * @return                  Pointer to the token buffer, which is 
+ *                          NUL-terminated, or NULL if out of memory.
  */
 
 const char *json_lexer_get_buffer(JSONLexer *lexer);
 
+/**
+ * Get the contents of the last token that was read, if it was a 
+ * string (@ref JSON_TOKEN_STRING), without copying it.  If the input 
+ * is read in place (see @ref json_input_is_in_place), strings that 
+ * contain no escape sequences are not copied into the token buffer;
+ * the contents are left in the input data.  If the input may be 
+ * modified (see @ref json_input_is_in_situ), all strings are 
+ * unescaped in the input data and NUL-terminated there.
+ *
+ * @param lexer             The lexer.
+ * @param data              Pointer to a variable to store a pointer to
+ *                          the string contents, encoded in UTF-8.
+ * @param length            Pointer to a variable to store the length of
+ *                          the string, in bytes.
+ * @return                  Non-zero if the contents are in the input 
+ *                          data: they are not NUL-terminated unless 
+ *                          they were unescaped in situ, and remain
+ *                          valid until the input reader is freed or
+ *                          initialised again.  Zero if they are in the 
+ *                          token buffer: they are NUL-terminated, and 
+ *                          are only valid until the next token is read.
+ */
+
+int json_lexer_get_string(JSONLexer *lexer, const char **data,
+                          size_t *length);
+
+/**
+ * Get the value of the last token that was read, if it was an integer
+ * (@ref JSON_TOKEN_INTEGER).
+ *
+ * @param lexer             The lexer.
+ * @return                  The integer value.
+ */
+
+int64_t json_lexer_get_int(JSONLexer *lexer);
+
+/**
+ * Get the value of the last token that was read, if it was an 
+ * unsigned integer (@ref JSON_TOKEN_UNSIGNED_INTEGER).
+ *
+ * @param lexer             The lexer.
+ * @return                  The integer value.
+ */
+
+uint64_t json_lexer_get_uint64(JSONLexer *lexer);
+
+/**
+ * Get the value of the last token that was read, if it was a 
+ * floating point number (@ref JSON_TOKEN_FLOAT).
+ *
+ * @param lexer             The lexer.
+ * @return                  The floating point value.
+ */
+
+double json_lexer_get_float(JSONLexer *lexer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,121 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_NUMBER_H
+#define JIGSAWN_INTERNAL_NUMBER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "string-buffer.h"
+
+/*
+ * Conversion of JSON numbers to binary values, independent of the
+ * C library locale.
+ */
+
+typedef struct _JSONNumber JSONNumber;
+
+/**
+ * A number being read by the lexer, in decimal form: the number is
+ * equal to mantissa * 10^exponent.
+ */
+
+struct _JSONNumber {
+
+        /** Significant digits of the number. */
+
+        uint64_t mantissa;
+
+        /** Decimal exponent. */
+
+        int exponent;
+
+        /** Non-zero if the number is negative. */
+
+        int negative;
+
+        /** 
+         * Non-zero if there are too many digits to fit in mantissa.  
+         * In this case, the string buffer that was passed to 
+         * @ref json_number_add_digit holds all of the digits.
+         */
+
+        int overflow;
+};
+
+/**
+ * Initialise a @ref JSONNumber to zero.
+ *
+ * @param number            The number.
+ */
+
+void json_number_init(JSONNumber *number);
+
+/**
+ * Add a digit to the end of a number's digits.
+ *
+ * @param number            The number.
+ * @param digit             The digit value, 0-9.
+ * @param fraction          Non-zero if the digit follows the decimal point.
+ * @param buffer            Buffer used to store the digits if they do not
+ *                          fit in the mantissa.
+ * @return                  Zero if successful, or negative error code.
+ */
+
+int json_number_add_digit(JSONNumber *number, int digit, int fraction,
+                          JSONStringBuffer *buffer);
+
+/**
+ * Add eight digits to the end of a number's digits, if the eight bytes
+ * at the specified location are all ASCII digits and the result fits
+ * in the mantissa.
+ *
+ * @param number            The number.
+ * @param p                 Pointer to eight bytes of input data.
+ * @param fraction          Non-zero if the digits follow the decimal point.
+ * @return                  Non-zero if the digits were added.
+ */
+
+int json_number_add_eight_digits(JSONNumber *number,
+                                 const unsigned char *p,
+                                 int fraction);
+
+/**
+ * Convert a number to the nearest double precision floating point
+ * value.
+ *
+ * @param number            The number.
+ * @param buffer            Buffer passed to @ref json_number_add_digit.
+ * @return                  The floating point value.
+ */
+
+double json_number_to_double(JSONNumber *number, JSONStringBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_NUMBER_H */
+
@@ -19,91 +19,627 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include "jigsawn/error.h"
+
+#include "allocator.h"
 #include "parser.h"
 #include "lexer.h"
 #include "value.h"
 
-JSONParser *json_parser_new(JSONInputSource source, 
-                            JSONInputReadFunc read_func)
+/* Allocate a new parser.  The input reader for the lexer must then be
+ * initialised by the caller. */
+
+static JSONParser *json_parser_alloc(const JSONAllocator *allocator)
 {
         JSONParser *parser;
         JSONLexer *lexer;
 
         /* Allocate the parser */
 
-        parser = malloc(sizeof(JSONParser));
+        parser = json_allocator_alloc(allocator, sizeof(JSONParser));
 
         if (parser == NULL) {
                 return NULL;
         }
 
+        parser->allocator = *allocator;
+
         /* Create the lexer */
 
-        lexer = json_lexer_new(source, read_func);
+        lexer = json_lexer_new(&parser->allocator);
 
         if (lexer == NULL) {
-                free(parser);
+                json_allocator_free(allocator, parser);
                 return NULL;
         }
 
         parser->lexer = lexer;
+        parser->error = JSON_ERROR_SUCCESS;
+        json_arena_init(&parser->arena, &parser->allocator);
+
+        parser->depth = 0;
+        parser->open_serials = NULL;
+        parser->open_serials_size = 0;
+        parser->next_serial = 0;
+        parser->skip_pending = 0;
+        parser->skip_depth = 0;
+
+        json_key_set_init(&parser->keys, &parser->allocator);
+        json_key_intern_init(&parser->interned_keys, &parser->allocator);
+
+        return parser;
+}
+
+/* Make the input reader allocate through the parser's allocator.  This
+ * must be done after the reader has been initialised. */
+
+static void json_parser_set_reader_allocator(JSONParser *parser)
+{
+        json_input_reader_set_allocator(json_lexer_get_reader(parser->lexer),
+                                        &parser->allocator);
+}
+
+JSONParser *json_parser_new(JSONInputSource source, 
+                            JSONInputReadFunc read_func)
+{
+        return json_parser_new_with_allocator(source, read_func,
+                                              &json_default_allocator);
+}
+
+JSONParser *json_parser_new_with_allocator(JSONInputSource source,
+                                           JSONInputReadFunc read_func,
+                                           const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        /* Without a callback function, data is fed by the caller. */
+
+        if (read_func == NULL) {
+                json_input_reader_init_push(json_lexer_get_reader(parser->lexer));
+        } else {
+                json_input_reader_init(json_lexer_get_reader(parser->lexer),
+                                       source, read_func);
+        }
+
+        json_parser_set_reader_allocator(parser);
+
+        return parser;
+}
+
+JSONParser *json_parser_new_from_memory(const void *data, size_t data_len)
+{
+        return json_parser_new_from_memory_with_allocator(
+                        data, data_len, &json_default_allocator);
+}
+
+JSONParser *json_parser_new_from_memory_with_allocator(
+                        const void *data, size_t data_len,
+                        const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        json_input_reader_init_memory(json_lexer_get_reader(parser->lexer),
+                                      data, data_len);
+        json_parser_set_reader_allocator(parser);
+
+        return parser;
+}
+
+JSONParser *json_parser_new_in_situ(void *data, size_t data_len)
+{
+        return json_parser_new_in_situ_with_allocator(
+                        data, data_len, &json_default_allocator);
+}
+
+JSONParser *json_parser_new_in_situ_with_allocator(
+                        void *data, size_t data_len,
+                        const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        json_input_reader_init_in_situ(json_lexer_get_reader(parser->lexer),
+                                       data, data_len);
+        json_parser_set_reader_allocator(parser);
+
+        return parser;
+}
+
+JSONParser *json_parser_new_from_iovec(const struct iovec *iov,
+                                       int iov_count)
+{
+        return json_parser_new_from_iovec_with_allocator(
+                        iov, iov_count, &json_default_allocator);
+}
+
+JSONParser *json_parser_new_from_iovec_with_allocator(
+                        const struct iovec *iov, int iov_count,
+                        const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        json_input_reader_init_iovec(json_lexer_get_reader(parser->lexer),
+                                     iov, iov_count);
+        json_parser_set_reader_allocator(parser);
+
+        return parser;
+}
+
+JSONParser *json_parser_new_from_file(const char *filename)
+{
+        return json_parser_new_from_file_with_allocator(
+                        filename, &json_default_allocator);
+}
+
+JSONParser *json_parser_new_from_file_with_allocator(
+                        const char *filename,
+                        const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+        int err;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        err = json_input_reader_init_file(json_lexer_get_reader(parser->lexer),
+                                          filename);
+
+        if (err < 0) {
+                json_parser_free(parser);
+                return NULL;
+        }
+
+        json_parser_set_reader_allocator(parser);
+
+        return parser;
+}
+
+JSONParser *json_parser_new_from_file_async(const char *filename)
+{
+        return json_parser_new_from_file_async_with_allocator(
+                        filename, &json_default_allocator);
+}
+
+JSONParser *json_parser_new_from_file_async_with_allocator(
+                        const char *filename,
+                        const JSONAllocator *allocator)
+{
+        JSONParser *parser;
+        int err;
+
+        parser = json_parser_alloc(allocator);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        err = json_input_reader_init_file_async(
+                        json_lexer_get_reader(parser->lexer), filename);
+
+        if (err < 0) {
+                json_parser_free(parser);
+                return NULL;
+        }
+
+        json_parser_set_reader_allocator(parser);
 
         return parser;
 }
 
 void json_parser_free(JSONParser *parser)
 {
+        JSONAllocator allocator;
+
         json_lexer_free(parser->lexer);
+        json_arena_free_all(&parser->arena);
+        json_allocator_free(&parser->allocator, parser->open_serials);
+        json_key_set_free(&parser->keys);
+        json_key_intern_free(&parser->interned_keys);
+
+        /* The allocator is stored inside the parser, so take a copy
+         * before freeing it. */
+
+        allocator = parser->allocator;
+        json_allocator_free(&allocator, parser);
+}
+
+int json_parser_feed(JSONParser *parser, const void *data, size_t data_len)
+{
+        return json_input_feed(json_lexer_get_reader(parser->lexer),
+                               data, data_len);
+}
+
+int json_parser_get_error(JSONParser *parser)
+{
+        return parser->error;
+}
 
-        free(parser);
+void json_parser_set_max_string_length(JSONParser *parser,
+                                       size_t max_length)
+{
+        json_lexer_set_max_string_length(parser->lexer, max_length);
+}
+
+int json_parser_set_readahead(JSONParser *parser,
+                              unsigned int num_buffers,
+                              size_t buffer_size)
+{
+        JSONInputReader *reader;
+
+        reader = json_lexer_get_reader(parser->lexer);
+
+        return json_input_reader_set_readahead(reader, num_buffers,
+                                               buffer_size);
+}
+
+int json_parser_set_structural_index(JSONParser *parser,
+                                     unsigned int num_threads)
+{
+        return json_lexer_set_structural_index(parser->lexer, num_threads);
+}
+
+int json_parser_register_keys(JSONParser *parser,
+                              const char *const *keys, int num_keys)
+{
+        int i;
+
+        if (num_keys < 0 || (keys == NULL && num_keys > 0)) {
+                return JSON_ERROR_INVALID_ARGUMENT;
+        }
+
+        for (i=0; i<num_keys; ++i) {
+                if (keys[i] == NULL) {
+                        return JSON_ERROR_INVALID_ARGUMENT;
+                }
+        }
+
+        if (json_lexer_has_started(parser->lexer)) {
+                return JSON_ERROR_INPUT_STREAM;
+        }
+
+        return json_key_set_build(&parser->keys, keys, num_keys);
+}
+
+void json_parser_get_stats(JSONParser *parser, JSONParserStats *stats)
+{
+        JSONInputStats input_stats;
+
+        json_input_reader_get_stats(json_lexer_get_reader(parser->lexer),
+                                    &input_stats);
+
+        stats->bytes_read = input_stats.bytes_read;
+        stats->read_syscalls = input_stats.syscalls;
+
+        if (input_stats.bytes_read > 0) {
+                stats->syscalls_per_mb = input_stats.syscalls
+                                       / (input_stats.bytes_read
+                                          / (1024.0 * 1024.0));
+        } else {
+                stats->syscalls_per_mb = 0;
+        }
+
+        stats->key_lookups = parser->interned_keys.lookups;
+        stats->key_hits = parser->interned_keys.hits;
+        stats->distinct_keys = parser->interned_keys.num_keys;
+
+        if (stats->key_lookups > 0) {
+                stats->key_hit_rate = (double) stats->key_hits
+                                    / stats->key_lookups;
+        } else {
+                stats->key_hit_rate = 0;
+        }
+}
+
+void json_parser_reset_arena(JSONParser *parser)
+{
+        json_arena_reset(&parser->arena);
+}
+
+/* Record that an array or object has been opened, giving it the next
+ * serial number.  value is NULL if the array or object is being 
+ * skipped without a value being created for it.  Returns zero for 
+ * success, or negative error code. */
+
+static int json_parser_open(JSONParser *parser, JSONValue *value)
+{
+        unsigned long *new_serials;
+        unsigned int new_size;
+
+        if (parser->depth >= parser->open_serials_size) {
+                new_size = parser->open_serials_size * 2;
+
+                if (new_size == 0) {
+                        new_size = 16;
+                }
+
+                new_serials = json_allocator_realloc(&parser->allocator,
+                                                     parser->open_serials,
+                                                     new_size
+                                                     * sizeof(*new_serials));
+
+                if (new_serials == NULL) {
+                        return JSON_ERROR_OUT_OF_MEMORY;
+                }
+
+                parser->open_serials = new_serials;
+                parser->open_serials_size = new_size;
+        }
+
+        ++parser->next_serial;
+        parser->open_serials[parser->depth] = parser->next_serial;
+        ++parser->depth;
+
+        if (value != NULL) {
+                value->data.collection.serial = parser->next_serial;
+                value->data.collection.depth = parser->depth;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+void json_parser_close(JSONParser *parser)
+{
+        --parser->depth;
+}
+
+int json_parser_token_error(JSONParser *parser, JSONToken token)
+{
+        if (token == JSON_TOKEN_ERROR) {
+                parser->error = json_lexer_get_error(parser->lexer);
+        } else {
+                parser->error = JSON_ERROR_PARSE;
+        }
+
+        return parser->error;
+}
+
+int json_parser_is_open(JSONParser *parser, JSONValue *value)
+{
+        unsigned int depth;
+
+        depth = value->data.collection.depth;
+
+        return value->data.collection.state != JSON_COLLECTION_END
+            && depth <= parser->depth
+            && parser->open_serials[depth - 1]
+                 == value->data.collection.serial;
+}
+
+int json_parser_skip_to(JSONParser *parser, unsigned int depth)
+{
+        JSONToken token;
+
+        /* An interrupted skip must be finished before anything else
+         * is read.  If it was skipping further out than this, the 
+         * input it has passed over cannot be read again, so it 
+         * continues to its own depth. */
+
+        if (parser->skip_pending && parser->skip_depth < depth) {
+                depth = parser->skip_depth;
+        }
+
+        if (parser->depth <= depth) {
+                return JSON_ERROR_SUCCESS;
+        }
+
+        token = json_lexer_skip(parser->lexer, parser->depth - depth);
+
+        if (token == JSON_TOKEN_NEED_MORE) {
+                parser->skip_pending = 1;
+                parser->skip_depth = depth;
+                parser->error = JSON_ERROR_NEED_MORE;
+                return parser->error;
+        }
+
+        parser->skip_pending = 0;
+
+        if (token == JSON_TOKEN_ERROR) {
+                return json_parser_token_error(parser, token);
+        }
+
+        parser->depth = depth;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+int json_parser_skip_value(JSONParser *parser)
+{
+        JSONToken token;
+        int err;
+
+        token = json_lexer_read_token(parser->lexer);
+
+        switch (token) {
+                case JSON_TOKEN_BEGIN_ARRAY:
+                case JSON_TOKEN_BEGIN_OBJECT:
+                        err = json_parser_open(parser, NULL);
+
+                        if (err < 0) {
+                                parser->error = err;
+                                return err;
+                        }
+
+                        return json_parser_skip_to(parser, parser->depth - 1);
+
+                case JSON_TOKEN_INTEGER:
+                case JSON_TOKEN_UNSIGNED_INTEGER:
+                case JSON_TOKEN_FLOAT:
+                case JSON_TOKEN_STRING:
+                case JSON_TOKEN_TRUE:
+                case JSON_TOKEN_FALSE:
+                case JSON_TOKEN_NULL:
+                        return JSON_ERROR_SUCCESS;
+
+                case JSON_TOKEN_NEED_MORE:
+                        parser->error = JSON_ERROR_NEED_MORE;
+                        return parser->error;
+
+                default:
+                        return json_parser_token_error(parser, token);
+        }
 }
 
 JSONValue *json_parser_read_value(JSONParser *parser)
+{
+        /* Skip any arrays and objects that were not read to the end. */
+
+        if (json_parser_skip_to(parser, 0) < 0) {
+                return NULL;
+        }
+
+        return json_parser_read_child(parser);
+}
+
+JSONValue *json_parser_read_child(JSONParser *parser)
 {
         JSONToken token;
-        const char *token_data;
+        JSONValue *value;
+        const char *data;
+        size_t length;
+        int in_place;
 
         token = json_lexer_read_token(parser->lexer);
-        token_data = json_lexer_get_buffer(parser->lexer);
 
         switch (token) {
                 case JSON_TOKEN_BEGIN_ARRAY:
                         /* Start of an array */
-                        return json_value_new(JSON_VALUE_ARRAY, NULL);
+                        value = json_value_new(parser, JSON_VALUE_ARRAY, NULL);
+
+                        if (value != NULL
+                         && json_parser_open(parser, value) < 0) {
+                                json_value_free(value);
+                                value = NULL;
+                        }
+                        break;
 
                 case JSON_TOKEN_BEGIN_OBJECT:
                         /* Start of an object */
-                        return json_value_new(JSON_VALUE_OBJECT, NULL);
+                        value = json_value_new(parser, JSON_VALUE_OBJECT, NULL);
+
+                        if (value != NULL
+                         && json_parser_open(parser, value) < 0) {
+                                json_value_free(value);
+                                value = NULL;
+                        }
+                        break;
 
                 case JSON_TOKEN_INTEGER:
-                        /* Integer */
-                        return json_value_new(JSON_VALUE_INT, token_data);
+                        /* Integer; the lexer has already converted it. */
+                        value = json_value_new(parser, JSON_VALUE_INT, NULL);
+
+                        if (value != NULL) {
+                                value->data.intval
+                                        = json_lexer_get_int(parser->lexer);
+                        }
+                        break;
+
+                case JSON_TOKEN_UNSIGNED_INTEGER:
+                        /* Integer too large for a signed 64-bit value */
+                        value = json_value_new(parser, JSON_VALUE_UINT64, NULL);
+
+                        if (value != NULL) {
+                                value->data.uintval
+                                       = json_lexer_get_uint64(parser->lexer);
+                        }
+                        break;
 
                 case JSON_TOKEN_FLOAT:
                         /* Floating point value */
-                        return json_value_new(JSON_VALUE_FLOAT, token_data);
+                        value = json_value_new(parser, JSON_VALUE_FLOAT, NULL);
+
+                        if (value != NULL) {
+                                value->data.floatval
+                                        = json_lexer_get_float(parser->lexer);
+                        }
+                        break;
 
                 case JSON_TOKEN_STRING:
-                        /* String value */
-                        return json_value_new(JSON_VALUE_STRING, token_data);
+                        /* String value.  The contents are copied,
+                         * unless they were read in place. */
+                        value = json_value_new(parser, JSON_VALUE_STRING,
+                                               NULL);
+
+                        if (value == NULL) {
+                                break;
+                        }
+
+                        in_place = json_lexer_get_string(parser->lexer,
+                                                         &data, &length);
+
+                        if (json_value_string_set(parser,
+                                                  &value->data.strval,
+                                                  data, length,
+                                                  in_place) < 0) {
+                                json_value_free(value);
+                                value = NULL;
+                        }
+                        break;
 
                 case JSON_TOKEN_TRUE:
                         /* Boolean */
-                        return json_value_new(JSON_VALUE_BOOLEAN, "1");
+                        value = json_value_new(parser, JSON_VALUE_BOOLEAN, "1");
+                        break;
 
                 case JSON_TOKEN_FALSE:
                         /* Boolean */
-                        return json_value_new(JSON_VALUE_BOOLEAN, "0");
+                        value = json_value_new(parser, JSON_VALUE_BOOLEAN, "0");
+                        break;
 
                 case JSON_TOKEN_NULL:
                         /* Null */
-                        return json_value_new(JSON_VALUE_NULL, NULL);
+                        value = json_value_new(parser, JSON_VALUE_NULL, NULL);
+                        break;
+
+                case JSON_TOKEN_NEED_MORE:
+                        /* Push mode: the token will be read again once 
+                         * more data has been fed. */
+
+                        parser->error = JSON_ERROR_NEED_MORE;
+                        return NULL;
+
+                case JSON_TOKEN_EOF:
+                        parser->error = JSON_ERROR_END_OF_FILE;
+                        return NULL;
 
                 default:
                         /* Anything else is an error; this is not the 
                          * start of a value. */
 
+                        json_parser_token_error(parser, token);
                         return NULL;
         }
-}
 
+        if (value == NULL) {
+                parser->error = JSON_ERROR_OUT_OF_MEMORY;
+        } else {
+                parser->error = JSON_ERROR_SUCCESS;
+        }
+
+        return value;
+}
@@ -27,13 +27,135 @@ extern "C" {
 #endif
 
 #include "jigsawn/parser.h"
+#include "allocator.h"
+#include "arena.h"
+#include "key-intern.h"
+#include "key-set.h"
 #include "lexer.h"
 #include "value.h"
 
 struct _JSONParser {
+
+        /** Allocator used for all memory allocated by the parser. */
+
+        JSONAllocator allocator;
+
         JSONLexer *lexer;
+
+        /** Error code from the last read. */
+
+        int error;
+
+        /** Arena from which values and copied strings are allocated. */
+
+        JSONArena arena;
+
+        /**
+         * Number of arrays and objects that are open: their opening
+         * bracket has been read, but not their closing bracket.
+         */
+
+        unsigned int depth;
+
+        /**
+         * Serial numbers of the open arrays and objects, from the 
+         * outermost inwards.  Each array and object that is read is 
+         * given the next serial number, so that it can be told whether
+         * one is still open.
+         */
+
+        unsigned long *open_serials;
+        unsigned int open_serials_size;
+        unsigned long next_serial;
+
+        /**
+         * If a skip was interrupted because more input was needed, 
+         * non-zero, and the depth that it is skipping to.
+         */
+
+        int skip_pending;
+        unsigned int skip_depth;
+
+        /** Keys registered with json_parser_register_keys. */
+
+        JSONKeySet keys;
+
+        /** Table of interned object keys. */
+
+        JSONKeyIntern interned_keys;
 };
 
+/**
+ * Read a value from the current position in the input, which may be
+ * inside an array or object.
+ *
+ * @param parser        The parser.
+ * @return              The new value, or NULL if no value could be 
+ *                      read; the reason is stored in the parser's 
+ *                      error code.
+ */
+
+JSONValue *json_parser_read_child(JSONParser *parser);
+
+/**
+ * Query whether an array or object value is still open: its end has
+ * not been read, and it has not been skipped.
+ *
+ * @param parser        The parser.
+ * @param value         The array or object.
+ * @return              Non-zero if the value is open.
+ */
+
+int json_parser_is_open(JSONParser *parser, JSONValue *value);
+
+/**
+ * Skip to the end of open arrays and objects, so that only the given
+ * number remain open.  The values inside them are not read.
+ *
+ * @param parser        The parser.
+ * @param depth         Number of arrays and objects to leave open.
+ * @return              Zero if successful, or negative error code, 
+ *                      which is also stored in the parser's error code.
+ */
+
+int json_parser_skip_to(JSONParser *parser, unsigned int depth);
+
+/**
+ * Skip the value at the current position, without reading it.  If it
+ * is an array or object, its contents are skipped with 
+ * @ref json_parser_skip_to; if that is interrupted because more input 
+ * is needed, it is left open, and is skipped by the next call to
+ * @ref json_parser_skip_to.
+ *
+ * @param parser        The parser.
+ * @return              Zero if successful, or negative error code, 
+ *                      which is also stored in the parser's error code.
+ */
+
+int json_parser_skip_value(JSONParser *parser);
+
+/**
+ * Record an error for an unexpected token.  If the token is an error
+ * token, the reason reported by the lexer is used; otherwise this is
+ * a parse error.
+ *
+ * @param parser        The parser.
+ * @param token         The unexpected token.
+ * @return              The error code, which is also stored in the
+ *                      parser's error code.
+ */
+
+int json_parser_token_error(JSONParser *parser, JSONToken token);
+
+/**
+ * Record that the end of the innermost open array or object has been
+ * read.
+ *
+ * @param parser        The parser.
+ */
+
+void json_parser_close(JSONParser *parser);
+
 #ifdef __cplusplus
 }
 #endif
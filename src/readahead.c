@@ -0,0 +1,343 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "jigsawn/error.h"
+
+#include "readahead.h"
+
+/*
+ * The buffers form a ring that is filled by the readahead thread and
+ * emptied by the reader.  write_index counts the buffers that have
+ * been filled, and read_index the buffers that have been given back;
+ * each is only written by one side, so the buffers can be handed 
+ * over without locking.  The mutex and condition variables are only 
+ * used when one side has to sleep, waiting for the other.
+ */
+
+typedef struct {
+        unsigned char *data;
+        size_t len;
+
+        /** Zero, or error code if the read function failed. */
+
+        int result;
+} JSONReadaheadBuffer;
+
+struct _JSONReadahead {
+        JSONInputSource source;
+        JSONInputReadFunc read_func;
+        const JSONAllocator *allocator;
+        JSONInputStats *stats;
+
+        JSONReadaheadBuffer *buffers;
+        unsigned int num_buffers;
+        size_t buffer_size;
+
+        /** Number of buffers filled by the thread. */
+
+        unsigned int write_index;
+
+        /** Number of buffers given back by the reader. */
+
+        unsigned int read_index;
+
+        /** If true, the reader holds the buffer at read_index. */
+
+        int holding;
+
+        /** 
+         * If true, the reader has reached the last buffer, and 
+         * result is the result to return from all further reads.
+         */
+
+        int finished;
+
+        int result;
+
+        /** Set to tell the thread to stop. */
+
+        int stop;
+
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t filled;
+        pthread_cond_t emptied;
+};
+
+/* Fill a buffer, reading until it is full or the input ends.  Returns
+ * non-zero if the input has ended. */
+
+static int json_readahead_fill(JSONReadahead *readahead,
+                               JSONReadaheadBuffer *buffer)
+{
+        int bytes;
+
+        buffer->len = 0;
+        buffer->result = JSON_ERROR_SUCCESS;
+
+        while (buffer->len < readahead->buffer_size) {
+                bytes = readahead->read_func(readahead->source,
+                                             buffer->data + buffer->len,
+                                             readahead->buffer_size
+                                               - buffer->len);
+
+                __atomic_fetch_add(&readahead->stats->syscalls, 1,
+                                   __ATOMIC_RELAXED);
+
+                if (bytes < 0) {
+                        buffer->result = JSON_ERROR_INPUT_STREAM;
+                        return 1;
+                } else if (bytes == 0) {
+                        return 1;
+                }
+
+                buffer->len += bytes;
+                __atomic_fetch_add(&readahead->stats->bytes_read, bytes,
+                                   __ATOMIC_RELAXED);
+        }
+
+        return 0;
+}
+
+/* Readahead thread main function. */
+
+static void *json_readahead_thread(void *arg)
+{
+        JSONReadahead *readahead = arg;
+        unsigned int index;
+        int done;
+
+        index = 0;
+
+        do {
+                /* Wait until there is a free buffer. */
+
+                if (index - __atomic_load_n(&readahead->read_index,
+                                            __ATOMIC_ACQUIRE)
+                      >= readahead->num_buffers) {
+                        pthread_mutex_lock(&readahead->lock);
+
+                        while (!readahead->stop
+                            && index - __atomic_load_n(&readahead->read_index,
+                                                       __ATOMIC_ACQUIRE)
+                                 >= readahead->num_buffers) {
+                                pthread_cond_wait(&readahead->emptied,
+                                                  &readahead->lock);
+                        }
+
+                        done = readahead->stop;
+                        pthread_mutex_unlock(&readahead->lock);
+
+                        if (done) {
+                                break;
+                        }
+                }
+
+                done = json_readahead_fill(readahead,
+                        &readahead->buffers[index % readahead->num_buffers]);
+
+                /* A buffer that ends the input is always handed over,
+                 * even if it is empty, so that the reader sees the 
+                 * end of file or error. */
+
+                ++index;
+                __atomic_store_n(&readahead->write_index, index,
+                                 __ATOMIC_RELEASE);
+
+                pthread_mutex_lock(&readahead->lock);
+                pthread_cond_signal(&readahead->filled);
+                pthread_mutex_unlock(&readahead->lock);
+
+        } while (!done);
+
+        return NULL;
+}
+
+/* Free the first count buffers, and the readahead itself. */
+
+static void json_readahead_free_buffers(JSONReadahead *readahead,
+                                       unsigned int count)
+{
+        unsigned int i;
+
+        for (i=0; i<count; ++i) {
+                json_allocator_free(readahead->allocator,
+                                    readahead->buffers[i].data);
+        }
+
+        json_allocator_free(readahead->allocator, readahead->buffers);
+        json_allocator_free(readahead->allocator, readahead);
+}
+
+JSONReadahead *json_readahead_new(JSONInputSource source,
+                                  JSONInputReadFunc read_func,
+                                  unsigned int num_buffers,
+                                  size_t buffer_size,
+                                  const JSONAllocator *allocator,
+                                  JSONInputStats *stats)
+{
+        JSONReadahead *readahead;
+        unsigned int i;
+
+        if (num_buffers < 2 || buffer_size == 0) {
+                return NULL;
+        }
+
+        readahead = json_allocator_alloc(allocator, sizeof(JSONReadahead));
+
+        if (readahead == NULL) {
+                return NULL;
+        }
+
+        readahead->source = source;
+        readahead->read_func = read_func;
+        readahead->allocator = allocator;
+        readahead->stats = stats;
+        readahead->num_buffers = num_buffers;
+        readahead->buffer_size = buffer_size;
+        readahead->write_index = 0;
+        readahead->read_index = 0;
+        readahead->holding = 0;
+        readahead->finished = 0;
+        readahead->result = JSON_ERROR_SUCCESS;
+        readahead->stop = 0;
+
+        readahead->buffers
+                = json_allocator_alloc(allocator,
+                                       sizeof(JSONReadaheadBuffer)
+                                         * num_buffers);
+
+        if (readahead->buffers == NULL) {
+                json_allocator_free(allocator, readahead);
+                return NULL;
+        }
+
+        for (i=0; i<num_buffers; ++i) {
+                readahead->buffers[i].data 
+                        = json_allocator_alloc(allocator, buffer_size);
+
+                if (readahead->buffers[i].data == NULL) {
+                        break;
+                }
+        }
+
+        if (i < num_buffers) {
+                json_readahead_free_buffers(readahead, i);
+                return NULL;
+        }
+
+        pthread_mutex_init(&readahead->lock, NULL);
+        pthread_cond_init(&readahead->filled, NULL);
+        pthread_cond_init(&readahead->emptied, NULL);
+
+        if (pthread_create(&readahead->thread, NULL,
+                           json_readahead_thread, readahead) != 0) {
+                pthread_cond_destroy(&readahead->emptied);
+                pthread_cond_destroy(&readahead->filled);
+                pthread_mutex_destroy(&readahead->lock);
+                json_readahead_free_buffers(readahead, num_buffers);
+                return NULL;
+        }
+
+        return readahead;
+}
+
+void json_readahead_free(JSONReadahead *readahead)
+{
+        pthread_mutex_lock(&readahead->lock);
+        readahead->stop = 1;
+        pthread_cond_signal(&readahead->emptied);
+        pthread_mutex_unlock(&readahead->lock);
+
+        pthread_join(readahead->thread, NULL);
+
+        pthread_cond_destroy(&readahead->emptied);
+        pthread_cond_destroy(&readahead->filled);
+        pthread_mutex_destroy(&readahead->lock);
+
+        json_readahead_free_buffers(readahead, readahead->num_buffers);
+}
+
+int json_readahead_next(JSONReadahead *readahead,
+                        const unsigned char **data,
+                        size_t *data_len)
+{
+        JSONReadaheadBuffer *buffer;
+        unsigned int index;
+
+        /* After the last buffer, the thread has stopped, and there is
+         * nothing more to read. */
+
+        if (readahead->finished) {
+                *data = NULL;
+                *data_len = 0;
+                return readahead->result;
+        }
+
+        index = readahead->read_index;
+
+        /* Give back the buffer we were holding. */
+
+        if (readahead->holding) {
+                ++index;
+                __atomic_store_n(&readahead->read_index, index,
+                                 __ATOMIC_RELEASE);
+
+                pthread_mutex_lock(&readahead->lock);
+                pthread_cond_signal(&readahead->emptied);
+                pthread_mutex_unlock(&readahead->lock);
+        }
+
+        /* Wait for the next buffer to be filled. */
+
+        if (__atomic_load_n(&readahead->write_index,
+                            __ATOMIC_ACQUIRE) == index) {
+                pthread_mutex_lock(&readahead->lock);
+
+                while (__atomic_load_n(&readahead->write_index,
+                                       __ATOMIC_ACQUIRE) == index) {
+                        pthread_cond_wait(&readahead->filled,
+                                          &readahead->lock);
+                }
+
+                pthread_mutex_unlock(&readahead->lock);
+        }
+
+        readahead->holding = 1;
+
+        /* A buffer that is not full is the last one. */
+
+        buffer = &readahead->buffers[index % readahead->num_buffers];
+
+        if (buffer->len < readahead->buffer_size) {
+                readahead->finished = 1;
+                readahead->result = buffer->result;
+        }
+
+        *data = buffer->data;
+        *data_len = buffer->len;
+
+        return buffer->result;
+}
@@ -0,0 +1,102 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_READAHEAD_H
+#define JIGSAWN_INTERNAL_READAHEAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "jigsawn/parser.h"
+#include "allocator.h"
+#include "input-reader.h"
+
+/*
+ * Readahead: a background thread reads from an input source into a
+ * ring of buffers, so that reading overlaps with parsing.
+ */
+
+typedef struct _JSONReadahead JSONReadahead;
+
+/**
+ * Create a new @ref JSONReadahead and start its thread reading from
+ * the specified source.  The read function is invoked from the
+ * readahead thread, not the calling thread.
+ *
+ * @param source            The source to read data from.
+ * @param read_func         Callback function to read from the source.
+ * @param num_buffers       Number of buffers in the ring (at least 2).
+ * @param buffer_size       Size of each buffer, in bytes.
+ * @param allocator         Allocator to allocate memory from.  Memory 
+ *                          is only allocated and freed by the calling
+ *                          thread.  The pointer must remain valid until
+ *                          the readahead is freed.
+ * @param stats             Statistics to update as data is read.  The
+ *                          counters are updated by the readahead 
+ *                          thread with atomic operations.
+ * @return                  A new readahead, or NULL if out of memory or
+ *                          the thread could not be started.
+ */
+
+JSONReadahead *json_readahead_new(JSONInputSource source,
+                                  JSONInputReadFunc read_func,
+                                  unsigned int num_buffers,
+                                  size_t buffer_size,
+                                  const JSONAllocator *allocator,
+                                  JSONInputStats *stats);
+
+/**
+ * Stop the thread of a @ref JSONReadahead and free it.  If the thread
+ * is in the middle of a call to the read function, this waits for the
+ * call to return.
+ *
+ * @param readahead         The readahead.
+ */
+
+void json_readahead_free(JSONReadahead *readahead);
+
+/**
+ * Get the next block of data read by a @ref JSONReadahead, waiting for
+ * it to be read if necessary.  The block returned by the previous call
+ * is given back to the thread to be filled again, so it must no 
+ * longer be used.
+ *
+ * @param readahead         The readahead.
+ * @param data              Pointer to a variable to store a pointer to
+ *                          the data.
+ * @param data_len          Pointer to a variable to store the length
+ *                          of the data, which is zero at end of file.
+ * @return                  Zero for success, or negative error code if
+ *                          the read function failed.
+ */
+
+int json_readahead_next(JSONReadahead *readahead,
+                        const unsigned char **data,
+                        size_t *data_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_READAHEAD_H */
@@ -19,29 +19,38 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include <string.h>
+
 #include "jigsawn/error.h"
 
 #include "string-buffer.h" 
 #include "utf8.h"
 
-void json_string_buffer_init(JSONStringBuffer *buffer)
+/* Initial size of a buffer when it is first allocated. */
+
+#define STRING_BUFFER_MIN_SIZE    64
+
+void json_string_buffer_init(JSONStringBuffer *buffer,
+                             const JSONAllocator *allocator)
 {
         buffer->buffer = NULL;
         buffer->buffer_len = 0;
         buffer->buffer_allocated = 0;
+        buffer->max_size = 0;
+        buffer->allocator = allocator;
 }
 
 void json_string_buffer_free(JSONStringBuffer *buffer)
 {
-        free(buffer->buffer);
+        json_allocator_free(buffer->allocator, buffer->buffer);
 }
 
 unsigned char *json_string_buffer_get(JSONStringBuffer *buffer)
 {
         if (buffer->buffer_len == 0) {
-                return buffer->buffer;
-        } else {
                 return NULL;
+        } else {
+                return buffer->buffer;
         }
 }
 
@@ -50,18 +59,44 @@ void json_string_buffer_reset(JSONStringBuffer *buffer)
         buffer->buffer_len = 0;
 }
 
-/* Increase the size of the buffer.  Returns zero for success, or
- * negative error code. */
+void json_string_buffer_set_max_size(JSONStringBuffer *buffer,
+                                     size_t max_size)
+{
+        buffer->max_size = max_size;
+}
+
+/* Increase the size of the buffer so that it can hold at least
+ * min_size bytes.  Returns zero for success, or negative error code. */
 
-static int json_string_buffer_enlarge(JSONStringBuffer *buffer)
+static int json_string_buffer_enlarge(JSONStringBuffer *buffer,
+                                      size_t min_size)
 {
-        char *new_buffer;
+        unsigned char *new_buffer;
         size_t new_size;
 
-        /* Increase by 32 characters each time. */
+        if (buffer->max_size != 0 && min_size > buffer->max_size) {
+                return JSON_ERROR_TOO_LONG;
+        }
+
+        /* Double the size each time, so that the cost of copying 
+         * when reallocating is linear in the final length. */
+
+        new_size = buffer->buffer_allocated * 2;
 
-        new_size = buffer->buffer_len + 32;
-        new_buffer = realloc(buffer->buffer, new_size);
+        if (new_size < STRING_BUFFER_MIN_SIZE) {
+                new_size = STRING_BUFFER_MIN_SIZE;
+        }
+
+        if (new_size < min_size) {
+                new_size = min_size;
+        }
+
+        if (buffer->max_size != 0 && new_size > buffer->max_size) {
+                new_size = buffer->max_size;
+        }
+
+        new_buffer = json_allocator_realloc(buffer->allocator,
+                                            buffer->buffer, new_size);
 
         if (new_buffer == NULL) {
                 return JSON_ERROR_OUT_OF_MEMORY;
@@ -73,6 +108,16 @@ static int json_string_buffer_enlarge(JSONStringBuffer *buffer)
         return JSON_ERROR_SUCCESS;
 }
 
+int json_string_buffer_reserve(JSONStringBuffer *buffer, size_t size)
+{
+        if (buffer->buffer_len + size > buffer->buffer_allocated) {
+                return json_string_buffer_enlarge(buffer,
+                                                  buffer->buffer_len + size);
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
 /* Add a byte to the buffer.  Returns zero for success, or negative
  * error code. */
 
@@ -84,7 +129,8 @@ static int json_string_buffer_put_byte(JSONStringBuffer *buffer,
         /* Enlarge buffer if necessary */
 
         if (buffer->buffer_len + 1 > buffer->buffer_allocated) {
-                err = json_string_buffer_enlarge(buffer);
+                err = json_string_buffer_enlarge(buffer,
+                                                 buffer->buffer_len + 1);
 
                 if (err < 0) {
                         return err;
@@ -105,7 +151,7 @@ static int json_string_buffer_put_byte(JSONStringBuffer *buffer,
 int json_string_buffer_put_char(JSONStringBuffer *buffer, int c)
 {
         unsigned char buf[4];
-        int length;
+        size_t length;
         int err;
         int i;
 
@@ -126,3 +172,30 @@ int json_string_buffer_put_char(JSONStringBuffer *buffer, int c)
         return JSON_ERROR_SUCCESS;
 }
 
+/* Add a block of bytes to the buffer.  Returns zero for success, or
+ * negative error code. */
+
+int json_string_buffer_put_bytes(JSONStringBuffer *buffer,
+                                 const unsigned char *data,
+                                 size_t data_len)
+{
+        int err;
+
+        /* Enlarge buffer if necessary */
+
+        if (buffer->buffer_len + data_len > buffer->buffer_allocated) {
+                err = json_string_buffer_enlarge(buffer,
+                                                 buffer->buffer_len
+                                                 + data_len);
+
+                if (err < 0) {
+                        return err;
+                }
+        }
+
+        memcpy(buffer->buffer + buffer->buffer_len, data, data_len);
+        buffer->buffer_len += data_len;
+
+        return JSON_ERROR_SUCCESS;
+}
+
@@ -28,6 +28,8 @@ extern "C" {
 
 #include <stdlib.h>
 
+#include "allocator.h"
+
 typedef struct _JSONStringBuffer JSONStringBuffer;
 
 struct _JSONStringBuffer {
@@ -43,15 +45,27 @@ struct _JSONStringBuffer {
         /** Allocated size */
 
         size_t buffer_allocated;
+
+        /** Maximum size the buffer may grow to, or zero for no limit */
+
+        size_t max_size;
+
+        /** Allocator used to allocate the buffer */
+
+        const JSONAllocator *allocator;
 };
 
 /**
  * Initialise a @ref JSONStringBuffer.
  *
  * @param buffer            Pointer to the buffer structure to initialise.
+ * @param allocator         Allocator to allocate memory from.  The 
+ *                          pointer must remain valid until the buffer
+ *                          is freed.
  */
 
-void json_string_buffer_init(JSONStringBuffer *buffer);
+void json_string_buffer_init(JSONStringBuffer *buffer,
+                             const JSONAllocator *allocator);
 
 /** 
  * Free all resources used by a @ref JSONStringBuffer.
@@ -80,6 +94,29 @@ unsigned char *json_string_buffer_get(JSONStringBuffer *buffer);
 
 void json_string_buffer_reset(JSONStringBuffer *buffer);
 
+/**
+ * Set the maximum size that a buffer may grow to.  Attempts to add
+ * data beyond the limit fail with @ref JSON_ERROR_TOO_LONG.
+ *
+ * @param buffer            Pointer to the buffer.
+ * @param max_size          Maximum size in bytes, or zero for no limit.
+ */
+
+void json_string_buffer_set_max_size(JSONStringBuffer *buffer,
+                                     size_t max_size);
+
+/**
+ * Ensure that a buffer has space for at least the specified number of
+ * further bytes, so that they can be added without the buffer having
+ * to be reallocated.
+ *
+ * @param buffer            Pointer to the buffer.
+ * @param size              Number of bytes to reserve space for.
+ * @return                  Zero if successful, or non-zero error code.
+ */
+
+int json_string_buffer_reserve(JSONStringBuffer *buffer, size_t size);
+
 /**
  * Add a unicode character to a buffer.
  *
@@ -90,6 +127,20 @@ void json_string_buffer_reset(JSONStringBuffer *buffer);
 
 int json_string_buffer_put_char(JSONStringBuffer *buffer, int c);
 
+/**
+ * Add a block of bytes to a buffer.  The bytes are copied as-is, so
+ * must already be encoded in UTF-8 format.
+ *
+ * @param buffer            Pointer to the buffer.
+ * @param data              Pointer to the data to add.
+ * @param data_len          Length of the data, in bytes.
+ * @return                  Zero if successful, or non-zero error code.
+ */
+
+int json_string_buffer_put_bytes(JSONStringBuffer *buffer,
+                                 const unsigned char *data,
+                                 size_t data_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,285 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "string-scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Scalar implementation, one byte at a time. */
+
+static size_t json_string_scan_scalar(const unsigned char *data,
+                                      size_t data_len)
+{
+        size_t i;
+
+        for (i=0; i<data_len; ++i) {
+                if (data[i] == '\"' || data[i] == '\\'
+                 || data[i] < 0x20 || data[i] >= 0x80) {
+                        break;
+                }
+        }
+
+        return i;
+}
+
+/* Scalar implementation for trusted data, where non-ASCII bytes do
+ * not stop the scan. */
+
+static size_t json_string_scan_trusted_scalar(const unsigned char *data,
+                                              size_t data_len)
+{
+        size_t i;
+
+        for (i=0; i<data_len; ++i) {
+                if (data[i] == '\"' || data[i] == '\\' || data[i] < 0x20) {
+                        break;
+                }
+        }
+
+        return i;
+}
+
+#ifdef JSON_HAVE_X86_SIMD
+
+/* SSE2 implementation, 16 bytes at a time.  A signed comparison 
+ * against 0x20 catches both control characters and non-ASCII bytes
+ * (which are negative when treated as signed). */
+
+__attribute__((target("sse2")))
+static size_t json_string_scan_sse2(const unsigned char *data,
+                                    size_t data_len)
+{
+        const __m128i quote = _mm_set1_epi8('\"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i space = _mm_set1_epi8(0x20);
+        __m128i v, special;
+        unsigned int mask;
+        size_t i;
+
+        for (i=0; i + 16 <= data_len; i += 16) {
+                v = _mm_loadu_si128((const __m128i *) (data + i));
+                special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                       _mm_cmpeq_epi8(v, backslash));
+                special = _mm_or_si128(special, _mm_cmplt_epi8(v, space));
+                mask = _mm_movemask_epi8(special);
+
+                if (mask != 0) {
+                        return i + __builtin_ctz(mask);
+                }
+        }
+
+        return i + json_string_scan_scalar(data + i, data_len - i);
+}
+
+/* SSE2 implementation for trusted data.  There is no unsigned 
+ * comparison, so control characters are found as the bytes that are 
+ * unchanged by taking the unsigned minimum with 0x1f. */
+
+__attribute__((target("sse2")))
+static size_t json_string_scan_trusted_sse2(const unsigned char *data,
+                                            size_t data_len)
+{
+        const __m128i quote = _mm_set1_epi8('\"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1f);
+        __m128i v, special;
+        unsigned int mask;
+        size_t i;
+
+        for (i=0; i + 16 <= data_len; i += 16) {
+                v = _mm_loadu_si128((const __m128i *) (data + i));
+                special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                       _mm_cmpeq_epi8(v, backslash));
+                special = _mm_or_si128(special,
+                                       _mm_cmpeq_epi8(_mm_min_epu8(v, control),
+                                                      v));
+                mask = _mm_movemask_epi8(special);
+
+                if (mask != 0) {
+                        return i + __builtin_ctz(mask);
+                }
+        }
+
+        return i + json_string_scan_trusted_scalar(data + i, data_len - i);
+}
+
+/* AVX2 implementation, 32 bytes at a time. */
+
+__attribute__((target("avx2")))
+static size_t json_string_scan_avx2(const unsigned char *data,
+                                    size_t data_len)
+{
+        const __m256i quote = _mm256_set1_epi8('\"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i space = _mm256_set1_epi8(0x20);
+        __m256i v, special;
+        unsigned int mask;
+        size_t i;
+
+        for (i=0; i + 32 <= data_len; i += 32) {
+                v = _mm256_loadu_si256((const __m256i *) (data + i));
+                special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                          _mm256_cmpeq_epi8(v, backslash));
+                special = _mm256_or_si256(special,
+                                          _mm256_cmpgt_epi8(space, v));
+                mask = _mm256_movemask_epi8(special);
+
+                if (mask != 0) {
+                        return i + __builtin_ctz(mask);
+                }
+        }
+
+        return i + json_string_scan_sse2(data + i, data_len - i);
+}
+
+/* AVX2 implementation for trusted data. */
+
+__attribute__((target("avx2")))
+static size_t json_string_scan_trusted_avx2(const unsigned char *data,
+                                            size_t data_len)
+{
+        const __m256i quote = _mm256_set1_epi8('\"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i control = _mm256_set1_epi8(0x1f);
+        __m256i v, special;
+        unsigned int mask;
+        size_t i;
+
+        for (i=0; i + 32 <= data_len; i += 32) {
+                v = _mm256_loadu_si256((const __m256i *) (data + i));
+                special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                          _mm256_cmpeq_epi8(v, backslash));
+                special = _mm256_or_si256(special,
+                                          _mm256_cmpeq_epi8(
+                                                _mm256_min_epu8(v, control),
+                                                v));
+                mask = _mm256_movemask_epi8(special);
+
+                if (mask != 0) {
+                        return i + __builtin_ctz(mask);
+                }
+        }
+
+        return i + json_string_scan_trusted_sse2(data + i, data_len - i);
+}
+
+#endif /* #ifdef JSON_HAVE_X86_SIMD */
+
+JSONStringScanFunc json_string_scan_get_impl(const char *name)
+{
+        if (!strcmp(name, "scalar")) {
+                return json_string_scan_scalar;
+        }
+
+#ifdef JSON_HAVE_X86_SIMD
+        __builtin_cpu_init();
+
+        if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+                return json_string_scan_sse2;
+        }
+
+        if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+                return json_string_scan_avx2;
+        }
+#endif
+
+        return NULL;
+}
+
+JSONStringScanFunc json_string_scan_trusted_get_impl(const char *name)
+{
+        if (!strcmp(name, "scalar")) {
+                return json_string_scan_trusted_scalar;
+        }
+
+#ifdef JSON_HAVE_X86_SIMD
+        __builtin_cpu_init();
+
+        if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+                return json_string_scan_trusted_sse2;
+        }
+
+        if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+                return json_string_scan_trusted_avx2;
+        }
+#endif
+
+        return NULL;
+}
+
+/* Select the fastest implementation supported by the CPU, using the
+ * given lookup function, and save it to the given pointer if one has
+ * not been selected already.  The pointer is accessed atomically since
+ * the scanners may be used from several threads. */
+
+static JSONStringScanFunc select_impl(JSONStringScanFunc *func_ptr,
+                                      JSONStringScanFunc (*get_impl)(
+                                              const char *name))
+{
+        JSONStringScanFunc func;
+
+        func = __atomic_load_n(func_ptr, __ATOMIC_ACQUIRE);
+
+        if (func == NULL) {
+                func = get_impl("avx2");
+
+                if (func == NULL) {
+                        func = get_impl("sse2");
+                }
+
+                if (func == NULL) {
+                        func = get_impl("scalar");
+                }
+
+                __atomic_store_n(func_ptr, func, __ATOMIC_RELEASE);
+        }
+
+        return func;
+}
+
+/* Scanner implementations to use.  These are selected on first use. */
+
+static JSONStringScanFunc scan_func = NULL;
+static JSONStringScanFunc trusted_scan_func = NULL;
+
+size_t json_string_scan(const unsigned char *data, size_t data_len)
+{
+        JSONStringScanFunc func;
+
+        func = select_impl(&scan_func, json_string_scan_get_impl);
+
+        return func(data, data_len);
+}
+
+size_t json_string_scan_trusted(const unsigned char *data, size_t data_len)
+{
+        JSONStringScanFunc func;
+
+        func = select_impl(&trusted_scan_func,
+                           json_string_scan_trusted_get_impl);
+
+        return func(data, data_len);
+}
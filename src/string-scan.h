@@ -0,0 +1,105 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_STRING_SCAN_H
+#define JIGSAWN_INTERNAL_STRING_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+/*
+ * Scanner used to find the end of a run of ordinary characters within
+ * a string.  Vectorized implementations are used where the CPU 
+ * supports them.
+ */
+
+/**
+ * Function pointer type for a string scanner implementation.
+ *
+ * @param data             Pointer to the data to scan.
+ * @param data_len         Length of the data, in bytes.
+ * @return                 Offset of the first byte that is a quote,
+ *                         backslash, control character (below 0x20) 
+ *                         or non-ASCII byte (0x80 and above), or 
+ *                         data_len if there is no such byte.
+ */
+
+typedef size_t (*JSONStringScanFunc)(const unsigned char *data,
+                                     size_t data_len);
+
+/**
+ * Find the first byte in a block of data that is a quote, backslash,
+ * control character or non-ASCII byte, using the fastest scanner 
+ * implementation supported by the CPU.
+ *
+ * @param data             Pointer to the data to scan.
+ * @param data_len         Length of the data, in bytes.
+ * @return                 Offset of the first such byte, or data_len
+ *                         if there is no such byte.
+ */
+
+size_t json_string_scan(const unsigned char *data, size_t data_len);
+
+/**
+ * Find the first byte in a block of data that is a quote, backslash or
+ * control character.  The data must already have been validated as 
+ * UTF-8, so that non-ASCII bytes need not stop the scan.
+ *
+ * @param data             Pointer to the data to scan.
+ * @param data_len         Length of the data, in bytes.
+ * @return                 Offset of the first such byte, or data_len
+ *                         if there is no such byte.
+ */
+
+size_t json_string_scan_trusted(const unsigned char *data, size_t data_len);
+
+/**
+ * Look up a string scanner implementation by name.  This is used for
+ * testing and benchmarking.
+ *
+ * @param name             Name of the implementation: "scalar", 
+ *                         "sse2" or "avx2".
+ * @return                 The implementation, or NULL if it is not
+ *                         compiled in or not supported by the CPU.
+ */
+
+JSONStringScanFunc json_string_scan_get_impl(const char *name);
+
+/**
+ * Look up an implementation of @ref json_string_scan_trusted by name.
+ *
+ * @param name             Name of the implementation: "scalar", 
+ *                         "sse2" or "avx2".
+ * @return                 The implementation, or NULL if it is not
+ *                         compiled in or not supported by the CPU.
+ */
+
+JSONStringScanFunc json_string_scan_trusted_get_impl(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_STRING_SCAN_H */
+
@@ -0,0 +1,853 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "jigsawn/error.h"
+
+#include "structural-index.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define JSON_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* The document is indexed in chunks of this size, making sure before
+ * each chunk that the positions array has space for every character
+ * in it.  This must be a multiple of the 64 byte block size. */
+
+#define INDEX_CHUNK_SIZE      (64 * 1024)
+
+/* Documents smaller than this are always indexed by a single thread. 
+ */
+
+#define PARALLEL_MIN_CHUNK    (1024 * 1024)
+
+#define EVEN_BITS             0x5555555555555555ULL
+#define ODD_BITS              0xaaaaaaaaaaaaaaaaULL
+
+/* Bitmasks of the characters in a 64 byte block: bit n is set if
+ * byte n is one of the characters. */
+
+typedef struct {
+        uint64_t backslash;
+        uint64_t quote;
+        uint64_t punctuation;
+        uint64_t whitespace;
+} JSONStructuralMasks;
+
+void json_structural_state_init(JSONStructuralState *state)
+{
+        state->in_string = 0;
+        state->escaped = 0;
+
+        /* The start of the document can start a token. */
+
+        state->follows_separator = 1;
+}
+
+/* Get a pointer to the 64 byte block at the specified offset in the
+ * data.  If there are less than 64 bytes left, they are copied into
+ * the buffer, padded with whitespace. */
+
+static const unsigned char *json_structural_block(const unsigned char *data,
+                                                  size_t data_len,
+                                                  size_t offset,
+                                                  unsigned char *buffer)
+{
+        if (data_len - offset >= 64) {
+                return data + offset;
+        }
+
+        memset(buffer, ' ', 64);
+        memcpy(buffer, data + offset, data_len - offset);
+
+        return buffer;
+}
+
+/* Find the characters that are escaped: those that follow an
+ * odd-length run of backslashes.  Runs are found by adding the start
+ * of each run to the run, so that the carry ends up on the character
+ * after it; whether the run is of odd length then depends on whether
+ * it started on an odd or even bit. */
+
+static uint64_t json_structural_escaped(JSONStructuralState *state,
+                                        uint64_t backslash)
+{
+        uint64_t start_edges;
+        uint64_t even_start_mask;
+        uint64_t even_starts, odd_starts;
+        uint64_t even_carries, odd_carries;
+        uint64_t even_start_odd_end, odd_start_even_end;
+        uint64_t ends_odd;
+
+        start_edges = backslash & ~(backslash << 1);
+
+        /* If the last block ended with an odd-length run, a run at the
+         * start of this block continues it, so its sense is flipped. */
+
+        even_start_mask = EVEN_BITS ^ state->escaped;
+        even_starts = start_edges & even_start_mask;
+        odd_starts = start_edges & ~even_start_mask;
+
+        even_carries = backslash + even_starts;
+        odd_carries = backslash + odd_starts;
+
+        /* A carry out of the top bit means the block ends with an
+         * odd-length run. */
+
+        ends_odd = odd_carries < backslash;
+
+        odd_carries |= state->escaped;
+        state->escaped = ends_odd;
+
+        even_start_odd_end = even_carries & ~backslash & ODD_BITS;
+        odd_start_even_end = odd_carries & ~backslash & EVEN_BITS;
+
+        return even_start_odd_end | odd_start_even_end;
+}
+
+/* Finish processing a block, given the mask of the characters inside
+ * strings: the positions of characters that can start a token are
+ * stored after the specified number already stored, and the number 
+ * found is returned.  If positions is NULL, they are only counted. */
+
+static size_t json_structural_finish(JSONStructuralState *state,
+                                     const JSONStructuralMasks *masks,
+                                     uint64_t quotes,
+                                     uint64_t in_string,
+                                     size_t offset,
+                                     size_t *positions,
+                                     size_t num_positions)
+{
+        uint64_t structural;
+        uint64_t separators;
+        uint64_t starts;
+        size_t result;
+
+        state->in_string = (uint64_t) ((int64_t) in_string >> 63);
+
+        /* Punctuation inside strings is ignored.  The mask of
+         * characters inside strings includes the opening quote but not
+         * the closing quote. */
+
+        structural = (masks->punctuation & ~in_string) | quotes;
+
+        /* Other characters outside strings start a token if they
+         * follow whitespace, punctuation or a quote.  Closing quotes
+         * are included too, so that the index gives the end of each
+         * string as well as its start. */
+
+        separators = structural | masks->whitespace;
+        starts = (separators << 1) | state->follows_separator;
+        starts &= ~masks->whitespace & ~in_string;
+        state->follows_separator = separators >> 63;
+
+        structural |= starts;
+
+        if (positions == NULL) {
+                return __builtin_popcountll(structural);
+        }
+
+        result = 0;
+
+        while (structural != 0) {
+                positions[num_positions + result] =
+                        offset + __builtin_ctzll(structural);
+                ++result;
+                structural &= structural - 1;
+        }
+
+        return result;
+}
+
+/* Scalar implementation: the masks are built a byte at a time, and
+ * the prefix XOR is done with shifts. */
+
+static void json_structural_masks_scalar(const unsigned char *block,
+                                         JSONStructuralMasks *masks)
+{
+        uint64_t bit;
+        int i;
+
+        memset(masks, 0, sizeof(JSONStructuralMasks));
+
+        for (i=0; i<64; ++i) {
+                bit = 1ULL << i;
+
+                switch (block[i]) {
+                        case '\\':
+                                masks->backslash |= bit;
+                                break;
+                        case '"':
+                                masks->quote |= bit;
+                                break;
+                        case '[': case ']': case '{': case '}':
+                        case ':': case ',':
+                                masks->punctuation |= bit;
+                                break;
+                        case ' ': case '\t': case '\r': case '\n':
+                                masks->whitespace |= bit;
+                                break;
+                        default:
+                                break;
+                }
+        }
+}
+
+static uint64_t json_structural_prefix_xor_scalar(uint64_t bits)
+{
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+
+        return bits;
+}
+
+static size_t json_structural_scan_scalar(const unsigned char *data,
+                                          size_t data_len,
+                                          size_t offset,
+                                          JSONStructuralState *state,
+                                          size_t *positions)
+{
+        const unsigned char *block;
+        unsigned char buffer[64];
+        JSONStructuralMasks masks;
+        uint64_t quotes, in_string;
+        size_t result;
+        size_t i;
+
+        result = 0;
+
+        for (i=0; i<data_len; i += 64) {
+                block = json_structural_block(data, data_len, i, buffer);
+                json_structural_masks_scalar(block, &masks);
+
+                quotes = masks.quote
+                       & ~json_structural_escaped(state, masks.backslash);
+                in_string = json_structural_prefix_xor_scalar(quotes)
+                          ^ state->in_string;
+
+                result += json_structural_finish(state, &masks, quotes,
+                                                 in_string, offset + i,
+                                                 positions, result);
+        }
+
+        return result;
+}
+
+#ifdef JSON_HAVE_X86_SIMD
+
+/* The prefix XOR is a carry-less multiply by a value with all bits
+ * set: each bit of the result is the XOR of the bits at and below it.
+ */
+
+__attribute__((target("sse2,pclmul")))
+static uint64_t json_structural_prefix_xor_clmul(uint64_t bits)
+{
+        __m128i result;
+
+        result = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long) bits),
+                                      _mm_set1_epi8((char) 0xff), 0);
+
+        return (uint64_t) _mm_cvtsi128_si64(result);
+}
+
+/* The vectorized implementations compare against each character.
+ * Setting bit 5 of each byte maps '[' and ']' onto '{' and '}', so
+ * that they need one comparison each. */
+
+__attribute__((target("sse2,pclmul")))
+static void json_structural_masks_sse2(const unsigned char *block,
+                                       JSONStructuralMasks *masks)
+{
+        __m128i input, folded, punctuation, whitespace;
+        int i;
+
+        memset(masks, 0, sizeof(JSONStructuralMasks));
+
+        for (i=0; i<4; ++i) {
+                input = _mm_loadu_si128((const __m128i *) (block + i * 16));
+                folded = _mm_or_si128(input, _mm_set1_epi8(0x20));
+
+                punctuation = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                 _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(input, _mm_set1_epi8(':')),
+                                 _mm_cmpeq_epi8(input, _mm_set1_epi8(','))));
+                whitespace = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(input, _mm_set1_epi8(' ')),
+                                 _mm_cmpeq_epi8(input, _mm_set1_epi8('\t'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(input, _mm_set1_epi8('\r')),
+                                 _mm_cmpeq_epi8(input, _mm_set1_epi8('\n'))));
+
+                masks->backslash |= (uint64_t) _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(input, _mm_set1_epi8('\\'))) << (i * 16);
+                masks->quote |= (uint64_t) _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(input, _mm_set1_epi8('"'))) << (i * 16);
+                masks->punctuation |= (uint64_t) _mm_movemask_epi8(
+                    punctuation) << (i * 16);
+                masks->whitespace |= (uint64_t) _mm_movemask_epi8(
+                    whitespace) << (i * 16);
+        }
+}
+
+__attribute__((target("sse2,pclmul")))
+static size_t json_structural_scan_sse2(const unsigned char *data,
+                                        size_t data_len,
+                                        size_t offset,
+                                        JSONStructuralState *state,
+                                        size_t *positions)
+{
+        const unsigned char *block;
+        unsigned char buffer[64];
+        JSONStructuralMasks masks;
+        uint64_t quotes, in_string;
+        size_t result;
+        size_t i;
+
+        result = 0;
+
+        for (i=0; i<data_len; i += 64) {
+                block = json_structural_block(data, data_len, i, buffer);
+                json_structural_masks_sse2(block, &masks);
+
+                quotes = masks.quote
+                       & ~json_structural_escaped(state, masks.backslash);
+                in_string = json_structural_prefix_xor_clmul(quotes)
+                          ^ state->in_string;
+
+                result += json_structural_finish(state, &masks, quotes,
+                                                 in_string, offset + i,
+                                                 positions, result);
+        }
+
+        return result;
+}
+
+__attribute__((target("avx2,pclmul")))
+static uint64_t json_structural_movemask_avx2(__m256i lo, __m256i hi)
+{
+        return (uint64_t) (uint32_t) _mm256_movemask_epi8(lo)
+             | ((uint64_t) (uint32_t) _mm256_movemask_epi8(hi) << 32);
+}
+
+__attribute__((target("avx2,pclmul")))
+static void json_structural_masks_avx2(const unsigned char *block,
+                                       JSONStructuralMasks *masks)
+{
+        __m256i input[2], folded, punctuation[2], whitespace[2];
+        __m256i backslash[2], quote[2];
+        int i;
+
+        for (i=0; i<2; ++i) {
+                input[i] = _mm256_loadu_si256((const __m256i *)
+                                              (block + i * 32));
+                folded = _mm256_or_si256(input[i], _mm256_set1_epi8(0x20));
+
+                backslash[i] = _mm256_cmpeq_epi8(input[i],
+                                                 _mm256_set1_epi8('\\'));
+                quote[i] = _mm256_cmpeq_epi8(input[i],
+                                             _mm256_set1_epi8('"'));
+                punctuation[i] = _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                        _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                    _mm256_or_si256(
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8(':')),
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8(','))));
+                whitespace[i] = _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8('\t'))),
+                    _mm256_or_si256(
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8('\r')),
+                        _mm256_cmpeq_epi8(input[i], _mm256_set1_epi8('\n'))));
+        }
+
+        masks->backslash = json_structural_movemask_avx2(backslash[0],
+                                                         backslash[1]);
+        masks->quote = json_structural_movemask_avx2(quote[0], quote[1]);
+        masks->punctuation = json_structural_movemask_avx2(punctuation[0],
+                                                           punctuation[1]);
+        masks->whitespace = json_structural_movemask_avx2(whitespace[0],
+                                                          whitespace[1]);
+}
+
+__attribute__((target("avx2,pclmul")))
+static size_t json_structural_scan_avx2(const unsigned char *data,
+                                        size_t data_len,
+                                        size_t offset,
+                                        JSONStructuralState *state,
+                                        size_t *positions)
+{
+        const unsigned char *block;
+        unsigned char buffer[64];
+        JSONStructuralMasks masks;
+        uint64_t quotes, in_string;
+        size_t result;
+        size_t i;
+
+        result = 0;
+
+        for (i=0; i<data_len; i += 64) {
+                block = json_structural_block(data, data_len, i, buffer);
+                json_structural_masks_avx2(block, &masks);
+
+                quotes = masks.quote
+                       & ~json_structural_escaped(state, masks.backslash);
+                in_string = json_structural_prefix_xor_clmul(quotes)
+                          ^ state->in_string;
+
+                result += json_structural_finish(state, &masks, quotes,
+                                                 in_string, offset + i,
+                                                 positions, result);
+        }
+
+        return result;
+}
+
+#endif /* #ifdef JSON_HAVE_X86_SIMD */
+
+JSONStructuralScanFunc json_structural_scan_get_impl(const char *name)
+{
+        if (!strcmp(name, "scalar")) {
+                return json_structural_scan_scalar;
+        }
+
+#ifdef JSON_HAVE_X86_SIMD
+        __builtin_cpu_init();
+
+        if (!__builtin_cpu_supports("pclmul")) {
+                return NULL;
+        }
+
+        if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+                return json_structural_scan_sse2;
+        }
+
+        if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+                return json_structural_scan_avx2;
+        }
+#endif
+
+        return NULL;
+}
+
+/* Scan implementation to use.  This is selected on first use, and
+ * accessed atomically since parsers may be used from several threads. */
+
+static JSONStructuralScanFunc scan_func = NULL;
+
+void json_structural_index_init(JSONStructuralIndex *index,
+                                const JSONAllocator *allocator)
+{
+        index->positions = NULL;
+        index->num_positions = 0;
+        index->positions_size = 0;
+        index->allocator = allocator;
+}
+
+void json_structural_index_free(JSONStructuralIndex *index)
+{
+        json_allocator_free(index->allocator, index->positions);
+}
+
+/* Make sure that there is space in the positions array for the
+ * specified number of positions to be added.  Returns zero for
+ * success, or negative error code. */
+
+static int json_structural_index_reserve(JSONStructuralIndex *index,
+                                         size_t count)
+{
+        size_t *new_positions;
+        size_t new_size;
+
+        if (index->num_positions + count <= index->positions_size) {
+                return JSON_ERROR_SUCCESS;
+        }
+
+        new_size = index->positions_size * 2;
+
+        if (new_size < index->num_positions + count) {
+                new_size = index->num_positions + count;
+        }
+
+        new_positions = json_allocator_realloc(index->allocator,
+                                               index->positions,
+                                               new_size * sizeof(size_t));
+
+        if (new_positions == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        index->positions = new_positions;
+        index->positions_size = new_size;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Select the scan implementation to use, if it has not been already.
+ * Returns the implementation. */
+
+static JSONStructuralScanFunc json_structural_select_impl(void)
+{
+        JSONStructuralScanFunc func;
+
+        func = __atomic_load_n(&scan_func, __ATOMIC_ACQUIRE);
+
+        if (func == NULL) {
+                func = json_structural_scan_get_impl("avx2");
+
+                if (func == NULL) {
+                        func = json_structural_scan_get_impl("sse2");
+                }
+
+                if (func == NULL) {
+                        func = json_structural_scan_scalar;
+                }
+
+                __atomic_store_n(&scan_func, func, __ATOMIC_RELEASE);
+        }
+
+        return func;
+}
+
+/* Scan data, adding the positions found to the index.  Returns zero
+ * for success, or negative error code. */
+
+static int json_structural_index_scan(JSONStructuralIndex *index,
+                                      const unsigned char *data,
+                                      size_t data_len,
+                                      size_t offset,
+                                      JSONStructuralState *state)
+{
+        JSONStructuralScanFunc func;
+        size_t chunk_len;
+        size_t i;
+        int err;
+
+        func = json_structural_select_impl();
+
+        for (i=0; i<data_len; i += chunk_len) {
+                chunk_len = data_len - i;
+
+                if (chunk_len > INDEX_CHUNK_SIZE) {
+                        chunk_len = INDEX_CHUNK_SIZE;
+                }
+
+                err = json_structural_index_reserve(index, chunk_len);
+
+                if (err < 0) {
+                        return err;
+                }
+
+                index->num_positions += func(data + i, chunk_len,
+                                             offset + i, state,
+                                             index->positions
+                                               + index->num_positions);
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+int json_structural_index_build(JSONStructuralIndex *index,
+                                const unsigned char *data,
+                                size_t data_len)
+{
+        JSONStructuralState state;
+
+        json_structural_state_init(&state);
+        index->num_positions = 0;
+
+        return json_structural_index_scan(index, data, data_len, 0, &state);
+}
+
+/*
+ * Building the index with several threads.  The document is split 
+ * into one chunk per thread, and each chunk is scanned twice:
+ *
+ * The state at the start of a chunk depends on the data before it.
+ * Whether a quote is escaped, and whether a character can start a 
+ * token, depend only on the few characters before it, which are 
+ * looked at directly.  Whether the chunk starts inside a string 
+ * depends on the number of quotes before it.  In the first pass, 
+ * each thread counts the positions in its chunk without storing them,
+ * both for if the chunk starts inside a string and for if it does 
+ * not, and finds whether the number of quotes in the chunk is odd.
+ * Each chunk then starts inside a string if an odd number of the 
+ * chunks before it did, which gives the number of positions in each
+ * chunk, and so where the positions for each chunk start in the 
+ * index.  In the second pass, each thread stores the positions in its
+ * chunk directly into the index.
+ */
+
+typedef struct {
+
+        /** Start and length of the chunk. */
+
+        size_t start;
+        size_t len;
+
+        /** Scan implementation to use. */
+
+        JSONStructuralScanFunc scan;
+
+        /** State at the start of the chunk. */
+
+        JSONStructuralState state;
+
+        /** 
+         * All bits set if there is an odd number of quotes in the chunk.
+         */
+
+        uint64_t odd_quotes;
+
+        /** 
+         * Number of positions in the chunk if it starts outside a 
+         * string, and if it starts inside one.
+         */
+
+        size_t count_outside;
+        size_t count_inside;
+
+        const unsigned char *data;
+
+        /** Where to store the positions in the second pass. */
+
+        size_t *positions;
+
+        /** Thread running the worker, if started is non-zero. */
+
+        pthread_t thread;
+        int started;
+} JSONStructuralWorker;
+
+/* Find the state at the start of a chunk from the characters before 
+ * it, except whether it starts inside a string. */
+
+static void json_structural_chunk_state(const unsigned char *data,
+                                        size_t start,
+                                        JSONStructuralState *state)
+{
+        size_t run;
+        int c;
+
+        json_structural_state_init(state);
+
+        if (start == 0) {
+                return;
+        }
+
+        /* The first character is escaped if the chunk follows an 
+         * odd-length run of backslashes. */
+
+        run = 0;
+
+        while (run < start && data[start - 1 - run] == '\\') {
+                ++run;
+        }
+
+        state->escaped = run % 2;
+
+        /* Punctuation inside a string is treated as a separator, but
+         * the character after it is then either inside the string, 
+         * which cannot start a token, or a closing quote, which is in
+         * the index anyway.  A quote is only a separator if it is not
+         * escaped. */
+
+        c = data[start - 1];
+
+        if (c == '"') {
+                run = 0;
+
+                while (run + 1 < start && data[start - 2 - run] == '\\') {
+                        ++run;
+                }
+
+                state->follows_separator = run % 2 == 0;
+        } else {
+                state->follows_separator = c != '\0'
+                                        && strchr(" \t\r\n[]{}:,", c) != NULL;
+        }
+}
+
+static void *json_structural_count_chunk(void *arg)
+{
+        JSONStructuralWorker *worker = arg;
+        JSONStructuralState state;
+
+        state = worker->state;
+        state.in_string = 0;
+        worker->count_outside = worker->scan(worker->data + worker->start,
+                                             worker->len, worker->start,
+                                             &state, NULL);
+        worker->odd_quotes = state.in_string;
+
+        state = worker->state;
+        state.in_string = ~(uint64_t) 0;
+        worker->count_inside = worker->scan(worker->data + worker->start,
+                                            worker->len, worker->start,
+                                            &state, NULL);
+
+        return NULL;
+}
+
+static void *json_structural_index_chunk(void *arg)
+{
+        JSONStructuralWorker *worker = arg;
+
+        worker->scan(worker->data + worker->start, worker->len,
+                     worker->start, &worker->state, worker->positions);
+
+        return NULL;
+}
+
+/* Run a function for each worker, with a thread for each one except
+ * the first, which runs in the calling thread.  If a thread cannot be
+ * started, the function is run in the calling thread instead. */
+
+static void json_structural_run_workers(JSONStructuralWorker *workers,
+                                        unsigned int num_workers,
+                                        void *(*func)(void *))
+{
+        unsigned int i;
+
+        for (i=1; i<num_workers; ++i) {
+                workers[i].started = pthread_create(&workers[i].thread, NULL,
+                                                    func, &workers[i]) == 0;
+        }
+
+        func(&workers[0]);
+
+        for (i=1; i<num_workers; ++i) {
+                if (workers[i].started) {
+                        pthread_join(workers[i].thread, NULL);
+                } else {
+                        func(&workers[i]);
+                }
+        }
+}
+
+int json_structural_index_build_parallel(JSONStructuralIndex *index,
+                                         const unsigned char *data,
+                                         size_t data_len,
+                                         unsigned int num_threads)
+{
+        JSONStructuralWorker *workers;
+        JSONStructuralScanFunc func;
+        size_t chunk_len;
+        size_t count;
+        uint64_t in_string;
+        unsigned int i;
+        int err;
+
+        if (num_threads <= 1) {
+                return json_structural_index_build(index, data, data_len);
+        }
+
+        /* Chunks are a multiple of the block size. */
+
+        chunk_len = (data_len / num_threads + 63) & ~(size_t) 63;
+
+        if (chunk_len < PARALLEL_MIN_CHUNK) {
+                return json_structural_index_build(index, data, data_len);
+        }
+
+        num_threads = (data_len + chunk_len - 1) / chunk_len;
+
+        workers = json_allocator_alloc(index->allocator,
+                                       num_threads
+                                         * sizeof(JSONStructuralWorker));
+
+        if (workers == NULL) {
+                return JSON_ERROR_OUT_OF_MEMORY;
+        }
+
+        func = json_structural_select_impl();
+
+        for (i=0; i<num_threads; ++i) {
+                workers[i].scan = func;
+                workers[i].data = data;
+                workers[i].start = i * chunk_len;
+                workers[i].len = data_len - workers[i].start;
+
+                if (workers[i].len > chunk_len) {
+                        workers[i].len = chunk_len;
+                }
+
+                json_structural_chunk_state(data, workers[i].start,
+                                            &workers[i].state);
+        }
+
+        /* First pass, then find the state at the start of each chunk,
+         * and the number of positions in it. */
+
+        json_structural_run_workers(workers, num_threads,
+                                    json_structural_count_chunk);
+
+        in_string = 0;
+        count = 0;
+
+        for (i=0; i<num_threads; ++i) {
+                workers[i].state.in_string = in_string;
+                in_string ^= workers[i].odd_quotes;
+
+                if (workers[i].state.in_string != 0) {
+                        count += workers[i].count_inside;
+                } else {
+                        count += workers[i].count_outside;
+                }
+        }
+
+        /* Second pass, storing the positions for each chunk after 
+         * those for the chunk before it. */
+
+        index->num_positions = 0;
+        err = json_structural_index_reserve(index, count);
+
+        if (err == JSON_ERROR_SUCCESS) {
+                count = 0;
+
+                for (i=0; i<num_threads; ++i) {
+                        workers[i].positions = index->positions + count;
+
+                        if (workers[i].state.in_string != 0) {
+                                count += workers[i].count_inside;
+                        } else {
+                                count += workers[i].count_outside;
+                        }
+                }
+
+                json_structural_run_workers(workers, num_threads,
+                                            json_structural_index_chunk);
+
+                index->num_positions = count;
+        }
+
+        json_allocator_free(index->allocator, workers);
+
+        return err;
+}
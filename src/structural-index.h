@@ -0,0 +1,205 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_STRUCTURAL_INDEX_H
+#define JIGSAWN_INTERNAL_STRUCTURAL_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+/*
+ * Structural index of a JSON document held in memory.  The document
+ * is scanned in blocks of 64 bytes, building bitmasks of the
+ * characters in each block: quotes that are not escaped, the
+ * characters inside strings (found with a prefix XOR of the quote
+ * mask, which vectorized implementations compute with a carry-less
+ * multiply), punctuation and whitespace.  From these, the positions
+ * are found of the characters that can start a token: punctuation and
+ * quotes outside of strings, and the first character of each run of
+ * other characters that follows whitespace, punctuation or a string
+ * (the start of a number or keyword).  The closing quote of each string
+ * is included too, so that the lexer can find where a string ends from
+ * the index.
+ */
+
+/**
+ * State carried from one block of the document to the next.
+ */
+
+typedef struct {
+
+        /** All bits set if the previous block ended inside a string. */
+
+        uint64_t in_string;
+
+        /**
+         * One if the previous block ended with an odd-length run of
+         * backslashes, which escapes the first character of the next
+         * block.
+         */
+
+        uint64_t escaped;
+
+        /**
+         * One if the last character of the previous block was
+         * whitespace, punctuation or a quote, so that a character at
+         * the start of the next block can start a token.
+         */
+
+        uint64_t follows_separator;
+} JSONStructuralState;
+
+/**
+ * Function pointer type for an implementation of the structural
+ * scan.
+ *
+ * @param data             Pointer to the data to scan.
+ * @param data_len         Length of the data, in bytes.  The data is
+ *                         scanned in blocks of 64 bytes; if the length
+ *                         is not a multiple of 64, the last block is
+ *                         padded with whitespace.
+ * @param offset           Offset of the data within the document,
+ *                         which is added to each position stored.
+ * @param state            State carried from the previous call, which
+ *                         is updated for the next.
+ * @param positions        Array in which to store the positions found,
+ *                         with space for at least data_len entries, or
+ *                         NULL to only count them.
+ * @return                 Number of positions found.
+ */
+
+typedef size_t (*JSONStructuralScanFunc)(const unsigned char *data,
+                                         size_t data_len,
+                                         size_t offset,
+                                         JSONStructuralState *state,
+                                         size_t *positions);
+
+/**
+ * Structural index of a document.
+ */
+
+typedef struct {
+
+        /** 
+         * Positions of the characters that can start a token, and of
+         * closing quotes.
+         */
+
+        size_t *positions;
+
+        /** Number of positions in the index. */
+
+        size_t num_positions;
+
+        /** Number of positions that there is space for. */
+
+        size_t positions_size;
+
+        /** Allocator used to allocate the positions array. */
+
+        const JSONAllocator *allocator;
+} JSONStructuralIndex;
+
+/**
+ * Initialise an empty @ref JSONStructuralIndex.
+ *
+ * @param index            Pointer to the structure to initialise.
+ * @param allocator        Allocator to allocate memory from.
+ */
+
+void json_structural_index_init(JSONStructuralIndex *index,
+                                const JSONAllocator *allocator);
+
+/**
+ * Build the structural index of a document, using the fastest
+ * implementation supported by the CPU.  Any positions already in the
+ * index are replaced.
+ *
+ * @param index            The index.
+ * @param data             Pointer to the document.
+ * @param data_len         Length of the document, in bytes.
+ * @return                 Zero if successful, or negative error code.
+ */
+
+int json_structural_index_build(JSONStructuralIndex *index,
+                                const unsigned char *data,
+                                size_t data_len);
+
+/**
+ * Build the structural index of a document using several threads, 
+ * each of which indexes part of the document.  The result is the same
+ * as for @ref json_structural_index_build.  Small documents are 
+ * indexed by the calling thread alone.
+ *
+ * @param index            The index.
+ * @param data             Pointer to the document.
+ * @param data_len         Length of the document, in bytes.
+ * @param num_threads      Number of threads to use, including the 
+ *                         calling thread.
+ * @return                 Zero if successful, or negative error code.
+ */
+
+int json_structural_index_build_parallel(JSONStructuralIndex *index,
+                                         const unsigned char *data,
+                                         size_t data_len,
+                                         unsigned int num_threads);
+
+/**
+ * Free the memory used by a @ref JSONStructuralIndex.
+ *
+ * @param index            The index.
+ */
+
+void json_structural_index_free(JSONStructuralIndex *index);
+
+/**
+ * Initialise a @ref JSONStructuralState for the start of a document.
+ *
+ * @param state            Pointer to the structure to initialise.
+ */
+
+void json_structural_state_init(JSONStructuralState *state);
+
+/**
+ * Look up a structural scan implementation by name.  This is used for
+ * testing and benchmarking.
+ *
+ * @param name             Name of the implementation: "scalar",
+ *                         "sse2" or "avx2" (the vectorized
+ *                         implementations also need the PCLMUL
+ *                         instruction).
+ * @return                 The implementation, or NULL if it is not
+ *                         compiled in or not supported by the CPU.
+ */
+
+JSONStructuralScanFunc json_structural_scan_get_impl(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_STRUCTURAL_INDEX_H */
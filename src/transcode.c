@@ -0,0 +1,325 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "jigsawn/error.h"
+
+#include "transcode.h"
+#include "utf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Read a UTF-16 or UTF-32 code unit. */
+
+static unsigned int json_transcode_read_unit(JSONInputEncoding encoding,
+                                             const unsigned char *p)
+{
+        switch (encoding) {
+                case JSON_ENCODING_16LE:
+                        return (p[1] << 8) | p[0];
+                case JSON_ENCODING_16BE:
+                        return (p[0] << 8) | p[1];
+                case JSON_ENCODING_32LE:
+                        return ((unsigned int) p[3] << 24)
+                             | (p[2] << 16)
+                             | (p[1] << 8)
+                             | p[0];
+                default:
+                        return ((unsigned int) p[0] << 24)
+                             | (p[1] << 16)
+                             | (p[2] << 8)
+                             | p[3];
+        }
+}
+
+/* Decode the character at the start of the input, storing its length
+ * in bytes.  Returns the character, JSON_ERROR_NEED_MORE if it is 
+ * incomplete, or JSON_ERROR_ENCODING if it is invalid. */
+
+static int json_transcode_decode(JSONInputEncoding encoding,
+                                 const unsigned char *in, size_t in_len,
+                                 size_t *char_len)
+{
+        unsigned int c, low;
+
+        if (encoding == JSON_ENCODING_32LE
+         || encoding == JSON_ENCODING_32BE) {
+                if (in_len < 4) {
+                        return JSON_ERROR_NEED_MORE;
+                }
+
+                c = json_transcode_read_unit(encoding, in);
+                *char_len = 4;
+
+                if (c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+                        return JSON_ERROR_ENCODING;
+                }
+
+                return c;
+        }
+
+        if (in_len < 2) {
+                return JSON_ERROR_NEED_MORE;
+        }
+
+        c = json_transcode_read_unit(encoding, in);
+        *char_len = 2;
+
+        if (c < 0xd800 || c > 0xdfff) {
+                return c;
+        }
+
+        /* A surrogate pair: a high surrogate followed by a low 
+         * surrogate.  Either one on its own is invalid. */
+
+        if (c >= 0xdc00) {
+                return JSON_ERROR_ENCODING;
+        }
+
+        if (in_len < 4) {
+                return JSON_ERROR_NEED_MORE;
+        }
+
+        low = json_transcode_read_unit(encoding, in + 2);
+
+        if (low < 0xdc00 || low > 0xdfff) {
+                return JSON_ERROR_ENCODING;
+        }
+
+        *char_len = 4;
+
+        return 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+}
+
+/* Convert characters one at a time, from the specified input and 
+ * output positions, until the input position reaches in_stop.  The
+ * positions are updated.  Returns zero for success (including when 
+ * stopping at an incomplete character), or negative error code. */
+
+static int json_transcode_chars(JSONInputEncoding encoding,
+                                const unsigned char *in, size_t in_len,
+                                size_t in_stop, size_t *in_pos,
+                                unsigned char *out, size_t out_len,
+                                size_t *out_pos)
+{
+        size_t i, o;
+        size_t char_len, seq_len;
+        int c;
+
+        i = *in_pos;
+        o = *out_pos;
+        c = 0;
+
+        while (i < in_stop && out_len - o >= 4) {
+                c = json_transcode_decode(encoding, in + i, in_len - i,
+                                          &char_len);
+
+                if (c < 0) {
+                        break;
+                }
+
+                if (c < 0x80) {
+                        out[o] = c;
+                        ++o;
+                } else {
+                        json_utf8_encode(c, out + o, &seq_len);
+                        o += seq_len;
+                }
+
+                i += char_len;
+        }
+
+        *in_pos = i;
+        *out_pos = o;
+
+        if (c == JSON_ERROR_ENCODING) {
+                return c;
+        }
+
+        return JSON_ERROR_SUCCESS;
+}
+
+/* Scalar implementation, one character at a time. */
+
+static int json_transcode_scalar(JSONInputEncoding encoding,
+                                 const unsigned char *in, size_t in_len,
+                                 size_t *in_used,
+                                 unsigned char *out, size_t out_len,
+                                 size_t *out_used)
+{
+        *in_used = 0;
+        *out_used = 0;
+
+        return json_transcode_chars(encoding, in, in_len, in_len, in_used,
+                                    out, out_len, out_used);
+}
+
+#ifdef JSON_HAVE_X86_SIMD
+
+/* SSE2 implementation.  Input is read 16 characters at a time; if all
+ * of them are ASCII, they are narrowed to bytes with saturating packs.
+ * Otherwise, the characters are converted one at a time. */
+
+__attribute__((target("sse2")))
+static int json_transcode_sse2(JSONInputEncoding encoding,
+                               const unsigned char *in, size_t in_len,
+                               size_t *in_used,
+                               unsigned char *out, size_t out_len,
+                               size_t *out_used)
+{
+        const __m128i zero = _mm_setzero_si128();
+        __m128i a, b, c, d, mask;
+        size_t unit_len, block_len;
+        size_t i, o, start;
+        int big_endian;
+        int err;
+
+        unit_len = encoding == JSON_ENCODING_16LE
+                || encoding == JSON_ENCODING_16BE ? 2 : 4;
+        big_endian = encoding == JSON_ENCODING_16BE
+                  || encoding == JSON_ENCODING_32BE;
+        block_len = 16 * unit_len;
+
+        /* Bits that must be zero in each (little endian) lane for the
+         * character to be ASCII. */
+
+        if (unit_len == 2) {
+                mask = _mm_set1_epi16(big_endian ? (short) 0x80ff
+                                                 : (short) 0xff80);
+        } else {
+                mask = _mm_set1_epi32(big_endian ? (int) 0x80ffffff
+                                                 : (int) 0xffffff80);
+        }
+
+        i = 0;
+        o = 0;
+
+        while (i + block_len <= in_len && out_len - o >= 16) {
+                a = _mm_loadu_si128((const __m128i *) (in + i));
+                b = _mm_loadu_si128((const __m128i *) (in + i + 16));
+
+                if (unit_len == 2) {
+                        c = _mm_and_si128(_mm_or_si128(a, b), mask);
+                } else {
+                        c = _mm_loadu_si128((const __m128i *) (in + i + 32));
+                        d = _mm_loadu_si128((const __m128i *) (in + i + 48));
+                        c = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b),
+                                                       _mm_or_si128(c, d)),
+                                          mask);
+                }
+
+                /* Not all ASCII?  Convert the characters in this block
+                 * one at a time. */
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(c, zero)) != 0xffff) {
+                        start = i;
+                        err = json_transcode_chars(encoding, in, in_len,
+                                                   start + block_len, &i,
+                                                   out, out_len, &o);
+
+                        /* Stopped early?  The rest is handled below. */
+
+                        if (err < 0 || i < start + block_len) {
+                                break;
+                        }
+
+                        continue;
+                }
+
+                if (unit_len == 2) {
+                        if (big_endian) {
+                                a = _mm_srli_epi16(a, 8);
+                                b = _mm_srli_epi16(b, 8);
+                        }
+
+                        a = _mm_packus_epi16(a, b);
+                } else {
+                        c = _mm_loadu_si128((const __m128i *) (in + i + 32));
+                        d = _mm_loadu_si128((const __m128i *) (in + i + 48));
+
+                        if (big_endian) {
+                                a = _mm_srli_epi32(a, 24);
+                                b = _mm_srli_epi32(b, 24);
+                                c = _mm_srli_epi32(c, 24);
+                                d = _mm_srli_epi32(d, 24);
+                        }
+
+                        a = _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                             _mm_packs_epi32(c, d));
+                }
+
+                _mm_storeu_si128((__m128i *) (out + o), a);
+                i += block_len;
+                o += 16;
+        }
+
+        *in_used = i;
+        *out_used = o;
+
+        return json_transcode_chars(encoding, in, in_len, in_len, in_used,
+                                    out, out_len, out_used);
+}
+
+#endif /* #ifdef JSON_HAVE_X86_SIMD */
+
+JSONTranscodeFunc json_transcode_get_impl(const char *name)
+{
+        if (!strcmp(name, "scalar")) {
+                return json_transcode_scalar;
+        }
+
+#ifdef JSON_HAVE_X86_SIMD
+        __builtin_cpu_init();
+
+        if (!strcmp(name, "sse2") && __builtin_cpu_supports("sse2")) {
+                return json_transcode_sse2;
+        }
+#endif
+
+        return NULL;
+}
+
+/* Transcoder implementation to use.  This is selected on first use. */
+
+static JSONTranscodeFunc transcode_func = NULL;
+
+int json_transcode_to_utf8(JSONInputEncoding encoding,
+                           const unsigned char *in, size_t in_len,
+                           size_t *in_used,
+                           unsigned char *out, size_t out_len,
+                           size_t *out_used)
+{
+        if (transcode_func == NULL) {
+                transcode_func = json_transcode_get_impl("sse2");
+
+                if (transcode_func == NULL) {
+                        transcode_func = json_transcode_scalar;
+                }
+        }
+
+        return transcode_func(encoding, in, in_len, in_used,
+                              out, out_len, out_used);
+}
+
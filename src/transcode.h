@@ -0,0 +1,101 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_TRANSCODE_H
+#define JIGSAWN_INTERNAL_TRANSCODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "jigsawn/parser.h"
+
+/*
+ * Conversion of UTF-16 and UTF-32 input to UTF-8 in blocks, so that
+ * the lexer only has to deal with UTF-8.  Vectorized implementations
+ * are used for runs of ASCII characters where the CPU supports them.
+ */
+
+/**
+ * Function pointer type for a transcoder implementation.  Complete
+ * characters are converted until the input ends, an invalid character
+ * is found, or there are fewer than four bytes of space left in the 
+ * output buffer.  A character that is incomplete at the end of the 
+ * input (including the high surrogate of a UTF-16 surrogate pair 
+ * without its low surrogate) is not converted.
+ *
+ * @param encoding         Encoding of the input: 
+ *                         @ref JSON_ENCODING_16LE, 
+ *                         @ref JSON_ENCODING_16BE,
+ *                         @ref JSON_ENCODING_32LE or 
+ *                         @ref JSON_ENCODING_32BE.
+ * @param in               Pointer to the input data.
+ * @param in_len           Length of the input data, in bytes.
+ * @param in_used          Pointer to a variable to store the number of
+ *                         bytes of input converted.
+ * @param out              Pointer to the output buffer.
+ * @param out_len          Size of the output buffer, in bytes.
+ * @param out_used         Pointer to a variable to store the number of
+ *                         bytes written to the output buffer.
+ * @return                 Zero for success, or 
+ *                         @ref JSON_ERROR_ENCODING if conversion 
+ *                         stopped at an invalid character: an unpaired
+ *                         surrogate, or a character beyond U+10FFFF.
+ */
+
+typedef int (*JSONTranscodeFunc)(JSONInputEncoding encoding,
+                                 const unsigned char *in, size_t in_len,
+                                 size_t *in_used,
+                                 unsigned char *out, size_t out_len,
+                                 size_t *out_used);
+
+/**
+ * Convert a block of UTF-16 or UTF-32 data to UTF-8, using the 
+ * fastest implementation supported by the CPU.  See 
+ * @ref JSONTranscodeFunc for details.
+ */
+
+int json_transcode_to_utf8(JSONInputEncoding encoding,
+                           const unsigned char *in, size_t in_len,
+                           size_t *in_used,
+                           unsigned char *out, size_t out_len,
+                           size_t *out_used);
+
+/**
+ * Look up a transcoder implementation by name.  This is used for
+ * testing and benchmarking.
+ *
+ * @param name             Name of the implementation: "scalar" or
+ *                         "sse2".
+ * @return                 The implementation, or NULL if it is not
+ *                         compiled in or not supported by the CPU.
+ */
+
+JSONTranscodeFunc json_transcode_get_impl(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_TRANSCODE_H */
+
@@ -0,0 +1,379 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <string.h>
+
+#include "utf8.h"
+#include "utf8-validate.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Scalar implementation, one sequence at a time. */
+
+static size_t json_utf8_validate_scalar(const unsigned char *data,
+                                        size_t data_len)
+{
+        size_t i;
+        int seq_length;
+
+        i = 0;
+
+        while (i < data_len) {
+                if (data[i] < 0x80) {
+                        ++i;
+                        continue;
+                }
+
+                seq_length = json_utf8_check_seq(data + i, data_len - i);
+
+                if (seq_length <= 0) {
+                        break;
+                }
+
+                i += seq_length;
+        }
+
+        return i;
+}
+
+#ifdef JSON_HAVE_X86_SIMD
+
+/* Find where scalar validation can be resumed from, when the vector
+ * loop stops at the specified offset.  The data before the end of the
+ * previous block is valid, but the sequence containing its last byte
+ * may not be complete; errors found in the current block can belong
+ * to that sequence, so it must be checked again. */
+
+static size_t json_utf8_resume_offset(const unsigned char *data,
+                                      size_t offset)
+{
+        size_t i;
+
+        for (i=1; i<=4 && i<=offset; ++i) {
+                if ((data[offset - i] & JSON_UTF8_SEQ_MASK)
+                      != JSON_UTF8_SEQ_BYTE) {
+                        return offset - i;
+                }
+        }
+
+        return offset;
+}
+
+/*
+ * The vectorized implementations use the lookup table algorithm of
+ * Keiser and Lemire ("Validating UTF-8 In Less Than One Instruction
+ * Per Byte", 2021).  Each pair of adjacent bytes is classified by 
+ * three table lookups, on the high and low nibbles of the first byte
+ * and the high nibble of the second; ANDing the results gives a set
+ * of error bits.  The one case that cannot be checked from a pair of
+ * bytes, two continuation bytes in a row, is checked against the
+ * bytes two and three places back.
+ *
+ * When a block has an error, or at the end of the data, validation
+ * continues with the scalar implementation from the start of the
+ * current sequence, to find the exact offset.
+ */
+
+#define TOO_SHORT       (1 << 0)  /* 11______ 0_______, 11______ 11______ */
+#define TOO_LONG        (1 << 1)  /* 0_______ 10______ */
+#define OVERLONG_3      (1 << 2)  /* 11100000 100_____ */
+#define TOO_LARGE       (1 << 3)  /* 11110100 1001____ etc. */
+#define SURROGATE       (1 << 4)  /* 11101101 101_____ */
+#define OVERLONG_2      (1 << 5)  /* 1100000_ 10______ */
+#define TOO_LARGE_1000  (1 << 6)  /* 11110101 1000____ etc. */
+#define OVERLONG_4      (1 << 6)  /* 11110000 1000____ */
+#define TWO_CONTS       (1 << 7)  /* 10______ 10______ */
+
+#define CARRY           (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* Indexed by the high nibble of the first byte. */
+
+#define BYTE_1_HIGH_TABLE                                                 \
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,                           \
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,                           \
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                       \
+        TOO_SHORT | OVERLONG_2,                                           \
+        TOO_SHORT,                                                        \
+        TOO_SHORT | OVERLONG_3 | SURROGATE,                               \
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+
+/* Indexed by the low nibble of the first byte. */
+
+#define BYTE_1_LOW_TABLE                                                  \
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,                     \
+        CARRY | OVERLONG_2,                                               \
+        CARRY,                                                            \
+        CARRY,                                                            \
+        CARRY | TOO_LARGE,                                                \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,                   \
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                               \
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+
+/* Indexed by the high nibble of the second byte. */
+
+#define BYTE_2_HIGH_TABLE                                                 \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,                       \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,                       \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3                    \
+                 | TOO_LARGE_1000 | OVERLONG_4,                           \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,       \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,        \
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,        \
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+/* SSE4 implementation, 16 bytes at a time. */
+
+__attribute__((target("sse4.1")))
+static __m128i json_utf8_check_sse4(__m128i input, __m128i prev_input)
+{
+        const __m128i byte_1_high_table = _mm_setr_epi8(BYTE_1_HIGH_TABLE);
+        const __m128i byte_1_low_table = _mm_setr_epi8(BYTE_1_LOW_TABLE);
+        const __m128i byte_2_high_table = _mm_setr_epi8(BYTE_2_HIGH_TABLE);
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        __m128i prev1, prev2, prev3;
+        __m128i special, must_be_cont;
+
+        prev1 = _mm_alignr_epi8(input, prev_input, 15);
+        prev2 = _mm_alignr_epi8(input, prev_input, 14);
+        prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+        special = _mm_and_si128(
+                _mm_shuffle_epi8(byte_1_high_table,
+                        _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                _mm_shuffle_epi8(byte_1_low_table,
+                        _mm_and_si128(prev1, nibble)));
+        special = _mm_and_si128(special,
+                _mm_shuffle_epi8(byte_2_high_table,
+                        _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+        /* The third byte of a 3 or 4 byte sequence, or the fourth byte
+         * of a 4 byte sequence, must be a continuation byte: the top
+         * bit is set by the subtraction only for those positions. */
+
+        must_be_cont = _mm_or_si128(
+                _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xe0 - 0x80))),
+                _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xf0 - 0x80))));
+        must_be_cont = _mm_and_si128(must_be_cont, _mm_set1_epi8((char) 0x80));
+
+        return _mm_xor_si128(must_be_cont, special);
+}
+
+/* Returns non-zero bytes where a sequence at the end of the block is
+ * incomplete. */
+
+__attribute__((target("sse4.1")))
+static __m128i json_utf8_incomplete_sse4(__m128i input)
+{
+        const __m128i max_value = _mm_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, (char) (0xf0 - 1),
+                (char) (0xe0 - 1), (char) (0xc0 - 1));
+
+        return _mm_subs_epu8(input, max_value);
+}
+
+__attribute__((target("sse4.1")))
+static size_t json_utf8_validate_sse4(const unsigned char *data,
+                                      size_t data_len)
+{
+        __m128i input, prev_input, prev_incomplete, error;
+        size_t i;
+
+        prev_input = _mm_setzero_si128();
+        prev_incomplete = _mm_setzero_si128();
+
+        for (i=0; i + 16 <= data_len; i += 16) {
+                input = _mm_loadu_si128((const __m128i *) (data + i));
+
+                /* Blocks of ASCII are only an error if the previous
+                 * block ended with an incomplete sequence. */
+
+                if (_mm_movemask_epi8(input) == 0) {
+                        error = prev_incomplete;
+                } else {
+                        error = json_utf8_check_sse4(input, prev_input);
+                        prev_incomplete = json_utf8_incomplete_sse4(input);
+                }
+
+                if (!_mm_testz_si128(error, error)) {
+                        break;
+                }
+
+                prev_input = input;
+        }
+
+        i = json_utf8_resume_offset(data, i);
+
+        return i + json_utf8_validate_scalar(data + i, data_len - i);
+}
+
+/* AVX2 implementation, 32 bytes at a time. */
+
+__attribute__((target("avx2")))
+static __m256i json_utf8_check_avx2(__m256i input, __m256i prev_input)
+{
+        const __m256i byte_1_high_table = _mm256_setr_epi8(
+                BYTE_1_HIGH_TABLE, BYTE_1_HIGH_TABLE);
+        const __m256i byte_1_low_table = _mm256_setr_epi8(
+                BYTE_1_LOW_TABLE, BYTE_1_LOW_TABLE);
+        const __m256i byte_2_high_table = _mm256_setr_epi8(
+                BYTE_2_HIGH_TABLE, BYTE_2_HIGH_TABLE);
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        __m256i shifted, prev1, prev2, prev3;
+        __m256i special, must_be_cont;
+
+        /* alignr works within each 128-bit lane, so the lanes must be
+         * lined up with the previous ones first. */
+
+        shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+        prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        prev2 = _mm256_alignr_epi8(input, shifted, 14);
+        prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+        special = _mm256_and_si256(
+                _mm256_shuffle_epi8(byte_1_high_table,
+                        _mm256_and_si256(_mm256_srli_epi16(prev1, 4),
+                                         nibble)),
+                _mm256_shuffle_epi8(byte_1_low_table,
+                        _mm256_and_si256(prev1, nibble)));
+        special = _mm256_and_si256(special,
+                _mm256_shuffle_epi8(byte_2_high_table,
+                        _mm256_and_si256(_mm256_srli_epi16(input, 4),
+                                         nibble)));
+
+        must_be_cont = _mm256_or_si256(
+                _mm256_subs_epu8(prev2,
+                                 _mm256_set1_epi8((char) (0xe0 - 0x80))),
+                _mm256_subs_epu8(prev3,
+                                 _mm256_set1_epi8((char) (0xf0 - 0x80))));
+        must_be_cont = _mm256_and_si256(must_be_cont,
+                                        _mm256_set1_epi8((char) 0x80));
+
+        return _mm256_xor_si256(must_be_cont, special);
+}
+
+__attribute__((target("avx2")))
+static __m256i json_utf8_incomplete_avx2(__m256i input)
+{
+        const __m256i max_value = _mm256_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, (char) (0xf0 - 1),
+                (char) (0xe0 - 1), (char) (0xc0 - 1));
+
+        return _mm256_subs_epu8(input, max_value);
+}
+
+__attribute__((target("avx2")))
+static size_t json_utf8_validate_avx2(const unsigned char *data,
+                                      size_t data_len)
+{
+        __m256i input, prev_input, prev_incomplete, error;
+        size_t i;
+
+        prev_input = _mm256_setzero_si256();
+        prev_incomplete = _mm256_setzero_si256();
+
+        for (i=0; i + 32 <= data_len; i += 32) {
+                input = _mm256_loadu_si256((const __m256i *) (data + i));
+
+                if (_mm256_movemask_epi8(input) == 0) {
+                        error = prev_incomplete;
+                } else {
+                        error = json_utf8_check_avx2(input, prev_input);
+                        prev_incomplete = json_utf8_incomplete_avx2(input);
+                }
+
+                if (!_mm256_testz_si256(error, error)) {
+                        break;
+                }
+
+                prev_input = input;
+        }
+
+        i = json_utf8_resume_offset(data, i);
+
+        return i + json_utf8_validate_scalar(data + i, data_len - i);
+}
+
+#endif /* #ifdef JSON_HAVE_X86_SIMD */
+
+JSONUTF8ValidateFunc json_utf8_validate_get_impl(const char *name)
+{
+        if (!strcmp(name, "scalar")) {
+                return json_utf8_validate_scalar;
+        }
+
+#ifdef JSON_HAVE_X86_SIMD
+        __builtin_cpu_init();
+
+        if (!strcmp(name, "sse4") && __builtin_cpu_supports("sse4.1")) {
+                return json_utf8_validate_sse4;
+        }
+
+        if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+                return json_utf8_validate_avx2;
+        }
+#endif
+
+        return NULL;
+}
+
+/* Validator implementation to use.  This is selected on first use,
+ * and accessed atomically since it may be used from several threads.
+ */
+
+static JSONUTF8ValidateFunc validate_func = NULL;
+
+size_t json_utf8_validate(const unsigned char *data, size_t data_len)
+{
+        JSONUTF8ValidateFunc func;
+
+        func = __atomic_load_n(&validate_func, __ATOMIC_ACQUIRE);
+
+        if (func == NULL) {
+                func = json_utf8_validate_get_impl("avx2");
+
+                if (func == NULL) {
+                        func = json_utf8_validate_get_impl("sse4");
+                }
+
+                if (func == NULL) {
+                        func = json_utf8_validate_scalar;
+                }
+
+                __atomic_store_n(&validate_func, func, __ATOMIC_RELEASE);
+        }
+
+        return func(data, data_len);
+}
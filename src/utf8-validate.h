@@ -0,0 +1,82 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#ifndef JIGSAWN_INTERNAL_UTF8_VALIDATE_H
+#define JIGSAWN_INTERNAL_UTF8_VALIDATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+/*
+ * Validation of UTF-8 data in bulk (RFC 3629): sequences must be 
+ * complete, use the shortest possible encoding, and not encode 
+ * surrogates or characters beyond U+10FFFF.  Vectorized 
+ * implementations are used where the CPU supports them.
+ */
+
+/**
+ * Function pointer type for a UTF-8 validator implementation.
+ *
+ * @param data             Pointer to the data to validate.
+ * @param data_len         Length of the data, in bytes.
+ * @return                 Length of the longest prefix of the data 
+ *                         that consists of complete, valid sequences:
+ *                         ie. the offset of the first sequence that
+ *                         is invalid or incomplete, or data_len if 
+ *                         there is no such sequence.
+ */
+
+typedef size_t (*JSONUTF8ValidateFunc)(const unsigned char *data,
+                                       size_t data_len);
+
+/**
+ * Validate a block of UTF-8 data, using the fastest implementation
+ * supported by the CPU.
+ *
+ * @param data             Pointer to the data to validate.
+ * @param data_len         Length of the data, in bytes.
+ * @return                 Offset of the first sequence that is 
+ *                         invalid or incomplete, or data_len if there
+ *                         is no such sequence.
+ */
+
+size_t json_utf8_validate(const unsigned char *data, size_t data_len);
+
+/**
+ * Look up a UTF-8 validator implementation by name.  This is used for
+ * testing and benchmarking.
+ *
+ * @param name             Name of the implementation: "scalar", 
+ *                         "sse4" or "avx2".
+ * @return                 The implementation, or NULL if it is not
+ *                         compiled in or not supported by the CPU.
+ */
+
+JSONUTF8ValidateFunc json_utf8_validate_get_impl(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef JIGSAWN_INTERNAL_UTF8_VALIDATE_H */
@@ -52,6 +52,65 @@ int json_utf8_seq_length(unsigned char start_byte)
         }
 }
 
+/* Check a UTF-8 sequence is complete and well-formed */
+
+int json_utf8_check_seq(const unsigned char *buf, size_t length)
+{
+        unsigned char lower, upper;
+        int seq_length;
+        int i;
+
+        seq_length = json_utf8_seq_length(buf[0]);
+
+        if (seq_length <= 1) {
+                return seq_length;
+        }
+
+        /* The range allowed for the second byte depends on the first,
+         * to exclude overlong encodings, surrogates (U+D800-U+DFFF)
+         * and characters beyond U+10FFFF (RFC 3629). */
+
+        lower = 0x80;
+        upper = 0xbf;
+
+        switch (buf[0]) {
+                case 0xc0: case 0xc1:
+                        return JSON_ERROR_ENCODING;
+                case 0xe0:
+                        lower = 0xa0;
+                        break;
+                case 0xed:
+                        upper = 0x9f;
+                        break;
+                case 0xf0:
+                        lower = 0x90;
+                        break;
+                case 0xf4:
+                        upper = 0x8f;
+                        break;
+                default:
+                        if (buf[0] > 0xf4) {
+                                return JSON_ERROR_ENCODING;
+                        }
+                        break;
+        }
+
+        for (i=1; i<seq_length; ++i) {
+                if (i >= length) {
+                        return 0;
+                }
+
+                if (buf[i] < lower || buf[i] > upper) {
+                        return JSON_ERROR_ENCODING;
+                }
+
+                lower = 0x80;
+                upper = 0xbf;
+        }
+
+        return seq_length;
+}
+
 /* Decode a UTF-8 sequence */
 
 int json_utf8_decode(const unsigned char *buf, int length) 
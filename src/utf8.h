@@ -70,6 +70,21 @@ extern "C" {
 
 int json_utf8_seq_length(unsigned char start_byte);
 
+/**
+ * Check that a UTF-8 sequence is complete and well-formed: that it 
+ * uses the shortest possible encoding and does not encode a 
+ * surrogate or a character beyond U+10FFFF.
+ *
+ * @param buf              Pointer to the start of the sequence.
+ * @param length           Number of bytes available in the buffer.
+ * @return                 Length of the sequence in bytes if it is
+ *                         valid, zero if more than length bytes are
+ *                         needed to complete it, or negative error code
+ *                         if the sequence is invalid.
+ */
+
+int json_utf8_check_seq(const unsigned char *buf, size_t length);
+
 /**
  * Decode a UTF-8 sequence to a Unicode character.
  *
@@ -21,29 +21,37 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "value.h"
 
-static void json_array_init(JSONValue *value, const char *data)
-{
-        value->data.collection.reached_end = 0;
-}
-
 static int json_array_has_more(JSONValue *value)
 {
-        /* TODO */
-        return 1;
+        return json_collection_has_more(value, JSON_TOKEN_END_ARRAY);
 }
 
 static JSONValue *json_array_read_next(JSONValue *value)
 {
-        /* TODO */
-        return NULL;
+        JSONValue *result;
+
+        if (json_collection_next_item(value, JSON_TOKEN_END_ARRAY) <= 0) {
+                return NULL;
+        }
+
+        /* If more input is needed, the item is read again next time. */
+
+        result = json_parser_read_child(value->parser);
+
+        if (result != NULL) {
+                value->data.collection.state = JSON_COLLECTION_AFTER_ITEM;
+        }
+
+        return result;
 }
 
 /* Value class for JSON_VALUE_ARRAY. */
 
 JSONValueClass json_class_array = {
         JSON_VALUE_ARRAY,
-        json_array_init,            /* init */
+        json_collection_init,       /* init */
         json_array_has_more,        /* has_more */
         json_array_read_next,       /* read_next */
+        json_collection_skip,       /* skip */
+        NULL,                       /* free */
 };
-
@@ -38,5 +38,7 @@ JSONValueClass json_class_boolean = {
         json_boolean_init,          /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        NULL,                       /* skip */
+        NULL,                       /* free */
 };
 
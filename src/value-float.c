@@ -21,11 +21,6 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "value.h"
 
-static void json_float_init(JSONValue *value, const char *data)
-{
-        value->data.floatval = atof(data);
-}
-
 double json_float_get_value(JSONValue *value)
 {
         return value->data.floatval;
@@ -35,8 +30,10 @@ double json_float_get_value(JSONValue *value)
 
 JSONValueClass json_class_float = {
         JSON_VALUE_FLOAT,
-        json_float_init,            /* init */
+        NULL,                       /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        NULL,                       /* skip */
+        NULL,                       /* free */
 };
 
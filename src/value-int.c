@@ -21,12 +21,12 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "value.h"
 
-static void json_int_init(JSONValue *value, const char *data)
+int json_int_get_value(JSONValue *value)
 {
-        value->data.intval = atoi(data);
+        return (int) value->data.intval;
 }
 
-int json_int_get_value(JSONValue *value)
+int64_t json_int64_get_value(JSONValue *value)
 {
         return value->data.intval;
 }
@@ -35,8 +35,10 @@ int json_int_get_value(JSONValue *value)
 
 JSONValueClass json_class_int = {
         JSON_VALUE_INT,
-        json_int_init,              /* init */
+        NULL,                       /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        NULL,                       /* skip */
+        NULL,                       /* free */
 };
 
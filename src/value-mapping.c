@@ -20,23 +20,76 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
 #include <string.h>
+
+#include "jigsawn/error.h"
 #include "value.h"
 
+/* The key is given as a NUL-terminated string, which is copied.  
+ * Keys read in place are set afterwards with json_value_string_set. */
+
 static void json_mapping_init(JSONValue *value, const char *data)
 {
-        value->data.mapping.key = strdup(data);
+        JSONValueString *key;
+
+        key = &value->data.mapping.key;
+        key->data = NULL;
+        key->length = 0;
+        key->in_place = 0;
+        value->data.mapping.key_id = -1;
+        value->data.mapping.value = NULL;
+
+        if (data != NULL) {
+                json_value_string_set(value->parser, key, data,
+                                      strlen(data), 0);
+        }
+}
+
+/* Skipping a mapping skips its value. */
+
+static int json_mapping_skip(JSONValue *value)
+{
+        if (value->data.mapping.value != NULL) {
+                return json_value_skip(value->data.mapping.value);
+        } else {
+                return JSON_ERROR_SUCCESS;
+        }
+}
+
+/* The value belongs to the mapping, and is freed with it. */
+
+static void json_mapping_free(JSONValue *value)
+{
+        json_value_string_free(value->parser, &value->data.mapping.key);
+
+        if (value->data.mapping.value != NULL) {
+                json_value_free(value->data.mapping.value);
+        }
 }
 
 const char *json_mapping_get_key(JSONValue *value)
 {
-        return value->data.mapping.key;
+        return json_value_string_terminate(value->parser,
+                                           &value->data.mapping.key);
 }
 
-JSONValue *json_mapping_get_value(JSONValue *value)
+int json_mapping_get_key_id(JSONValue *value)
+{
+        return value->data.mapping.key_id;
+}
+
+const char *json_mapping_get_key_data(JSONValue *value)
 {
-        /* TODO */
+        return value->data.mapping.key.data;
+}
 
-        return NULL;
+size_t json_mapping_get_key_length(JSONValue *value)
+{
+        return value->data.mapping.key.length;
+}
+
+JSONValue *json_mapping_get_value(JSONValue *value)
+{
+        return value->data.mapping.value;
 }
 
 /* Value class for JSON_VALUE_MAPPING. */
@@ -46,5 +99,7 @@ JSONValueClass json_class_mapping = {
         json_mapping_init,          /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        json_mapping_skip,          /* skip */
+        json_mapping_free,          /* free */
 };
 
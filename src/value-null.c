@@ -28,5 +28,7 @@ JSONValueClass json_class_null = {
         NULL,                       /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        NULL,                       /* skip */
+        NULL,                       /* free */
 };
 
@@ -19,31 +19,272 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include <string.h>
+
+#include "jigsawn/error.h"
+
 #include "value.h"
 
-static void json_object_init(JSONValue *value, const char *data)
+static int json_object_has_more(JSONValue *value)
 {
-        value->data.collection.reached_end = 0;
+        return json_collection_has_more(value, JSON_TOKEN_END_OBJECT);
 }
 
-static int json_object_has_more(JSONValue *value)
+/* Read the next token, which must be of the given type.  Returns zero
+ * if it is, or negative error code, which is also stored in the 
+ * parser's error code. */
+
+static int json_object_expect(JSONParser *parser, JSONToken expected)
 {
-        /* TODO */
-        return 1;
+        JSONToken token;
+
+        token = json_lexer_peek_token(parser->lexer);
+
+        if (token == JSON_TOKEN_NEED_MORE) {
+                parser->error = JSON_ERROR_NEED_MORE;
+                return parser->error;
+        } else if (token != expected) {
+                return json_parser_token_error(parser, token);
+        }
+
+        json_lexer_read_token(parser->lexer);
+
+        return JSON_ERROR_SUCCESS;
 }
 
+/* Read the key of the next item into a new mapping. */
+
+static JSONValue *json_object_read_key(JSONParser *parser)
+{
+        JSONValue *mapping;
+        const char *interned;
+        const char *data;
+        size_t length;
+        int in_place;
+        int key_id;
+
+        if (json_object_expect(parser, JSON_TOKEN_STRING) < 0) {
+                return NULL;
+        }
+
+        mapping = json_value_new(parser, JSON_VALUE_MAPPING, NULL);
+
+        if (mapping == NULL) {
+                parser->error = JSON_ERROR_OUT_OF_MEMORY;
+                return NULL;
+        }
+
+        in_place = json_lexer_get_string(parser->lexer, &data, &length);
+
+        /* If keys have been registered, the key is looked up where the
+         * lexer left it.  Keys that are found use the registered copy,
+         * which lasts as long as the parser, and other keys are not
+         * stored at all. */
+
+        if (parser->keys.num_keys > 0) {
+                key_id = json_key_set_lookup(&parser->keys, data, length);
+                mapping->data.mapping.key_id = key_id;
+
+                if (key_id >= 0) {
+                        json_value_string_set(parser,
+                                &mapping->data.mapping.key,
+                                json_key_set_get_key(&parser->keys, key_id),
+                                length, 1);
+                }
+
+                return mapping;
+        }
+
+        /* Otherwise the key is interned, so that each distinct key is
+         * copied once, and identical keys share the copy.  Keys that 
+         * cannot be interned are stored like string values. */
+
+        interned = json_key_intern(&parser->interned_keys, data, length);
+
+        if (interned != NULL) {
+                data = interned;
+                in_place = 1;
+        }
+
+        if (json_value_string_set(parser, &mapping->data.mapping.key,
+                                  data, length, in_place) < 0) {
+                json_value_free(mapping);
+                parser->error = JSON_ERROR_OUT_OF_MEMORY;
+                return NULL;
+        }
+
+        return mapping;
+}
+
+/* Read the next item, returning it as a mapping.  If more input is
+ * needed, the state is saved, and reading continues from the same
+ * place next time. */
+
 static JSONValue *json_object_read_next(JSONValue *value)
 {
-        /* TODO */
+        JSONParser *parser;
+        JSONValue *mapping;
+        JSONValue *item;
+
+        parser = value->parser;
+
+        if (json_collection_next_item(value, JSON_TOKEN_END_OBJECT) <= 0) {
+                return NULL;
+        }
+
+        if (value->data.collection.state == JSON_COLLECTION_ITEM) {
+                mapping = json_object_read_key(parser);
+
+                if (mapping == NULL) {
+                        return NULL;
+                }
+
+                value->data.collection.mapping = mapping;
+                value->data.collection.state = JSON_COLLECTION_KEY;
+        }
+
+        if (value->data.collection.state == JSON_COLLECTION_KEY) {
+                if (json_object_expect(parser, JSON_TOKEN_COLON) < 0) {
+                        return NULL;
+                }
+
+                value->data.collection.state = JSON_COLLECTION_COLON;
+        }
+
+        /* A search with json_object_find_any that was interrupted 
+         * after reading the key has no mapping to continue with. */
+
+        mapping = value->data.collection.mapping;
+
+        if (mapping == NULL) {
+                parser->error = JSON_ERROR_PARSE;
+                return NULL;
+        }
+
+        item = json_parser_read_child(parser);
+
+        if (item == NULL) {
+                return NULL;
+        }
+
+        mapping->data.mapping.value = item;
+        value->data.collection.mapping = NULL;
+        value->data.collection.state = JSON_COLLECTION_AFTER_ITEM;
+
+        return mapping;
+}
+
+/* Compare the key just read against a set of keys, returning the 
+ * index of the key that matches, or -1 if none match. */
+
+static int json_object_match_key(JSONParser *parser,
+                                 const char *const *keys, int num_keys)
+{
+        const char *data;
+        size_t length;
+        int i;
+
+        json_lexer_get_string(parser->lexer, &data, &length);
+
+        for (i=0; i<num_keys; ++i) {
+                if (strlen(keys[i]) == length
+                 && memcmp(keys[i], data, length) == 0) {
+                        return i;
+                }
+        }
+
+        return -1;
+}
+
+JSONValue *json_object_find_any(JSONValue *object,
+                                const char *const *keys, int num_keys,
+                                int *index)
+{
+        JSONParser *parser;
+        JSONValue *item;
+
+        if (json_value_get_type(object) != JSON_VALUE_OBJECT) {
+                return NULL;
+        }
+
+        parser = object->parser;
+
+        while (json_collection_next_item(object, JSON_TOKEN_END_OBJECT) > 0) {
+
+                if (object->data.collection.state == JSON_COLLECTION_ITEM) {
+                        if (json_object_expect(parser, JSON_TOKEN_STRING) < 0) {
+                                return NULL;
+                        }
+
+                        object->data.collection.match
+                                = json_object_match_key(parser, keys,
+                                                        num_keys);
+                        object->data.collection.state = JSON_COLLECTION_KEY;
+                } else if (object->data.collection.mapping != NULL) {
+
+                        /* Interrupted by json_value_read_next. */
+
+                        parser->error = JSON_ERROR_PARSE;
+                        return NULL;
+                }
+
+                if (object->data.collection.state == JSON_COLLECTION_KEY) {
+                        if (json_object_expect(parser, JSON_TOKEN_COLON) < 0) {
+                                return NULL;
+                        }
+
+                        object->data.collection.state = JSON_COLLECTION_COLON;
+                }
+
+                if (object->data.collection.match >= 0) {
+                        item = json_parser_read_child(parser);
+
+                        if (item == NULL) {
+                                return NULL;
+                        }
+
+                        if (index != NULL) {
+                                *index = object->data.collection.match;
+                        }
+
+                        object->data.collection.state 
+                                = JSON_COLLECTION_AFTER_ITEM;
+
+                        return item;
+                }
+
+                /* Skip the value without reading it.  If an array or
+                 * object is interrupted part way through, the rest of
+                 * it is skipped by json_collection_next_item. */
+
+                if (json_lexer_peek_token(parser->lexer) 
+                    == JSON_TOKEN_NEED_MORE) {
+                        parser->error = JSON_ERROR_NEED_MORE;
+                        return NULL;
+                }
+
+                object->data.collection.state = JSON_COLLECTION_AFTER_ITEM;
+
+                if (json_parser_skip_value(parser) < 0) {
+                        return NULL;
+                }
+        }
+
         return NULL;
 }
 
+JSONValue *json_object_find(JSONValue *object, const char *key)
+{
+        return json_object_find_any(object, &key, 1, NULL);
+}
+
 /* Value class for JSON_VALUE_OBJECT. */
 
 JSONValueClass json_class_object = {
         JSON_VALUE_OBJECT,
-        json_object_init,           /* init */
+        json_collection_init,       /* init */
         json_object_has_more,       /* has_more */
         json_object_read_next,      /* read_next */
+        json_collection_skip,       /* skip */
+        NULL,                       /* free */
 };
-
@@ -19,16 +19,96 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include <string.h>
+
+#include "jigsawn/error.h"
 #include "value.h"
 
-void json_string_init(JSONValue *value, const char *data)
+int json_value_string_set(JSONParser *parser, JSONValueString *str,
+                          const char *data, size_t length, int in_place)
+{
+        if (in_place) {
+                str->data = data;
+        } else {
+                str->data = json_arena_strndup(&parser->arena, data, length);
+
+                if (str->data == NULL) {
+                        return JSON_ERROR_OUT_OF_MEMORY;
+                }
+        }
+
+        str->length = length;
+        str->in_place = in_place;
+
+        return JSON_ERROR_SUCCESS;
+}
+
+const char *json_value_string_terminate(JSONParser *parser,
+                                        JSONValueString *str)
+{
+        const char *copy;
+
+        if (str->in_place && str->data[str->length] != '\0') {
+                copy = json_arena_strndup(&parser->arena, str->data,
+                                          str->length);
+
+                if (copy == NULL) {
+                        return NULL;
+                }
+
+                str->data = copy;
+                str->in_place = 0;
+        }
+
+        return str->data;
+}
+
+void json_value_string_free(JSONParser *parser, JSONValueString *str)
+{
+        if (!str->in_place && str->data != NULL) {
+                json_arena_release(&parser->arena, (char *) str->data,
+                                   str->length + 1);
+        }
+}
+
+/* Strings read by the parser are set with json_value_string_set 
+ * once the value is allocated; data is only given when creating a 
+ * string from a NUL-terminated string, which is copied. */
+
+static void json_string_init(JSONValue *value, const char *data)
+{
+        JSONValueString *str;
+
+        str = &value->data.strval;
+        str->data = NULL;
+        str->length = 0;
+        str->in_place = 0;
+
+        if (data != NULL) {
+                json_value_string_set(value->parser, str, data,
+                                      strlen(data), 0);
+        }
+}
+
+static void json_string_free(JSONValue *value)
 {
-        value->data.strval = data;
+        json_value_string_free(value->parser, &value->data.strval);
 }
 
 const char *json_string_get_value(JSONValue *value)
 {
-        return value->data.strval;
+        return json_value_string_terminate(value->parser,
+                                           &value->data.strval);
+}
+
+const char *json_string_get_data(JSONValue *value)
+{
+        return value->data.strval.data;
+}
+
+size_t json_string_get_length(JSONValue *value)
+{
+        return value->data.strval.length;
 }
 
 /* Value class for JSON_VALUE_STRING. */
@@ -38,5 +118,6 @@ JSONValueClass json_class_string = {
         json_string_init,           /* init */
         NULL,                       /* has_more */
         NULL,                       /* read_next */
+        NULL,                       /* skip */
+        json_string_free,           /* free */
 };
-
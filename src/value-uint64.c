@@ -0,0 +1,46 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include "value.h"
+
+/* Non-negative JSON_VALUE_INT values can be read here too, so check
+ * which type this is. */
+
+uint64_t json_uint64_get_value(JSONValue *value)
+{
+        if (value->value_class->value_type == JSON_VALUE_UINT64) {
+                return value->data.uintval;
+        } else {
+                return (uint64_t) value->data.intval;
+        }
+}
+
+/* Value class for JSON_VALUE_UINT64. */
+
+JSONValueClass json_class_uint64 = {
+        JSON_VALUE_UINT64,
+        NULL,                       /* init */
+        NULL,                       /* has_more */
+        NULL,                       /* read_next */
+        NULL,                       /* skip */
+        NULL,                       /* free */
+};
+
@@ -19,6 +19,8 @@ CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
  */
 
+#include "jigsawn/error.h"
+
 #include "value.h"
 
 extern JSONValueClass json_class_null;
@@ -29,6 +31,7 @@ extern JSONValueClass json_class_mapping;
 extern JSONValueClass json_class_int;
 extern JSONValueClass json_class_float;
 extern JSONValueClass json_class_boolean;
+extern JSONValueClass json_class_uint64;
 
 static JSONValueClass *value_classes[] = {
         &json_class_null,             /* JSON_VALUE_NULL */
@@ -39,22 +42,26 @@ static JSONValueClass *value_classes[] = {
         &json_class_int,              /* JSON_VALUE_INT */
         &json_class_float,            /* JSON_VALUE_FLOAT */
         &json_class_boolean,          /* JSON_VALUE_BOOLEAN */
+        &json_class_uint64,           /* JSON_VALUE_UINT64 */
 };
 
-JSONValue *json_value_new(JSONValueType value_type, const char *data)
+JSONValue *json_value_new(JSONParser *parser, JSONValueType value_type,
+                          const char *data)
 {
         JSONValue *value;
         JSONValueClass *value_class;
 
         /* Allocate the new value */
 
-        value = malloc(sizeof(*value));
+        value = json_arena_alloc(&parser->arena, sizeof(*value));
 
         if (value == NULL) {
                 return NULL;
         }
 
         value_class = value_classes[value_type];
+        value->value_class = value_class;
+        value->parser = parser;
 
         /* Call initialisation function if required */
 
@@ -65,6 +72,17 @@ JSONValue *json_value_new(JSONValueType value_type, const char *data)
         return value;
 }
 
+void json_value_free(JSONValue *value)
+{
+        if (value->value_class->free != NULL) {
+                value->value_class->free(value);
+        }
+
+        /* Return the value to the arena to be recycled */
+
+        json_arena_release(&value->parser->arena, value, sizeof(*value));
+}
+
 JSONValueType json_value_get_type(JSONValue *value)
 {
         return value->value_class->value_type;
@@ -88,3 +106,125 @@ JSONValue *json_value_read_next(JSONValue *value)
         }
 }
 
+int json_value_skip(JSONValue *value)
+{
+        if (value->value_class->skip != NULL) {
+                return value->value_class->skip(value);
+        } else {
+                return JSON_ERROR_SUCCESS;
+        }
+}
+
+void json_collection_init(JSONValue *value, const char *data)
+{
+        value->data.collection.state = JSON_COLLECTION_START;
+        value->data.collection.depth = 0;
+        value->data.collection.serial = 0;
+        value->data.collection.mapping = NULL;
+        value->data.collection.match = -1;
+}
+
+int json_collection_next_item(JSONValue *value, JSONToken end_token)
+{
+        JSONParser *parser;
+        JSONToken token;
+        int err;
+
+        parser = value->parser;
+
+        /* The array or object may have been skipped already, if 
+         * reading moved on past it, or it may be skipped by finishing
+         * an interrupted skip that was skipping further out. */
+
+        if (json_parser_is_open(parser, value)) {
+                err = json_parser_skip_to(parser,
+                                          value->data.collection.depth);
+
+                if (err < 0) {
+                        return err;
+                }
+        }
+
+        if (!json_parser_is_open(parser, value)) {
+                value->data.collection.state = JSON_COLLECTION_END;
+                parser->error = JSON_ERROR_SUCCESS;
+                return 0;
+        }
+
+        if (value->data.collection.state >= JSON_COLLECTION_ITEM) {
+                return 1;
+        }
+
+        token = json_lexer_peek_token(parser->lexer);
+
+        if (token == end_token) {
+                json_lexer_read_token(parser->lexer);
+                json_parser_close(parser);
+                value->data.collection.state = JSON_COLLECTION_END;
+                parser->error = JSON_ERROR_SUCCESS;
+                return 0;
+        } else if (token == JSON_TOKEN_NEED_MORE) {
+                parser->error = JSON_ERROR_NEED_MORE;
+                return parser->error;
+        }
+
+        /* Items after the first are preceded by a comma. */
+
+        if (value->data.collection.state == JSON_COLLECTION_AFTER_ITEM) {
+                if (token != JSON_TOKEN_COMMA) {
+                        return json_parser_token_error(parser, token);
+                }
+
+                json_lexer_read_token(parser->lexer);
+        }
+
+        value->data.collection.state = JSON_COLLECTION_ITEM;
+
+        return 1;
+}
+
+int json_collection_has_more(JSONValue *value, JSONToken end_token)
+{
+        JSONParser *parser;
+
+        parser = value->parser;
+
+        if (!json_parser_is_open(parser, value)) {
+                return 0;
+        }
+
+        /* If the skip cannot be finished, the position is not known. */
+
+        if (json_parser_skip_to(parser, value->data.collection.depth) < 0
+         || !json_parser_is_open(parser, value)) {
+                return 0;
+        }
+
+        if (value->data.collection.state >= JSON_COLLECTION_ITEM) {
+                return 1;
+        }
+
+        return json_lexer_peek_token(parser->lexer) != end_token;
+}
+
+int json_collection_skip(JSONValue *value)
+{
+        JSONParser *parser;
+        int err;
+
+        parser = value->parser;
+
+        if (json_parser_is_open(parser, value)) {
+                err = json_parser_skip_to(parser,
+                                          value->data.collection.depth - 1);
+
+                if (err < 0) {
+                        return err;
+                }
+        }
+
+        value->data.collection.state = JSON_COLLECTION_END;
+        parser->error = JSON_ERROR_SUCCESS;
+
+        return JSON_ERROR_SUCCESS;
+}
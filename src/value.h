@@ -27,10 +27,52 @@ extern "C" {
 #endif
 
 #include "jigsawn/value.h"
+#include "lexer.h"
 #include "parser.h"
 
 typedef struct _JSONValueClass JSONValueClass;
 
+/**
+ * Position reached in reading the contents of an array or object.
+ */
+
+typedef enum {
+        JSON_COLLECTION_START,       /* Before the first item */
+        JSON_COLLECTION_AFTER_ITEM,  /* After an item: , or the end next */
+        JSON_COLLECTION_ITEM,        /* An item is next */
+        JSON_COLLECTION_KEY,         /* After the key of an object item */
+        JSON_COLLECTION_COLON,       /* After the : of an object item */
+        JSON_COLLECTION_END          /* The end has been read */
+} JSONCollectionState;
+
+/**
+ * Contents of a string value or of the key of a mapping.  Strings 
+ * read in place by the lexer are left in the input data; others are 
+ * copied into the parser's arena.
+ */
+
+typedef struct {
+
+        /** Pointer to the string contents, encoded in UTF-8. */
+
+        const char *data;
+
+        /** Length of the string, in bytes. */
+
+        size_t length;
+
+        /**
+         * Non-zero if the contents are in the input data.  They are 
+         * followed there by the closing quote, or by a NUL if the 
+         * string was unescaped in situ.  Keys registered with the
+         * parser are also held in place, in the parser's key set.
+         * Zero if they are a NUL-terminated copy in the parser's
+         * arena.
+         */
+
+        int in_place;
+} JSONValueString;
+
 struct _JSONValueClass {
 
         /** Type of this class. */
@@ -70,6 +112,25 @@ struct _JSONValueClass {
          */
 
         JSONValue *(*read_next)(JSONValue *value);
+
+        /**
+         * Skip the rest of an array or object without reading it.
+         *
+         * @param value              The value.
+         * @return                   Zero if successful, or negative 
+         *                           error code.
+         */
+
+        int (*skip)(JSONValue *value);
+
+        /**
+         * Free any resources used by a value.  The value structure 
+         * itself is freed separately.
+         *
+         * @param value              The value.
+         */
+
+        void (*free)(JSONValue *value);
 };
 
 struct _JSONValue {
@@ -88,11 +149,41 @@ struct _JSONValue {
                 /** Structure used for arrays and object. */
 
                 struct {
+                        /** Position reached in reading the contents. */
+
+                        JSONCollectionState state;
+
                         /** 
-                         * Non-zero if we have read to the end of the
-                         * structure. 
+                         * Depth of the contents: the parser's depth
+                         * while they are being read.
                          */
-                        int reached_end;
+
+                        unsigned int depth;
+
+                        /** 
+                         * Serial number, used to check if the array
+                         * or object is still open.
+                         */
+
+                        unsigned long serial;
+
+                        /** 
+                         * For objects, the mapping being read, if it
+                         * has been interrupted because more input was
+                         * needed after its key was read.
+                         */
+
+                        JSONValue *mapping;
+
+                        /**
+                         * For objects, if a search with 
+                         * @ref json_object_find_any has been 
+                         * interrupted after a key was read, the index 
+                         * of the key that it matched, or -1 if it did
+                         * not match any.
+                         */
+
+                        int match;
                 } collection;
 
                 /** Structure used for mappings (@ref JSON_VALUE_MAPPING) */
@@ -100,7 +191,14 @@ struct _JSONValue {
                 struct {
                         /** String used for key */
 
-                        const char *key;
+                        JSONValueString key;
+
+                        /** 
+                         * ID of the key in the keys registered with
+                         * the parser, or -1.
+                         */
+
+                        int key_id;
 
                         /** Value */
 
@@ -109,11 +207,15 @@ struct _JSONValue {
 
                 /** For strings (@ref JSON_VALUE_STRING) */
 
-                const char *strval;
+                JSONValueString strval;
 
                 /** For integers (@ref JSON_VALUE_INT) */
 
-                int intval;
+                int64_t intval;
+
+                /** For unsigned integers (@ref JSON_VALUE_UINT64) */
+
+                uint64_t uintval;
 
                 /** For floating point numbers (@ref JSON_VALUE_FLOAT) */
 
@@ -126,24 +228,111 @@ struct _JSONValue {
 };
 
 /**
- * Allocate a new @ref JSONValue of the specified type.
+ * Allocate a new @ref JSONValue of the specified type, from the
+ * parser's arena.
  *
+ * @param parser             The parser that the value is read from.
  * @param type               @ref JSONValueType of the new value.
  * @param data               Extra string data to initialise the new value.
  * @return                   Pointer to a new @ref JSONValue, or NULL if
  *                           out of memory.
  */
 
-JSONValue *json_value_new(JSONValueType value_type, const char *data);
+JSONValue *json_value_new(JSONParser *parser, JSONValueType value_type,
+                          const char *data);
 
 /**
- * Free a @ref JSONValue structure.
+ * Initialise the state of a new array or object value.
  *
- * @param value              The value to free.
+ * @param value              The array or object.
+ * @param data               Not used.
  */
 
-void json_value_free(JSONValue *value);
+void json_collection_init(JSONValue *value, const char *data);
+
+/**
+ * Move to the next item in an array or object: skip any arrays and
+ * objects inside it that were not read to the end, and then read the
+ * comma before the next item, or the end of the array or object.  
+ * Objects that are part way through reading an item are left where
+ * they are.
+ *
+ * @param value              The array or object.
+ * @param end_token          The token that ends the array or object.
+ * @return                   One if an item follows, zero if the end 
+ *                           has been reached, or negative error code.
+ *                           The parser's error code is set, except 
+ *                           when an item follows.
+ */
+
+int json_collection_next_item(JSONValue *value, JSONToken end_token);
+
+/**
+ * Query whether more items can be read from an array or object.  Any
+ * arrays and objects inside it that were not read to the end are 
+ * skipped first.
+ *
+ * @param value              The array or object.
+ * @param end_token          The token that ends the array or object.
+ * @return                   Zero if the end has been reached, or 
+ *                           non-zero if it has not.
+ */
+
+int json_collection_has_more(JSONValue *value, JSONToken end_token);
+
+/**
+ * Skip the rest of an array or object, including any arrays and 
+ * objects inside it that are still open.
+ *
+ * @param value              The array or object.
+ * @return                   Zero if successful, or negative error code.
+ */
+
+int json_collection_skip(JSONValue *value);
+
+/**
+ * Set the contents of a @ref JSONValueString.
+ *
+ * @param parser             The parser that the string was read from.
+ * @param str                The string to set.
+ * @param data               Pointer to the string contents.
+ * @param length             Length of the string, in bytes.
+ * @param in_place           If non-zero, the contents are in the input
+ *                           data, and remain valid until the parser's
+ *                           input reader is freed, so they are not 
+ *                           copied.  Otherwise, they are copied into
+ *                           the parser's arena.
+ * @return                   Zero if successful, or 
+ *                           @ref JSON_ERROR_OUT_OF_MEMORY.
+ */
+
+int json_value_string_set(JSONParser *parser, JSONValueString *str,
+                          const char *data, size_t length, int in_place);
+
+/**
+ * Get the contents of a @ref JSONValueString as a NUL-terminated 
+ * string.  Contents that are in the input data and are not 
+ * NUL-terminated are copied into the parser's arena the first time 
+ * that this is called.
+ *
+ * @param parser             The parser that the string was read from.
+ * @param str                The string.
+ * @return                   Pointer to the NUL-terminated string, or
+ *                           NULL if out of memory.
+ */
+
+const char *json_value_string_terminate(JSONParser *parser,
+                                        JSONValueString *str);
+
+/**
+ * Free the copy of a @ref JSONValueString in the parser's arena, if
+ * there is one.
+ *
+ * @param parser             The parser that the string was read from.
+ * @param str                The string.
+ */
 
+void json_value_string_free(JSONParser *parser, JSONValueString *str);
 
 #ifdef __cplusplus
 }
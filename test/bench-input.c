@@ -0,0 +1,310 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark comparing lexer throughput when reading through a
+ * callback function against reading from memory and from a memory
+ * mapped file or a file read with asynchronous I/O, and reading gzip
+ * compressed data and UTF-16 data from memory.  For sources that make
+ * system calls, the number made per MB is shown.  Throughput is given
+ * in MB of the uncompressed, UTF-8 document.
+ *
+ * Usage: bench-input [size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+
+static const char bench_record[] =
+        "{\"name\": \"A moderately long string value in a record\", "
+        "\"enabled\": true, \"deleted\": false, \"parent\": null, "
+        "\"tags\": [\"alpha\", \"beta\", \"gamma\"]},\n";
+
+/* Generate a test document of approximately the specified size. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        size_t record_len;
+        size_t len;
+
+        record_len = strlen(bench_record);
+        result = malloc(size + record_len + 2);
+        assert(result != NULL);
+
+        result[0] = '[';
+        len = 1;
+
+        while (len < size) {
+                memcpy(result + len, bench_record, record_len);
+                len += record_len;
+        }
+
+        /* Replace the trailing ",\n" */
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read all tokens from the lexer, returning the number read. */
+
+static size_t read_all_tokens(JSONLexer *lexer)
+{
+        JSONToken token;
+        size_t count;
+
+        count = 0;
+
+        do {
+                token = json_lexer_read_token(lexer);
+                ++count;
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        return count;
+}
+
+static void report(const char *name, size_t len, double start,
+                   size_t tokens)
+{
+        double elapsed;
+
+        elapsed = now() - start;
+
+        printf("%-12s %8.1f MB/s  (%lu tokens, %.3fs)\n",
+               name, len / elapsed / (1024 * 1024),
+               (unsigned long) tokens, elapsed);
+}
+
+static void report_syscalls(JSONLexer *lexer)
+{
+        JSONInputStats stats;
+
+        json_input_reader_get_stats(json_lexer_get_reader(lexer), &stats);
+
+        printf("%-12s %8.1f syscalls/MB\n", "",
+               stats.syscalls / (stats.bytes_read / (1024.0 * 1024.0)));
+}
+
+static int stdio_read(JSONInputSource source,
+                      unsigned char *data, size_t data_len)
+{
+        FILE *stream = source;
+
+        return fread(data, 1, data_len, stream);
+}
+
+static void bench_callback(const char *filename, size_t len)
+{
+        JSONLexer *lexer;
+        FILE *stream;
+        double start;
+        size_t tokens;
+
+        stream = fopen(filename, "rb");
+        assert(stream != NULL);
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init(json_lexer_get_reader(lexer),
+                               stream, stdio_read);
+        tokens = read_all_tokens(lexer);
+        report("callback", len, start, tokens);
+        report_syscalls(lexer);
+        json_lexer_free(lexer);
+
+        fclose(stream);
+}
+
+static void bench_memory(const char *data, size_t len)
+{
+        JSONLexer *lexer;
+        double start;
+        size_t tokens;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      data, len);
+        tokens = read_all_tokens(lexer);
+        json_lexer_free(lexer);
+        report("memory", len, start, tokens);
+}
+
+static void bench_file(const char *filename, size_t len)
+{
+        JSONLexer *lexer;
+        double start;
+        size_t tokens;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        assert(json_input_reader_init_file(json_lexer_get_reader(lexer),
+                                           filename) == 0);
+        tokens = read_all_tokens(lexer);
+        json_lexer_free(lexer);
+        report("mmap", len, start, tokens);
+}
+
+static void bench_file_async(const char *filename, size_t len)
+{
+        JSONLexer *lexer;
+        double start;
+        size_t tokens;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        assert(json_input_reader_init_file_async(json_lexer_get_reader(lexer),
+                                                 filename) == 0);
+        tokens = read_all_tokens(lexer);
+        report("async", len, start, tokens);
+        report_syscalls(lexer);
+        json_lexer_free(lexer);
+}
+
+static void bench_gzip(const char *data, size_t len)
+{
+        JSONLexer *lexer;
+        z_stream stream;
+        unsigned char *compressed;
+        size_t compressed_len;
+        double start;
+        size_t tokens;
+
+        memset(&stream, 0, sizeof(stream));
+        assert(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                            MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+
+        compressed_len = deflateBound(&stream, len);
+        compressed = malloc(compressed_len);
+        assert(compressed != NULL);
+
+        stream.next_in = (unsigned char *) data;
+        stream.avail_in = len;
+        stream.next_out = compressed;
+        stream.avail_out = compressed_len;
+        assert(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+        compressed_len = stream.total_out;
+        deflateEnd(&stream);
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      compressed, compressed_len);
+        tokens = read_all_tokens(lexer);
+        json_lexer_free(lexer);
+        report("gzip", len, start, tokens);
+
+        free(compressed);
+}
+
+static void bench_utf16(const char *data, size_t len)
+{
+        JSONLexer *lexer;
+        unsigned char *utf16;
+        double start;
+        size_t tokens;
+        size_t i;
+
+        /* The document is ASCII, so each byte becomes one UTF-16 
+         * code unit. */
+
+        utf16 = malloc(len * 2 + 2);
+        assert(utf16 != NULL);
+
+        utf16[0] = 0xff;
+        utf16[1] = 0xfe;
+
+        for (i=0; i<len; ++i) {
+                utf16[i * 2 + 2] = data[i];
+                utf16[i * 2 + 3] = 0;
+        }
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      utf16, len * 2 + 2);
+        tokens = read_all_tokens(lexer);
+        json_lexer_free(lexer);
+        report("utf16", len, start, tokens);
+
+        free(utf16);
+}
+
+int main(int argc, char *argv[])
+{
+        char filename[] = "/tmp/bench-input-XXXXXX";
+        FILE *stream;
+        char *data;
+        size_t size;
+        size_t len;
+        int fd;
+
+        size = 32;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        data = generate_document(size * 1024 * 1024, &len);
+
+        fd = mkstemp(filename);
+        assert(fd >= 0);
+        stream = fdopen(fd, "wb");
+        assert(fwrite(data, 1, len, stream) == len);
+        fclose(stream);
+
+        bench_callback(filename, len);
+        bench_memory(data, len);
+        bench_file(filename, len);
+        bench_file_async(filename, len);
+        bench_gzip(data, len);
+        bench_utf16(data, len);
+
+        remove(filename);
+        free(data);
+
+        return 0;
+}
+
@@ -0,0 +1,186 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark reading a single very long string, to check that the
+ * cost of growing the token buffer is linear in the string length.
+ * The string is read both from memory and through a callback that
+ * supplies the data in small blocks, for a series of doubling sizes;
+ * the time per MB should stay constant as the size increases.
+ *
+ * Usage: bench-long-string [maximum size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "allocator.h"
+#include "input-reader.h"
+#include "lexer.h"
+
+/* Allocator that counts calls to realloc. */
+
+static unsigned long realloc_count;
+
+static void *counting_alloc(void *user_data, size_t size)
+{
+        return malloc(size);
+}
+
+static void *counting_realloc(void *user_data, void *ptr, size_t size)
+{
+        ++realloc_count;
+        return realloc(ptr, size);
+}
+
+static void counting_free(void *user_data, void *ptr)
+{
+        free(ptr);
+}
+
+static const JSONAllocator counting_allocator = {
+        counting_alloc,
+        counting_realloc,
+        counting_free,
+        NULL,
+};
+
+typedef struct {
+        const char *data;
+        size_t offset;
+        size_t length;
+} MemoryStream;
+
+static int memory_stream_read(void *src, unsigned char *buf, size_t buf_len)
+{
+        MemoryStream *stream = src;
+        size_t len;
+
+        len = stream->length - stream->offset;
+
+        if (len > buf_len) {
+                len = buf_len;
+        }
+
+        memcpy(buf, stream->data + stream->offset, len);
+        stream->offset += len;
+
+        return len;
+}
+
+/* Generate a document containing a single string of the given 
+ * length. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        size_t i;
+
+        result = malloc(size + 2);
+        assert(result != NULL);
+
+        result[0] = '\"';
+
+        for (i=1; i<=size; ++i) {
+                result[i] = 'a' + (i % 26);
+        }
+
+        result[size + 1] = '\"';
+
+        *result_len = size + 2;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, const char *data, size_t len,
+                  int use_callback)
+{
+        MemoryStream stream;
+        JSONLexer *lexer;
+        double start, elapsed;
+
+        start = now();
+        realloc_count = 0;
+
+        lexer = json_lexer_new(&counting_allocator);
+
+        if (use_callback) {
+                stream.data = data;
+                stream.offset = 0;
+                stream.length = len;
+                json_input_reader_init(json_lexer_get_reader(lexer),
+                                       &stream, memory_stream_read);
+        } else {
+                json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                              data, len);
+        }
+
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(strlen(json_lexer_get_buffer(lexer)) == len - 2);
+
+        json_lexer_free(lexer);
+
+        elapsed = now() - start;
+
+        printf("%-10s %6.1f MB  %8.3f ms/MB  %6lu reallocs\n",
+               name, len / (1024.0 * 1024.0),
+               elapsed * 1000 / (len / (1024.0 * 1024.0)),
+               realloc_count);
+}
+
+int main(int argc, char *argv[])
+{
+        char *data;
+        size_t max_size;
+        size_t size;
+        size_t len;
+
+        max_size = 64;
+
+        if (argc > 1) {
+                max_size = atoi(argv[1]);
+        }
+
+        for (size = 1; size <= max_size; size *= 2) {
+                data = generate_document(size * 1024 * 1024, &len);
+
+                bench("callback", data, len, 1);
+                bench("memory", data, len, 0);
+
+                free(data);
+        }
+
+        return 0;
+}
+
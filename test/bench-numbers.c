@@ -0,0 +1,151 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark for reading numeric-heavy documents: records containing
+ * 64-bit IDs, nanosecond timestamps, unsigned hashes beyond INT64_MAX,
+ * floating point measurements and coordinates printed with all 17 
+ * significant digits.
+ *
+ * Usage: bench-numbers [size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+
+/* Generate a random 64-bit value. */
+
+static uint64_t random64(void)
+{
+        return ((uint64_t) (rand() & 0xffff) << 48)
+             ^ ((uint64_t) (rand() & 0xffff) << 32)
+             ^ ((uint64_t) (rand() & 0xffff) << 16)
+             ^ ((uint64_t) (rand() & 0xffff));
+}
+
+/* Generate a document of large-ID records. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        uint64_t timestamp;
+        size_t len;
+
+        result = malloc(size + 1024);
+        assert(result != NULL);
+
+        srand(1234);
+        timestamp = 1700000000000000000ULL;
+        len = 0;
+        result[len++] = '[';
+
+        while (len < size) {
+                timestamp += rand() % 1000000;
+
+                len += sprintf(result + len,
+                               "{\"id\": %" PRId64 ", \"ts\": %" PRIu64 ", "
+                               "\"hash\": %" PRIu64 ", \"parent\": -%i, "
+                               "\"value\": %i.%03i, \"ratio\": %ie-%i, "
+                               "\"lat\": %.17g},\n",
+                               (int64_t) (random64() >> 1),
+                               timestamp,
+                               (uint64_t) (random64() | (1ULL << 63)),
+                               rand() % 100000,
+                               rand() % 10000, rand() % 1000,
+                               rand() % 100000, rand() % 20,
+                               random64() / 18446744073709551616.0 * 180
+                                 - 90);
+        }
+
+        /* Replace the trailing ",\n" */
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+        JSONLexer *lexer;
+        JSONToken token;
+        size_t counts[JSON_TOKEN_START + 1];
+        char *data;
+        size_t size;
+        size_t len;
+        double start, elapsed;
+
+        size = 64;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        data = generate_document(size * 1024 * 1024, &len);
+        memset(counts, 0, sizeof(counts));
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      data, len);
+
+        do {
+                token = json_lexer_read_token(lexer);
+                ++counts[token];
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        json_lexer_free(lexer);
+        elapsed = now() - start;
+
+        printf("lexer        %8.1f MB/s  (%.3fs)\n",
+               len / elapsed / (1024 * 1024), elapsed);
+        printf("             %lu int64, %lu uint64, %lu double\n",
+               (unsigned long) counts[JSON_TOKEN_INTEGER],
+               (unsigned long) counts[JSON_TOKEN_UNSIGNED_INTEGER],
+               (unsigned long) counts[JSON_TOKEN_FLOAT]);
+
+        free(data);
+
+        return 0;
+}
+
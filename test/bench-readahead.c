@@ -0,0 +1,254 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark comparing lexer throughput when reading from a file with
+ * and without readahead.  The file is dropped from the page cache
+ * before each run, so that it is read from disk.  A source that is
+ * throttled to a fixed bandwidth is also measured, to show the 
+ * overlap of reading and parsing independent of the disk.
+ *
+ * The file is written to the current directory, as /tmp may be held
+ * in memory.
+ *
+ * Usage: bench-readahead [size in MB] [throttle in MB/s] */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+
+#define READAHEAD_BUFFERS      4
+#define READAHEAD_BUFFER_SIZE  (1024 * 1024)
+
+static const char bench_record[] =
+        "{\"name\": \"A moderately long string value in a record\", "
+        "\"enabled\": true, \"deleted\": false, \"parent\": null, "
+        "\"tags\": [\"alpha\", \"beta\", \"gamma\"], \"id\": 12345},\n";
+
+static const char bench_filename[] = "bench-readahead.tmp";
+
+/* Source that can be throttled to a fixed bandwidth: each read
+ * returns no earlier than the time at which a device of that 
+ * bandwidth would have delivered the data. */
+
+typedef struct {
+        int fd;
+        double bandwidth;
+        double start;
+        size_t total;
+} BenchSource;
+
+/* Generate a test document of approximately the specified size. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        size_t record_len;
+        size_t len;
+
+        record_len = strlen(bench_record);
+        result = malloc(size + record_len + 2);
+        assert(result != NULL);
+
+        result[0] = '[';
+        len = 1;
+
+        while (len < size) {
+                memcpy(result + len, bench_record, record_len);
+                len += record_len;
+        }
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_read(JSONInputSource source,
+                      unsigned char *data, size_t data_len)
+{
+        BenchSource *bench_source = source;
+        struct timespec ts;
+        double delay;
+        ssize_t result;
+
+        do {
+                result = read(bench_source->fd, data, data_len);
+        } while (result < 0 && errno == EINTR);
+
+        if (result > 0 && bench_source->bandwidth > 0) {
+                bench_source->total += result;
+                delay = bench_source->start
+                      + bench_source->total / bench_source->bandwidth
+                      - now();
+
+                if (delay <= 0) {
+                        return result;
+                }
+
+                ts.tv_sec = (time_t) delay;
+                ts.tv_nsec = (long) ((delay - ts.tv_sec) * 1e9);
+                nanosleep(&ts, NULL);
+        }
+
+        return result;
+}
+
+/* Drop the file from the page cache, so that it is read from disk. */
+
+static void drop_cache(void)
+{
+        int fd;
+
+        fd = open(bench_filename, O_RDONLY);
+        assert(fd >= 0);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+}
+
+/* Lex the file, returning the time taken. */
+
+static double bench(double bandwidth, int readahead)
+{
+        BenchSource source;
+        JSONLexer *lexer;
+        JSONToken token;
+        double start;
+
+        source.fd = open(bench_filename, O_RDONLY);
+        assert(source.fd >= 0);
+        source.bandwidth = bandwidth;
+        source.total = 0;
+
+        start = now();
+        source.start = start;
+
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init(json_lexer_get_reader(lexer),
+                               &source, bench_read);
+
+        if (readahead) {
+                assert(json_input_reader_set_readahead(
+                           json_lexer_get_reader(lexer),
+                           READAHEAD_BUFFERS,
+                           READAHEAD_BUFFER_SIZE) == 0);
+        }
+
+        do {
+                token = json_lexer_read_token(lexer);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        json_lexer_free(lexer);
+        close(source.fd);
+
+        return now() - start;
+}
+
+static void report(const char *name, size_t len,
+                   double sync_time, double readahead_time)
+{
+        printf("%-10s sync %7.1f MB/s   readahead %7.1f MB/s   "
+               "speedup %.2fx\n",
+               name,
+               len / sync_time / (1024 * 1024),
+               len / readahead_time / (1024 * 1024),
+               sync_time / readahead_time);
+}
+
+int main(int argc, char *argv[])
+{
+        double sync_time, readahead_time;
+        double bandwidth;
+        FILE *stream;
+        char *data;
+        size_t size;
+        size_t len;
+
+        size = 64;
+        bandwidth = 100;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+        if (argc > 2) {
+                bandwidth = atof(argv[2]);
+        }
+
+        data = generate_document(size * 1024 * 1024, &len);
+
+        stream = fopen(bench_filename, "wb");
+        assert(stream != NULL);
+        assert(fwrite(data, 1, len, stream) == len);
+        fflush(stream);
+        fsync(fileno(stream));
+        fclose(stream);
+        free(data);
+
+        /* Cold cache: read from disk. */
+
+        drop_cache();
+        sync_time = bench(0, 0);
+        drop_cache();
+        readahead_time = bench(0, 1);
+        report("cold", len, sync_time, readahead_time);
+
+        /* Warm cache: the file is already in memory, so this shows 
+         * the overhead of handing buffers between threads. */
+
+        sync_time = bench(0, 0);
+        readahead_time = bench(0, 1);
+        report("warm", len, sync_time, readahead_time);
+
+        /* Source throttled to a fixed bandwidth. */
+
+        sync_time = bench(bandwidth * 1024 * 1024, 0);
+        readahead_time = bench(bandwidth * 1024 * 1024, 1);
+        report("throttled", len, sync_time, readahead_time);
+
+        remove(bench_filename);
+
+        return 0;
+}
@@ -0,0 +1,334 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark comparing reading every value in a document with skipping
+ * over the document with json_value_skip; reading every value and
+ * finding which of a set of keys each mapping has by comparing 
+ * strings with doing so with key IDs from json_parser_register_keys;
+ * and finding the last key of each record by reading its mappings 
+ * with finding it with json_object_find.  The document is an array of records containing
+ * nested objects, strings with escape sequences and numbers.
+ *
+ * Usage: bench-skip [size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+#include "jigsawn/value.h"
+
+static const char bench_record[] =
+        "{\"id\": 1234567, \"name\": \"A moderately long string value\", "
+        "\"text\": \"Line one\\nLine \\\"two\\\"\", \"score\": -12.5e3, "
+        "\"owner\": {\"login\": \"someone\", \"admin\": false, "
+        "\"groups\": [1, 2, 3, 4]}, \"tags\": [\"alpha\", \"beta\"]},\n";
+
+static const char *bench_keys[] = {
+        "id", "name", "text", "score", "owner", "login", "admin",
+        "groups", "tags",
+};
+
+#define NUM_BENCH_KEYS (int) (sizeof(bench_keys) / sizeof(*bench_keys))
+
+/* Generate a test document of approximately the specified size. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        size_t record_len;
+        size_t len;
+
+        record_len = strlen(bench_record);
+        result = malloc(size + record_len + 2);
+        assert(result != NULL);
+
+        result[0] = '[';
+        len = 1;
+
+        while (len < size) {
+                memcpy(result + len, bench_record, record_len);
+                len += record_len;
+        }
+
+        /* Replace the trailing ",\n" */
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read every value inside an array or object, returning the number of
+ * values read. */
+
+static size_t read_all(JSONParser *parser, JSONValue *value)
+{
+        JSONValue *item;
+        JSONValue *child;
+        size_t count;
+
+        count = 0;
+
+        for (;;) {
+                item = json_value_read_next(value);
+
+                if (item == NULL) {
+                        break;
+                }
+
+                child = item;
+
+                if (json_value_get_type(item) == JSON_VALUE_MAPPING) {
+                        child = json_mapping_get_value(item);
+                }
+
+                if (json_value_get_type(child) == JSON_VALUE_ARRAY
+                 || json_value_get_type(child) == JSON_VALUE_OBJECT) {
+                        count += read_all(parser, child);
+                }
+
+                json_value_free(item);
+                ++count;
+        }
+
+        assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+
+        return count;
+}
+
+/* Read every value, as read_all, finding the index of the key of each
+ * mapping in bench_keys by comparing strings or from the key ID.
+ * Returns the sum of the indexes. */
+
+static size_t dispatch_all(JSONParser *parser, JSONValue *value,
+                           int use_ids)
+{
+        JSONValue *item;
+        JSONValue *child;
+        const char *key;
+        size_t result;
+        int id;
+
+        result = 0;
+
+        for (;;) {
+                item = json_value_read_next(value);
+
+                if (item == NULL) {
+                        break;
+                }
+
+                child = item;
+
+                if (json_value_get_type(item) == JSON_VALUE_MAPPING) {
+                        child = json_mapping_get_value(item);
+
+                        if (use_ids) {
+                                id = json_mapping_get_key_id(item);
+                        } else {
+                                key = json_mapping_get_key(item);
+
+                                for (id=0; id<NUM_BENCH_KEYS; ++id) {
+                                        if (!strcmp(key, bench_keys[id])) {
+                                                break;
+                                        }
+                                }
+                        }
+
+                        result += id;
+                }
+
+                if (json_value_get_type(child) == JSON_VALUE_ARRAY
+                 || json_value_get_type(child) == JSON_VALUE_OBJECT) {
+                        result += dispatch_all(parser, child, use_ids);
+                }
+
+                json_value_free(item);
+        }
+
+        assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+
+        return result;
+}
+
+/* Find the "tags" key in each record of the document, by reading
+ * mappings and comparing their keys, or with json_object_find. */
+
+static size_t find_tags(JSONParser *parser, JSONValue *array,
+                        int use_find)
+{
+        JSONValue *record;
+        JSONValue *item;
+        JSONValue *tags;
+        size_t count;
+
+        count = 0;
+
+        for (;;) {
+                record = json_value_read_next(array);
+
+                if (record == NULL) {
+                        break;
+                }
+
+                if (use_find) {
+                        tags = json_object_find(record, "tags");
+                } else {
+                        tags = NULL;
+
+                        while (tags == NULL) {
+                                item = json_value_read_next(record);
+
+                                if (item == NULL) {
+                                        break;
+                                }
+
+                                if (strcmp(json_mapping_get_key(item),
+                                           "tags") == 0) {
+                                        tags = json_mapping_get_value(item);
+                                }
+                        }
+                }
+
+                assert(tags != NULL);
+                ++count;
+        }
+
+        assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+
+        return count;
+}
+
+static void report(const char *name, size_t len, double elapsed)
+{
+        printf("%-12s %8.1f MB/s  (%.3fs)\n",
+               name, len / elapsed / (1024 * 1024), elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+        JSONParserStats stats;
+        JSONParser *parser;
+        JSONValue *value;
+        char *data;
+        size_t size;
+        size_t len;
+        size_t count;
+        double start, read_time, skip_time;
+
+        size = 32;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        data = generate_document(size * 1024 * 1024, &len);
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        count = read_all(parser, value);
+        json_parser_free(parser);
+        read_time = now() - start;
+
+        report("read", len, read_time);
+        printf("             %lu values\n", (unsigned long) count);
+
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        assert(json_value_skip(value) == 0);
+        json_parser_free(parser);
+        skip_time = now() - start;
+
+        report("skip", len, skip_time);
+        printf("             %.1fx faster\n", read_time / skip_time);
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        count = dispatch_all(parser, value, 0);
+        json_parser_get_stats(parser, &stats);
+        json_parser_free(parser);
+        read_time = now() - start;
+
+        report("keys (str)", len, read_time);
+        printf("             %lu distinct keys, %.4f%% interned hits\n",
+               stats.distinct_keys, stats.key_hit_rate * 100);
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        assert(json_parser_register_keys(parser, bench_keys,
+                                         NUM_BENCH_KEYS) == 0);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        assert(dispatch_all(parser, value, 1) == count);
+        json_parser_free(parser);
+        skip_time = now() - start;
+
+        report("keys (ids)", len, skip_time);
+        printf("             %.1fx faster\n", read_time / skip_time);
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        count = find_tags(parser, value, 0);
+        json_parser_free(parser);
+        read_time = now() - start;
+
+        report("find (read)", len, read_time);
+        printf("             %lu records\n", (unsigned long) count);
+
+        start = now();
+        parser = json_parser_new_from_memory(data, len);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        count = find_tags(parser, value, 1);
+        json_parser_free(parser);
+        skip_time = now() - start;
+
+        report("find", len, skip_time);
+        printf("             %.1fx faster\n", read_time / skip_time);
+
+        free(data);
+
+        return 0;
+}
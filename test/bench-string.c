@@ -0,0 +1,195 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Micro-benchmark for string scanning over string-heavy input: long
+ * log messages, some of them with non-ASCII words, and base64 blobs.  Each scanner implementation is timed
+ * on its own, followed by the lexer reading the whole document.
+ *
+ * Usage: bench-string [size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+#include "string-scan.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse2", "avx2" };
+
+static const char base64_chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char *log_words[] = {
+        "connection", "from", "accepted", "request", "GET", "/index.html",
+        "completed", "in", "12ms", "user", "session", "expired", "warning:",
+        "retrying", "upstream", "timeout", "status=200", "bytes=5120",
+        "r\xc3\xa9ponse", "\xe6\x97\xa5\xe5\xbf\x97",
+        "\xd0\xbe\xd1\x88\xd0\xb8\xd0\xb1\xd0\xba\xd0\xb0",
+};
+
+/* Generate a document containing an array of objects, each with a log
+ * message and a base64 blob. */
+
+static char *generate_document(size_t size, size_t *result_len)
+{
+        char *result;
+        size_t len;
+        int i, n;
+
+        result = malloc(size + 4096);
+        assert(result != NULL);
+
+        srand(1234);
+        len = 0;
+        result[len++] = '[';
+
+        while (len < size) {
+                len += sprintf(result + len, "{\"message\": \"");
+
+                n = 10 + rand() % 30;
+
+                for (i=0; i<n; ++i) {
+                        len += sprintf(result + len, "%s ",
+                                       log_words[rand() % ARRLEN(log_words)]);
+                }
+
+                len += sprintf(result + len, "\", \"blob\": \"");
+
+                n = 256 + rand() % 1024;
+
+                for (i=0; i<n; ++i) {
+                        result[len++] = base64_chars[rand() % 64];
+                }
+
+                len += sprintf(result + len, "==\"},\n");
+        }
+
+        /* Replace the trailing ",\n" */
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t len, double start)
+{
+        double elapsed;
+
+        elapsed = now() - start;
+
+        printf("%-12s %8.1f MB/s  (%.3fs)\n",
+               name, len / elapsed / (1024 * 1024), elapsed);
+}
+
+/* Scan through the document as the lexer would, stopping at each
+ * special character. */
+
+static void bench_scan(const char *name, const unsigned char *data,
+                       size_t len)
+{
+        JSONStringScanFunc scan;
+        double start;
+        size_t pos;
+
+        scan = json_string_scan_get_impl(name);
+
+        if (scan == NULL) {
+                printf("%-12s not supported\n", name);
+                return;
+        }
+
+        start = now();
+        pos = 0;
+
+        while (pos < len) {
+                pos += scan(data + pos, len - pos) + 1;
+        }
+
+        report(name, len, start);
+}
+
+static void bench_lexer(const char *data, size_t len)
+{
+        JSONLexer *lexer;
+        JSONToken token;
+        double start;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      data, len);
+
+        do {
+                token = json_lexer_read_token(lexer);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        json_lexer_free(lexer);
+        report("lexer", len, start);
+}
+
+int main(int argc, char *argv[])
+{
+        char *data;
+        size_t size;
+        size_t len;
+        int i;
+
+        size = 64;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        data = generate_document(size * 1024 * 1024, &len);
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                bench_scan(impl_names[i], (unsigned char *) data, len);
+        }
+
+        bench_lexer(data, len);
+
+        free(data);
+
+        return 0;
+}
+
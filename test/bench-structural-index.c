@@ -0,0 +1,259 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Benchmark for the structural index.  Each implementation of the 
+ * structural scan is timed on its own, followed by the lexer reading
+ * the document with and without the index, for a compact document and
+ * for a pretty-printed one with indentation.  The index of the 
+ * compact document is also built with from one thread up to the 
+ * number of CPUs (or the number given), to show how building it 
+ * scales.
+ *
+ * Usage: bench-structural-index [size in MB] [threads] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+#include "structural-index.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse2", "avx2" };
+
+static const char compact_record[] =
+        "{\"name\":\"A moderately long string value in a record\","
+        "\"id\":12345,\"enabled\":true,\"parent\":null,"
+        "\"tags\":[\"alpha\",\"beta\",\"gamma\"]},";
+
+static const char pretty_record[] =
+        "    {\n"
+        "        \"name\": \"A moderately long string value in a record\",\n"
+        "        \"id\": 12345,\n"
+        "        \"enabled\": true,\n"
+        "        \"parent\": null,\n"
+        "        \"tags\": [\n"
+        "            \"alpha\",\n"
+        "            \"beta\",\n"
+        "            \"gamma\"\n"
+        "        ]\n"
+        "    },\n";
+
+/* Generate a document containing an array of copies of a record. */
+
+static char *generate_document(const char *record, size_t size,
+                               size_t *result_len)
+{
+        char *result;
+        size_t record_len;
+        size_t len;
+
+        record_len = strlen(record);
+        result = malloc(size + record_len + 2);
+        assert(result != NULL);
+
+        result[0] = '[';
+        len = 1;
+
+        while (len < size) {
+                memcpy(result + len, record, record_len);
+                len += record_len;
+        }
+
+        /* Replace the trailing comma, or ",\n" */
+
+        if (result[len - 1] == '\n') {
+                --len;
+        }
+
+        result[len - 1] = ']';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t len, double start)
+{
+        double elapsed;
+
+        elapsed = now() - start;
+
+        printf("%-12s %8.1f MB/s  (%.3fs)\n",
+               name, len / elapsed / (1024 * 1024), elapsed);
+}
+
+static void bench_scan(const char *name, const unsigned char *data,
+                       size_t len)
+{
+        JSONStructuralScanFunc scan;
+        JSONStructuralState state;
+        size_t *positions;
+        double start;
+
+        scan = json_structural_scan_get_impl(name);
+
+        if (scan == NULL) {
+                printf("%-12s not supported\n", name);
+                return;
+        }
+
+        positions = malloc(len * sizeof(size_t));
+        assert(positions != NULL);
+
+        /* Touch the positions array first, so that page faults are not
+         * counted. */
+
+        memset(positions, 0, len * sizeof(size_t));
+
+        start = now();
+        json_structural_state_init(&state);
+        assert(scan(data, len, 0, &state, positions) > 0);
+        report(name, len, start);
+
+        free(positions);
+}
+
+static void bench_lexer(const char *name, const char *data, size_t len,
+                        int use_index)
+{
+        JSONLexer *lexer;
+        JSONToken token;
+        double start;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      data, len);
+        json_lexer_set_structural_index(lexer, use_index);
+
+        do {
+                token = json_lexer_read_token(lexer);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        json_lexer_free(lexer);
+        report(name, len, start);
+}
+
+static void bench_parallel(const char *data, size_t len, int max_threads)
+{
+        JSONStructuralIndex index;
+        double start, elapsed, single;
+        int i;
+
+        json_structural_index_init(&index, &json_default_allocator);
+
+        /* Build once first, so that the positions array is already
+         * allocated and page faults are not counted. */
+
+        assert(json_structural_index_build(&index, (unsigned char *) data,
+                                           len) == 0);
+        single = 0;
+
+        for (i=1; i<=max_threads; ++i) {
+                start = now();
+                assert(json_structural_index_build_parallel(
+                           &index, (unsigned char *) data, len, i) == 0);
+                elapsed = now() - start;
+
+                if (i == 1) {
+                        single = elapsed;
+                }
+
+                printf("%2i threads   %8.1f MB/s  (%.3fs, %.2fx)\n",
+                       i, len / elapsed / (1024 * 1024), elapsed,
+                       single / elapsed);
+        }
+
+        json_structural_index_free(&index);
+}
+
+static void bench_document(const char *record, size_t size,
+                           int max_threads)
+{
+        char *data;
+        size_t len;
+        int i;
+
+        data = generate_document(record, size, &len);
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                bench_scan(impl_names[i], (unsigned char *) data, len);
+        }
+
+        bench_lexer("lexer", data, len, 0);
+        bench_lexer("indexed", data, len, 1);
+
+        if (max_threads > 0) {
+                printf("Building the index with threads:\n");
+                bench_parallel(data, len, max_threads);
+        }
+
+        free(data);
+}
+
+int main(int argc, char *argv[])
+{
+        size_t size;
+        int max_threads;
+
+        size = 64;
+        max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        if (argc > 2) {
+                max_threads = atoi(argv[2]);
+        }
+
+        if (max_threads < 1) {
+                max_threads = 1;
+        }
+
+        printf("Compact:\n");
+        bench_document(compact_record, size * 1024 * 1024, max_threads);
+
+        printf("Pretty-printed:\n");
+        bench_document(pretty_record, size * 1024 * 1024, 0);
+
+        return 0;
+}
@@ -0,0 +1,195 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+/* Micro-benchmark for UTF-8 validation, on ASCII text and on text 
+ * with a mixture of multi-byte characters.  Each validator
+ * implementation is timed on its own, followed by the lexer reading
+ * a document made of the mixed text.
+ *
+ * Usage: bench-utf8-validate [size in MB] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+#include "utf8-validate.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse4", "avx2" };
+
+static const char *ascii_words[] = {
+        "connection", "from", "accepted", "request", "completed", "in",
+        "user", "session", "expired", "retrying", "upstream", "timeout",
+};
+
+static const char *mixed_words[] = {
+        "connexion", "accept\xc3\xa9" "e", "requ\xc3\xaate",
+        "\xd0\xb7\xd0\xb0\xd0\xbf\xd1\x80\xd0\xbe\xd1\x81",
+        "\xe6\x8e\xa5\xe7\xb6\x9a", "\xe3\x83\xa6\xe3\x83\xbc\xe3\x82\xb6",
+        "\xe2\x82\xac" "12", "\xf0\x9f\x98\x80", "session", "timeout",
+};
+
+/* Generate a document containing an array of strings made from the
+ * specified words. */
+
+static char *generate_document(const char **words, size_t num_words,
+                               size_t size, size_t *result_len)
+{
+        char *result;
+        size_t len;
+        int i, n;
+
+        result = malloc(size + 4096);
+        assert(result != NULL);
+
+        srand(1234);
+        len = 0;
+        result[len++] = '[';
+
+        while (len < size) {
+                result[len++] = '"';
+
+                n = 10 + rand() % 30;
+
+                for (i=0; i<n; ++i) {
+                        len += sprintf(result + len, "%s ",
+                                       words[rand() % num_words]);
+                }
+
+                len += sprintf(result + len, "\",\n");
+        }
+
+        /* Replace the trailing ",\n" */
+
+        result[len - 2] = ']';
+        result[len - 1] = '\n';
+
+        *result_len = len;
+
+        return result;
+}
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t len, double start)
+{
+        double elapsed;
+
+        elapsed = now() - start;
+
+        printf("%-12s %8.1f MB/s  (%.3fs)\n",
+               name, len / elapsed / (1024 * 1024), elapsed);
+}
+
+static void bench_validate(const char *name, const unsigned char *data,
+                           size_t len)
+{
+        JSONUTF8ValidateFunc validate;
+        double start;
+
+        validate = json_utf8_validate_get_impl(name);
+
+        if (validate == NULL) {
+                printf("%-12s not supported\n", name);
+                return;
+        }
+
+        start = now();
+        assert(validate(data, len) == len);
+        report(name, len, start);
+}
+
+static void bench_lexer(const char *data, size_t len)
+{
+        JSONLexer *lexer;
+        JSONToken token;
+        double start;
+
+        start = now();
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      data, len);
+
+        do {
+                token = json_lexer_read_token(lexer);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        assert(token == JSON_TOKEN_EOF);
+
+        json_lexer_free(lexer);
+        report("lexer", len, start);
+}
+
+int main(int argc, char *argv[])
+{
+        char *data;
+        size_t size;
+        size_t len;
+        int i;
+
+        size = 64;
+
+        if (argc > 1) {
+                size = atoi(argv[1]);
+        }
+
+        printf("ASCII text:\n");
+
+        data = generate_document(ascii_words, ARRLEN(ascii_words),
+                                 size * 1024 * 1024, &len);
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                bench_validate(impl_names[i], (unsigned char *) data, len);
+        }
+
+        free(data);
+
+        printf("Mixed text:\n");
+
+        data = generate_document(mixed_words, ARRLEN(mixed_words),
+                                 size * 1024 * 1024, &len);
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                bench_validate(impl_names[i], (unsigned char *) data, len);
+        }
+
+        bench_lexer(data, len);
+
+        free(data);
+
+        return 0;
+}
+
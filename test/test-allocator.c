@@ -0,0 +1,326 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/allocator.h"
+#include "jigsawn/parser.h"
+#include "jigsawn/value.h"
+
+#include "parser.h"
+
+/* Allocator that counts allocations, and can be made to fail after a
+ * given number of allocations. */
+
+typedef struct {
+        int allocations;
+        int outstanding;
+        int fail_after;
+} TestAllocator;
+
+static void *test_alloc(void *user_data, size_t size)
+{
+        TestAllocator *test = user_data;
+
+        if (test->fail_after >= 0 && test->allocations >= test->fail_after) {
+                return NULL;
+        }
+
+        ++test->allocations;
+        ++test->outstanding;
+
+        return malloc(size);
+}
+
+static void *test_realloc(void *user_data, void *ptr, size_t size)
+{
+        TestAllocator *test = user_data;
+
+        if (ptr == NULL) {
+                return test_alloc(user_data, size);
+        }
+
+        if (test->fail_after >= 0 && test->allocations >= test->fail_after) {
+                return NULL;
+        }
+
+        ++test->allocations;
+
+        return realloc(ptr, size);
+}
+
+static void test_free(void *user_data, void *ptr)
+{
+        TestAllocator *test = user_data;
+
+        assert(ptr != NULL);
+        --test->outstanding;
+
+        free(ptr);
+}
+
+static void init_allocator(JSONAllocator *allocator, TestAllocator *test,
+                           int fail_after)
+{
+        test->allocations = 0;
+        test->outstanding = 0;
+        test->fail_after = fail_after;
+
+        allocator->alloc = test_alloc;
+        allocator->realloc = test_realloc;
+        allocator->free = test_free;
+        allocator->user_data = test;
+}
+
+/* Read data from a string in memory. */
+
+typedef struct {
+        const char *data;
+        size_t offset;
+} StringStream;
+
+static int string_stream_read(void *src, unsigned char *buf, size_t buf_len)
+{
+        StringStream *stream = src;
+        size_t len;
+
+        len = strlen(stream->data + stream->offset);
+
+        if (len > buf_len) {
+                len = buf_len;
+        }
+
+        memcpy(buf, stream->data + stream->offset, len);
+        stream->offset += len;
+
+        return len;
+}
+
+static const char test_input[] =
+        "\"a string long enough to need the token buffer to grow "
+        "several times as it is read in\" 12345 -1.5 true null";
+
+/* Read all the values from test_input.  Returns zero if an allocation
+ * failed. */
+
+static int read_values(JSONParser *parser)
+{
+        JSONValue *value;
+
+        value = json_parser_read_value(parser);
+
+        if (value == NULL) {
+                return 0;
+        }
+
+        assert(strncmp(json_string_get_value(value), "a string", 8) == 0);
+        json_value_free(value);
+
+        value = json_parser_read_value(parser);
+
+        if (value == NULL) {
+                return 0;
+        }
+
+        assert(json_int_get_value(value) == 12345);
+        json_value_free(value);
+
+        value = json_parser_read_value(parser);
+
+        if (value == NULL) {
+                return 0;
+        }
+
+        assert(json_float_get_value(value) == -1.5);
+
+        value = json_parser_read_value(parser);
+
+        if (value == NULL) {
+                return 0;
+        }
+
+        assert(json_boolean_get_value(value) == 1);
+
+        value = json_parser_read_value(parser);
+
+        if (value == NULL) {
+                return 0;
+        }
+
+        assert(json_value_get_type(value) == JSON_VALUE_NULL);
+
+        return 1;
+}
+
+/* All memory is allocated through the allocator, and is all freed
+ * when the parser is freed. */
+
+static void test_allocator(void)
+{
+        JSONAllocator allocator;
+        TestAllocator test;
+        StringStream stream;
+        JSONParser *parser;
+
+        init_allocator(&allocator, &test, -1);
+
+        stream.data = test_input;
+        stream.offset = 0;
+
+        parser = json_parser_new_with_allocator(&stream, string_stream_read,
+                                                &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+
+        json_parser_free(parser);
+
+        assert(test.outstanding == 0);
+}
+
+/* Parsers that read from memory or a file also allocate all memory
+ * through the allocator. */
+
+static void test_other_sources(void)
+{
+        char filename[] = "/tmp/test-allocator-XXXXXX";
+        JSONAllocator allocator;
+        TestAllocator test;
+        JSONParser *parser;
+        FILE *stream;
+        struct iovec iov[2];
+        char *copy;
+        int fd;
+
+        init_allocator(&allocator, &test, -1);
+        parser = json_parser_new_from_memory_with_allocator(
+                        test_input, strlen(test_input), &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+        json_parser_free(parser);
+        assert(test.outstanding == 0);
+
+        iov[0].iov_base = (void *) test_input;
+        iov[0].iov_len = 20;
+        iov[1].iov_base = (void *) (test_input + 20);
+        iov[1].iov_len = strlen(test_input) - 20;
+
+        init_allocator(&allocator, &test, -1);
+        parser = json_parser_new_from_iovec_with_allocator(iov, 2,
+                                                           &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+        json_parser_free(parser);
+        assert(test.outstanding == 0);
+
+        init_allocator(&allocator, &test, -1);
+        copy = strdup(test_input);
+        parser = json_parser_new_in_situ_with_allocator(copy, strlen(copy),
+                                                        &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+        json_parser_free(parser);
+        assert(test.outstanding == 0);
+        free(copy);
+
+        fd = mkstemp(filename);
+        assert(fd >= 0);
+        stream = fdopen(fd, "wb");
+        assert(fwrite(test_input, 1, strlen(test_input), stream)
+               == strlen(test_input));
+        fclose(stream);
+
+        init_allocator(&allocator, &test, -1);
+        parser = json_parser_new_from_file_with_allocator(filename,
+                                                          &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+        json_parser_free(parser);
+        assert(test.outstanding == 0);
+
+        init_allocator(&allocator, &test, -1);
+        parser = json_parser_new_from_file_async_with_allocator(filename,
+                                                                &allocator);
+        assert(parser != NULL);
+        assert(read_values(parser));
+        assert(test.allocations > 0);
+        json_parser_free(parser);
+        assert(test.outstanding == 0);
+
+        remove(filename);
+}
+
+/* Allocation failures are handled cleanly at every point. */
+
+static void test_allocation_failure(void)
+{
+        JSONAllocator allocator;
+        TestAllocator test;
+        StringStream stream;
+        JSONParser *parser;
+        int i;
+
+        for (i=0; ; ++i) {
+                init_allocator(&allocator, &test, i);
+
+                stream.data = test_input;
+                stream.offset = 0;
+
+                parser = json_parser_new_with_allocator(&stream,
+                                                        string_stream_read,
+                                                        &allocator);
+
+                if (parser == NULL) {
+                        assert(test.outstanding == 0);
+                        continue;
+                }
+
+                if (read_values(parser)) {
+                        json_parser_free(parser);
+                        assert(test.outstanding == 0);
+                        break;
+                }
+
+                json_parser_free(parser);
+                assert(test.outstanding == 0);
+        }
+
+        /* Several points of failure should have been tested. */
+
+        assert(i > 2);
+}
+
+int main(int argc, char *argv[])
+{
+        test_allocator();
+        test_other_sources();
+        test_allocation_failure();
+
+        return 0;
+}
+
@@ -0,0 +1,153 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* Allocations are aligned and do not overlap. */
+
+static void test_alloc(void)
+{
+        JSONArena arena;
+        unsigned char *blocks[1000];
+        int i, j;
+
+        json_arena_init(&arena, &json_default_allocator);
+
+        for (i=0; i<1000; ++i) {
+                blocks[i] = json_arena_alloc(&arena, 1 + i % 100);
+                assert(blocks[i] != NULL);
+                assert(((uintptr_t) blocks[i] % JSON_ARENA_ALIGN) == 0);
+                memset(blocks[i], i & 0xff, 1 + i % 100);
+        }
+
+        for (i=0; i<1000; ++i) {
+                for (j=0; j<1 + i % 100; ++j) {
+                        assert(blocks[i][j] == (i & 0xff));
+                }
+        }
+
+        json_arena_free_all(&arena);
+}
+
+/* Released allocations are reused for allocations of the same size
+ * class. */
+
+static void test_recycle(void)
+{
+        JSONArena arena;
+        void *a, *b, *c;
+
+        json_arena_init(&arena, &json_default_allocator);
+
+        a = json_arena_alloc(&arena, 40);
+        b = json_arena_alloc(&arena, 100);
+        json_arena_release(&arena, a, 40);
+        json_arena_release(&arena, b, 100);
+
+        c = json_arena_alloc(&arena, 33);
+        assert(c == a);
+        c = json_arena_alloc(&arena, 100);
+        assert(c == b);
+        c = json_arena_alloc(&arena, 40);
+        assert(c != a);
+
+        json_arena_free_all(&arena);
+}
+
+/* Large allocations, and strings. */
+
+static void test_large(void)
+{
+        JSONArena arena;
+        unsigned char *large, *small;
+        char *str;
+
+        json_arena_init(&arena, &json_default_allocator);
+
+        small = json_arena_alloc(&arena, 16);
+        large = json_arena_alloc(&arena, 1024 * 1024);
+        assert(large != NULL);
+        memset(large, 0xaa, 1024 * 1024);
+
+        str = json_arena_strdup(&arena, "hello world");
+        assert(strcmp(str, "hello world") == 0);
+
+        /* Small allocations continue from the same block. */
+
+        assert((unsigned char *) str > small
+            && (unsigned char *) str < small + 1024);
+
+        /* As they do after an allocation that is too large to share
+         * a block, but smaller than a block. */
+
+        large = json_arena_alloc(&arena, 32 * 1024);
+        assert(large != NULL);
+        memset(large, 0xaa, 32 * 1024);
+
+        str = json_arena_strdup(&arena, "hello world");
+        assert((unsigned char *) str > small
+            && (unsigned char *) str < small + 1024);
+
+        json_arena_free_all(&arena);
+}
+
+/* After a reset, memory is reused from the start. */
+
+static void test_reset(void)
+{
+        JSONArena arena;
+        void *first, *p;
+        int i;
+
+        json_arena_init(&arena, &json_default_allocator);
+
+        first = json_arena_alloc(&arena, 64);
+
+        for (i=0; i<10000; ++i) {
+                p = json_arena_alloc(&arena, 64);
+                assert(p != NULL);
+        }
+
+        json_arena_release(&arena, p, 64);
+        json_arena_reset(&arena);
+
+        p = json_arena_alloc(&arena, 64);
+        assert(p == first);
+
+        json_arena_free_all(&arena);
+}
+
+int main(int argc, char *argv[])
+{
+        test_alloc();
+        test_recycle();
+        test_large();
+        test_reset();
+
+        return 0;
+}
+
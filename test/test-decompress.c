@@ -0,0 +1,299 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#include "jigsawn/error.h"
+
+#include "input-reader.h"
+
+/* Compress data in gzip format. */
+
+static unsigned char *gzip_compress(const unsigned char *data, size_t len,
+                                    size_t *result_len)
+{
+        unsigned char *result;
+        z_stream zstream;
+
+        result = malloc(len + 1024);
+        assert(result != NULL);
+
+        memset(&zstream, 0, sizeof(zstream));
+        assert(deflateInit2(&zstream, 6, Z_DEFLATED, MAX_WBITS + 16, 8,
+                            Z_DEFAULT_STRATEGY) == Z_OK);
+
+        zstream.next_in = (Bytef *) data;
+        zstream.avail_in = len;
+        zstream.next_out = result;
+        zstream.avail_out = len + 1024;
+
+        assert(deflate(&zstream, Z_FINISH) == Z_STREAM_END);
+
+        *result_len = zstream.total_out;
+        deflateEnd(&zstream);
+
+        return result;
+}
+
+/* Read from a buffer a few bytes at a time, so that compressed data
+ * is split into many small blocks. */
+
+typedef struct {
+        const unsigned char *data;
+        size_t len;
+        size_t pos;
+} SmallReadStream;
+
+static int small_read(void *source, unsigned char *buf, size_t buf_len)
+{
+        SmallReadStream *stream = source;
+        size_t len;
+
+        len = stream->len - stream->pos;
+
+        if (len > 7) {
+                len = 7;
+        }
+
+        memcpy(buf, stream->data + stream->pos, len);
+        stream->pos += len;
+
+        return len;
+}
+
+/* Read all characters from a reader and check that they match the
+ * expected data (which is in UTF-8), and that the input ends with the
+ * expected result.  If the result is an error, only the data read
+ * before the error is checked. */
+
+static void check_reader(JSONInputReader *reader,
+                         const unsigned char *expected, size_t expected_len,
+                         int expected_result)
+{
+        JSONInputReader expected_reader;
+        int c1, c2;
+
+        json_input_reader_init_memory(&expected_reader,
+                                      expected, expected_len);
+
+        for (;;) {
+                c1 = json_input_read_char(reader);
+
+                if (c1 < 0) {
+                        break;
+                }
+
+                c2 = json_input_read_char(&expected_reader);
+                assert(c1 == c2);
+        }
+
+        assert(c1 == expected_result);
+
+        if (expected_result == JSON_ERROR_END_OF_FILE) {
+                assert(json_input_read_char(&expected_reader)
+                       == JSON_ERROR_END_OF_FILE);
+        }
+
+        json_input_reader_free(reader);
+}
+
+/* Check that compressed data can be read from memory, iovec segments, from a 
+ * callback and from a file, giving the expected result. */
+
+static void check_compressed(const unsigned char *compressed,
+                             size_t compressed_len,
+                             const unsigned char *expected,
+                             size_t expected_len,
+                             int expected_result)
+{
+        char filename[] = "/tmp/test-decompress-XXXXXX";
+        JSONInputReader reader;
+        SmallReadStream stream;
+        struct iovec iov[3];
+        FILE *fstream;
+        int fd;
+
+        json_input_reader_init_memory(&reader, compressed, compressed_len);
+        check_reader(&reader, expected, expected_len, expected_result);
+
+        stream.data = compressed;
+        stream.len = compressed_len;
+        stream.pos = 0;
+        json_input_reader_init(&reader, &stream, small_read);
+        check_reader(&reader, expected, expected_len, expected_result);
+
+        /* Split into segments, with the magic bytes split too. */
+
+        iov[0].iov_base = (void *) compressed;
+        iov[0].iov_len = 1;
+        iov[1].iov_base = (void *) (compressed + 1);
+        iov[1].iov_len = compressed_len / 3;
+        iov[2].iov_base = (void *) (compressed + 1 + iov[1].iov_len);
+        iov[2].iov_len = compressed_len - 1 - iov[1].iov_len;
+        json_input_reader_init_iovec(&reader, iov, 3);
+        check_reader(&reader, expected, expected_len, expected_result);
+
+        fd = mkstemp(filename);
+        assert(fd >= 0);
+        fstream = fdopen(fd, "wb");
+        assert(fwrite(compressed, 1, compressed_len, fstream)
+               == compressed_len);
+        fclose(fstream);
+
+        assert(json_input_reader_init_file(&reader, filename) == 0);
+        check_reader(&reader, expected, expected_len, expected_result);
+
+        remove(filename);
+}
+
+/* Generate test data: longer than the decompression block size, with
+ * some multi-byte characters. */
+
+static unsigned char *generate_data(size_t *result_len)
+{
+        unsigned char *result;
+        size_t len;
+        int i;
+
+        result = malloc(400 * 1024);
+        assert(result != NULL);
+        len = 0;
+
+        for (i=0; len < 300 * 1024; ++i) {
+                len += sprintf((char *) result + len,
+                               "{\"id\": %i, \"name\": \"\xc2\xa3%i\"},\n",
+                               i, i * 7919);
+        }
+
+        *result_len = len;
+
+        return result;
+}
+
+static void test_gzip(void)
+{
+        unsigned char *data, *compressed, *compressed2, *concat, *expected;
+        size_t data_len, compressed_len, compressed2_len;
+
+        data = generate_data(&data_len);
+        compressed = gzip_compress(data, data_len, &compressed_len);
+
+        check_compressed(compressed, compressed_len, data, data_len,
+                         JSON_ERROR_END_OF_FILE);
+
+        /* Concatenated gzip members are read as one stream. */
+
+        compressed2 = gzip_compress(data, 1000, &compressed2_len);
+
+        concat = malloc(compressed2_len + compressed_len);
+        memcpy(concat, compressed2, compressed2_len);
+        memcpy(concat + compressed2_len, compressed, compressed_len);
+
+        expected = malloc(data_len + 1000);
+        memcpy(expected, data, 1000);
+        memcpy(expected + 1000, data, data_len);
+
+        check_compressed(concat, compressed2_len + compressed_len,
+                         expected, data_len + 1000, JSON_ERROR_END_OF_FILE);
+
+        /* Truncated and corrupted input are errors. */
+
+        check_compressed(compressed2, compressed2_len - 4, data, 1000,
+                         JSON_ERROR_INPUT_STREAM);
+
+        compressed2[compressed2_len - 1] ^= 0xff;
+        check_compressed(compressed2, compressed2_len, data, 1000,
+                         JSON_ERROR_INPUT_STREAM);
+
+        free(concat);
+        free(expected);
+        free(compressed);
+        free(compressed2);
+        free(data);
+}
+
+/* The encoding of the decompressed data is detected. */
+
+static void test_gzip_utf16(void)
+{
+        static const unsigned char utf16_data[] = {
+                0xff, 0xfe, '[', 0, '"', 0, 0xac, 0x20, '"', 0, ']', 0,
+        };
+        static const unsigned char expected[] = "[\"\xe2\x82\xac\"]";
+        unsigned char *compressed;
+        size_t compressed_len;
+
+        compressed = gzip_compress(utf16_data, sizeof(utf16_data),
+                                   &compressed_len);
+        check_compressed(compressed, compressed_len,
+                         expected, sizeof(expected) - 1,
+                         JSON_ERROR_END_OF_FILE);
+        free(compressed);
+}
+
+#ifdef HAVE_LIBZSTD
+
+static void test_zstd(void)
+{
+        unsigned char *data, *compressed;
+        size_t data_len, compressed_len;
+
+        data = generate_data(&data_len);
+        compressed = malloc(ZSTD_compressBound(data_len));
+        compressed_len = ZSTD_compress(compressed, ZSTD_compressBound(data_len),
+                                       data, data_len, 3);
+        assert(!ZSTD_isError(compressed_len));
+
+        check_compressed(compressed, compressed_len, data, data_len,
+                         JSON_ERROR_END_OF_FILE);
+
+        /* Truncated input is an error. */
+
+        check_compressed(compressed, compressed_len / 2,
+                         data, data_len, JSON_ERROR_INPUT_STREAM);
+
+        free(compressed);
+        free(data);
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+        test_gzip();
+        test_gzip_utf16();
+#ifdef HAVE_LIBZSTD
+        test_zstd();
+#endif
+
+        return 0;
+}
+
@@ -0,0 +1,225 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+
+#define BLOCK_SIZE (1024 * 1024)
+
+static char test_filename[] = "/tmp/test-file-reader-XXXXXX";
+
+/* Generate test data of the specified length, containing multi-byte
+ * UTF-8 characters that are split between blocks. */
+
+static unsigned char *generate_data(size_t len)
+{
+        static const char pattern[] = "[\"caf\xc3\xa9\", \"\xe2\x82\xac\"],";
+        unsigned char *result;
+        size_t i;
+
+        result = malloc(len + 1);
+        assert(result != NULL);
+
+        for (i=0; i<len; ++i) {
+                result[i] = pattern[i % (sizeof(pattern) - 1)];
+        }
+
+        /* Do not end with an incomplete character. */
+
+        while (len > 0 && (result[len - 1] & 0x80) != 0) {
+                result[len - 1] = ' ';
+                --len;
+        }
+
+        return result;
+}
+
+static void write_file(const unsigned char *data, size_t len)
+{
+        FILE *stream;
+
+        stream = fopen(test_filename, "wb");
+        assert(stream != NULL);
+        assert(fwrite(data, 1, len, stream) == len);
+        fclose(stream);
+}
+
+/* Read a file and check that the characters read match those read 
+ * from the same data in memory. */
+
+static void check_file(const unsigned char *data, size_t len)
+{
+        JSONInputReader reader, expected_reader;
+        JSONInputStats stats;
+        int c1, c2;
+
+        assert(json_input_reader_init_file_async(&reader,
+                                                 test_filename) == 0);
+        json_input_reader_init_memory(&expected_reader, data, len);
+
+        do {
+                c1 = json_input_read_char(&reader);
+                c2 = json_input_read_char(&expected_reader);
+                assert(c1 == c2);
+        } while (c1 >= 0);
+
+        assert(c1 == JSON_ERROR_END_OF_FILE);
+        assert(json_input_read_char(&reader) == JSON_ERROR_END_OF_FILE);
+
+        /* A few system calls per block at most. */
+
+        json_input_reader_get_stats(&reader, &stats);
+        assert(stats.bytes_read == len);
+        assert(stats.syscalls <= (len / BLOCK_SIZE + 1) * 3);
+
+        json_input_reader_free(&reader);
+}
+
+/* Read files of various lengths around the block size, and longer
+ * than all of the blocks in flight. */
+
+static void test_read(void)
+{
+        static const size_t lengths[] = {
+                0, 1, 4095, 4096, BLOCK_SIZE - 1, BLOCK_SIZE,
+                BLOCK_SIZE + 1, 4 * BLOCK_SIZE, 7 * BLOCK_SIZE + 123,
+        };
+        unsigned char *data;
+        size_t len;
+        int i;
+
+        for (i=0; i<sizeof(lengths) / sizeof(*lengths); ++i) {
+                len = lengths[i];
+                data = generate_data(len);
+                write_file(data, len);
+                check_file(data, len);
+                free(data);
+        }
+}
+
+/* Compressed files are decompressed as they are read. */
+
+static void test_compressed(void)
+{
+        unsigned char *data, *compressed;
+        size_t data_len, compressed_len;
+        z_stream zstream;
+        JSONInputReader reader, expected_reader;
+        int c1, c2;
+
+        data_len = 3 * BLOCK_SIZE;
+        data = generate_data(data_len);
+
+        compressed_len = data_len + 1024;
+        compressed = malloc(compressed_len);
+        assert(compressed != NULL);
+
+        memset(&zstream, 0, sizeof(zstream));
+        assert(deflateInit2(&zstream, 1, Z_DEFLATED, MAX_WBITS + 16, 8,
+                            Z_DEFAULT_STRATEGY) == Z_OK);
+        zstream.next_in = data;
+        zstream.avail_in = data_len;
+        zstream.next_out = compressed;
+        zstream.avail_out = compressed_len;
+        assert(deflate(&zstream, Z_FINISH) == Z_STREAM_END);
+        compressed_len = zstream.total_out;
+        deflateEnd(&zstream);
+
+        write_file(compressed, compressed_len);
+
+        assert(json_input_reader_init_file_async(&reader,
+                                                 test_filename) == 0);
+        json_input_reader_init_memory(&expected_reader, data, data_len);
+
+        do {
+                c1 = json_input_read_char(&reader);
+                c2 = json_input_read_char(&expected_reader);
+                assert(c1 == c2);
+        } while (c1 >= 0);
+
+        assert(c1 == JSON_ERROR_END_OF_FILE);
+
+        json_input_reader_free(&reader);
+
+        free(compressed);
+        free(data);
+}
+
+/* Parse a file, and check the parser statistics. */
+
+static void test_parser(void)
+{
+        static const unsigned char data[] = "12 true \"abc\"";
+        JSONParserStats stats;
+        JSONParser *parser;
+        JSONValue *value;
+
+        assert(json_parser_new_from_file_async("/nonexistent/file") == NULL);
+
+        write_file(data, sizeof(data) - 1);
+
+        parser = json_parser_new_from_file_async(test_filename);
+        assert(parser != NULL);
+
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_int_get_value(value) == 12);
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_boolean_get_value(value));
+        value = json_parser_read_value(parser);
+        assert(value != NULL
+               && strcmp(json_string_get_value(value), "abc") == 0);
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_END_OF_FILE);
+
+        json_parser_get_stats(parser, &stats);
+        assert(stats.bytes_read == sizeof(data) - 1);
+        assert(stats.read_syscalls > 0 && stats.read_syscalls <= 3);
+        assert(stats.syscalls_per_mb > 0);
+
+        json_parser_free(parser);
+}
+
+int main(int argc, char *argv[])
+{
+        int fd;
+
+        fd = mkstemp(test_filename);
+        assert(fd >= 0);
+        close(fd);
+
+        test_read();
+        test_compressed();
+        test_parser();
+
+        remove(test_filename);
+
+        return 0;
+}
@@ -0,0 +1,139 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "allocator.h"
+#include "key-intern.h"
+
+static void test_intern(void)
+{
+        JSONKeyIntern table;
+        const char *id, *name, *empty;
+        char buf[16];
+
+        json_key_intern_init(&table, &json_default_allocator);
+
+        /* Identical keys give the same pointer, even when the data is
+         * not NUL-terminated. */
+
+        id = json_key_intern(&table, "id", 2);
+        assert(id != NULL && strcmp(id, "id") == 0);
+        name = json_key_intern(&table, "name", 4);
+        assert(name != NULL && strcmp(name, "name") == 0);
+        empty = json_key_intern(&table, "", 0);
+        assert(empty != NULL && strcmp(empty, "") == 0);
+
+        strcpy(buf, "idx");
+        assert(json_key_intern(&table, buf, 2) == id);
+        assert(json_key_intern(&table, "names", 4) == name);
+        assert(json_key_intern(&table, "", 0) == empty);
+
+        /* Keys are compared by length. */
+
+        assert(json_key_intern(&table, "i", 1) != id);
+        assert(json_key_intern(&table, "id\0", 3) != id);
+
+        assert(table.num_keys == 5);
+        assert(table.lookups == 8);
+        assert(table.hits == 3);
+
+        json_key_intern_free(&table);
+}
+
+/* Enough keys to enlarge the table several times. */
+
+static void test_many_keys(void)
+{
+        JSONKeyIntern table;
+        const char **keys;
+        char buf[32];
+        int num_keys;
+        int i;
+
+        num_keys = 10000;
+        keys = malloc(sizeof(char *) * num_keys);
+        assert(keys != NULL);
+
+        json_key_intern_init(&table, &json_default_allocator);
+
+        for (i=0; i<num_keys; ++i) {
+                sprintf(buf, "key%i", i);
+                keys[i] = json_key_intern(&table, buf, strlen(buf));
+                assert(keys[i] != NULL && strcmp(keys[i], buf) == 0);
+        }
+
+        for (i=0; i<num_keys; ++i) {
+                sprintf(buf, "key%i", i);
+                assert(json_key_intern(&table, buf, strlen(buf)) == keys[i]);
+        }
+
+        assert(table.num_keys == (size_t) num_keys);
+        assert(table.hits == (unsigned long) num_keys);
+
+        json_key_intern_free(&table);
+        free(keys);
+}
+
+/* Long keys are not interned, and the table stops growing when full. */
+
+static void test_limits(void)
+{
+        JSONKeyIntern table;
+        char buf[1024];
+        int i;
+
+        json_key_intern_init(&table, &json_default_allocator);
+
+        memset(buf, 'x', sizeof(buf));
+        assert(json_key_intern(&table, buf, sizeof(buf)) == NULL);
+        assert(json_key_intern(&table, buf, 256) != NULL);
+
+        for (i=0; ; ++i) {
+                sprintf(buf, "%i", i);
+
+                if (json_key_intern(&table, buf, strlen(buf)) == NULL) {
+                        break;
+                }
+        }
+
+        assert(table.num_keys == 65536);
+
+        /* Keys already in the table are still found. */
+
+        assert(json_key_intern(&table, "0", 1) != NULL);
+
+        json_key_intern_free(&table);
+}
+
+int main(int argc, char *argv[])
+{
+        test_intern();
+        test_many_keys();
+        test_limits();
+
+        return 0;
+}
@@ -0,0 +1,142 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "allocator.h"
+#include "key-set.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *test_keys[] = {
+        "id", "name", "type", "created_at", "updated_at", "owner",
+        "login", "url", "tags", "", "a", "b", "ab", "ba", "name2",
+};
+
+static void test_lookup(void)
+{
+        JSONKeySet set;
+        unsigned int i;
+
+        json_key_set_init(&set, &json_default_allocator);
+
+        assert(json_key_set_build(&set, test_keys, ARRLEN(test_keys)) == 0);
+
+        for (i=0; i<ARRLEN(test_keys); ++i) {
+                assert(json_key_set_lookup(&set, test_keys[i],
+                                           strlen(test_keys[i])) == (int) i);
+                assert(strcmp(json_key_set_get_key(&set, i),
+                              test_keys[i]) == 0);
+        }
+
+        /* Keys are compared by length, not as NUL-terminated strings. */
+
+        assert(json_key_set_lookup(&set, "name", 3) == -1);
+        assert(json_key_set_lookup(&set, "name2", 4) == 1);
+        assert(json_key_set_lookup(&set, "a\0", 2) == -1);
+
+        assert(json_key_set_lookup(&set, "nam", 3) == -1);
+        assert(json_key_set_lookup(&set, "tagz", 4) == -1);
+        assert(json_key_set_lookup(&set, "ownerx", 6) == -1);
+
+        json_key_set_free(&set);
+}
+
+/* A larger set of keys, which needs many buckets. */
+
+static void test_many_keys(void)
+{
+        JSONKeySet set;
+        char **keys;
+        char buf[32];
+        unsigned int num_keys;
+        unsigned int i;
+
+        num_keys = 5000;
+        keys = malloc(sizeof(char *) * num_keys);
+        assert(keys != NULL);
+
+        for (i=0; i<num_keys; ++i) {
+                sprintf(buf, "key%u", i);
+                keys[i] = strdup(buf);
+        }
+
+        json_key_set_init(&set, &json_default_allocator);
+        assert(json_key_set_build(&set, (const char *const *) keys,
+                                  num_keys) == 0);
+
+        for (i=0; i<num_keys; ++i) {
+                assert(json_key_set_lookup(&set, keys[i], strlen(keys[i]))
+                       == (int) i);
+        }
+
+        for (i=num_keys; i<num_keys * 2; ++i) {
+                sprintf(buf, "key%u", i);
+                assert(json_key_set_lookup(&set, buf, strlen(buf)) == -1);
+        }
+
+        json_key_set_free(&set);
+
+        for (i=0; i<num_keys; ++i) {
+                free(keys[i]);
+        }
+
+        free(keys);
+}
+
+static void test_duplicates(void)
+{
+        const char *keys[] = { "x", "y", "x", "z", "y" };
+        JSONKeySet set;
+
+        json_key_set_init(&set, &json_default_allocator);
+        assert(json_key_set_build(&set, keys, ARRLEN(keys)) == 0);
+
+        assert(json_key_set_lookup(&set, "x", 1) == 0);
+        assert(json_key_set_lookup(&set, "y", 1) == 1);
+        assert(json_key_set_lookup(&set, "z", 1) == 3);
+
+        /* Building again replaces the keys; an empty set matches 
+         * nothing. */
+
+        assert(json_key_set_build(&set, keys + 3, 1) == 0);
+        assert(json_key_set_lookup(&set, "z", 1) == 0);
+        assert(json_key_set_lookup(&set, "x", 1) == -1);
+
+        assert(json_key_set_build(&set, keys, 0) == 0);
+        assert(json_key_set_lookup(&set, "x", 1) == -1);
+
+        json_key_set_free(&set);
+}
+
+int main(int argc, char *argv[])
+{
+        test_lookup();
+        test_many_keys();
+        test_duplicates();
+
+        return 0;
+}
@@ -0,0 +1,923 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+#include "lexer.h"
+
+/* Code to read from a buffer, one byte at a time, so that every 
+ * token is split across input blocks. */
+
+typedef struct {
+        const unsigned char *buffer;
+        size_t offset;
+        size_t length;
+} ByteStream;
+
+static int byte_stream_read(void *src, unsigned char *buf, size_t buf_len)
+{
+        ByteStream *stream;
+
+        stream = src;
+
+        if (stream->offset < stream->length) {
+                buf[0] = stream->buffer[stream->offset];
+                ++stream->offset;
+                return 1;
+        } else {
+                return 0;
+        }
+}
+
+/* Create a lexer to read the specified input, either from memory or
+ * through a callback that reads a byte at a time. */
+
+static JSONLexer *lexer_for_input(const char *input, ByteStream *stream)
+{
+        JSONLexer *lexer;
+
+        lexer = json_lexer_new(NULL);
+        assert(lexer != NULL);
+
+        if (stream != NULL) {
+                stream->buffer = (const unsigned char *) input;
+                stream->length = strlen(input);
+                stream->offset = 0;
+                json_input_reader_init(json_lexer_get_reader(lexer),
+                                       stream, byte_stream_read);
+        } else {
+                json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                              input, strlen(input));
+        }
+
+        return lexer;
+}
+
+/* Check that a string token with the given value is read next. */
+
+static void expect_string(JSONLexer *lexer, const char *expected)
+{
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(strcmp(json_lexer_get_buffer(lexer), expected) == 0);
+}
+
+/* Test reading strings, with both memory and callback input. */
+
+static void test_strings(ByteStream *stream)
+{
+        JSONLexer *lexer;
+        char long_expected[1024];
+        char long_input[sizeof(long_expected) + 2];
+        int i;
+
+        /* Plain ASCII, multi-byte UTF-8, and escape sequences. */
+
+        lexer = lexer_for_input("[\"abc\", \"\xc2\xa3\xe2\xa0\x81\xf0\x90\x90"
+                                "\x81\", \"a\\\"b\\\\c\\n\\u00e9\"]",
+                                stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        expect_string(lexer, "abc");
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_string(lexer, "\xc2\xa3\xe2\xa0\x81\xf0\x90\x90\x81");
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_string(lexer, "a\"b\\c\n\xc3\xa9");
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_END_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_EOF);
+        json_lexer_free(lexer);
+
+        /* Empty string */
+
+        lexer = lexer_for_input("\"\"", stream);
+        expect_string(lexer, "");
+        json_lexer_free(lexer);
+
+        /* A string longer than the input buffer. */
+
+        for (i=0; i<1000; ++i) {
+                long_expected[i] = 'a' + (i % 26);
+        }
+
+        long_expected[i] = '\0';
+        sprintf(long_input, "\"%s\"", long_expected);
+
+        lexer = lexer_for_input(long_input, stream);
+        expect_string(lexer, long_expected);
+        json_lexer_free(lexer);
+
+        /* An escaped quote near the start of a long string, and an
+         * escaped backslash before the closing quote. */
+
+        long_input[0] = '\"';
+        long_input[1] = '\\';
+        long_input[2] = '\"';
+        long_expected[0] = '\"';
+
+        for (i=1; i<900; ++i) {
+                long_input[i + 2] = 'a' + (i % 26);
+                long_expected[i] = 'a' + (i % 26);
+        }
+
+        strcpy(long_input + i + 2, "\\\\\" \"x\"");
+        strcpy(long_expected + i, "\\");
+
+        lexer = lexer_for_input(long_input, stream);
+        expect_string(lexer, long_expected);
+        expect_string(lexer, "x");
+        json_lexer_free(lexer);
+
+        /* Maximum string length. */
+
+        lexer = lexer_for_input("\"abcd\" \"abcde\"", stream);
+        json_lexer_set_max_string_length(lexer, 4);
+        expect_string(lexer, "abcd");
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_ERROR);
+        json_lexer_free(lexer);
+
+        /* Invalid UTF-8 */
+
+        lexer = lexer_for_input("\"abc\xff\"", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_ERROR);
+        json_lexer_free(lexer);
+
+        /* Unterminated string */
+
+        lexer = lexer_for_input("\"abc", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_ERROR);
+        json_lexer_free(lexer);
+}
+
+/* Check that an integer token with the given value is read next. */
+
+static void expect_int(JSONLexer *lexer, int64_t expected)
+{
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_INTEGER);
+        assert(json_lexer_get_int(lexer) == expected);
+}
+
+/* Check that reading a single number gives the same result as
+ * strtod(). */
+
+static void expect_float(const char *input, ByteStream *stream)
+{
+        JSONLexer *lexer;
+
+        lexer = lexer_for_input(input, stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_FLOAT);
+        assert(json_lexer_get_float(lexer) == strtod(input, NULL));
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_EOF);
+        json_lexer_free(lexer);
+}
+
+static void expect_error(const char *input, ByteStream *stream)
+{
+        JSONLexer *lexer;
+
+        lexer = lexer_for_input(input, stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_ERROR);
+        json_lexer_free(lexer);
+}
+
+/* Test reading keywords, whitespace and escape sequences, which are
+ * matched using character classes that do not depend on the locale. */
+
+static void test_keywords(ByteStream *stream)
+{
+        JSONLexer *lexer;
+
+        lexer = lexer_for_input(" \t\r\n[true,false , null]\n", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_TRUE);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_FALSE);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_NULL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_END_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_EOF);
+        json_lexer_free(lexer);
+
+        /* Keywords cut short at the end of the input. */
+
+        expect_error("tru", stream);
+        expect_error("fals", stream);
+        expect_error("nul", stream);
+        expect_error("trUe", stream);
+        expect_error("True", stream);
+
+        /* Only space, tab, CR and LF are whitespace in JSON. */
+
+        expect_error("\v1", stream);
+        expect_error("\f1", stream);
+        expect_error("\xc2\xa0" "1", stream);
+
+        /* Hex digits in escapes can be upper or lower case. */
+
+        lexer = lexer_for_input("\"\\u00C9\\u00e9\\uAbCd\"", stream);
+        expect_string(lexer, "\xc3\x89\xc3\xa9\xea\xaf\x8d");
+        json_lexer_free(lexer);
+
+        expect_error("\"\\u00g9\"", stream);
+        expect_error("\"\\u00G9\"", stream);
+        expect_error("\"\\u00\xc3\xa9\"", stream);
+}
+
+/* Test reading numbers. */
+
+static void test_numbers(ByteStream *stream)
+{
+        JSONLexer *lexer;
+
+        lexer = lexer_for_input("[0, -0, 7, -12, 123456789, 2147483647, "
+                                "-2147483648]", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        expect_int(lexer, 0);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, 0);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, 7);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, -12);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, 123456789);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, 2147483647);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, -2147483647 - 1);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_END_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_EOF);
+        json_lexer_free(lexer);
+
+        /* Numbers followed directly by other tokens */
+
+        lexer = lexer_for_input("{1:2.5}", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_OBJECT);
+        expect_int(lexer, 1);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COLON);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_FLOAT);
+        assert(json_lexer_get_float(lexer) == 2.5);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_END_OBJECT);
+        json_lexer_free(lexer);
+
+        /* Large IDs and timestamps: 64-bit signed integers, and 
+         * unsigned integers for values beyond INT64_MAX. */
+
+        lexer = lexer_for_input("[2147483648, -2147483649, "
+                                "1700000000123456789, "
+                                "9223372036854775807, "
+                                "-9223372036854775808, "
+                                "9223372036854775808, "
+                                "18446744073709551615]", stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        expect_int(lexer, 2147483648LL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, -2147483649LL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, 1700000000123456789LL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, INT64_MAX);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        expect_int(lexer, INT64_MIN);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_UNSIGNED_INTEGER);
+        assert(json_lexer_get_uint64(lexer) == 9223372036854775808ULL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_UNSIGNED_INTEGER);
+        assert(json_lexer_get_uint64(lexer) == UINT64_MAX);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_END_ARRAY);
+        json_lexer_free(lexer);
+
+        /* Floating point values, including integers too large for
+         * 64 bits, and those that need the slow conversion path. */
+
+        expect_float("18446744073709551616", stream);
+        expect_float("-9223372036854775809", stream);
+        expect_float("100000000000000000000000", stream);
+        expect_float("0.1", stream);
+        expect_float("-0.000123", stream);
+        expect_float("3.14159265358979", stream);
+        expect_float("1e10", stream);
+        expect_float("1E+2", stream);
+        expect_float("2.5e-3", stream);
+        expect_float("12345678901234567890.0", stream);
+        expect_float("1234567890123456789012345678901234567890", stream);
+        expect_float("0.12345678901234567890123456789", stream);
+        expect_float("9007199254740993.0", stream);
+        expect_float("1.7976931348623157e308", stream);
+        expect_float("4.9406564584124654e-324", stream);
+        expect_float("2.2250738585072011e-308", stream);
+        expect_float("1e400", stream);
+        expect_float("1e-400", stream);
+        expect_float("123456781234567812345678.5", stream);
+
+        /* Invalid numbers */
+
+        expect_error("-", stream);
+        expect_error("-a", stream);
+        expect_error("1.", stream);
+        expect_error("1.e5", stream);
+        expect_error("1e", stream);
+        expect_error("1e+", stream);
+}
+
+/* Append a description of a token read from a lexer to a string, so
+ * that the results of reading in different ways can be compared. */
+
+static void describe_token(JSONLexer *lexer, JSONToken token, char *result)
+{
+        result += strlen(result);
+
+        switch (token) {
+                case JSON_TOKEN_STRING:
+                        sprintf(result, "S<%s>", json_lexer_get_buffer(lexer));
+                        break;
+                case JSON_TOKEN_INTEGER:
+                        sprintf(result, "I<%lld>",
+                                (long long) json_lexer_get_int(lexer));
+                        break;
+                case JSON_TOKEN_UNSIGNED_INTEGER:
+                        sprintf(result, "U<%llu>",
+                                (unsigned long long)
+                                json_lexer_get_uint64(lexer));
+                        break;
+                case JSON_TOKEN_FLOAT:
+                        sprintf(result, "F<%.17g>", json_lexer_get_float(lexer));
+                        break;
+                default:
+                        sprintf(result, "%i ", token);
+                        break;
+        }
+}
+
+/* Read all tokens from the given input in memory, optionally using a
+ * structural index. */
+
+static void read_memory(const unsigned char *input, size_t input_len,
+                        int use_index, char *result)
+{
+        JSONLexer *lexer;
+        JSONToken token;
+
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer),
+                                      input, input_len);
+        assert(json_lexer_set_structural_index(lexer, use_index) == 0);
+        result[0] = '\0';
+
+        do {
+                token = json_lexer_read_token(lexer);
+                describe_token(lexer, token, result);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        json_lexer_free(lexer);
+}
+
+/* Read all tokens from a writable copy of the given input, with 
+ * strings unescaped in situ, optionally using a structural index. */
+
+static void read_in_situ(const unsigned char *input, size_t input_len,
+                         int use_index, char *result)
+{
+        JSONLexer *lexer;
+        JSONToken token;
+        unsigned char *data;
+
+        data = malloc(input_len + 1);
+        assert(data != NULL);
+        memcpy(data, input, input_len);
+
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_in_situ(json_lexer_get_reader(lexer),
+                                       data, input_len);
+        assert(json_lexer_set_structural_index(lexer, use_index) == 0);
+        result[0] = '\0';
+
+        do {
+                token = json_lexer_read_token(lexer);
+                describe_token(lexer, token, result);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        json_lexer_free(lexer);
+        free(data);
+}
+
+/* Read all tokens from the given input, feeding it to a push mode 
+ * lexer in blocks of the given size.  Each block is overwritten once
+ * the lexer has finished with it. */
+
+static void read_push(const unsigned char *input, size_t input_len,
+                      size_t block_size, char *result)
+{
+        JSONInputReader *reader;
+        JSONLexer *lexer;
+        JSONToken token;
+        unsigned char *block;
+        size_t pos, len;
+
+        block = malloc(block_size);
+        lexer = json_lexer_new(NULL);
+        reader = json_lexer_get_reader(lexer);
+        json_input_reader_init_push(reader);
+        result[0] = '\0';
+        pos = 0;
+
+        for (;;) {
+                token = json_lexer_read_token(lexer);
+
+                if (token == JSON_TOKEN_NEED_MORE) {
+                        len = input_len - pos;
+
+                        if (len > block_size) {
+                                len = block_size;
+                        }
+
+                        memset(block, 0xff, block_size);
+                        memcpy(block, input + pos, len);
+                        pos += len;
+
+                        assert(json_input_feed(reader, block, len) == 0);
+                        continue;
+                }
+
+                describe_token(lexer, token, result);
+
+                if (token == JSON_TOKEN_EOF || token == JSON_TOKEN_ERROR) {
+                        break;
+                }
+        }
+
+        /* No more data can be fed after the end. */
+
+        if (token == JSON_TOKEN_EOF) {
+                assert(json_input_feed(reader, block, 1)
+                       == JSON_ERROR_INPUT_STREAM);
+        }
+
+        json_lexer_free(lexer);
+        free(block);
+}
+
+/* Read all tokens from the given input in push mode, as with
+ * read_push, but with the input split wherever a bit is set in the 
+ * given mask: bit i splits the input after byte i. */
+
+static void read_push_split(const unsigned char *input, size_t input_len,
+                            unsigned int splits, char *result)
+{
+        JSONInputReader *reader;
+        JSONLexer *lexer;
+        JSONToken token;
+        unsigned char block[32];
+        size_t pos, len;
+
+        lexer = json_lexer_new(NULL);
+        reader = json_lexer_get_reader(lexer);
+        json_input_reader_init_push(reader);
+        result[0] = '\0';
+        pos = 0;
+
+        for (;;) {
+                token = json_lexer_read_token(lexer);
+
+                if (token == JSON_TOKEN_NEED_MORE) {
+                        for (len=1; pos + len < input_len; ++len) {
+                                if ((splits & (1U << (pos + len - 1))) != 0) {
+                                        break;
+                                }
+                        }
+
+                        if (pos >= input_len) {
+                                len = 0;
+                        }
+
+                        assert(len <= sizeof(block));
+                        memset(block, 0xff, sizeof(block));
+                        memcpy(block, input + pos, len);
+                        pos += len;
+
+                        assert(json_input_feed(reader, block, len) == 0);
+                        continue;
+                }
+
+                describe_token(lexer, token, result);
+
+                if (token == JSON_TOKEN_EOF || token == JSON_TOKEN_ERROR) {
+                        break;
+                }
+        }
+
+        json_lexer_free(lexer);
+}
+
+/* Read all tokens from the given input, split into separately 
+ * allocated segments of the given size and read from an iovec array.
+ * An empty segment is placed after each one. */
+
+static void read_iovec(const unsigned char *input, size_t input_len,
+                       size_t segment_size, char *result)
+{
+        struct iovec iov[2048];
+        JSONLexer *lexer;
+        JSONToken token;
+        size_t pos, len;
+        int iov_count;
+        int i;
+
+        iov_count = 0;
+
+        for (pos=0; pos<input_len; pos += len) {
+                len = input_len - pos;
+
+                if (len > segment_size) {
+                        len = segment_size;
+                }
+
+                assert(iov_count + 2 <= sizeof(iov) / sizeof(*iov));
+                iov[iov_count].iov_base = malloc(len);
+                iov[iov_count].iov_len = len;
+                memcpy(iov[iov_count].iov_base, input + pos, len);
+                iov[iov_count + 1].iov_base = NULL;
+                iov[iov_count + 1].iov_len = 0;
+                iov_count += 2;
+        }
+
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_iovec(json_lexer_get_reader(lexer),
+                                     iov, iov_count);
+        result[0] = '\0';
+
+        do {
+                token = json_lexer_read_token(lexer);
+                describe_token(lexer, token, result);
+        } while (token != JSON_TOKEN_EOF && token != JSON_TOKEN_ERROR);
+
+        json_lexer_free(lexer);
+
+        for (i=0; i<iov_count; ++i) {
+                free(iov[i].iov_base);
+        }
+}
+
+/* Check that reading in push mode or from an iovec array gives the
+ * same results as reading from memory, whatever the input is split, 
+ * as does reading from memory with a structural index, and reading
+ * with strings unescaped in situ. */
+
+static void check_push(const unsigned char *input, size_t input_len)
+{
+        static const size_t block_sizes[] = { 1, 2, 3, 5, 7, 64, 1000 };
+        char expected[4096];
+        char result[4096];
+        int i;
+
+        read_memory(input, input_len, 0, expected);
+        read_memory(input, input_len, 1, result);
+        assert(strcmp(result, expected) == 0);
+        read_in_situ(input, input_len, 0, result);
+        assert(strcmp(result, expected) == 0);
+        read_in_situ(input, input_len, 1, result);
+        assert(strcmp(result, expected) == 0);
+
+        for (i=0; i<sizeof(block_sizes) / sizeof(*block_sizes); ++i) {
+                read_push(input, input_len, block_sizes[i], result);
+                assert(strcmp(result, expected) == 0);
+                read_iovec(input, input_len, block_sizes[i], result);
+                assert(strcmp(result, expected) == 0);
+        }
+}
+
+static void check_push_string(const char *input)
+{
+        check_push((const unsigned char *) input, strlen(input));
+}
+
+/* Check that reading multibyte characters in push mode gives the same
+ * result however the input is split into blocks shorter than eight 
+ * bytes, so that a block can complete one split character and also
+ * end partway through the next. */
+
+static void test_push_split(void)
+{
+        static const unsigned char input[] =
+                "[\"\xe4\xb8\xad\xf0\x9f\x98\x80\xe2\x82\xac"
+                "\xf0\x90\x90\x81\"]";
+        size_t input_len = sizeof(input) - 1;
+        char expected[256];
+        char result[256];
+        unsigned int splits;
+        size_t i, last;
+
+        read_memory(input, input_len, 0, expected);
+
+        for (splits=0; splits < (1U << (input_len - 1)); ++splits) {
+
+                /* Only try splits where every block is short. */
+
+                last = 0;
+
+                for (i=0; i<input_len - 1; ++i) {
+                        if ((splits & (1U << i)) != 0) {
+                                if (i + 1 - last >= 8) {
+                                        break;
+                                }
+                                last = i + 1;
+                        }
+                }
+
+                if (i < input_len - 1 || input_len - last >= 8) {
+                        continue;
+                }
+
+                read_push_split(input, input_len, splits, result);
+                assert(strcmp(result, expected) == 0);
+        }
+}
+
+/* Test reading in push mode. */
+
+static void test_push(void)
+{
+        static const unsigned char utf16_input[] = {
+                0xff, 0xfe, '[', 0, '\"', 0, 'a', 0, 0xac, 0x20,
+                0x34, 0xd8, 0x1e, 0xdd, '\"', 0, ',', 0, ' ', 0,
+                '1', 0, '2', 0, ']', 0,
+        };
+        char long_input[600];
+        int i;
+
+        check_push_string("[\"abc\", \"\xc2\xa3\xe2\xa0\x81\xf0\x90\x90"
+                          "\x81\", \"a\\\"b\\\\c\\n\\u00e9\"]");
+        check_push_string("{\"key\": [true, false, null, -12.5e-3, 0, 1E5, "
+                          "-0.0, 123456789012345678901234, "
+                          "18446744073709551615, 1e+2]} ");
+        check_push_string("  12345678901234567  ");
+        check_push_string("[\"{\\\"a\\\": \\\"\\\\u00e9\\\"}\", "
+                          "\"\\u00e9\\u20ac\\t\\/\x01\", \"\\\"\"]");
+        check_push_string("");
+
+        /* Errors are reported in the same place. */
+
+        check_push_string("[tru]");
+        check_push_string("[1, \"abc\xff\"]");
+        check_push_string("[1.e5]");
+        check_push_string("[\"\\u12g4\"]");
+        check_push_string("[\"abc");
+        check_push_string("[\"a\\nb");
+        check_push_string("[\"a\\x\"]");
+        check_push_string("-");
+
+        /* A string longer than the reader's input buffer. */
+
+        long_input[0] = '\"';
+
+        for (i=1; i<500; ++i) {
+                long_input[i] = 'a' + (i % 26);
+        }
+
+        strcpy(long_input + i, "\"");
+        check_push_string(long_input);
+
+        /* UTF-16, where characters are also split between blocks. */
+
+        check_push(utf16_input, sizeof(utf16_input));
+}
+
+/* Test reading with a structural index, where the whitespace between
+ * tokens is skipped using the index.  Characters that follow a token
+ * directly are not in the index, and must still be read. */
+
+static void test_index(void)
+{
+        char pretty[1024];
+        JSONLexer *lexer;
+        int i;
+
+        check_push_string("  [ \"a\" , 1.5e3 ,\n\t null,\"\\\\\" ]  ");
+        check_push_string("{\"k\\\"\" :  \"v\\\\\"  , \"\xc3\xa9\": [12 , -3]}");
+        check_push_string("\xef\xbb\xbf [1 , 2]");
+        check_push_string("[12x, 3]");
+        check_push_string("[12 x, 3]");
+        check_push_string("[truex]");
+        check_push_string("[truefalse ]");
+        check_push_string("[1-2 , 3]");
+        check_push_string("[\"a\"x ]");
+        check_push_string("[1 , \"abc   ");
+        check_push_string("[1 \xc3\xa9]");
+        check_push_string("[1\xc3\xa9 ]");
+        check_push_string("[1 , 2   ");
+        check_push_string("   ");
+
+        /* Tokens bounded by the index, including ones that are left to
+         * be read in the usual way. */
+
+        check_push_string("[0, -0, 01, -01, 0.5, -12.25e-3, 1E+5, 7e2 ]");
+        check_push_string("[12345678901234567890123, 1.123456789012345678e5]");
+        check_push_string("[-, 1., .5, 1e, 1e+, 2E-x]");
+        check_push_string("[nul, fals ]");
+        check_push_string("[\"\", \"a\tb\", \"a\\nb\", \"a\x01\"]");
+        check_push_string("{\"\xe2\x82\xac\": \"\xf0\x90\x90\x81\"}");
+        check_push_string("[\"a\xc3\", 1]");
+
+        /* Indentation, with a string containing whitespace and 
+         * punctuation. */
+
+        strcpy(pretty, "{\n");
+
+        for (i=0; i<20; ++i) {
+                strcat(pretty, "        \"key\": [ \"{ a, b }\",  1 ],\n");
+        }
+
+        strcat(pretty, "        \"end\" : null\n}\n");
+        check_push_string(pretty);
+
+        /* The index cannot be enabled once reading has started. */
+
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_memory(json_lexer_get_reader(lexer), "[]", 2);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        assert(json_lexer_set_structural_index(lexer, 1)
+               == JSON_ERROR_INPUT_STREAM);
+        json_lexer_free(lexer);
+}
+
+/* Check that a document longer than the chunks that input is validated
+ * in is read in the same way with a structural index, whichever token
+ * crosses from one chunk into the next. */
+
+static void test_index_long(void)
+{
+        JSONLexer *lexers[2];
+        JSONToken tokens[2];
+        char results[2][256];
+        char *input;
+        size_t input_len;
+        int padding;
+        int i, j;
+
+        input = malloc(100000);
+        assert(input != NULL);
+
+        for (padding=0; padding<16; ++padding) {
+                input_len = 0;
+                input[input_len++] = '[';
+
+                for (i=0; i<padding; ++i) {
+                        input[input_len++] = ' ';
+                }
+
+                for (i=0; input_len < 90000; ++i) {
+                        input_len += sprintf(input + input_len,
+                                             "\"str \xc3\xa9 %i\", %i, true,",
+                                             i * 7, i * 13);
+                }
+
+                input_len += sprintf(input + input_len, "null]");
+
+                for (j=0; j<2; ++j) {
+                        lexers[j] = json_lexer_new(NULL);
+                        json_input_reader_init_memory(
+                                json_lexer_get_reader(lexers[j]),
+                                input, input_len);
+                        assert(json_lexer_set_structural_index(lexers[j], j)
+                               == 0);
+                }
+
+                do {
+                        for (j=0; j<2; ++j) {
+                                tokens[j] = json_lexer_read_token(lexers[j]);
+                                results[j][0] = '\0';
+                                describe_token(lexers[j], tokens[j],
+                                               results[j]);
+                        }
+
+                        assert(strcmp(results[0], results[1]) == 0);
+                } while (tokens[0] != JSON_TOKEN_EOF
+                      && tokens[0] != JSON_TOKEN_ERROR);
+
+                assert(tokens[0] == JSON_TOKEN_EOF);
+
+                for (j=0; j<2; ++j) {
+                        json_lexer_free(lexers[j]);
+                }
+        }
+
+        free(input);
+}
+
+/* Test that strings with no escape sequences are read in place when
+ * reading from memory, and copied otherwise. */
+
+static void test_in_place(void)
+{
+        static const char input[] = "[\"abc\", \"a\\nb\", \"\"]";
+        char writable[sizeof(input)];
+        ByteStream stream;
+        JSONLexer *lexer;
+        const char *data;
+        size_t length;
+
+        lexer = lexer_for_input(input, NULL);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(json_lexer_get_string(lexer, &data, &length));
+        assert(data == input + 2 && length == 3);
+
+        /* The buffer holds a NUL-terminated copy. */
+
+        assert(strcmp(json_lexer_get_buffer(lexer), "abc") == 0);
+
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(!json_lexer_get_string(lexer, &data, &length));
+        assert(length == 3 && strcmp(data, "a\nb") == 0);
+
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(json_lexer_get_string(lexer, &data, &length));
+        assert(data == input + 17 && length == 0);
+        json_lexer_free(lexer);
+
+        /* Strings that are unescaped in situ are NUL-terminated in 
+         * the input data. */
+
+        strcpy(writable, input);
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_in_situ(json_lexer_get_reader(lexer),
+                                       writable, strlen(writable));
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(json_lexer_get_string(lexer, &data, &length));
+        assert(data == writable + 2 && length == 3);
+        assert(json_lexer_get_buffer(lexer) == data);
+        assert(strcmp(data, "abc") == 0);
+
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_COMMA);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(json_lexer_get_string(lexer, &data, &length));
+        assert(data == writable + 9 && length == 3);
+        assert(strcmp(data, "a\nb") == 0);
+        json_lexer_free(lexer);
+
+        /* The maximum string length still applies. */
+
+        strcpy(writable, "\"abcd\" \"a\\ncde\"");
+        lexer = json_lexer_new(NULL);
+        json_input_reader_init_in_situ(json_lexer_get_reader(lexer),
+                                       writable, strlen(writable));
+        json_lexer_set_max_string_length(lexer, 4);
+        expect_string(lexer, "abcd");
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_ERROR);
+        json_lexer_free(lexer);
+
+        /* Input read through a callback is always copied. */
+
+        lexer = lexer_for_input(input, &stream);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_BEGIN_ARRAY);
+        assert(json_lexer_read_token(lexer) == JSON_TOKEN_STRING);
+        assert(!json_lexer_get_string(lexer, &data, &length));
+        assert(length == 3 && strcmp(data, "abc") == 0);
+        json_lexer_free(lexer);
+}
+
+int main(int argc, char *argv[])
+{
+        ByteStream stream;
+
+        test_strings(NULL);
+        test_strings(&stream);
+        test_numbers(NULL);
+        test_numbers(&stream);
+        test_keywords(NULL);
+        test_keywords(&stream);
+        test_push();
+        test_push_split();
+        test_index();
+        test_index_long();
+        test_in_place();
+
+        return 0;
+}
+
@@ -0,0 +1,144 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "jigsawn/error.h"
+
+#include "allocator.h"
+#include "number.h"
+#include "string-buffer.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+/* Convert a string of digits with an exponent, and check the result is
+ * the same as the C library gives. */
+
+static void check_conversion(const char *digits, int exponent)
+{
+        JSONStringBuffer buffer;
+        JSONNumber number;
+        char str[128];
+        double result, expected;
+        int i;
+
+        json_string_buffer_init(&buffer, &json_default_allocator);
+        json_number_init(&number);
+
+        for (i=0; digits[i] != '\0'; ++i) {
+                assert(json_number_add_digit(&number, digits[i] - '0', 0,
+                                             &buffer) == 0);
+        }
+
+        number.exponent += exponent;
+        result = json_number_to_double(&number, &buffer);
+
+        sprintf(str, "%se%i", digits, exponent);
+        expected = strtod(str, NULL);
+
+        if (memcmp(&result, &expected, sizeof(double)) != 0) {
+                fprintf(stderr, "%s: %.17g, expected %.17g\n",
+                        str, result, expected);
+                assert(0);
+        }
+
+        json_string_buffer_free(&buffer);
+}
+
+/* Generate a random 64-bit value. */
+
+static uint64_t random64(void)
+{
+        return ((uint64_t) (rand() & 0xffff) << 48)
+             ^ ((uint64_t) (rand() & 0xffff) << 32)
+             ^ ((uint64_t) (rand() & 0xffff) << 16)
+             ^ ((uint64_t) (rand() & 0xffff));
+}
+
+/* Mantissas of every length up to 20 digits, with exponents across 
+ * the whole range of doubles and beyond. */
+
+static void test_random(void)
+{
+        char digits[24];
+        uint64_t mantissa;
+        int exponent;
+        int len;
+        int i;
+
+        srand(1234);
+
+        for (i=0; i<200000; ++i) {
+                mantissa = random64();
+                len = sprintf(digits, "%" PRIu64, mantissa);
+                len = 1 + rand() % len;
+                digits[len] = '\0';
+                exponent = rand() % 700 - 350;
+
+                check_conversion(digits, exponent);
+        }
+}
+
+/* Values that are hard to round correctly: halfway between two 
+ * doubles, near the largest and smallest doubles, and subnormal. */
+
+static void test_edge_cases(void)
+{
+        static const struct {
+                const char *digits;
+                int exponent;
+        } cases[] = {
+                { "9007199254740993", 0 },       /* 2^53 + 1, halfway */
+                { "9007199254740995", 0 },
+                { "18014398509481987", 0 },
+                { "17976931348623157", 292 },    /* DBL_MAX */
+                { "17976931348623159", 292 },    /* Rounds to infinity */
+                { "22250738585072014", -324 },   /* DBL_MIN */
+                { "22250738585072011", -324 },   /* Subnormal */
+                { "49406564584124654", -340 },   /* Smallest subnormal */
+                { "24703282292062327", -340 },   /* Half of it */
+                { "7", -400 },
+                { "1", 400 },
+                { "12345678901234567890123", -5 },
+                { "30000000000000000000000000001", -28 },
+                { "10000000000000000000000000001", 0 },
+                { "4503599627370497", 0 },
+                { "7205759403792794", -16 },
+        };
+        int i;
+
+        for (i=0; i<ARRLEN(cases); ++i) {
+                check_conversion(cases[i].digits, cases[i].exponent);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        test_edge_cases();
+        test_random();
+
+        return 0;
+}
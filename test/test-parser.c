@@ -0,0 +1,912 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+#include "jigsawn/value.h"
+
+/* Read values from a push mode parser: the input arrives in 
+ * fragments, and values are read until more data is needed. */
+
+static void test_push(void)
+{
+        static const char *fragments[] = {
+                "12 \"ab", "c\\u00", "e9\" tr", "ue -1.", "5e1", NULL
+        };
+        char fragment[16];
+        JSONParser *parser;
+        JSONValue *value;
+        int values_read;
+        int i;
+
+        parser = json_parser_new(NULL, NULL);
+        assert(parser != NULL);
+
+        /* Nothing can be read before data is fed. */
+
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_NEED_MORE);
+
+        values_read = 0;
+
+        for (i=0; fragments[i] != NULL; ++i) {
+
+                /* The fragment buffer is reused for each fragment. */
+
+                strcpy(fragment, fragments[i]);
+                assert(json_parser_feed(parser, fragment,
+                                        strlen(fragment)) == 0);
+
+                for (;;) {
+                        value = json_parser_read_value(parser);
+
+                        if (value == NULL) {
+                                assert(json_parser_get_error(parser)
+                                       == JSON_ERROR_NEED_MORE);
+                                break;
+                        }
+
+                        switch (values_read) {
+                                case 0:
+                                        assert(json_int_get_value(value)
+                                               == 12);
+                                        break;
+                                case 1:
+                                        assert(strcmp(json_string_get_value(value),
+                                                      "abc\xc3\xa9") == 0);
+                                        break;
+                                case 2:
+                                        assert(json_boolean_get_value(value));
+                                        break;
+                                default:
+                                        assert(0);
+                        }
+
+                        ++values_read;
+                        json_value_free(value);
+                }
+
+                memset(fragment, 0, sizeof(fragment));
+        }
+
+        /* The last number is only complete at the end of the input. */
+
+        assert(values_read == 3);
+        assert(json_parser_feed(parser, NULL, 0) == 0);
+
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+        assert(json_float_get_value(value) == -15.0);
+
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_END_OF_FILE);
+
+        json_parser_free(parser);
+}
+
+/* Read values from data split into segments.  Values that cross 
+ * segment boundaries are read the same as any others. */
+
+static void test_iovec(void)
+{
+        static char segments[][8] = {
+                "12 \"ab", "c\\u00", "", "e9\" tr", "ue -1.", "5e1",
+        };
+        struct iovec iov[6];
+        JSONParser *parser;
+        JSONValue *value;
+        int i;
+
+        for (i=0; i<6; ++i) {
+                iov[i].iov_base = segments[i];
+                iov[i].iov_len = strlen(segments[i]);
+        }
+
+        parser = json_parser_new_from_iovec(iov, 6);
+        assert(parser != NULL);
+
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_int_get_value(value) == 12);
+        value = json_parser_read_value(parser);
+        assert(value != NULL
+               && strcmp(json_string_get_value(value), "abc\xc3\xa9") == 0);
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_boolean_get_value(value));
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_float_get_value(value) == -15.0);
+
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_END_OF_FILE);
+
+        json_parser_free(parser);
+}
+
+/* Feeding data at the wrong time is an error. */
+
+static void test_feed_errors(void)
+{
+        JSONParser *parser;
+
+        /* Parsers that read from memory cannot be fed. */
+
+        parser = json_parser_new_from_memory("1", 1);
+        assert(json_parser_feed(parser, "2", 1) == JSON_ERROR_INPUT_STREAM);
+        json_parser_free(parser);
+
+        /* All data must be read before more is fed. */
+
+        parser = json_parser_new(NULL, NULL);
+        assert(json_parser_feed(parser, "1 2 3 ", 6) == 0);
+        assert(json_parser_read_value(parser) != NULL);
+        assert(json_parser_feed(parser, "4", 1) == JSON_ERROR_INPUT_STREAM);
+        json_parser_free(parser);
+}
+
+/* Strings with no escape sequences are left in the input data when
+ * reading from memory.  All strings remain valid after later values
+ * have been read. */
+
+static void test_string_data(void)
+{
+        static const char input[] = "\"abc\" \"a\\nb\" \"caf\xc3\xa9\" 1";
+        char fragment[32];
+        JSONParser *parser;
+        JSONValue *values[3];
+        int i;
+
+        parser = json_parser_new_from_memory(input, strlen(input));
+        assert(parser != NULL);
+
+        for (i=0; i<3; ++i) {
+                values[i] = json_parser_read_value(parser);
+                assert(values[i] != NULL);
+                assert(json_value_get_type(values[i]) == JSON_VALUE_STRING);
+        }
+
+        assert(json_parser_read_value(parser) != NULL);
+
+        assert(json_string_get_data(values[0]) == input + 1);
+        assert(json_string_get_length(values[0]) == 3);
+        assert(strcmp(json_string_get_value(values[0]), "abc") == 0);
+
+        assert(json_string_get_length(values[1]) == 3);
+        assert(strcmp(json_string_get_value(values[1]), "a\nb") == 0);
+
+        assert(json_string_get_data(values[2]) == input + 14);
+        assert(json_string_get_length(values[2]) == 5);
+        assert(strcmp(json_string_get_value(values[2]),
+                      "caf\xc3\xa9") == 0);
+
+        for (i=0; i<3; ++i) {
+                json_value_free(values[i]);
+        }
+
+        json_parser_free(parser);
+
+        /* Values read in push mode are copied, and so are not 
+         * affected when the fed data is overwritten. */
+
+        strcpy(fragment, input);
+        parser = json_parser_new(NULL, NULL);
+        assert(json_parser_feed(parser, fragment, strlen(fragment)) == 0);
+
+        for (i=0; i<3; ++i) {
+                values[i] = json_parser_read_value(parser);
+                assert(values[i] != NULL);
+        }
+
+        memset(fragment, 0, sizeof(fragment));
+
+        assert(strcmp(json_string_get_value(values[0]), "abc") == 0);
+        assert(json_string_get_length(values[1]) == 3);
+        assert(strcmp(json_string_get_data(values[2]), "caf\xc3\xa9") == 0);
+
+        json_parser_free(parser);
+}
+
+/* A parser reading in situ unescapes strings in the input data, so 
+ * that strings with escape sequences are not copied either. */
+
+static void test_in_situ(void)
+{
+        char input[] = "\"abc\" \"{\\\"a\\\": \\\"b\\\"}\" 1";
+        JSONParser *parser;
+        JSONValue *values[2];
+        int i;
+
+        parser = json_parser_new_in_situ(input, strlen(input));
+        assert(parser != NULL);
+
+        for (i=0; i<2; ++i) {
+                values[i] = json_parser_read_value(parser);
+                assert(values[i] != NULL);
+                assert(json_value_get_type(values[i]) == JSON_VALUE_STRING);
+        }
+
+        assert(json_parser_read_value(parser) != NULL);
+
+        assert(json_string_get_value(values[0]) == input + 1);
+        assert(json_string_get_length(values[0]) == 3);
+        assert(strcmp(json_string_get_value(values[0]), "abc") == 0);
+
+        assert(json_string_get_value(values[1]) == input + 7);
+        assert(json_string_get_length(values[1]) == 10);
+        assert(strcmp(json_string_get_value(values[1]),
+                      "{\"a\": \"b\"}") == 0);
+
+        json_parser_free(parser);
+}
+
+/* Read the next value from an array or object, checking its type. */
+
+static JSONValue *expect_next(JSONValue *value, JSONValueType type)
+{
+        JSONValue *result;
+
+        assert(json_value_has_more(value));
+        result = json_value_read_next(value);
+        assert(result != NULL);
+        assert(json_value_get_type(result) == type);
+
+        return result;
+}
+
+/* Check that the end of an array or object is reached next. */
+
+static void expect_end(JSONParser *parser, JSONValue *value)
+{
+        assert(!json_value_has_more(value));
+        assert(json_value_read_next(value) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+}
+
+/* Read the contents of arrays and objects. */
+
+static void test_collections(void)
+{
+        static const char input[] =
+                "[1, [], [2, 3], {\"a\": [4], \"b\": \"x\"}, {}, \"y\"]";
+        JSONParser *parser;
+        JSONValue *array;
+        JSONValue *child;
+        JSONValue *object;
+        JSONValue *mapping;
+        JSONValue *value;
+
+        parser = json_parser_new_from_memory(input, strlen(input));
+        array = json_parser_read_value(parser);
+        assert(json_value_get_type(array) == JSON_VALUE_ARRAY);
+
+        value = expect_next(array, JSON_VALUE_INT);
+        assert(json_int_get_value(value) == 1);
+
+        child = expect_next(array, JSON_VALUE_ARRAY);
+        expect_end(parser, child);
+
+        child = expect_next(array, JSON_VALUE_ARRAY);
+        value = expect_next(child, JSON_VALUE_INT);
+        assert(json_int_get_value(value) == 2);
+        value = expect_next(child, JSON_VALUE_INT);
+        assert(json_int_get_value(value) == 3);
+        expect_end(parser, child);
+
+        object = expect_next(array, JSON_VALUE_OBJECT);
+        mapping = expect_next(object, JSON_VALUE_MAPPING);
+        assert(strcmp(json_mapping_get_key(mapping), "a") == 0);
+        child = json_mapping_get_value(mapping);
+        assert(json_value_get_type(child) == JSON_VALUE_ARRAY);
+        value = expect_next(child, JSON_VALUE_INT);
+        assert(json_int_get_value(value) == 4);
+        expect_end(parser, child);
+        json_value_free(mapping);
+
+        mapping = expect_next(object, JSON_VALUE_MAPPING);
+        assert(json_mapping_get_key_length(mapping) == 1);
+        assert(memcmp(json_mapping_get_key_data(mapping), "b", 1) == 0);
+        value = json_mapping_get_value(mapping);
+        assert(strcmp(json_string_get_value(value), "x") == 0);
+        expect_end(parser, object);
+
+        object = expect_next(array, JSON_VALUE_OBJECT);
+        expect_end(parser, object);
+
+        value = expect_next(array, JSON_VALUE_STRING);
+        assert(strcmp(json_string_get_value(value), "y") == 0);
+        expect_end(parser, array);
+
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_END_OF_FILE);
+
+        json_parser_free(parser);
+}
+
+/* Malformed arrays and objects are reported as parse errors. */
+
+static void check_collection_error(const char *input)
+{
+        JSONParser *parser;
+        JSONValue *value;
+        JSONValue *item;
+
+        parser = json_parser_new_from_memory(input, strlen(input));
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+
+        do {
+                item = json_value_read_next(value);
+        } while (item != NULL);
+
+        assert(json_parser_get_error(parser) == JSON_ERROR_PARSE);
+
+        json_parser_free(parser);
+}
+
+static void test_collection_errors(void)
+{
+        check_collection_error("[1 2]");
+        check_collection_error("[1, ]");
+        check_collection_error("[,]");
+        check_collection_error("[1, 2");
+        check_collection_error("{1: 2}");
+        check_collection_error("{\"a\" 2}");
+        check_collection_error("{\"a\": }");
+        check_collection_error("{\"a\": 1,}");
+        check_collection_error("[1, [2, 3]");
+}
+
+/* Input read through a callback, a few bytes at a time. */
+
+typedef struct {
+        const char *data;
+        size_t data_len;
+} TestSource;
+
+static int test_source_read(JSONInputSource source, unsigned char *data,
+                            size_t data_len)
+{
+        TestSource *test_source = source;
+
+        if (data_len > 3) {
+                data_len = 3;
+        }
+
+        if (data_len > test_source->data_len) {
+                data_len = test_source->data_len;
+        }
+
+        memcpy(data, test_source->data, data_len);
+        test_source->data += data_len;
+        test_source->data_len -= data_len;
+
+        return data_len;
+}
+
+/* Strings over the maximum length are reported as such, rather than
+ * as parse errors.  The input is read through a callback if mode is 1,
+ * or from memory with a structural index if mode is 2. */
+
+static void check_max_string_length(const char *input, int mode)
+{
+        TestSource source;
+        JSONParser *parser;
+        JSONValue *value;
+        JSONValue *item;
+
+        if (mode == 1) {
+                source.data = input;
+                source.data_len = strlen(input);
+                parser = json_parser_new(&source, test_source_read);
+        } else {
+                parser = json_parser_new_from_memory(input, strlen(input));
+        }
+
+        if (mode == 2) {
+                assert(json_parser_set_structural_index(parser, 1) == 0);
+        }
+
+        json_parser_set_max_string_length(parser, 4);
+        value = json_parser_read_value(parser);
+        assert(value != NULL);
+
+        do {
+                item = json_value_read_next(value);
+        } while (item != NULL);
+
+        assert(json_parser_get_error(parser) == JSON_ERROR_TOO_LONG);
+
+        json_parser_free(parser);
+}
+
+static void test_max_string_length(void)
+{
+        int i;
+
+        for (i=0; i<3; ++i) {
+                check_max_string_length("[\"abcd\", \"abcde\"]", i);
+                check_max_string_length("{\"abcd\": 1, \"abcde\": 2}", i);
+                check_max_string_length("{\"a\": \"abc\\u00e9\"}", i);
+        }
+}
+
+/* Values are skipped over, explicitly or by reading past them. */
+
+static const char skip_input[] =
+        "[{\"a\": [1, \"]}\\\"[{\", {\"b\": -2.5e3}], \"c\": {}}, "
+        "[[[\"\\\\\"]]], 7, {\"d\": [8]}, \"e\"]  9";
+
+/* Read skip_input, skipping some of the values in it. */
+
+static void read_skip_input(JSONParser *parser)
+{
+        JSONValue *array;
+        JSONValue *child;
+        JSONValue *mapping;
+        JSONValue *value;
+
+        array = json_parser_read_value(parser);
+        assert(array != NULL);
+
+        /* Skip explicitly. */
+
+        child = expect_next(array, JSON_VALUE_OBJECT);
+        assert(json_value_skip(child) == 0);
+        assert(json_value_read_next(child) == NULL);
+
+        /* Read past a value that was only partly read. */
+
+        child = expect_next(array, JSON_VALUE_ARRAY);
+        child = expect_next(child, JSON_VALUE_ARRAY);
+        value = expect_next(array, JSON_VALUE_INT);
+        assert(json_int_get_value(value) == 7);
+        assert(json_value_read_next(child) == NULL);
+
+        /* Skip the value of a mapping. */
+
+        child = expect_next(array, JSON_VALUE_OBJECT);
+        mapping = expect_next(child, JSON_VALUE_MAPPING);
+        assert(strcmp(json_mapping_get_key(mapping), "d") == 0);
+        assert(json_value_skip(mapping) == 0);
+        expect_end(parser, child);
+
+        value = expect_next(array, JSON_VALUE_STRING);
+        assert(strcmp(json_string_get_value(value), "e") == 0);
+}
+
+static void test_skip(void)
+{
+        JSONParser *parser;
+        JSONValue *value;
+        JSONValue *array;
+        int i;
+
+        /* From memory, with and without a structural index. */
+
+        for (i=0; i<2; ++i) {
+                parser = json_parser_new_from_memory(skip_input,
+                                                     strlen(skip_input));
+                assert(json_parser_set_structural_index(parser, i) == 0);
+                read_skip_input(parser);
+
+                /* Reading the next value at the top level skips the
+                 * rest of the array. */
+
+                value = json_parser_read_value(parser);
+                assert(value != NULL && json_int_get_value(value) == 9);
+                json_parser_free(parser);
+        }
+
+        /* The end is never found. */
+
+        parser = json_parser_new_from_memory("[[1, \"]\"], 2", 12);
+        array = json_parser_read_value(parser);
+        value = expect_next(array, JSON_VALUE_ARRAY);
+        assert(json_value_skip(array) == JSON_ERROR_PARSE);
+        json_parser_free(parser);
+}
+
+/* Skipping in push mode, with the input fed a byte at a time, so that
+ * skips are interrupted at every point. */
+
+static void test_skip_push(void)
+{
+        JSONParser *parser;
+        JSONValue *array;
+        JSONValue *child;
+        JSONValue *item;
+        JSONValue *value;
+        char c;
+        int i;
+
+        parser = json_parser_new(NULL, NULL);
+        array = NULL;
+        child = NULL;
+        value = NULL;
+
+        for (i=0; skip_input[i] != '\0'; ++i) {
+                c = skip_input[i];
+                assert(json_parser_feed(parser, &c, 1) == 0);
+
+                if (array == NULL) {
+                        array = json_parser_read_value(parser);
+                        continue;
+                } else if (child == NULL) {
+                        child = json_value_read_next(array);
+                        continue;
+                }
+
+                /* Skip the first two items by reading past them. */
+
+                item = NULL;
+
+                if (value == NULL) {
+                        item = json_value_read_next(array);
+
+                        if (item != NULL
+                         && json_value_get_type(item) == JSON_VALUE_INT) {
+                                value = item;
+                        }
+                } else {
+                        /* Skip the rest of the array, up to the number
+                         * at the end, which is not complete until the
+                         * end of the input. */
+
+                        item = json_parser_read_value(parser);
+                }
+
+                assert(item != NULL
+                    || json_parser_get_error(parser) == JSON_ERROR_NEED_MORE);
+        }
+
+        assert(value != NULL && json_int_get_value(value) == 7);
+
+        assert(json_parser_feed(parser, NULL, 0) == 0);
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_int_get_value(value) == 9);
+
+        json_parser_free(parser);
+}
+
+/* An interrupted skip is continued by a read that needs to skip 
+ * further out, or that would have needed a shorter skip. */
+
+static void test_skip_push_target(void)
+{
+        static const char input1[] = "[{\"a\": [1, 2, ";
+        static const char input2[] = "3], \"b\": 4}, 42]";
+        JSONParser *parser;
+        JSONValue *root;
+        JSONValue *object;
+        JSONValue *mapping;
+        JSONValue *inner;
+        JSONValue *value;
+        int i;
+
+        for (i=0; i<2; ++i) {
+                parser = json_parser_new(NULL, NULL);
+                assert(json_parser_feed(parser, input1, strlen(input1)) == 0);
+
+                root = json_parser_read_value(parser);
+                object = json_value_read_next(root);
+                mapping = json_value_read_next(object);
+                assert(mapping != NULL);
+                inner = json_mapping_get_value(mapping);
+                assert(json_value_get_type(inner) == JSON_VALUE_ARRAY);
+
+                if (i == 0) {
+                        /* Skip the inner array, then read the next 
+                         * value of the root, further out. */
+
+                        assert(json_value_skip(inner) == JSON_ERROR_NEED_MORE);
+                        assert(!json_value_has_more(root));
+                        assert(json_parser_get_error(parser)
+                               == JSON_ERROR_NEED_MORE);
+                        assert(json_parser_feed(parser, input2,
+                                                strlen(input2)) == 0);
+                        value = json_value_read_next(root);
+                        assert(value != NULL);
+                        assert(json_value_get_type(value) == JSON_VALUE_INT);
+                        assert(json_int_get_value(value) == 42);
+                } else {
+                        /* Skip the object, then read from the inner
+                         * array, which has been skipped past. */
+
+                        assert(json_value_skip(object) == JSON_ERROR_NEED_MORE);
+                        assert(json_value_read_next(inner) == NULL);
+                        assert(json_parser_get_error(parser)
+                               == JSON_ERROR_NEED_MORE);
+                        assert(json_parser_feed(parser, input2,
+                                                strlen(input2)) == 0);
+                        assert(json_value_read_next(inner) == NULL);
+                        assert(json_parser_get_error(parser)
+                               == JSON_ERROR_SUCCESS);
+                        assert(json_value_read_next(object) == NULL);
+                        value = json_value_read_next(root);
+                        assert(value != NULL && json_int_get_value(value) == 42);
+                }
+
+                json_parser_free(parser);
+        }
+}
+
+static const char find_input[] = 
+        "{\"a\": [1, {\"b\": 2}], \"b\": \"x\", \"c\\u0064\": 3, "
+        "\"e\": {\"f\": 4}, \"g\": true} 9";
+
+static void test_find(void)
+{
+        const char *keys[] = { "e", "cd", "a" };
+        JSONParser *parser;
+        JSONValue *object;
+        JSONValue *value;
+        int index;
+        int i;
+
+        for (i=0; i<2; ++i) {
+                parser = json_parser_new_from_memory(find_input,
+                                                     strlen(find_input));
+                assert(json_parser_set_structural_index(parser, i) == 0);
+                object = json_parser_read_value(parser);
+
+                /* Keys are matched after escapes are decoded; the key
+                 * "b" inside the array is not matched. */
+
+                value = json_object_find(object, "b");
+                assert(value != NULL 
+                    && strcmp(json_string_get_value(value), "x") == 0);
+                value = json_object_find(object, "cd");
+                assert(value != NULL && json_int_get_value(value) == 3);
+
+                /* Keys already passed are not found. */
+
+                assert(json_object_find(object, "a") == NULL);
+                assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+                assert(!json_value_has_more(object));
+
+                value = json_parser_read_value(parser);
+                assert(value != NULL && json_int_get_value(value) == 9);
+                json_parser_free(parser);
+        }
+
+        /* Several keys in one pass; the object found is read. */
+
+        parser = json_parser_new_from_memory(find_input, strlen(find_input));
+        object = json_parser_read_value(parser);
+        value = json_object_find_any(object, keys, 3, &index);
+        assert(value != NULL && index == 2);
+        assert(json_value_get_type(value) == JSON_VALUE_ARRAY);
+        value = json_object_find_any(object, keys, 3, &index);
+        assert(value != NULL && index == 1);
+        value = json_object_find_any(object, keys, 3, &index);
+        assert(value != NULL && index == 0);
+        value = json_object_find(value, "f");
+        assert(value != NULL && json_int_get_value(value) == 4);
+        assert(json_object_find_any(object, keys, 3, &index) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+
+        /* Not an object. */
+
+        value = json_parser_read_value(parser);
+        assert(json_object_find(value, "a") == NULL);
+        json_parser_free(parser);
+
+        /* Errors. */
+
+        parser = json_parser_new_from_memory("{\"a\": 1, 2: 3}", 14);
+        object = json_parser_read_value(parser);
+        assert(json_object_find(object, "b") == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_PARSE);
+        json_parser_free(parser);
+
+        parser = json_parser_new_from_memory("{\"a\": ]", 7);
+        object = json_parser_read_value(parser);
+        assert(json_object_find(object, "b") == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_PARSE);
+        json_parser_free(parser);
+}
+
+/* Searching in push mode, with the input fed a byte at a time. */
+
+static void test_find_push(void)
+{
+        JSONParser *parser;
+        JSONValue *object;
+        JSONValue *value;
+        char c;
+        int i;
+
+        parser = json_parser_new(NULL, NULL);
+        object = NULL;
+        value = NULL;
+
+        for (i=0; find_input[i] != '\0'; ++i) {
+                c = find_input[i];
+                assert(json_parser_feed(parser, &c, 1) == 0);
+
+                if (object == NULL) {
+                        object = json_parser_read_value(parser);
+                } else if (value == NULL) {
+                        value = json_object_find(object, "g");
+                } else {
+                        break;
+                }
+
+                assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS
+                    || json_parser_get_error(parser) == JSON_ERROR_NEED_MORE);
+        }
+
+        assert(value != NULL && json_boolean_get_value(value));
+
+        json_parser_free(parser);
+}
+
+static void test_register_keys(void)
+{
+        static const char input[] = 
+                "{\"name\": 1, \"other\": 2, \"i\\u0064\": 3, \"name\": 4}";
+        const char *keys[] = { "id", "name" };
+        const char *null_keys[2];
+        static const int expected_ids[] = { 1, -1, 0, 1 };
+        JSONParser *parser;
+        JSONValue *object;
+        JSONValue *mapping;
+        int i, j;
+
+        /* From memory, where keys are looked up in the input, and in
+         * push mode, where they are read into the lexer's buffer. */
+
+        for (i=0; i<2; ++i) {
+                if (i == 0) {
+                        parser = json_parser_new_from_memory(input,
+                                                             strlen(input));
+                } else {
+                        parser = json_parser_new(NULL, NULL);
+                }
+
+                assert(json_parser_register_keys(parser, keys, 2) == 0);
+
+                if (i == 1) {
+                        assert(json_parser_feed(parser, input,
+                                                strlen(input)) == 0);
+                }
+
+                object = json_parser_read_value(parser);
+                assert(object != NULL);
+
+                for (j=0; j<4; ++j) {
+                        mapping = json_value_read_next(object);
+                        assert(mapping != NULL);
+                        assert(json_mapping_get_key_id(mapping)
+                               == expected_ids[j]);
+                        assert(json_int_get_value(
+                                json_mapping_get_value(mapping)) == j + 1);
+
+                        if (expected_ids[j] >= 0) {
+                                assert(json_mapping_get_key(mapping) 
+                                       == json_mapping_get_key_data(mapping));
+                                assert(strcmp(json_mapping_get_key(mapping),
+                                              keys[expected_ids[j]]) == 0);
+                        } else {
+                                assert(json_mapping_get_key(mapping) == NULL);
+                                assert(json_mapping_get_key_length(mapping)
+                                       == 0);
+                        }
+                }
+
+                assert(json_value_read_next(object) == NULL);
+                assert(json_parser_get_error(parser) == JSON_ERROR_SUCCESS);
+
+                /* Too late to register keys now; bad arguments are
+                 * rejected first. */
+
+                assert(json_parser_register_keys(parser, keys, -1)
+                       == JSON_ERROR_INVALID_ARGUMENT);
+                assert(json_parser_register_keys(parser, NULL, 2)
+                       == JSON_ERROR_INVALID_ARGUMENT);
+
+                assert(json_parser_register_keys(parser, keys, 2)
+                       == JSON_ERROR_INPUT_STREAM);
+
+                json_parser_free(parser);
+        }
+
+        /* Without registered keys, there are no key IDs. */
+
+        parser = json_parser_new_from_memory(input, strlen(input));
+        null_keys[0] = "id";
+        null_keys[1] = NULL;
+        assert(json_parser_register_keys(parser, null_keys, 2)
+               == JSON_ERROR_INVALID_ARGUMENT);
+        object = json_parser_read_value(parser);
+        mapping = json_value_read_next(object);
+        assert(json_mapping_get_key_id(mapping) == -1);
+        assert(strcmp(json_mapping_get_key(mapping), "name") == 0);
+        json_parser_free(parser);
+}
+
+/* Keys are interned, so that identical keys share one copy. */
+
+static void test_intern_keys(void)
+{
+        static const char input[] = 
+                "[{\"id\": 1, \"name\": 2}, {\"name\": 3, \"i\\u0064\": 4}]";
+        JSONParserStats stats;
+        JSONParser *parser;
+        JSONValue *array;
+        JSONValue *object;
+        JSONValue *mapping;
+        const char *keys[4];
+        int i, j;
+
+        parser = json_parser_new_from_memory(input, strlen(input));
+        array = json_parser_read_value(parser);
+
+        for (i=0; i<2; ++i) {
+                object = json_value_read_next(array);
+                assert(object != NULL);
+
+                for (j=0; j<2; ++j) {
+                        mapping = json_value_read_next(object);
+                        assert(mapping != NULL);
+                        keys[i * 2 + j] = json_mapping_get_key(mapping);
+                        assert(keys[i * 2 + j]
+                               == json_mapping_get_key_data(mapping));
+                        json_value_free(mapping);
+                }
+        }
+
+        assert(strcmp(keys[0], "id") == 0 && keys[3] == keys[0]);
+        assert(strcmp(keys[1], "name") == 0 && keys[2] == keys[1]);
+
+        json_parser_get_stats(parser, &stats);
+        assert(stats.key_lookups == 4);
+        assert(stats.key_hits == 2);
+        assert(stats.distinct_keys == 2);
+        assert(stats.key_hit_rate == 0.5);
+
+        json_parser_free(parser);
+}
+
+int main(int argc, char *argv[])
+{
+        test_push();
+        test_iovec();
+        test_feed_errors();
+        test_string_data();
+        test_in_situ();
+        test_collections();
+        test_collection_errors();
+        test_max_string_length();
+        test_skip();
+        test_skip_push();
+        test_skip_push_target();
+        test_find();
+        test_find_push();
+        test_register_keys();
+        test_intern_keys();
+
+        return 0;
+}
+
@@ -0,0 +1,338 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "jigsawn/error.h"
+#include "jigsawn/parser.h"
+
+#include "input-reader.h"
+
+/* Test source that reads from a buffer in chunks of a fixed size,
+ * and can be made to fail after a number of bytes. */
+
+typedef struct {
+        const unsigned char *data;
+        size_t len;
+        size_t pos;
+        size_t chunk_size;
+        size_t fail_pos;
+} TestStream;
+
+static int test_read(void *source, unsigned char *buf, size_t buf_len)
+{
+        TestStream *stream = source;
+        size_t len;
+
+        if (stream->pos >= stream->fail_pos) {
+                return -1;
+        }
+
+        len = stream->len - stream->pos;
+
+        if (len > stream->chunk_size) {
+                len = stream->chunk_size;
+        }
+        if (len > buf_len) {
+                len = buf_len;
+        }
+
+        memcpy(buf, stream->data + stream->pos, len);
+        stream->pos += len;
+
+        return len;
+}
+
+static void init_stream(TestStream *stream,
+                        const unsigned char *data, size_t len,
+                        size_t chunk_size)
+{
+        stream->data = data;
+        stream->len = len;
+        stream->pos = 0;
+        stream->chunk_size = chunk_size;
+        stream->fail_pos = (size_t) -1;
+}
+
+/* Generate test data containing multi-byte UTF-8 characters, so that
+ * characters are split between buffers. */
+
+static unsigned char *generate_data(size_t *result_len)
+{
+        static const char record[] = "[\"caf\xc3\xa9\", \"\xe2\x82\xac\", "
+                                     "\"\xf0\x9d\x84\x9e\", 1234],\n";
+        unsigned char *result;
+        size_t record_len;
+        size_t len;
+        int i;
+
+        record_len = strlen(record);
+        result = malloc(record_len * 10000);
+        assert(result != NULL);
+        len = 0;
+
+        for (i=0; i<10000; ++i) {
+                memcpy(result + len, record, record_len);
+                len += record_len;
+        }
+
+        *result_len = len;
+
+        return result;
+}
+
+/* Read all characters from a reader, and check they match those 
+ * read from the same data in memory. */
+
+static void check_reader(JSONInputReader *reader,
+                         const unsigned char *data, size_t data_len,
+                         int expected_result)
+{
+        JSONInputReader expected_reader;
+        int c1, c2;
+
+        json_input_reader_init_memory(&expected_reader, data, data_len);
+
+        for (;;) {
+                c1 = json_input_read_char(reader);
+
+                if (c1 < 0) {
+                        break;
+                }
+
+                c2 = json_input_read_char(&expected_reader);
+                assert(c1 == c2);
+        }
+
+        assert(c1 == expected_result);
+
+        if (expected_result == JSON_ERROR_END_OF_FILE) {
+                assert(json_input_read_char(&expected_reader)
+                       == JSON_ERROR_END_OF_FILE);
+
+                /* Reading again after the end gives the same result. */
+
+                assert(json_input_read_char(reader)
+                       == JSON_ERROR_END_OF_FILE);
+        }
+}
+
+/* Read through readahead with various buffer and chunk sizes. */
+
+static void test_readahead(void)
+{
+        static const size_t buffer_sizes[] = { 1, 7, 4096, 1024 * 1024 };
+        static const size_t chunk_sizes[] = { 3, 1000, 1024 * 1024 };
+        JSONInputReader reader;
+        TestStream stream;
+        unsigned char *data;
+        size_t data_len;
+        unsigned int num_buffers;
+        int i, j;
+
+        data = generate_data(&data_len);
+
+        for (num_buffers=2; num_buffers<=4; num_buffers += 2) {
+                for (i=0; i<4; ++i) {
+                        for (j=0; j<3; ++j) {
+                                init_stream(&stream, data, data_len,
+                                            chunk_sizes[j]);
+                                json_input_reader_init(&reader, &stream,
+                                                       test_read);
+                                assert(json_input_reader_set_readahead(
+                                           &reader, num_buffers,
+                                           buffer_sizes[i]) == 0);
+                                check_reader(&reader, data, data_len,
+                                             JSON_ERROR_END_OF_FILE);
+                                json_input_reader_free(&reader);
+                        }
+                }
+        }
+
+        /* Empty input */
+
+        init_stream(&stream, data, 0, 1000);
+        json_input_reader_init(&reader, &stream, test_read);
+        assert(json_input_reader_set_readahead(&reader, 2, 64) == 0);
+        check_reader(&reader, data, 0, JSON_ERROR_END_OF_FILE);
+        json_input_reader_free(&reader);
+
+        free(data);
+}
+
+/* Errors from the read function are passed on to the reader. */
+
+static void test_read_error(void)
+{
+        JSONInputReader reader;
+        TestStream stream;
+        unsigned char *data;
+        size_t data_len;
+
+        data = generate_data(&data_len);
+
+        init_stream(&stream, data, data_len, 1000);
+        stream.fail_pos = 100000;
+        json_input_reader_init(&reader, &stream, test_read);
+        assert(json_input_reader_set_readahead(&reader, 4, 4096) == 0);
+        check_reader(&reader, data, data_len, JSON_ERROR_INPUT_STREAM);
+        json_input_reader_free(&reader);
+
+        free(data);
+}
+
+/* The reader can be freed while the thread is still reading, or is
+ * waiting for a free buffer. */
+
+static void test_early_free(void)
+{
+        JSONInputReader reader;
+        TestStream stream;
+        unsigned char *data;
+        size_t data_len;
+        int i;
+
+        data = generate_data(&data_len);
+
+        for (i=0; i<100; ++i) {
+                init_stream(&stream, data, data_len, 3);
+                json_input_reader_init(&reader, &stream, test_read);
+                assert(json_input_reader_set_readahead(&reader, 2, 16) == 0);
+                assert(json_input_read_char(&reader) == '[');
+                json_input_reader_free(&reader);
+        }
+
+        free(data);
+}
+
+/* Compressed data is read through readahead too. */
+
+static void test_compressed(void)
+{
+        JSONInputReader reader;
+        TestStream stream;
+        unsigned char *data, *compressed;
+        size_t data_len;
+        uLongf compressed_len;
+        z_stream zstream;
+
+        data = generate_data(&data_len);
+
+        compressed_len = compressBound(data_len) + 64;
+        compressed = malloc(compressed_len);
+        assert(compressed != NULL);
+
+        memset(&zstream, 0, sizeof(zstream));
+        assert(deflateInit2(&zstream, 6, Z_DEFLATED, MAX_WBITS + 16, 8,
+                            Z_DEFAULT_STRATEGY) == Z_OK);
+        zstream.next_in = data;
+        zstream.avail_in = data_len;
+        zstream.next_out = compressed;
+        zstream.avail_out = compressed_len;
+        assert(deflate(&zstream, Z_FINISH) == Z_STREAM_END);
+        compressed_len = zstream.total_out;
+        deflateEnd(&zstream);
+
+        init_stream(&stream, compressed, compressed_len, 1000);
+        json_input_reader_init(&reader, &stream, test_read);
+        assert(json_input_reader_set_readahead(&reader, 3, 4096) == 0);
+        check_reader(&reader, data, data_len, JSON_ERROR_END_OF_FILE);
+        json_input_reader_free(&reader);
+
+        free(compressed);
+        free(data);
+}
+
+/* Invalid uses of json_input_reader_set_readahead. */
+
+static void test_set_readahead(void)
+{
+        static const unsigned char data[] = "[1, 2, 3]";
+        JSONInputReader reader;
+        TestStream stream;
+
+        /* Too few buffers */
+
+        init_stream(&stream, data, sizeof(data) - 1, 1000);
+        json_input_reader_init(&reader, &stream, test_read);
+        assert(json_input_reader_set_readahead(&reader, 1, 4096)
+               == JSON_ERROR_INPUT_STREAM);
+
+        /* Already reading */
+
+        assert(json_input_read_char(&reader) == '[');
+        assert(json_input_reader_set_readahead(&reader, 2, 4096)
+               == JSON_ERROR_INPUT_STREAM);
+        json_input_reader_free(&reader);
+
+        /* No effect on memory sources */
+
+        json_input_reader_init_memory(&reader, data, sizeof(data) - 1);
+        assert(json_input_reader_set_readahead(&reader, 2, 4096) == 0);
+        assert(reader.block_source == NULL);
+        check_reader(&reader, data, sizeof(data) - 1,
+                     JSON_ERROR_END_OF_FILE);
+        json_input_reader_free(&reader);
+}
+
+/* Parse values with a parser that reads ahead. */
+
+static void test_parser(void)
+{
+        static const unsigned char data[] = "12 true \"abc\"";
+        JSONParser *parser;
+        JSONValue *value;
+        TestStream stream;
+
+        init_stream(&stream, data, sizeof(data) - 1, 5);
+        parser = json_parser_new(&stream, test_read);
+        assert(parser != NULL);
+        assert(json_parser_set_readahead(parser, 2, 4) == 0);
+
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_int_get_value(value) == 12);
+        value = json_parser_read_value(parser);
+        assert(value != NULL && json_boolean_get_value(value));
+        value = json_parser_read_value(parser);
+        assert(value != NULL
+               && strcmp(json_string_get_value(value), "abc") == 0);
+        assert(json_parser_read_value(parser) == NULL);
+        assert(json_parser_get_error(parser) == JSON_ERROR_END_OF_FILE);
+
+        json_parser_free(parser);
+}
+
+int main(int argc, char *argv[])
+{
+        test_readahead();
+        test_read_error();
+        test_early_free();
+        test_compressed();
+        test_set_readahead();
+        test_parser();
+
+        return 0;
+}
@@ -0,0 +1,160 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "allocator.h"
+#include "string-buffer.h"
+
+/* Allocator that counts calls to realloc. */
+
+static int realloc_count;
+
+static void *counting_alloc(void *user_data, size_t size)
+{
+        return malloc(size);
+}
+
+static void *counting_realloc(void *user_data, void *ptr, size_t size)
+{
+        ++realloc_count;
+        return realloc(ptr, size);
+}
+
+static void counting_free(void *user_data, void *ptr)
+{
+        free(ptr);
+}
+
+static const JSONAllocator counting_allocator = {
+        counting_alloc,
+        counting_realloc,
+        counting_free,
+        NULL,
+};
+
+/* The buffer grows geometrically, so only a logarithmic number of
+ * reallocations are needed. */
+
+static void test_growth(void)
+{
+        JSONStringBuffer buffer;
+        unsigned char *data;
+        int i;
+
+        json_string_buffer_init(&buffer, &counting_allocator);
+        realloc_count = 0;
+
+        for (i=0; i<1000000; ++i) {
+                assert(json_string_buffer_put_char(&buffer, 'a' + i % 26)
+                       == JSON_ERROR_SUCCESS);
+        }
+
+        assert(buffer.buffer_len == 1000000);
+        assert(realloc_count < 20);
+
+        data = json_string_buffer_get(&buffer);
+
+        for (i=0; i<1000000; ++i) {
+                assert(data[i] == 'a' + i % 26);
+        }
+
+        json_string_buffer_free(&buffer);
+}
+
+/* Reserving space in advance avoids further reallocations. */
+
+static void test_reserve(void)
+{
+        JSONStringBuffer buffer;
+        unsigned char block[1000];
+        int i;
+
+        memset(block, 'x', sizeof(block));
+
+        json_string_buffer_init(&buffer, &counting_allocator);
+        json_string_buffer_put_char(&buffer, 'a');
+
+        realloc_count = 0;
+        assert(json_string_buffer_reserve(&buffer, 100 * sizeof(block))
+               == JSON_ERROR_SUCCESS);
+        assert(realloc_count == 1);
+
+        for (i=0; i<100; ++i) {
+                json_string_buffer_put_bytes(&buffer, block, sizeof(block));
+        }
+
+        assert(realloc_count == 1);
+        assert(buffer.buffer_len == 100 * sizeof(block) + 1);
+
+        /* Space that is already available does not need to be 
+         * reserved again. */
+
+        json_string_buffer_reset(&buffer);
+        assert(json_string_buffer_reserve(&buffer, 50 * sizeof(block))
+               == JSON_ERROR_SUCCESS);
+        assert(realloc_count == 1);
+
+        json_string_buffer_free(&buffer);
+}
+
+/* Data cannot be added beyond the maximum size. */
+
+static void test_max_size(void)
+{
+        JSONStringBuffer buffer;
+        unsigned char block[100];
+        int i;
+
+        memset(block, 'x', sizeof(block));
+
+        json_string_buffer_init(&buffer, &json_default_allocator);
+        json_string_buffer_set_max_size(&buffer, 1000);
+
+        for (i=0; i<10; ++i) {
+                assert(json_string_buffer_put_bytes(&buffer, block,
+                                                    sizeof(block))
+                       == JSON_ERROR_SUCCESS);
+        }
+
+        assert(buffer.buffer_allocated == 1000);
+        assert(json_string_buffer_put_char(&buffer, 'a')
+               == JSON_ERROR_TOO_LONG);
+        assert(json_string_buffer_reserve(&buffer, 1) == JSON_ERROR_TOO_LONG);
+        assert(buffer.buffer_len == 1000);
+
+        json_string_buffer_free(&buffer);
+}
+
+int main(int argc, char *argv[])
+{
+        test_growth();
+        test_reserve();
+        test_max_size();
+
+        return 0;
+}
+
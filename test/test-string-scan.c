@@ -0,0 +1,110 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "string-scan.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse2", "avx2" };
+
+/* Bytes that should stop the scanner, and some that should not. */
+
+static const unsigned char special_bytes[] = {
+        '\"', '\\', 0x00, 0x0a, 0x1f, 0x80, 0xc2, 0xff
+};
+
+static const unsigned char ordinary_bytes[] = {
+        ' ', 'a', '/', '~', 0x7f
+};
+
+/* Check a scanner finds a special byte at every position, in blocks
+ * of every length up to 100 bytes.  Scanners for trusted data do not
+ * stop at non-ASCII bytes. */
+
+static void test_impl(JSONStringScanFunc scan, int trusted)
+{
+        unsigned char buf[100];
+        size_t len, pos;
+        int i, j;
+
+        for (len=0; len<=sizeof(buf); ++len) {
+
+                /* No special bytes at all */
+
+                for (j=0; j<ARRLEN(ordinary_bytes); ++j) {
+                        memset(buf, ordinary_bytes[j], len);
+                        assert(scan(buf, len) == len);
+                }
+
+                for (pos=0; pos<len; ++pos) {
+                        for (i=0; i<ARRLEN(special_bytes); ++i) {
+                                memset(buf, 'x', len);
+                                buf[pos] = special_bytes[i];
+
+                                /* A second special byte after the
+                                 * first should be ignored. */
+
+                                if (pos + 1 < len) {
+                                        buf[len - 1] = '\"';
+                                }
+
+                                if (trusted && special_bytes[i] >= 0x80) {
+                                        assert(scan(buf, len)
+                                               == (pos + 1 < len ? len - 1
+                                                                 : len));
+                                } else {
+                                        assert(scan(buf, len) == pos);
+                                }
+                        }
+                }
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        JSONStringScanFunc scan;
+        int i;
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                scan = json_string_scan_get_impl(impl_names[i]);
+
+                if (scan != NULL) {
+                        test_impl(scan, 0);
+                }
+
+                scan = json_string_scan_trusted_get_impl(impl_names[i]);
+
+                if (scan != NULL) {
+                        test_impl(scan, 1);
+                }
+        }
+
+        test_impl(json_string_scan, 0);
+        test_impl(json_string_scan_trusted, 1);
+
+        return 0;
+}
+
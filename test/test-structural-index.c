@@ -0,0 +1,320 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "allocator.h"
+#include "structural-index.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse2", "avx2" };
+
+/* Reference implementation of the structural scan, a character at a 
+ * time.  As in the real implementations, backslashes escape quotes 
+ * wherever they appear. */
+
+static size_t reference_scan(const unsigned char *data, size_t data_len,
+                             size_t *positions)
+{
+        size_t result;
+        size_t i;
+        int in_string, escaped, next_escaped, follows_separator;
+
+        result = 0;
+        in_string = 0;
+        next_escaped = 0;
+        follows_separator = 1;
+
+        for (i=0; i<data_len; ++i) {
+                escaped = next_escaped;
+                next_escaped = data[i] == '\\' && !escaped;
+
+                if (data[i] == '"' && !escaped) {
+                        positions[result++] = i;
+                        in_string = !in_string;
+                        follows_separator = 1;
+                } else if (in_string) {
+                        follows_separator = 0;
+                } else if (strchr("[]{}:,", data[i]) != NULL) {
+                        positions[result++] = i;
+                        follows_separator = 1;
+                } else if (strchr(" \t\r\n", data[i]) != NULL) {
+                        follows_separator = 1;
+                } else {
+                        if (follows_separator) {
+                                positions[result++] = i;
+                        }
+
+                        follows_separator = 0;
+                }
+        }
+
+        return result;
+}
+
+/* Scan data with an implementation, in two parts split at the given
+ * offset (a multiple of the block size), and check that the result 
+ * matches the reference implementation. */
+
+static void check_scan(JSONStructuralScanFunc scan,
+                       const unsigned char *data, size_t data_len,
+                       size_t split)
+{
+        JSONStructuralState state;
+        size_t expected[400], result[400];
+        size_t expected_len, result_len;
+
+        assert(data_len <= ARRLEN(expected));
+
+        if (split > data_len) {
+                split = data_len;
+        }
+
+        expected_len = reference_scan(data, data_len, expected);
+
+        json_structural_state_init(&state);
+        result_len = scan(data, split, 0, &state, result);
+        result_len += scan(data + split, data_len - split, split, &state,
+                           result + result_len);
+
+        assert(result_len == expected_len);
+        assert(!memcmp(result, expected, expected_len * sizeof(size_t)));
+}
+
+static void test_document(JSONStructuralScanFunc scan)
+{
+        static const size_t expected[] = {
+                0, 1, 3, 4, 6, 7, 8, 10, 14, 15, 17, 21, 22, 24, 28, 29
+        };
+        const char *doc = "{\"a\": [1, true], \"b\\\"\": \"x y\"}";
+        JSONStructuralState state;
+        size_t result[64];
+
+        json_structural_state_init(&state);
+        assert(scan((const unsigned char *) doc, strlen(doc), 0,
+                    &state, result) == ARRLEN(expected));
+        assert(!memcmp(result, expected, sizeof(expected)));
+}
+
+/* Runs of backslashes of each length, before a quote at each position
+ * around a block boundary. */
+
+static void test_escapes(JSONStructuralScanFunc scan)
+{
+        unsigned char buf[200];
+        size_t quote_pos;
+        int run;
+
+        for (run=0; run<6; ++run) {
+                for (quote_pos=50; quote_pos<140; ++quote_pos) {
+                        memset(buf, 'a', sizeof(buf));
+                        buf[0] = '[';
+                        buf[1] = '"';
+                        memset(buf + quote_pos - run, '\\', run);
+                        buf[quote_pos] = '"';
+                        buf[quote_pos + 1] = ',';
+                        buf[quote_pos + 2] = '1';
+
+                        check_scan(scan, buf, sizeof(buf), 0);
+                        check_scan(scan, buf, sizeof(buf), 64);
+                        check_scan(scan, buf, sizeof(buf), 128);
+                }
+        }
+}
+
+/* Random data made of the characters that matter to the scan. */
+
+static void test_random(JSONStructuralScanFunc scan)
+{
+        static const char chars[] = "\"\"\\\\ \n[]{}:,a1";
+        unsigned char buf[300];
+        size_t len;
+        size_t i;
+        int n;
+
+        srand(4321);
+
+        for (n=0; n<20000; ++n) {
+                len = rand() % sizeof(buf);
+
+                for (i=0; i<len; ++i) {
+                        buf[i] = chars[rand() % (sizeof(chars) - 1)];
+                }
+
+                check_scan(scan, buf, len, (rand() % 5) * 64);
+        }
+}
+
+/* Build the index of a document that is larger than the chunk size
+ * used to build it, so that the positions array is enlarged. */
+
+static void test_build(void)
+{
+        static const char record[] = "{\"a\\\\\": [1, \"x\\\"\"], \"b\": 2}, ";
+        JSONStructuralIndex index;
+        unsigned char *data;
+        size_t *expected;
+        size_t expected_len;
+        size_t data_len;
+        size_t i;
+
+        data_len = 300000;
+        data = malloc(data_len);
+        expected = malloc(data_len * sizeof(size_t));
+        assert(data != NULL && expected != NULL);
+
+        for (i=0; i<data_len; ++i) {
+                data[i] = record[i % (sizeof(record) - 1)];
+        }
+
+        expected_len = reference_scan(data, data_len, expected);
+
+        json_structural_index_init(&index, &json_default_allocator);
+        assert(json_structural_index_build(&index, data, data_len) == 0);
+        assert(index.num_positions == expected_len);
+        assert(!memcmp(index.positions, expected,
+                       expected_len * sizeof(size_t)));
+
+        /* Building again replaces the old positions. */
+
+        assert(json_structural_index_build(&index, data, 10) == 0);
+        assert(index.num_positions == reference_scan(data, 10, expected));
+
+        assert(json_structural_index_build(&index, data, 0) == 0);
+        assert(index.num_positions == 0);
+
+        json_structural_index_free(&index);
+        free(expected);
+        free(data);
+}
+
+/* Check that building an index with several threads gives the same
+ * result as with one. */
+
+static void check_parallel(const unsigned char *data, size_t data_len,
+                           unsigned int num_threads)
+{
+        JSONStructuralIndex expected, result;
+
+        json_structural_index_init(&expected, &json_default_allocator);
+        json_structural_index_init(&result, &json_default_allocator);
+
+        assert(json_structural_index_build(&expected, data, data_len) == 0);
+        assert(json_structural_index_build_parallel(&result, data, data_len,
+                                                    num_threads) == 0);
+
+        assert(result.num_positions == expected.num_positions);
+        assert(!memcmp(result.positions, expected.positions,
+                       expected.num_positions * sizeof(size_t)));
+
+        json_structural_index_free(&expected);
+        json_structural_index_free(&result);
+}
+
+/* Sequences that a chunk boundary can fall inside: the state at the
+ * start of the next chunk depends on the characters before it. */
+
+static const char *boundary_sequences[] = {
+        "[\"abc\"]", "\"a\\\"b\"", "\"a\\\\\"1", "\\\\\\\"\"",
+        "1,true", "12 34", "\"x\"y", "\"{,}\"1", "a\\\"b",
+};
+
+static void test_parallel(void)
+{
+        static const char *pieces[] = {
+                "\"", "\\", "\\\\", "\\\"", " ", "\n", "[", "]", "{", "}",
+                ",", ":", "a", "12", "true",
+        };
+        const char *piece;
+        unsigned char *data;
+        size_t data_len, seq_len;
+        size_t i, j;
+        unsigned int n;
+
+        /* Two chunks, with the boundary at each position in each 
+         * sequence. */
+
+        data_len = 4 * 1024 * 1024;
+        data = malloc(data_len);
+        assert(data != NULL);
+
+        for (i=0; i<ARRLEN(boundary_sequences); ++i) {
+                seq_len = strlen(boundary_sequences[i]);
+
+                for (j=0; j<=seq_len; ++j) {
+                        memset(data, ' ', data_len);
+                        memcpy(data + data_len / 2 - j,
+                               boundary_sequences[i], seq_len);
+                        check_parallel(data, data_len, 2);
+                }
+        }
+
+        /* Random data, with different numbers of threads. */
+
+        srand(8765);
+
+        for (i=0; i<data_len; i += j) {
+                piece = pieces[rand() % ARRLEN(pieces)];
+                j = strlen(piece);
+
+                if (i + j > data_len) {
+                        j = data_len - i;
+                }
+
+                memcpy(data + i, piece, j);
+        }
+
+        for (n=0; n<=6; ++n) {
+                check_parallel(data, data_len, n);
+        }
+
+        free(data);
+}
+
+int main(int argc, char *argv[])
+{
+        JSONStructuralScanFunc scan;
+        int i;
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                scan = json_structural_scan_get_impl(impl_names[i]);
+
+                if (scan == NULL) {
+                        printf("%s not supported\n", impl_names[i]);
+                        continue;
+                }
+
+                test_document(scan);
+                test_escapes(scan);
+                test_random(scan);
+        }
+
+        test_build();
+        test_parallel();
+
+        return 0;
+}
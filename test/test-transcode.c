@@ -0,0 +1,317 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "transcode.h"
+#include "utf8.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse2" };
+
+static const JSONInputEncoding encodings[] = {
+        JSON_ENCODING_16LE, JSON_ENCODING_16BE,
+        JSON_ENCODING_32LE, JSON_ENCODING_32BE,
+};
+
+/* Characters used to build test input, mostly ASCII. */
+
+static const int test_chars[] = {
+        'a', 'b', ' ', '\"', '{', 0x00, 0x7f,
+        0x80, 0xe9, 0x7ff, 0x800, 0x20ac, 0xd7ff, 0xe000, 0xfffd, 0xffff,
+        0x10000, 0x1d11e, 0x10ffff,
+};
+
+/* Encode a code unit in the specified encoding. */
+
+static size_t encode_unit(JSONInputEncoding encoding, unsigned int unit,
+                          unsigned char *buf)
+{
+        switch (encoding) {
+                case JSON_ENCODING_16LE:
+                        buf[0] = unit & 0xff;
+                        buf[1] = (unit >> 8) & 0xff;
+                        return 2;
+                case JSON_ENCODING_16BE:
+                        buf[0] = (unit >> 8) & 0xff;
+                        buf[1] = unit & 0xff;
+                        return 2;
+                case JSON_ENCODING_32LE:
+                        buf[0] = unit & 0xff;
+                        buf[1] = (unit >> 8) & 0xff;
+                        buf[2] = (unit >> 16) & 0xff;
+                        buf[3] = (unit >> 24) & 0xff;
+                        return 4;
+                default:
+                        buf[0] = (unit >> 24) & 0xff;
+                        buf[1] = (unit >> 16) & 0xff;
+                        buf[2] = (unit >> 8) & 0xff;
+                        buf[3] = unit & 0xff;
+                        return 4;
+        }
+}
+
+/* Encode a character in the specified encoding, using a surrogate 
+ * pair for UTF-16 where needed. */
+
+static size_t encode_char(JSONInputEncoding encoding, int c,
+                          unsigned char *buf)
+{
+        size_t len;
+
+        if (c >= 0x10000 && (encoding == JSON_ENCODING_16LE
+                          || encoding == JSON_ENCODING_16BE)) {
+                c -= 0x10000;
+                len = encode_unit(encoding, 0xd800 + (c >> 10), buf);
+                return len + encode_unit(encoding, 0xdc00 + (c & 0x3ff),
+                                         buf + len);
+        }
+
+        return encode_unit(encoding, c, buf);
+}
+
+/* Build a test string from random characters: the input in the 
+ * specified encoding, and the UTF-8 output expected.  The offsets in
+ * the input where each character starts are saved. */
+
+static int build_input(JSONInputEncoding encoding, int num_chars,
+                       int ascii_only,
+                       unsigned char *input, size_t *input_len,
+                       unsigned char *expected, size_t *expected_len,
+                       size_t *offsets)
+{
+        size_t in_len, out_len, len;
+        int c;
+        int i;
+
+        in_len = 0;
+        out_len = 0;
+
+        for (i=0; i<num_chars; ++i) {
+                if (ascii_only || rand() % 4 != 0) {
+                        c = test_chars[rand() % 7];
+                } else {
+                        c = test_chars[rand() % ARRLEN(test_chars)];
+                }
+
+                offsets[i] = in_len;
+                in_len += encode_char(encoding, c, input + in_len);
+                json_utf8_encode(c, expected + out_len, &len);
+                out_len += len;
+        }
+
+        offsets[num_chars] = in_len;
+        *input_len = in_len;
+        *expected_len = out_len;
+
+        return num_chars;
+}
+
+/* Check conversion of valid input, including runs long enough to use 
+ * the vectorized code. */
+
+static void test_valid(JSONTranscodeFunc transcode,
+                       JSONInputEncoding encoding)
+{
+        unsigned char input[400 * 4];
+        unsigned char expected[400 * 4];
+        unsigned char output[400 * 4];
+        size_t offsets[401];
+        size_t input_len, expected_len;
+        size_t in_used, out_used;
+        int num_chars;
+        int i;
+
+        for (i=0; i<2000; ++i) {
+                num_chars = build_input(encoding, rand() % 400, i % 2,
+                                        input, &input_len,
+                                        expected, &expected_len, offsets);
+
+                assert(transcode(encoding, input, input_len, &in_used,
+                                 output, sizeof(output), &out_used) == 0);
+                assert(in_used == input_len);
+                assert(out_used == expected_len);
+                assert(!memcmp(output, expected, expected_len));
+                assert(offsets[num_chars] == input_len);
+        }
+}
+
+/* Check that input cut short part way through a character is 
+ * converted up to the start of that character. */
+
+static void test_incomplete(JSONTranscodeFunc transcode,
+                            JSONInputEncoding encoding)
+{
+        unsigned char input[100 * 4];
+        unsigned char expected[100 * 4];
+        unsigned char output[100 * 4];
+        size_t offsets[101];
+        size_t input_len, expected_len;
+        size_t in_used, out_used;
+        size_t len;
+        int i;
+
+        build_input(encoding, 100, 0, input, &input_len,
+                    expected, &expected_len, offsets);
+
+        for (len=0; len<=input_len; ++len) {
+                assert(transcode(encoding, input, len, &in_used,
+                                 output, sizeof(output), &out_used) == 0);
+
+                for (i=0; i < 100 && offsets[i + 1] <= len; ++i);
+
+                assert(in_used == offsets[i]);
+                assert(!memcmp(output, expected, out_used));
+        }
+}
+
+/* Check conversion into a small output buffer, a piece at a time. */
+
+static void test_output_space(JSONTranscodeFunc transcode,
+                              JSONInputEncoding encoding)
+{
+        unsigned char input[200 * 4];
+        unsigned char expected[200 * 4];
+        unsigned char output[200 * 4];
+        size_t offsets[201];
+        size_t input_len, expected_len;
+        size_t in_pos, out_pos;
+        size_t in_used, out_used;
+        size_t space;
+
+        for (space=4; space<40; ++space) {
+                build_input(encoding, 200, space % 2, input, &input_len,
+                            expected, &expected_len, offsets);
+
+                in_pos = 0;
+                out_pos = 0;
+
+                while (in_pos < input_len) {
+                        assert(transcode(encoding,
+                                         input + in_pos, input_len - in_pos,
+                                         &in_used, output + out_pos, space,
+                                         &out_used) == 0);
+                        assert(in_used > 0 && out_used <= space);
+                        in_pos += in_used;
+                        out_pos += out_used;
+                }
+
+                assert(out_pos == expected_len);
+                assert(!memcmp(output, expected, expected_len));
+        }
+}
+
+/* Invalid characters: unpaired surrogates, and (for UTF-32) 
+ * characters beyond U+10FFFF. */
+
+static void test_invalid(JSONTranscodeFunc transcode,
+                         JSONInputEncoding encoding)
+{
+        static const unsigned int invalid_utf16[][2] = {
+                { 0xd800, 'a' }, { 0xdbff, 0xdbff }, { 0xdc00, 'a' },
+                { 0xdfff, 0xdc00 },
+        };
+        static const unsigned int invalid_utf32[] = {
+                0xd800, 0xdfff, 0x110000, 0xffffffff,
+        };
+        unsigned char input[100 * 4 + 8];
+        unsigned char output[100 * 4];
+        size_t input_len;
+        size_t in_used, out_used;
+        size_t pos, unit_len;
+        int i;
+
+        unit_len = encode_unit(encoding, 'a', input);
+
+        for (pos=0; pos<100; ++pos) {
+                for (i=0; i<4; ++i) {
+                        input_len = 0;
+
+                        while (input_len < pos * unit_len) {
+                                input_len += encode_unit(encoding, 'a',
+                                                         input + input_len);
+                        }
+
+                        if (unit_len == 2) {
+                                input_len += encode_unit(encoding,
+                                        invalid_utf16[i][0],
+                                        input + input_len);
+                                input_len += encode_unit(encoding,
+                                        invalid_utf16[i][1],
+                                        input + input_len);
+                        } else {
+                                input_len += encode_unit(encoding,
+                                        invalid_utf32[i],
+                                        input + input_len);
+                        }
+
+                        while (input_len < sizeof(input)) {
+                                input_len += encode_unit(encoding, 'a',
+                                                         input + input_len);
+                        }
+
+                        assert(transcode(encoding, input, input_len,
+                                         &in_used, output, sizeof(output),
+                                         &out_used) == JSON_ERROR_ENCODING);
+                        assert(in_used == pos * unit_len);
+                        assert(out_used == pos);
+                }
+        }
+}
+
+static void test_impl(JSONTranscodeFunc transcode)
+{
+        int i;
+
+        for (i=0; i<ARRLEN(encodings); ++i) {
+                test_valid(transcode, encodings[i]);
+                test_incomplete(transcode, encodings[i]);
+                test_output_space(transcode, encodings[i]);
+                test_invalid(transcode, encodings[i]);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        JSONTranscodeFunc transcode;
+        int i;
+
+        srand(4321);
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                transcode = json_transcode_get_impl(impl_names[i]);
+
+                if (transcode != NULL) {
+                        test_impl(transcode);
+                }
+        }
+
+        test_impl(json_transcode_to_utf8);
+
+        return 0;
+}
+
@@ -0,0 +1,273 @@
+
+/*
+
+Copyright (c) 2008, Simon Howard 
+
+Permission to use, copy, modify, and/or distribute this software 
+for any purpose with or without fee is hereby granted, provided 
+that the above copyright notice and this permission notice appear 
+in all copies. 
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL 
+WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE 
+AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR 
+CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM 
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, 
+NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN 
+CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. 
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "jigsawn/error.h"
+
+#include "input-reader.h"
+#include "utf8-validate.h"
+
+#define ARRLEN(x) (sizeof(x) / sizeof(*x))
+
+static const char *impl_names[] = { "scalar", "sse4", "avx2" };
+
+/* A sequence for the test corpus, with the length of the valid 
+ * prefix of the sequence (which is the length of the sequence if it
+ * is valid). */
+
+typedef struct {
+        const char *bytes;
+        size_t valid_len;
+} TestSequence;
+
+#define VALID(s)  { s, sizeof(s) - 1 }
+
+static const TestSequence test_corpus[] = {
+
+        /* Valid sequences, including the limits of each length. */
+
+        VALID("\x7f"),
+        VALID("\xc2\x80"),
+        VALID("\xdf\xbf"),
+        VALID("\xe0\xa0\x80"),
+        VALID("\xed\x9f\xbf"),                /* U+D7FF */
+        VALID("\xee\x80\x80"),                /* U+E000 */
+        VALID("\xef\xbf\xbf"),
+        VALID("\xf0\x90\x80\x80"),
+        VALID("\xf4\x8f\xbf\xbf"),            /* U+10FFFF */
+        VALID("\xe2\x82\xac\xc2\xa3"),
+
+        /* Overlong encodings */
+
+        { "\xc0\x80", 0 },
+        { "\xc1\xbf", 0 },
+        { "\xe0\x80\x80", 0 },
+        { "\xe0\x9f\xbf", 0 },
+        { "\xf0\x80\x80\x80", 0 },
+        { "\xf0\x8f\xbf\xbf", 0 },
+
+        /* Surrogates */
+
+        { "\xed\xa0\x80", 0 },
+        { "\xed\xbf\xbf", 0 },
+        { "\xed\xa0\x80\xed\xb0\x80", 0 },
+
+        /* Beyond U+10FFFF */
+
+        { "\xf4\x90\x80\x80", 0 },
+        { "\xf5\x80\x80\x80", 0 },
+        { "\xf7\xbf\xbf\xbf", 0 },
+        { "\xf8\x88\x80\x80\x80", 0 },
+        { "\xfc\x84\x80\x80\x80\x80", 0 },
+        { "\xfe", 0 },
+        { "\xff", 0 },
+
+        /* Unexpected continuation bytes */
+
+        { "\x80", 0 },
+        { "\xbf", 0 },
+        { "\xc2\x80\x80", 2 },
+        { "\xe2\x82\xac\x80", 3 },
+        { "\xf0\x90\x80\x80\x80", 4 },
+
+        /* Sequences cut short by another character */
+
+        { "\xc2" "a", 0 },
+        { "\xe2\x82" "a", 0 },
+        { "\xf0\x90\x80" "a", 0 },
+        { "\xc2\xc2\x80", 0 },
+        { "\xe2\xc2\x80", 0 },
+};
+
+/* Sequences that are incomplete at the end of the data. */
+
+static const char *incomplete_sequences[] = {
+        "\xc2", "\xe2", "\xe2\x82", "\xf0", "\xf0\x90", "\xf0\x90\x80",
+};
+
+/* Check a sequence from the corpus in the middle of a block, at 
+ * every offset and with both ASCII and multi-byte text before it. */
+
+static void check_sequence(JSONUTF8ValidateFunc validate,
+                           const TestSequence *sequence)
+{
+        static const char *fill_patterns[] = {
+                "a", "\xc3\xa9\xe2\x82\xac\xf0\x9d\x84\x9e",
+        };
+        unsigned char buf[200];
+        size_t seq_len, fill_len;
+        size_t pos, j;
+        int i;
+
+        seq_len = strlen(sequence->bytes);
+
+        for (i=0; i<ARRLEN(fill_patterns); ++i) {
+                fill_len = strlen(fill_patterns[i]);
+
+                for (pos=0; pos + seq_len < sizeof(buf); pos += fill_len) {
+                        memset(buf, 'x', sizeof(buf));
+
+                        for (j=0; j<pos; j += fill_len) {
+                                memcpy(buf + j, fill_patterns[i], fill_len);
+                        }
+
+                        memcpy(buf + pos, sequence->bytes, seq_len);
+
+                        if (sequence->valid_len == seq_len) {
+                                assert(validate(buf, sizeof(buf))
+                                       == sizeof(buf));
+                                assert(validate(buf, pos + seq_len)
+                                       == pos + seq_len);
+                        } else {
+                                assert(validate(buf, sizeof(buf))
+                                       == pos + sequence->valid_len);
+                        }
+                }
+        }
+}
+
+/* Check that incomplete sequences at the end of a block are not 
+ * included in the valid prefix. */
+
+static void check_incomplete(JSONUTF8ValidateFunc validate,
+                             const char *sequence)
+{
+        unsigned char buf[100];
+        size_t seq_len, len;
+
+        seq_len = strlen(sequence);
+
+        for (len=seq_len; len<=sizeof(buf); ++len) {
+                memset(buf, 'x', len);
+                memcpy(buf + len - seq_len, sequence, seq_len);
+                assert(validate(buf, len) == len - seq_len);
+        }
+}
+
+/* Compare an implementation against the scalar implementation on
+ * random data, made of a mixture of valid and invalid sequences. */
+
+static void test_random(JSONUTF8ValidateFunc validate)
+{
+        JSONUTF8ValidateFunc scalar;
+        unsigned char buf[300];
+        const char *seq;
+        size_t len, seq_len;
+        int i;
+
+        scalar = json_utf8_validate_get_impl("scalar");
+        srand(5678);
+
+        for (i=0; i<20000; ++i) {
+                len = 0;
+
+                for (;;) {
+                        if (rand() % 200 == 0) {
+                                seq = test_corpus[rand() % ARRLEN(test_corpus)].bytes;
+                        } else {
+                                seq = test_corpus[rand() % 10].bytes;
+                        }
+
+                        seq_len = strlen(seq);
+
+                        if (len + seq_len > sizeof(buf)) {
+                                break;
+                        }
+
+                        memcpy(buf + len, seq, seq_len);
+                        len += seq_len;
+                }
+
+                assert(validate(buf, len) == scalar(buf, len));
+        }
+}
+
+static void test_impl(JSONUTF8ValidateFunc validate)
+{
+        int i;
+
+        assert(validate((const unsigned char *) "", 0) == 0);
+
+        for (i=0; i<ARRLEN(test_corpus); ++i) {
+                check_sequence(validate, &test_corpus[i]);
+        }
+
+        for (i=0; i<ARRLEN(incomplete_sequences); ++i) {
+                check_incomplete(validate, incomplete_sequences[i]);
+        }
+
+        test_random(validate);
+}
+
+/* Invalid sequences are reported as encoding errors when read, and
+ * valid ones are decoded, whatever the block boundaries. */
+
+static void test_reader(void)
+{
+        JSONInputReader reader;
+        unsigned char buf[200];
+        size_t seq_len;
+        int i, c;
+
+        for (i=0; i<ARRLEN(test_corpus); ++i) {
+                seq_len = strlen(test_corpus[i].bytes);
+                memset(buf, 'x', sizeof(buf));
+                memcpy(buf + 70, test_corpus[i].bytes, seq_len);
+
+                json_input_reader_init_memory(&reader, buf, sizeof(buf));
+
+                do {
+                        c = json_input_read_char(&reader);
+                } while (c >= 0);
+
+                if (test_corpus[i].valid_len == seq_len) {
+                        assert(c == JSON_ERROR_END_OF_FILE);
+                } else {
+                        assert(c == JSON_ERROR_ENCODING);
+                }
+
+                json_input_reader_free(&reader);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        JSONUTF8ValidateFunc validate;
+        int i;
+
+        for (i=0; i<ARRLEN(impl_names); ++i) {
+                validate = json_utf8_validate_get_impl(impl_names[i]);
+
+                if (validate != NULL) {
+                        test_impl(validate);
+                } else {
+                        printf("%s: not supported\n", impl_names[i]);
+                }
+        }
+
+        test_reader();
+
+        return 0;
+}